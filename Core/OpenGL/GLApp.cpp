@@ -1,13 +1,66 @@
 #include "GLApp.h"
+#include "GLBenchmark.h"
+#include "GLFramebuffer.h"
+#include "GLProgram.h"
+#include "GLShaderReloader.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <glad/gl.h>
 
+#include "argh.h"
+
+#ifdef GLAPP_WITH_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 #include "Util/Debug.h"
 
-GLApp::GLApp()
+// headless mode advances the time by a fixed step to produce the same frames on every run
+static constexpr float kHeadlessDeltaSeconds = 1.0f / 60.0f;
+
+GLApp::GLApp(int argc, char** argv)
+{
+	int         width  = 0;
+	int         height = 0;
+	std::string benchmarkPath;
+
+	if (argc > 0 && argv)
+	{
+		argh::parser cmdl(argc, argv);
+		mHeadless = cmdl["--headless"];
+		cmdl("--width", 0) >> width;
+		cmdl("--height", 0) >> height;
+		cmdl("--benchmark", "") >> benchmarkPath;
+		cmdl("--benchmark-output", "benchmark.json") >> mBenchmarkOutputFileName;
+		// a benchmark runs until the end of its path
+		cmdl("--frames", mHeadless && benchmarkPath.empty() ? 1 : 0) >> mNumFrames;
+		cmdl("--capture", "") >> mCaptureFileName;
+		// measures the startup time without the on-disk program binary cache
+		if (cmdl["--no-program-cache"])
+			GLProgram::setBinaryCacheEnabled(false);
+	}
+
+	if (mHeadless)
+		initHeadless(width ? width : 1280, height ? height : 720);
+	else
+		initWindow(width, height);
+
+	initDebug();
+
+	mTimeStamp = getTime();
+
+	if (!benchmarkPath.empty())
+	{
+		mBenchmark = std::make_unique<GLBenchmark>(benchmarkPath.c_str());
+		mBenchmark->beginFrame();
+	}
+}
+
+void GLApp::initWindow(int width, int height)
 {
 	glfwSetErrorCallback([](int error, const char* description)
 	{
@@ -28,13 +81,10 @@ GLApp::GLApp()
 	const GLFWvidmode* info = glfwGetVideoMode(glfwGetPrimaryMonitor());
 	glfwGetMonitorPos(glfwGetPrimaryMonitor(), &monitorX, &monitorY);
 
-	windowWidth = (int)(info->width * 0.85f);
-	windowHeight = (int)(info->height * 0.85f);
+	windowWidth = width ? width : (int)(info->width * 0.85f);
+	windowHeight = height ? height : (int)(info->height * 0.85f);
 
 	mWindow = glfwCreateWindow(windowWidth, windowHeight, "Simple example", nullptr, nullptr);
-	glfwSetWindowPos(mWindow,
-	                 monitorX + (info->width - windowWidth) / 2,
-	                 monitorY + (info->height - windowHeight) / 2);
 
 	if (!mWindow)
 	{
@@ -42,26 +92,183 @@ GLApp::GLApp()
 		exit(EXIT_FAILURE);
 	}
 
+	glfwSetWindowPos(mWindow,
+	                 monitorX + (info->width - windowWidth) / 2,
+	                 monitorY + (info->height - windowHeight) / 2);
+
 	glfwMakeContextCurrent(mWindow);
 	gladLoadGL(glfwGetProcAddress);
 	glfwSwapInterval(0);
+}
 
-	initDebug();
+void GLApp::initHeadless(int width, int height)
+{
+#ifdef GLAPP_WITH_EGL
+	// the surfaceless platform needs neither a display server nor a GPU
+	const auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+	{
+		printf("Cannot initialize EGL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// OpenGL 4.6 first, llvmpipe only provides 4.5
+	EGLContext context = EGL_NO_CONTEXT;
+	for (const EGLint glMinor : {6, 5})
+	{
+		const EGLint attribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, glMinor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+		if (context != EGL_NO_CONTEXT)
+			break;
+	}
+
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		printf("Cannot create a surfaceless OpenGL 4.5+ context\n");
+		exit(EXIT_FAILURE);
+	}
+
+	mEGLDisplay = display;
+	mEGLContext = context;
+
+	gladLoadGL((GLADloadfunc)eglGetProcAddress);
+
+	printf("Headless rendering (EGL %d.%d): %s, OpenGL %s, %dx%d\n",
+	       major, minor, (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION), width, height);
+
+	// there is no default framebuffer without a surface
+	mOffscreenFramebuffer = std::make_unique<GLFramebuffer>(width, height, GL_RGBA8, GL_DEPTH_COMPONENT24);
+	GLFramebuffer::setDefaultHandle(mOffscreenFramebuffer->getHandle());
+	mOffscreenFramebuffer->bind();
+#else
+	printf("Headless mode is not available in this build (requires EGL)\n");
+	exit(EXIT_FAILURE);
+#endif
 }
 
 GLApp::~GLApp()
 {
+	mShaderReloader.reset();
+	mBenchmark.reset();
+
+	if (mHeadless)
+	{
+		GLFramebuffer::setDefaultHandle(0);
+		mOffscreenFramebuffer.reset();
+#ifdef GLAPP_WITH_EGL
+		eglMakeCurrent(mEGLDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(mEGLDisplay, mEGLContext);
+		eglTerminate(mEGLDisplay);
+#endif
+		return;
+	}
+
 	glfwDestroyWindow(mWindow);
 	glfwTerminate();
 }
 
+double GLApp::getTime() const
+{
+	if (!mHeadless)
+		return glfwGetTime();
+
+	static const auto startTime = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool GLApp::shouldClose() const
+{
+	if (mNumFrames && mFrameIndex >= mNumFrames)
+		return true;
+
+	if (mBenchmark && mBenchmark->isFinished())
+		return true;
+
+	return mWindow && glfwWindowShouldClose(mWindow);
+}
+
+void GLApp::getFramebufferSize(int& width, int& height) const
+{
+	if (mOffscreenFramebuffer)
+	{
+		width  = mOffscreenFramebuffer->getWidth();
+		height = mOffscreenFramebuffer->getHeight();
+		return;
+	}
+
+	glfwGetFramebufferSize(mWindow, &width, &height);
+}
+
 void GLApp::swapBuffers()
 {
-	glfwSwapBuffers(mWindow);
-	glfwPollEvents();
-	assert(glGetError() == GL_NO_ERROR);
+	// --frames defaults to 0 with --benchmark, the benchmark ends the run then
+	const bool lastFrame = (mNumFrames && mFrameIndex + 1 == mNumFrames) || (mBenchmark && mBenchmark->isLastFrame());
+
+	if (lastFrame && !mCaptureFileName.empty())
+	{
+		if (mOffscreenFramebuffer)
+			mOffscreenFramebuffer->saveColorToFile(mCaptureFileName.c_str());
+		else
+		{
+			int width, height;
+			getFramebufferSize(width, height);
+			GLFramebuffer::saveDefaultColorToFile(mCaptureFileName.c_str(), width, height);
+		}
+	}
+
+	mFrameIndex++;
+
+	if (mHeadless)
+	{
+		// the frame is complete when swapBuffers() returns, as it would be after presenting it
+		glFinish();
+		assert(glGetError() == GL_NO_ERROR);
+		mDeltaSeconds = kHeadlessDeltaSeconds;
+	}
+	else
+	{
+		glfwSwapBuffers(mWindow);
+		glfwPollEvents();
+		if (mShaderReloader)
+			GLProgram::applyReloadedPrograms();
+		assert(glGetError() == GL_NO_ERROR);
+
+		const double newTimeStamp = glfwGetTime();
+		mDeltaSeconds             = static_cast<float>(newTimeStamp - mTimeStamp);
+		mTimeStamp                = newTimeStamp;
+	}
+
+	if (mBenchmark)
+	{
+		// everything animated by the delta time has to advance the same way on every run
+		mDeltaSeconds = mBenchmark->getTimeStep();
+
+		mBenchmark->endFrame();
+		if (mBenchmark->isFinished())
+			mBenchmark->saveResults(mBenchmarkOutputFileName.c_str());
+		else
+			mBenchmark->beginFrame();
+	}
+}
+
+void GLApp::enableShaderHotReload()
+{
+	// the reloader compiles on a hidden window sharing objects with the main one
+	if (mHeadless)
+		return;
 
-	const double newTimeStamp = glfwGetTime();
-	mDeltaSeconds             = static_cast<float>(newTimeStamp - mTimeStamp);
-	mTimeStamp                = newTimeStamp;
+	if (!mShaderReloader)
+		mShaderReloader = std::make_unique<GLShaderReloader>(mWindow);
 }
@@ -3,20 +3,71 @@
 #define GLFW_INCLUDE_NONE 
 #include "GLFW/glfw3.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class GLBenchmark;
+class GLFramebuffer;
+class GLShaderReloader;
+
+// Command line options (all optional):
+//   --headless          render without a window into an offscreen framebuffer using an EGL surfaceless context,
+//                       works without a display and with Mesa llvmpipe (OpenGL 4.5 is accepted if 4.6 is not available)
+//   --width, --height   size of the window or of the offscreen framebuffer
+//   --frames=N          number of frames to render before the app closes itself (headless default: 1)
+//   --capture=file      save the last frame to a .png or .hdr file, the last one of --frames or of the benchmark
+//   --benchmark=file    replay the camera path from the file at a fixed time step and close when it ends,
+//                       see GLBenchmark and CameraPositionerPath
+//   --benchmark-output=file   where the benchmark results are written (default: benchmark.json)
+//   --no-program-cache  link every shader program instead of loading it from the binary cache, see GLProgram
+// In headless mode getWindow() returns nullptr and every frame advances the time by a fixed step, so that the
+// output is deterministic.
 class GLApp
 {
 public:
-	GLApp();
+	GLApp(int argc = 0, char** argv = nullptr);
 
 	~GLApp();
 
 	GLFWwindow* getWindow() const { return mWindow; }
 	float       getDeltaSeconds() const { return mDeltaSeconds; }
+	bool        isHeadless() const { return mHeadless; }
+	uint32_t    getFrameIndex() const { return mFrameIndex; }
+	double      getTime() const;
+
+	// nullptr unless the app was started with --benchmark
+	GLBenchmark* getBenchmark() const { return mBenchmark.get(); }
+
+	bool shouldClose() const;
+	void getFramebufferSize(int& width, int& height) const;
 
 	void swapBuffers();
 
+	// rebuilds programs in the background when their shader files change, swapped in by swapBuffers()
+	void enableShaderHotReload();
+
+private:
+	void initWindow(int width, int height);
+	void initHeadless(int width, int height);
+
 private:
 	GLFWwindow* mWindow       = nullptr;
-	double      mTimeStamp    = glfwGetTime();
+	double      mTimeStamp    = 0.0;
 	float       mDeltaSeconds = 0.f;
+
+	bool        mHeadless    = false;
+	uint32_t    mFrameIndex  = 0;
+	uint32_t    mNumFrames   = 0; // 0 means run until the window is closed
+	std::string mCaptureFileName;
+
+	// headless mode: EGL objects and the framebuffer standing in for the window
+	void*                          mEGLDisplay = nullptr;
+	void*                          mEGLContext = nullptr;
+	std::unique_ptr<GLFramebuffer> mOffscreenFramebuffer;
+
+	std::unique_ptr<GLBenchmark> mBenchmark;
+	std::string                  mBenchmarkOutputFileName;
+
+	std::unique_ptr<GLShaderReloader> mShaderReloader;
 };
@@ -0,0 +1,199 @@
+#include "GLBenchmark.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static double getTimeMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+GLBenchmark::GLBenchmark(const char* pathFileName, float timeStep, uint32_t warmupFrames)
+	: mPathFileName(pathFileName)
+	, mTimeStep(timeStep)
+	, mWarmupFrames(warmupFrames)
+{
+	if (!mPositioner.load(pathFileName))
+	{
+		printf("Benchmark: camera path '%s' is empty\n", pathFileName);
+		exit(EXIT_FAILURE);
+	}
+}
+
+GLBenchmark::~GLBenchmark()
+{
+	if (!mQueries.empty())
+		glDeleteQueries((GLsizei)mQueries.size(), mQueries.data());
+}
+
+// one frame at every time step of the path, both ends included
+static uint32_t getNumPathFrames(float duration, float timeStep)
+{
+	return (uint32_t)std::floor(duration / timeStep) + 1;
+}
+
+bool GLBenchmark::isFinished() const
+{
+	return mFrameIndex >= mWarmupFrames + getNumPathFrames(mPositioner.getDuration(), mTimeStep);
+}
+
+bool GLBenchmark::isLastFrame() const
+{
+	return mFrameIndex + 1 == mWarmupFrames + getNumPathFrames(mPositioner.getDuration(), mTimeStep);
+}
+
+void GLBenchmark::beginFrame()
+{
+	assert(!mInFrame);
+	mInFrame = true;
+
+	// the time is derived from the frame index rather than accumulated, the same frame sees the same pose on every run
+	const bool recording = mFrameIndex >= mWarmupFrames;
+	mPositioner.setTime(recording ? (mFrameIndex - mWarmupFrames) * (double)mTimeStep : 0.0);
+
+	mCurrentFrame = FrameStats();
+
+	// a pair of timestamps per frame, only read back in saveResults() so that measuring never stalls the pipeline
+	if (recording)
+	{
+		GLuint queries[2];
+		glCreateQueries(GL_TIMESTAMP, 2, queries);
+		glQueryCounter(queries[0], GL_TIMESTAMP);
+		mQueries.insert(mQueries.end(), queries, queries + 2);
+	}
+
+	mCpuBegin = getTimeMs();
+}
+
+void GLBenchmark::endFrame()
+{
+	assert(mInFrame);
+	mInFrame = false;
+
+	// warm-up frames hold the camera at the start of the path and warm shader and driver caches, they are not recorded
+	if (mFrameIndex++ < mWarmupFrames)
+		return;
+
+	glQueryCounter(mQueries.back(), GL_TIMESTAMP);
+
+	mCurrentFrame.cpuMs = getTimeMs() - mCpuBegin;
+	mFrames.push_back(mCurrentFrame);
+}
+
+void GLBenchmark::addDrawStats(uint32_t numDraws, uint64_t numTriangles, uint32_t numCulled)
+{
+	mCurrentFrame.numDraws += numDraws;
+	mCurrentFrame.numTriangles += numTriangles;
+	mCurrentFrame.numCulled += numCulled;
+}
+
+// nearest-rank percentile of sorted values
+static double getPercentile(const std::vector<double>& sorted, double percentile)
+{
+	const size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+// a JSON string, file names on Windows are full of backslashes
+static std::string getJsonString(const char* str)
+{
+	std::string json = "\"";
+	for (const char* c = str ? str : ""; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			json += '\\';
+			json += *c;
+		}
+		else if ((unsigned char)*c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)*c);
+			json += escaped;
+		}
+		else
+		{
+			json += *c;
+		}
+	}
+	return json + "\"";
+}
+
+static void writeStats(FILE* f, const char* name, std::vector<double> values, bool last = false)
+{
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for (const double v : values)
+		sum += v;
+
+	fprintf(f, "    \"%s\": {\"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+	        name, values.front(), sum / values.size(), getPercentile(values, 50.0), getPercentile(values, 95.0),
+	        getPercentile(values, 99.0), values.back(), last ? "" : ",");
+}
+
+bool GLBenchmark::saveResults(const char* fileName)
+{
+	if (mFrames.empty())
+	{
+		printf("Benchmark: no frames were recorded\n");
+		return false;
+	}
+
+	// waits for the GPU to finish the last frames
+	for (size_t i = 0; i != mFrames.size(); i++)
+	{
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(mQueries[2 * i + 0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(mQueries[2 * i + 1], GL_QUERY_RESULT, &end);
+		mFrames[i].gpuMs = (double)(end - begin) * 1e-6;
+	}
+
+	FILE* f = fopen(fileName, "w");
+
+	if (!f)
+	{
+		printf("Cannot write benchmark results '%s'\n", fileName);
+		return false;
+	}
+
+	std::vector<double> cpuMs, gpuMs, numDraws, numTriangles, numCulled;
+	for (const FrameStats& s : mFrames)
+	{
+		cpuMs.push_back(s.cpuMs);
+		gpuMs.push_back(s.gpuMs);
+		numDraws.push_back(s.numDraws);
+		numTriangles.push_back((double)s.numTriangles);
+		numCulled.push_back(s.numCulled);
+	}
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"path\": %s,\n", getJsonString(mPathFileName.c_str()).c_str());
+	fprintf(f, "  \"renderer\": %s,\n", getJsonString((const char*)glGetString(GL_RENDERER)).c_str());
+	fprintf(f, "  \"version\": %s,\n", getJsonString((const char*)glGetString(GL_VERSION)).c_str());
+	fprintf(f, "  \"timeStep\": %.6f,\n", mTimeStep);
+	fprintf(f, "  \"warmupFrames\": %u,\n", mWarmupFrames);
+	fprintf(f, "  \"frames\": %u,\n", (uint32_t)mFrames.size());
+	fprintf(f, "  \"stats\": {\n");
+	writeStats(f, "cpuMs", cpuMs);
+	writeStats(f, "gpuMs", gpuMs);
+	writeStats(f, "draws", numDraws);
+	writeStats(f, "triangles", numTriangles);
+	writeStats(f, "culled", numCulled, true);
+	fprintf(f, "  }\n");
+	fprintf(f, "}\n");
+	fclose(f);
+
+	std::sort(cpuMs.begin(), cpuMs.end());
+	std::sort(gpuMs.begin(), gpuMs.end());
+	printf("Benchmark: %u frames, CPU p50 %.2f ms p99 %.2f ms, GPU p50 %.2f ms p99 %.2f ms, saved to %s\n",
+	       (uint32_t)mFrames.size(), getPercentile(cpuMs, 50.0), getPercentile(cpuMs, 99.0),
+	       getPercentile(gpuMs, 50.0), getPercentile(gpuMs, 99.0), fileName);
+
+	return true;
+}
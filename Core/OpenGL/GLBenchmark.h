@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Util/Camera.h"
+
+// replays a camera path at a fixed time step and writes per-frame CPU/GPU times and draw stats as JSON (see --benchmark)
+class GLBenchmark
+{
+public:
+	static constexpr float    kDefaultTimeStep     = 1.0f / 60.0f;
+	static constexpr uint32_t kDefaultWarmupFrames = 30;
+
+	explicit GLBenchmark(const char* pathFileName, float timeStep = kDefaultTimeStep, uint32_t warmupFrames = kDefaultWarmupFrames);
+	~GLBenchmark();
+	GLBenchmark(const GLBenchmark&) = delete;
+
+	CameraPositionerPath& getPositioner() { return mPositioner; }
+	float                 getTimeStep() const { return mTimeStep; }
+	bool                  isFinished() const;
+	// the frame between beginFrame() and endFrame() is the last one of the path
+	bool isLastFrame() const;
+
+	void beginFrame();
+	void endFrame();
+
+	void addDrawStats(uint32_t numDraws, uint64_t numTriangles, uint32_t numCulled = 0);
+
+	bool saveResults(const char* fileName);
+
+private:
+	struct FrameStats
+	{
+		double   cpuMs        = 0.0;
+		double   gpuMs        = 0.0;
+		uint32_t numDraws     = 0;
+		uint64_t numTriangles = 0;
+		uint32_t numCulled    = 0;
+	};
+
+	CameraPositionerPath    mPositioner;
+	std::string             mPathFileName;
+	float                   mTimeStep;
+	uint32_t                mWarmupFrames;
+	uint32_t                mFrameIndex = 0;
+	bool                    mInFrame    = false;
+	double                  mCpuBegin   = 0.0;
+	FrameStats              mCurrentFrame;
+	std::vector<FrameStats> mFrames;
+	std::vector<GLuint>     mQueries; // begin and end timestamps of every recorded frame
+};
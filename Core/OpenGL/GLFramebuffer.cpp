@@ -1,5 +1,10 @@
 ﻿#include "GLFramebuffer.h"
+#include "Util/Utils.h"
 #include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include <stb/stb_image_write.h>
 
 
 GLFramebuffer::GLFramebuffer(int width, int height, GLenum formatColor, GLenum formatDepth)
@@ -45,7 +50,7 @@ GLFramebuffer::GLFramebuffer(int width, int height, GLenum formatColor, GLenum f
 
 GLFramebuffer::~GLFramebuffer()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, sDefaultHandle == mHandle ? 0 : sDefaultHandle);
 	glDeleteFramebuffers(1, &mHandle);
 }
 
@@ -59,7 +64,52 @@ void GLFramebuffer::bind()
 void GLFramebuffer::unbind()
 {
 	// revert to default frame buffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, sDefaultHandle);
 
 	// TODO: after unbinding, it may be very handy to restore the viewport parameters
 }
+
+// reads the color attachment of a framebuffer (0 is the window) and writes it to a file, OpenGL images are bottom-up
+static bool saveFramebufferColor(GLuint framebuffer, const char* fileName, int width, int height)
+{
+	const bool hdr = endsWith(fileName, ".hdr");
+
+	if (!hdr && !endsWith(fileName, ".png"))
+	{
+		printf("Unsupported image format '%s', use .png or .hdr\n", fileName);
+		return false;
+	}
+
+	const int            comp = hdr ? 3 : 4;
+	std::vector<uint8_t> pixels(width * height * comp * (hdr ? sizeof(float) : 1));
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glNamedFramebufferReadBuffer(framebuffer, framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+	GLint previous = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadPixels(0, 0, width, height, hdr ? GL_RGB : GL_RGBA, hdr ? GL_FLOAT : GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+
+	stbi_flip_vertically_on_write(1);
+	const int ok = hdr ? stbi_write_hdr(fileName, width, height, comp, (const float*)pixels.data())
+	                   : stbi_write_png(fileName, width, height, comp, pixels.data(), width * comp);
+	stbi_flip_vertically_on_write(0);
+
+	if (!ok)
+		printf("Cannot write image file '%s'\n", fileName);
+
+	return ok != 0;
+}
+
+bool GLFramebuffer::saveColorToFile(const char* fileName) const
+{
+	assert(mTexColor);
+
+	return saveFramebufferColor(mHandle, fileName, mWidth, mHeight);
+}
+
+bool GLFramebuffer::saveDefaultColorToFile(const char* fileName, int width, int height)
+{
+	return saveFramebufferColor(sDefaultHandle, fileName, width, height);
+}
@@ -12,11 +12,21 @@ public:
 	GLFramebuffer(const GLFramebuffer&) = delete;
 	GLFramebuffer(GLFramebuffer&&)      = default;
 	GLuint           getHandle() const { return mHandle; }
+	int              getWidth() const { return mWidth; }
+	int              getHeight() const { return mHeight; }
 	const GLTexture& getTextureColor() const { return *mTexColor; }
 	const GLTexture& getTextureDepth() const { return *mTexDepth; }
 	void             bind();
 	void             unbind();
 
+	// writes the color buffer to a .png (8-bit) or .hdr (floating point) file
+	bool saveColorToFile(const char* fileName) const;
+
+	// the framebuffer unbind() returns to: 0 for a window, an offscreen framebuffer in headless mode (see GLApp)
+	static GLuint getDefaultHandle() { return sDefaultHandle; }
+	static void   setDefaultHandle(GLuint handle) { sDefaultHandle = handle; }
+	static bool   saveDefaultColorToFile(const char* fileName, int width, int height);
+
 private:
 	int    mWidth;
 	int    mHeight;
@@ -25,4 +35,6 @@ private:
 	// TODO: multiple render targets (MRT) may need more than just one of each buffer
 	std::unique_ptr<GLTexture> mTexColor;
 	std::unique_ptr<GLTexture> mTexDepth;
+
+	static inline GLuint sDefaultHandle = 0;
 };
@@ -0,0 +1,55 @@
+#include "GLHiZ.h"
+
+#include <algorithm>
+
+void GLHiZ::build(GLuint depthTexture, int width, int height)
+{
+	if (!mPyramid || mWidth != width || mHeight != height)
+	{
+		mWidth  = width;
+		mHeight = height;
+
+		const int w = std::max(width / 2, 1);
+		const int h = std::max(height / 2, 1);
+
+		// the whole mip chain, down to 1x1
+		mPyramid   = std::make_unique<GLTexture>(GL_TEXTURE_2D, w, h, GL_R32F);
+		mNumLevels = 1;
+		while ((std::max(w, h) >> mNumLevels) > 0)
+			mNumLevels++;
+
+		const GLuint handle = mPyramid->getHandle();
+		glTextureParameteri(handle, GL_TEXTURE_MAX_LEVEL, mNumLevels - 1);
+		glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	const GLuint handle = mPyramid->getHandle();
+
+	mProgBuildFirst.useProgram();
+	glBindTextureUnit(0, depthTexture);
+	glBindImageTexture(1, handle, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute((std::max(mWidth / 2, 1) + 7) / 8, (std::max(mHeight / 2, 1) + 7) / 8, 1);
+
+	mProgBuild.useProgram();
+	for (int level = 1; level < mNumLevels; level++)
+	{
+		const int w = std::max(mWidth / 2 >> level, 1);
+		const int h = std::max(mHeight / 2 >> level, 1);
+
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glBindImageTexture(0, handle, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, handle, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+	}
+
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void GLHiZ::bindForCulling() const
+{
+	mProgCull.useProgram();
+	glBindTextureUnit(0, getHandle());
+}
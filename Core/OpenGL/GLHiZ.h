@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+
+#include "GLProgram.h"
+#include "GLShader.h"
+#include "GLTexture.h"
+
+// A hierarchical-Z pyramid for occlusion culling on the GPU, built from a depth buffer, usually the one of the depth
+// pre-pass. Level 0 has half the resolution of the depth buffer and every texel of every level holds the farthest depth
+// of its footprint, so a box whose nearest depth is farther than all texels it covers is hidden.
+// GLMesh::cullOcclusion() tests the shapes of a mesh against it.
+class GLHiZ
+{
+public:
+	// the pyramid is reallocated when the size of the depth buffer changes
+	void build(GLuint depthTexture, int width, int height);
+
+	// binds the culling program and the pyramid, see data/shaders/15LargeScene/occlusionCull.comp
+	void bindForCulling() const;
+
+	GLuint getHandle() const { return mPyramid ? mPyramid->getHandle() : 0; }
+	int    getNumLevels() const { return mNumLevels; }
+
+private:
+	GLShader  mShdBuildFirst = GLShader("data/shaders/15LargeScene/hiZ.comp", {"FROM_DEPTH_BUFFER"});
+	GLShader  mShdBuild      = GLShader("data/shaders/15LargeScene/hiZ.comp");
+	GLShader  mShdCull       = GLShader("data/shaders/15LargeScene/occlusionCull.comp");
+	GLProgram mProgBuildFirst = GLProgram(mShdBuildFirst);
+	GLProgram mProgBuild      = GLProgram(mShdBuild);
+	GLProgram mProgCull       = GLProgram(mShdCull);
+
+	std::unique_ptr<GLTexture> mPyramid;
+	int                        mWidth     = 0; // of the depth buffer
+	int                        mHeight    = 0;
+	int                        mNumLevels = 0;
+};
@@ -128,9 +128,9 @@ void GLImGui::defaultInitImGui()
 
 int renderSceneTree(const Scene& scene, int node)
 {
-	int         selected = -1;
-	std::string name     = getNodeName(scene, node);
-	std::string label    = name.empty() ? (std::string("Node") + std::to_string(node)) : name;
+	int              selected = -1;
+	std::string_view name     = getNodeName(scene, node);
+	std::string      label    = name.empty() ? (std::string("Node") + std::to_string(node)) : std::string(name);
 
 	const int flags = (scene.hierarchy[node].firstChild < 0) ? ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_Bullet : 0;
 
@@ -0,0 +1,51 @@
+#include "GLMaterialPermutations.h"
+
+#include <cstdio>
+
+uint32_t getMaterialPermutation(const MaterialData& mtl)
+{
+	uint32_t permutation = 0;
+
+	if (mtl.albedoMap)
+		permutation |= sMaterialPermutation_AlbedoMap;
+	if (mtl.normalMap)
+		permutation |= sMaterialPermutation_NormalMap;
+	if (mtl.flags & sMaterialFlags_AlphaTest)
+		permutation |= sMaterialPermutation_AlphaTest;
+
+	return permutation;
+}
+
+GLMaterialPermutations::GLMaterialPermutations(const char* vertexShaderFile, const char* fragmentShaderFile)
+	: mVertexShader(vertexShaderFile)
+	, mFragmentShaderFile(fragmentShaderFile)
+{
+}
+
+std::vector<std::string> GLMaterialPermutations::getDefines(uint32_t permutation)
+{
+	std::vector<std::string> defines = {"MATERIAL_PERMUTATION"};
+
+	if (permutation & sMaterialPermutation_AlbedoMap)
+		defines.push_back("MATERIAL_HAS_ALBEDO_MAP");
+	if (permutation & sMaterialPermutation_NormalMap)
+		defines.push_back("MATERIAL_HAS_NORMAL_MAP");
+	if (permutation & sMaterialPermutation_AlphaTest)
+		defines.push_back("MATERIAL_ALPHA_TEST");
+
+	return defines;
+}
+
+const GLProgram& GLMaterialPermutations::getProgram(uint32_t permutation)
+{
+	auto& program = mPrograms[permutation];
+
+	if (!program)
+	{
+		const GLShader fragmentShader(mFragmentShaderFile.c_str(), getDefines(permutation));
+		program = std::make_unique<GLProgram>(mVertexShader, fragmentShader);
+		printf("Created shader permutation 0x%x of %s\n", permutation, mFragmentShaderFile.c_str());
+	}
+
+	return *program;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "GLProgram.h"
+#include "GLShader.h"
+#include "Util/Material.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// features of a material that select a specialized shader variant
+enum MaterialPermutationBits : uint32_t
+{
+	sMaterialPermutation_AlbedoMap = 0x1,
+	sMaterialPermutation_NormalMap = 0x2,
+	sMaterialPermutation_AlphaTest = 0x4, // materials without it are opaque
+};
+
+// expects the material as stored in GLSceneData, i.e. maps are bindless handles and 0 means no map
+uint32_t getMaterialPermutation(const MaterialData& mtl);
+
+// Compiles and caches specialized variants of a scene shader program. A variant is compiled with MATERIAL_PERMUTATION
+// defined plus one define per permutation bit, so the shader only contains the code the materials of the variant use.
+// The vertex shader is shared by all variants.
+class GLMaterialPermutations
+{
+public:
+	GLMaterialPermutations(const char* vertexShaderFile, const char* fragmentShaderFile);
+
+	// the variant is created on first use
+	const GLProgram& getProgram(uint32_t permutation);
+
+	static std::vector<std::string> getDefines(uint32_t permutation);
+
+private:
+	GLShader                                                 mVertexShader;
+	std::string                                              mFragmentShaderFile;
+	std::unordered_map<uint32_t, std::unique_ptr<GLProgram>> mPrograms;
+};
@@ -1,20 +1,79 @@
 #include "GLMesh.h"
+#include "GLHiZ.h"
+#include "GLMaterialPermutations.h"
+#include "GLSceneTransforms.h"
+#include "Util/OcclusionBuffer.h"
+#include <algorithm>
+#include <numeric>
 #include <glm/glm.hpp>
 using glm::vec3;
 using glm::vec2;
 
-const static GLuint kBufferIndex_ModelMatrices = 1;
-const static GLuint kBufferIndex_Materials     = 2;
+// DrawElementsIndirectCommand::baseInstance is the index of the command, gl_BaseInstance indexes both per-command buffers
+const static GLuint kBufferIndex_CommandMaterials = 0;
+const static GLuint kBufferIndex_ModelMatrices    = 1;
+const static GLuint kBufferIndex_Materials        = 2;
+
+// occlusionCull.comp
+const static GLuint kBufferIndex_CullCommands        = 3;
+const static GLuint kBufferIndex_CullBounds          = 4;
+const static GLuint kBufferIndex_CullVisibleCommands = 5;
+const static GLuint kBufferIndex_CullDrawCounts      = 6;
+
+// scatterModelMatrices.comp
+const static GLuint kBufferIndex_ModelUpdates = 7;
+
+// copyModelMatrices.comp, the changed nodes and the global transforms are bound by GLSceneTransforms
+const static GLuint kBufferIndex_NodeCommands = 3;
+const static GLuint kBufferIndex_CommandBoxes = 5;
+
+// more moved shapes than this are uploaded as a whole
+const static uint32_t kMaxModelUpdates = 16 * 1024;
+
+// interleaved position, uv and normal
+const static uint32_t kVertexStride = 8;
+
+static GLsizeiptr getUpdateListSize(uint32_t maxUpdates, GLsizeiptr updateSize)
+{
+	// every list is bound as a range of the ring buffer
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	const GLsizeiptr size = 16 + maxUpdates * updateSize;
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+static std::vector<float> getPositions(const std::vector<float>& vertexData)
+{
+	std::vector<float> positions;
+	positions.reserve(vertexData.size() / kVertexStride * 3);
+	for (size_t i = 0; i + kVertexStride <= vertexData.size(); i += kVertexStride)
+		positions.insert(positions.end(), vertexData.begin() + i, vertexData.begin() + i + 3);
+	return positions;
+}
 
 GLMesh::GLMesh(const GLSceneData& data)
 	: mNumIndices(data.mHeader.indexDataSize / sizeof(uint32_t))
 	, mBufferIndices(data.mHeader.indexDataSize, data.mMeshData.indexData.data(), 0)
 	, mBufferVertices(data.mHeader.vertexDataSize, data.mMeshData.vertexData.data(), 0)
+	, mBufferPositions(data.mHeader.vertexDataSize / kVertexStride * 3, getPositions(data.mMeshData.vertexData).data(), 0)
 	, mBufferMaterials(sizeof(MaterialData) * data.mMaterials.size(), data.mMaterials.data(), 0)
+	, mBufferCommandMaterials(sizeof(uint32_t) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
 	  // Indirect buffer contains: NumberOfDrawCommands + Commands, where NumberOfDrawCommands is represented by one GLsizei
 	, mBufferIndirect(sizeof(DrawElementsIndirectCommand) * data.mShapes.size() + sizeof(GLsizei), nullptr, GL_DYNAMIC_STORAGE_BIT)
-	, mBufferModelMatrices(sizeof(glm::mat4) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, mBufferIndirectCulled(sizeof(DrawElementsIndirectCommand) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, mBufferIndirectVisible(sizeof(DrawElementsIndirectCommand) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	  // there are never more buckets than shapes
+	, mBufferDrawCounts(sizeof(GLuint) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, mBufferCullBounds(sizeof(CullBounds) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, mBufferModelMatrices(sizeof(glm::mat3x4) * data.mShapes.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, mMaxUpdates(std::max(std::min((uint32_t)data.mShapes.size(), kMaxModelUpdates), 1u))
+	, mUpdateListSize(getUpdateListSize(mMaxUpdates, sizeof(ModelUpdate)))
+	, mBufferUpdates(mUpdateListSize * kNumUpdateLists, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+	, mBufferNodeCommands(sizeof(uint32_t) * (data.mScene.hierarchy.size() + 1 + data.mShapes.size()), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, mBufferCommandBoxes(sizeof(glm::vec4) * 2 * std::max(data.mShapes.size(), size_t(1)), nullptr, GL_DYNAMIC_STORAGE_BIT)
 {
+	mUpdates = static_cast<uint8_t*>(glMapNamedBufferRange(mBufferUpdates.getHandle(), 0, mUpdateListSize * kNumUpdateLists, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+
 	glCreateVertexArrays(1, &mVao);
 	glVertexArrayElementBuffer(mVao, mBufferIndices.getHandle());
 	glVertexArrayVertexBuffer(mVao, 0, mBufferVertices.getHandle(), 0, sizeof(vec3) + sizeof(vec3) + sizeof(vec2));
@@ -31,6 +90,14 @@ GLMesh::GLMesh(const GLSceneData& data)
 	glVertexArrayAttribFormat(mVao, 2, 3, GL_FLOAT, GL_FALSE, sizeof(vec3) + sizeof(vec2)); //? Book says GL_TRUE, however, GL_TRUE only applies if type is an integer type
 	glVertexArrayAttribBinding(mVao, 2, 0);
 
+	// positions only, for the depth pre-pass
+	glCreateVertexArrays(1, &mVaoPositions);
+	glVertexArrayElementBuffer(mVaoPositions, mBufferIndices.getHandle());
+	glVertexArrayVertexBuffer(mVaoPositions, 0, mBufferPositions.getHandle(), 0, sizeof(vec3));
+	glEnableVertexArrayAttrib(mVaoPositions, 0);
+	glVertexArrayAttribFormat(mVaoPositions, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(mVaoPositions, 0, 0);
+
 	std::vector<uint8_t> drawCommands;
 
 	drawCommands.resize(sizeof(DrawElementsIndirectCommand) * data.mShapes.size() + sizeof(GLsizei));
@@ -44,9 +111,28 @@ GLMesh::GLMesh(const GLSceneData& data)
 		                                                drawCommands.data() + sizeof(GLsizei)
 	                                                ));
 
-	// prepare indirect commands buffer
+	// group the shapes by the shader variant their material needs, the order inside a group is preserved
+	std::vector<uint32_t> permutations(data.mShapes.size());
+	std::vector<uint32_t> order(data.mShapes.size());
 	for (size_t i = 0; i != data.mShapes.size(); i++)
+		permutations[i] = getMaterialPermutation(data.mMaterials[data.mShapes[i].materialIndex]);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&permutations](uint32_t a, uint32_t b) { return permutations[a] < permutations[b]; });
+
+	for (uint32_t c = 0; c != order.size(); c++)
 	{
+		const uint32_t permutation = permutations[order[c]];
+		if (mBuckets.empty() || mBuckets.back().permutation != permutation)
+			mBuckets.push_back({permutation, c, 0});
+		mBuckets.back().numCommands++;
+	}
+
+	// prepare indirect commands buffer, every bucket is a separate multi-draw and culling compacts the commands, so
+	// neither gl_DrawID nor gl_InstanceID identify the command; baseInstance does
+	std::vector<uint32_t> commandMaterials(order.size());
+	for (uint32_t c = 0; c != order.size(); c++)
+	{
+		const uint32_t i       = order[c];
 		const uint32_t meshIdx = data.mShapes[i].meshIndex;
 		const uint32_t lod     = data.mShapes[i].LOD;
 		*cmd++                 = {
@@ -54,31 +140,173 @@ GLMesh::GLMesh(const GLSceneData& data)
 			.instanceCount = 1,
 			.firstIndex = data.mShapes[i].indexOffset,
 			.baseVertex = data.mShapes[i].vertexOffset,
-			.baseInstance = data.mShapes[i].materialIndex
+			.baseInstance = c
 		};
+		commandMaterials[c] = data.mShapes[i].materialIndex;
+		mNumTriangles += (cmd - 1)->count / 3;
+		mCommands.push_back(*(cmd - 1));
+	}
+	glNamedBufferSubData(mBufferCommandMaterials.getHandle(), 0, commandMaterials.size() * sizeof(uint32_t), commandMaterials.data());
+	mNumDrawCommands = numCommands;
+	mCommandShapes   = order;
+
+	mShapeCommands.resize(order.size());
+	for (uint32_t c = 0; c != order.size(); c++)
+		mShapeCommands[order[c]] = c;
+
+	// commands grouped by their node, counting sort, the starts are relative to the first command
+	const size_t          numNodes = data.mScene.hierarchy.size();
+	std::vector<uint32_t> nodeCommands(numNodes + 1 + order.size(), 0);
+	for (const uint32_t i : order)
+		nodeCommands[data.mShapes[i].transformIndex + 1]++;
+	for (size_t n = 1; n <= numNodes; n++)
+		nodeCommands[n] += nodeCommands[n - 1];
+	std::vector<uint32_t> next(nodeCommands.begin(), nodeCommands.begin() + numNodes);
+	for (uint32_t c = 0; c != order.size(); c++)
+		nodeCommands[numNodes + 1 + next[data.mShapes[order[c]].transformIndex]++] = c;
+	glNamedBufferSubData(mBufferNodeCommands.getHandle(), 0, nodeCommands.size() * sizeof(uint32_t), nodeCommands.data());
+
+	std::vector<glm::vec4> commandBoxes;
+	commandBoxes.reserve(order.size() * 2);
+	for (const uint32_t i : order)
+	{
+		const BoundingBox& box = data.mMeshData.boundingBoxes[data.mShapes[i].meshIndex];
+		commandBoxes.emplace_back(box.min, 0.0f);
+		commandBoxes.emplace_back(box.max, 0.0f);
 	}
+	glNamedBufferSubData(mBufferCommandBoxes.getHandle(), 0, commandBoxes.size() * sizeof(glm::vec4), commandBoxes.data());
 
 	glNamedBufferSubData(mBufferIndirect.getHandle(), 0, drawCommands.size(), drawCommands.data());
 
-	std::vector<glm::mat4> matrices(data.mShapes.size());
-	size_t                 i = 0;
-	for (const auto& c : data.mShapes)
-		matrices[i++] = data.mScene.globalTransform[c.transformIndex];
+	updateModelMatrices(data);
+}
+
+void GLMesh::updateModelMatrices(const GLSceneData& data)
+{
+	// matrices follow the order of the draw commands, shaders get the 3 rows of the affine matrices
+	std::vector<glm::mat3x4> matrices(mCommandShapes.size());
+	size_t                   i = 0;
+	for (const uint32_t c : mCommandShapes)
+		matrices[i++] = glm::transpose(data.mScene.globalTransform[data.mShapes[c].transformIndex]);
+
+	glNamedBufferSubData(mBufferModelMatrices.getHandle(), 0, matrices.size() * sizeof(glm::mat3x4), matrices.data());
+
+	std::vector<CullBounds> bounds(mCommandShapes.size());
+	for (uint32_t b = 0; b != mBuckets.size(); b++)
+	{
+		const DrawBucket& bucket = mBuckets[b];
+		for (uint32_t c = bucket.firstCommand; c != bucket.firstCommand + bucket.numCommands; c++)
+		{
+			const BoundingBox& box = data.mShapeBoxes[mCommandShapes[c]];
+			bounds[c]              = {box.min, b, box.max, bucket.firstCommand};
+		}
+	}
+
+	glNamedBufferSubData(mBufferCullBounds.getHandle(), 0, bounds.size() * sizeof(CullBounds), bounds.data());
+}
+
+void GLMesh::updateMovedShapes(const GLSceneData& data)
+{
+	const std::vector<uint32_t>& shapes = data.mMovedShapes;
+
+	if (shapes.empty())
+		return;
+
+	if (shapes.size() > mMaxUpdates)
+	{
+		updateModelMatrices(data);
+		return;
+	}
+
+	// wait until the GPU is done with the list written kNumUpdateLists calls ago, which is practically never
+	const uint32_t list = mNextUpdateList;
+	mNextUpdateList     = (mNextUpdateList + 1) % kNumUpdateLists;
+	if (mUpdateFences[list])
+	{
+		while (glClientWaitSync(mUpdateFences[list], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(mUpdateFences[list]);
+		mUpdateFences[list] = nullptr;
+	}
+
+	uint8_t* const     ptr     = mUpdates + list * mUpdateListSize;
+	const uint32_t     count   = (uint32_t)shapes.size();
+	ModelUpdate* const updates = reinterpret_cast<ModelUpdate*>(ptr + 16);
+	memcpy(ptr, &count, sizeof(count));
+	for (uint32_t i = 0; i != count; i++)
+	{
+		const uint32_t     shape = shapes[i];
+		const BoundingBox& box   = data.mShapeBoxes[shape];
+		updates[i]               = {
+			.model = glm::transpose(data.mScene.globalTransform[data.mShapes[shape].transformIndex]),
+			.boxMin = box.min,
+			.command = mShapeCommands[shape],
+			.boxMax = box.max,
+			.padding = 0
+		};
+	}
 
-	glNamedBufferSubData(mBufferModelMatrices.getHandle(), 0, matrices.size() * sizeof(mat4), matrices.data());
+	mProgScatter.useProgram();
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelUpdates, mBufferUpdates.getHandle(), list * mUpdateListSize, mUpdateListSize);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, mBufferModelMatrices.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CullBounds, mBufferCullBounds.getHandle());
+
+	glDispatchCompute((count + 63) / 64, 1, 1);
+	// the matrices are read by vertex shaders and the bounds by occlusionCull.comp
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	mUpdateFences[list] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
-void GLMesh::draw(const GLSceneData& data) const
+void GLMesh::updateModelMatrices(const GLSceneTransforms& transforms)
+{
+	mProgCopyTransforms.useProgram();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, mBufferModelMatrices.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CullBounds, mBufferCullBounds.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_NodeCommands, mBufferNodeCommands.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CommandBoxes, mBufferCommandBoxes.getHandle());
+
+	bool anyChanged = false;
+	for (int level = 0; level != MAX_NODE_LEVEL; level++)
+	{
+		const uint32_t numNodes = transforms.getNumChangedNodes(level);
+		if (!numNodes)
+			continue;
+		transforms.bindChangedNodes(level);
+		glDispatchCompute((numNodes + 63) / 64, 1, 1);
+		anyChanged = true;
+	}
+
+	if (anyChanged)
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GLMesh::getModelMatrices(std::vector<glm::mat4x3>& shapeTransforms) const
+{
+	std::vector<glm::mat3x4> rows(mCommandShapes.size());
+	glGetNamedBufferSubData(mBufferModelMatrices.getHandle(), 0, rows.size() * sizeof(glm::mat3x4), rows.data());
+
+	shapeTransforms.resize(mShapeCommands.size());
+	for (uint32_t shape = 0; shape != mShapeCommands.size(); shape++)
+		shapeTransforms[shape] = glm::transpose(rows[mShapeCommands[shape]]);
+}
+
+void GLMesh::bindBuffers() const
 {
 	glBindVertexArray(mVao);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, mBufferModelMatrices.getHandle());
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Materials, mBufferMaterials.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CommandMaterials, mBufferCommandMaterials.getHandle());
 
 	// https://www.khronos.org/registry/OpenGL/specs/gl/glspec46.core.pdf
 
 	// upload the command container
 	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mBufferIndirect.getHandle());
 	glBindBuffer(GL_PARAMETER_BUFFER, mBufferIndirect.getHandle());
+}
+
+void GLMesh::draw(const GLSceneData& data) const
+{
+	bindBuffers();
 
 	glMultiDrawElementsIndirectCount(GL_TRIANGLES,
 	                                 GL_UNSIGNED_INT,
@@ -88,7 +316,150 @@ void GLMesh::draw(const GLSceneData& data) const
 	                                 0);                           // the array elements is tightly packed
 }
 
+void GLMesh::draw(const GLSceneData& data, GLMaterialPermutations& permutations) const
+{
+	bindBuffers();
+
+	for (const DrawBucket& b : mBuckets)
+	{
+		permutations.getProgram(b.permutation).useProgram();
+		glMultiDrawElementsIndirect(GL_TRIANGLES,
+		                           GL_UNSIGNED_INT,
+		                           (const void*)(sizeof(GLsizei) + b.firstCommand * sizeof(DrawElementsIndirectCommand)),
+		                           (GLsizei)b.numCommands,
+		                           0);
+	}
+}
+
+void GLMesh::drawDepth() const
+{
+	glBindVertexArray(mVaoPositions);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, mBufferModelMatrices.getHandle());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mBufferIndirect.getHandle());
+
+	// alpha-tested shapes would need their texture coordinates, they are left to the main pass
+	for (const DrawBucket& b : mBuckets)
+	{
+		if (b.permutation & sMaterialPermutation_AlphaTest)
+			continue;
+		glMultiDrawElementsIndirect(GL_TRIANGLES,
+		                            GL_UNSIGNED_INT,
+		                            (const void*)(sizeof(GLsizei) + b.firstCommand * sizeof(DrawElementsIndirectCommand)),
+		                            (GLsizei)b.numCommands,
+		                            0);
+	}
+}
+
+void GLMesh::cullOcclusion(const GLHiZ& hiZ)
+{
+	hiZ.bindForCulling();
+
+	glClearNamedBufferData(mBufferDrawCounts.getHandle(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CullCommands, mBufferIndirect.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CullBounds, mBufferCullBounds.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CullVisibleCommands, mBufferIndirectVisible.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CullDrawCounts, mBufferDrawCounts.getHandle());
+
+	glDispatchCompute((mNumDrawCommands + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+uint32_t GLMesh::cullOcclusion(const GLSceneData& data, const OcclusionBuffer& buffer)
+{
+	mCulledCommands.resize(mCommands.size());
+	mDrawCounts.assign(mBuckets.size(), 0);
+
+	uint32_t numVisible = 0;
+
+	for (uint32_t b = 0; b != mBuckets.size(); b++)
+	{
+		const DrawBucket& bucket = mBuckets[b];
+		for (uint32_t c = bucket.firstCommand; c != bucket.firstCommand + bucket.numCommands; c++)
+		{
+			if (buffer.isVisible(data.mShapeBoxes[mCommandShapes[c]]))
+				mCulledCommands[bucket.firstCommand + mDrawCounts[b]++] = mCommands[c];
+		}
+		numVisible += mDrawCounts[b];
+	}
+
+	glNamedBufferSubData(mBufferIndirectVisible.getHandle(), 0, mCulledCommands.size() * sizeof(DrawElementsIndirectCommand), mCulledCommands.data());
+	glNamedBufferSubData(mBufferDrawCounts.getHandle(), 0, mDrawCounts.size() * sizeof(uint32_t), mDrawCounts.data());
+
+	return (uint32_t)mCommands.size() - numVisible;
+}
+
+void GLMesh::rasterizeOccluders(const GLSceneData& data, OcclusionBuffer& buffer, float minSize) const
+{
+	for (const DrawBucket& b : mBuckets)
+	{
+		if (b.permutation & sMaterialPermutation_AlphaTest)
+			continue;
+		for (uint32_t c = b.firstCommand; c != b.firstCommand + b.numCommands; c++)
+		{
+			const uint32_t shape = mCommandShapes[c];
+			const vec3     size  = data.mShapeBoxes[shape].max - data.mShapeBoxes[shape].min;
+			if (std::max({size.x, size.y, size.z}) < minSize)
+				continue;
+			buffer.rasterizeShape(data.mMeshData, data.mShapes[shape], glm::mat4(data.mScene.globalTransform[data.mShapes[shape].transformIndex]));
+		}
+	}
+}
+
+void GLMesh::drawVisible(GLMaterialPermutations& permutations) const
+{
+	bindBuffers();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mBufferIndirectVisible.getHandle());
+	glBindBuffer(GL_PARAMETER_BUFFER, mBufferDrawCounts.getHandle());
+
+	for (uint32_t i = 0; i != mBuckets.size(); i++)
+	{
+		const DrawBucket& b = mBuckets[i];
+		permutations.getProgram(b.permutation).useProgram();
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES,
+		                                 GL_UNSIGNED_INT,
+		                                 (const void*)(b.firstCommand * sizeof(DrawElementsIndirectCommand)),
+		                                 (GLintptr)(i * sizeof(GLuint)),
+		                                 (GLsizei)b.numCommands,
+		                                 0);
+	}
+}
+
+uint32_t GLMesh::drawCulled(const GLSceneData& data, const glm::mat4& viewProj, uint32_t materialFlags)
+{
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 frustumCorners[8];
+	getFrustumPlanes(viewProj, frustumPlanes);
+	getFrustumCorners(viewProj, frustumCorners);
+
+	mCulledCommands.clear();
+	for (size_t c = 0; c != mCommands.size(); c++)
+	{
+		const uint32_t shape = mCommandShapes[c];
+		if ((data.mMaterials[data.mShapes[shape].materialIndex].flags & materialFlags) != materialFlags)
+			continue;
+		if (isBoxInFrustum(frustumPlanes, frustumCorners, data.mShapeBoxes[shape]))
+			mCulledCommands.push_back(mCommands[c]);
+	}
+
+	if (!mCulledCommands.empty())
+	{
+		glNamedBufferSubData(mBufferIndirectCulled.getHandle(), 0, mCulledCommands.size() * sizeof(DrawElementsIndirectCommand), mCulledCommands.data());
+
+		bindBuffers();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mBufferIndirectCulled.getHandle());
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)mCulledCommands.size(), 0);
+	}
+
+	return (uint32_t)(mCommands.size() - mCulledCommands.size());
+}
+
 GLMesh::~GLMesh()
 {
+	for (GLsync fence : mUpdateFences)
+		if (fence)
+			glDeleteSync(fence);
+	glUnmapNamedBuffer(mBufferUpdates.getHandle());
 	glDeleteVertexArrays(1, &mVao);
+	glDeleteVertexArrays(1, &mVaoPositions);
 }
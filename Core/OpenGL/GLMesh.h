@@ -1,8 +1,15 @@
 #pragma once
 #include "GLBuffer.h"
+#include "GLProgram.h"
 #include "GLSceneData.h"
+#include "GLShader.h"
 #include "Util/VtxData.h"
 
+class GLHiZ;
+class GLMaterialPermutations;
+class GLSceneTransforms;
+class OcclusionBuffer;
+
 // describes a single draw command
 struct DrawElementsIndirectCommand
 {
@@ -19,21 +26,126 @@ public:
 	explicit GLMesh(const GLSceneData& data);
 
 	void draw(const GLSceneData& data) const;
+	// draws each bucket of shapes with the shader variant specialized for their materials
+	void draw(const GLSceneData& data, GLMaterialPermutations& permutations) const;
+	// draws the shapes whose world bounds intersect the frustum and whose material has all of the materialFlags,
+	// with the currently bound program. Returns the number of culled shapes.
+	uint32_t drawCulled(const GLSceneData& data, const glm::mat4& viewProj, uint32_t materialFlags = 0);
+
+	// depth pre-pass: draws the opaque shapes with a position-only vertex stream and the currently bound program
+	void drawDepth() const;
+
+	// occlusion culling, the visible shapes of each bucket are drawn by drawVisible()
+	// on the GPU against a Hi-Z pyramid, the number of visible shapes is never read back
+	void cullOcclusion(const GLHiZ& hiZ);
+	// on the CPU against a software occlusion buffer, returns the number of culled shapes
+	uint32_t cullOcclusion(const GLSceneData& data, const OcclusionBuffer& buffer);
+	// rasterizes the opaque shapes whose bounds are at least minSize wide into the occlusion buffer
+	void rasterizeOccluders(const GLSceneData& data, OcclusionBuffer& buffer, float minSize) const;
+	void drawVisible(GLMaterialPermutations& permutations) const;
+
+	// uploads the global transforms and bounds of all shapes again
+	void updateModelMatrices(const GLSceneData& data);
+	// uploads the global transforms and bounds of GLSceneData::mMovedShapes only, call after
+	// GLSceneData::updateTransforms(). Falls back to updateModelMatrices() if too many shapes have moved.
+	void updateMovedShapes(const GLSceneData& data);
+	// copies the global transforms of the nodes recalculated by GLSceneTransforms::update() into the model matrices and
+	// recalculates the bounds of their shapes, all on the GPU. The transforms have to be created from the scene of the
+	// same GLSceneData. GLSceneData::mShapeBoxes is not updated, so drawCulled() and the CPU version of cullOcclusion()
+	// keep seeing the old bounds.
+	void updateModelMatrices(const GLSceneTransforms& transforms);
+	// reads the model matrix of every shape back, for validation
+	void getModelMatrices(std::vector<glm::mat4x3>& shapeTransforms) const;
+
+	uint32_t getNumDrawCommands() const { return mNumDrawCommands; }
+	uint64_t getNumTriangles() const { return mNumTriangles; }
 
 	~GLMesh();
 
 	GLMesh(const GLMesh&);
 	GLMesh(GLMesh&&);
 
+private:
+	void bindBuffers() const;
+
+	// draw commands are sorted by material permutation, each bucket is a contiguous range of commands
+	struct DrawBucket
+	{
+		uint32_t permutation;
+		uint32_t firstCommand;
+		uint32_t numCommands;
+	};
+
+	// world bounds of the shape of a draw command for occlusionCull.comp, std430 layout
+	struct CullBounds
+	{
+		glm::vec3 boxMin;
+		uint32_t  bucket;
+		glm::vec3 boxMax;
+		uint32_t  bucketFirstCommand;
+	};
+	static_assert(sizeof(CullBounds) == 32, "CullBounds must match the std430 layout of occlusionCull.comp");
+
+	// a moved shape for scatterModelMatrices.comp, std430 layout
+	struct ModelUpdate
+	{
+		glm::mat3x4 model;
+		glm::vec3   boxMin;
+		uint32_t    command;
+		glm::vec3   boxMax;
+		uint32_t    padding;
+	};
+	static_assert(sizeof(ModelUpdate) == 80, "ModelUpdate must match the std430 layout of scatterModelMatrices.comp");
+
+	// the update lists are written by the CPU while the GPU may still read the ones of the previous frames
+	static constexpr uint32_t kNumUpdateLists = 3;
+
 private:
 	GLuint   mVao;
+	GLuint   mVaoPositions;
 	uint32_t mNumIndices;
+	uint32_t mNumDrawCommands = 0;
+	uint64_t mNumTriangles    = 0;
 
 	GLBuffer mBufferIndices;
 	GLBuffer mBufferVertices;
+	GLBuffer mBufferPositions;
 	GLBuffer mBufferMaterials;
+	GLBuffer mBufferCommandMaterials; // the material of every draw command
 
 	GLBuffer mBufferIndirect;
+	GLBuffer mBufferIndirectCulled;
+	// occlusion culling: the visible commands of every bucket start at the first command of the bucket
+	GLBuffer mBufferIndirectVisible;
+	GLBuffer mBufferDrawCounts; // one per bucket
+	GLBuffer mBufferCullBounds;
 
 	GLBuffer mBufferModelMatrices;
+
+	// persistently mapped ring of update lists, each is the number of updates padded to 16 bytes and the updates
+	uint32_t   mMaxUpdates;
+	GLsizeiptr mUpdateListSize;
+	GLBuffer   mBufferUpdates;
+	uint8_t*   mUpdates;
+	uint32_t   mNextUpdateList = 0;
+	GLsync     mUpdateFences[kNumUpdateLists] = {};
+
+	GLShader  mShdScatter  = GLShader("data/shaders/15LargeScene/scatterModelMatrices.comp");
+	GLProgram mProgScatter = GLProgram(mShdScatter);
+
+	// GPU transforms: the start of the commands of every node, then the commands, and the mesh bounds of every command
+	GLBuffer mBufferNodeCommands;
+	GLBuffer mBufferCommandBoxes;
+
+	GLShader  mShdCopyTransforms  = GLShader("data/shaders/15LargeScene/copyModelMatrices.comp");
+	GLProgram mProgCopyTransforms = GLProgram(mShdCopyTransforms);
+
+	std::vector<DrawBucket> mBuckets;
+
+	// CPU copy of the draw commands and the shape each of them draws, for culling
+	std::vector<DrawElementsIndirectCommand> mCommands;
+	std::vector<uint32_t>                    mCommandShapes;
+	std::vector<uint32_t>                    mShapeCommands; // the inverse of mCommandShapes
+	std::vector<DrawElementsIndirectCommand> mCulledCommands;
+	std::vector<uint32_t>                    mDrawCounts;
 };
@@ -0,0 +1,310 @@
+#include "GLProfiler.h"
+
+#include <imgui/imgui.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+GLProfiler::~GLProfiler()
+{
+	for (Frame& f : mFrames)
+		if (!f.queries.empty())
+			glDeleteQueries((GLsizei)f.queries.size(), f.queries.data());
+}
+
+double GLProfiler::getTime() const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count() - mStartTime;
+}
+
+void GLProfiler::beginFrame()
+{
+	if (mStartTime < 0.0)
+		mStartTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	Frame& frame = mFrames[mFrameIndex % kFramesInFlight];
+
+	if (frame.pending)
+		resolveFrame(frame);
+
+	frame.scopes.clear();
+	frame.numQueries = 0;
+
+	// does not wait for the GPU, it returns the time at which all previous commands have reached the GPU
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	frame.gpuOffset = getTime() - (double)gpuTime * 1e-3;
+
+	mStack.clear();
+	beginScope("Frame");
+}
+
+void GLProfiler::endFrame()
+{
+	endScope();
+	assert(mStack.empty());
+
+	mFrames[mFrameIndex % kFramesInFlight].pending = true;
+	mFrameIndex++;
+}
+
+void GLProfiler::beginScope(const char* name, bool gpu)
+{
+	Frame& frame = mFrames[mFrameIndex % kFramesInFlight];
+
+	Scope scope = {.name = name, .depth = (uint32_t)mStack.size()};
+
+	if (gpu)
+	{
+		if (frame.numQueries + 2 > frame.queries.size())
+		{
+			const size_t oldSize = frame.queries.size();
+			frame.queries.resize(oldSize + 32);
+			glCreateQueries(GL_TIMESTAMP, 32, frame.queries.data() + oldSize);
+		}
+		scope.query = (int32_t)frame.numQueries;
+		frame.numQueries += 2;
+		glQueryCounter(frame.queries[scope.query], GL_TIMESTAMP);
+	}
+
+	mStack.push_back((uint32_t)frame.scopes.size());
+
+	scope.cpuBegin = getTime();
+	frame.scopes.push_back(scope);
+}
+
+void GLProfiler::endScope()
+{
+	assert(!mStack.empty());
+
+	Frame& frame = mFrames[mFrameIndex % kFramesInFlight];
+	Scope& scope = frame.scopes[mStack.back()];
+	mStack.pop_back();
+
+	scope.cpuEnd = getTime();
+
+	if (scope.query >= 0)
+		glQueryCounter(frame.queries[scope.query + 1], GL_TIMESTAMP);
+}
+
+void GLProfiler::resolveFrame(Frame& frame)
+{
+	frame.pending = false;
+
+	if (frame.numQueries)
+	{
+		// queries complete in order, so if the last one is available all of them are
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(frame.queries[frame.numQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			mDroppedFrames++;
+			return;
+		}
+
+		for (Scope& s : frame.scopes)
+		{
+			if (s.query < 0)
+				continue;
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(frame.queries[s.query], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.queries[s.query + 1], GL_QUERY_RESULT, &end);
+			s.gpuBegin = (double)begin * 1e-3 + frame.gpuOffset;
+			s.gpuEnd   = (double)end * 1e-3 + frame.gpuOffset;
+		}
+	}
+
+	if (mPaused)
+		return;
+
+	mHistory.push_back(frame.scopes);
+	if (mHistory.size() > kHistorySize)
+		mHistory.pop_front();
+}
+
+static ImU32 getScopeColor(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c; c++)
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
+	return IM_COL32(96 + (hash & 0x7F), 96 + ((hash >> 8) & 0x7F), 96 + ((hash >> 16) & 0x7F), 255);
+}
+
+void GLProfiler::renderUI()
+{
+	ImGui::Begin("Profiler", nullptr);
+
+	ImGui::Checkbox("Pause", &mPaused);
+	ImGui::SameLine();
+	if (ImGui::Button("Export Chrome trace"))
+	{
+		if (exportChromeTrace("profile.json"))
+			printf("Profiler: saved %u frames to profile.json\n", (uint32_t)mHistory.size());
+	}
+
+	if (mHistory.empty())
+	{
+		ImGui::Text("Waiting for the GPU...");
+		ImGui::End();
+		return;
+	}
+
+	const std::vector<Scope>& frame = mHistory.back();
+
+	// the GPU runs behind the CPU, the timeline covers both
+	double t0 = frame[0].cpuBegin;
+	double t1 = frame[0].cpuEnd;
+	uint32_t maxDepth = 0;
+	for (const Scope& s : frame)
+	{
+		if (s.query >= 0)
+		{
+			t0 = std::min(t0, s.gpuBegin);
+			t1 = std::max(t1, s.gpuEnd);
+		}
+		maxDepth = std::max(maxDepth, s.depth);
+	}
+
+	ImGui::Text("Frame: CPU %.2f ms, GPU %.2f ms, dropped frames: %u",
+	            (frame[0].cpuEnd - frame[0].cpuBegin) * 1e-3, (frame[0].gpuEnd - frame[0].gpuBegin) * 1e-3, mDroppedFrames);
+
+	// flame graph: one band of rows for the CPU and one for the GPU, a row per nesting level
+	ImDrawList*  drawList   = ImGui::GetWindowDrawList();
+	const ImVec2 origin     = ImGui::GetCursorScreenPos();
+	const float  width      = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+	const float  rowHeight  = ImGui::CalcTextSize("A").y + 4.0f;
+	const float  bandHeight = rowHeight * (maxDepth + 1);
+	const double scale      = width / std::max(t1 - t0, 1.0);
+
+	for (int gpu = 0; gpu != 2; gpu++)
+	{
+		const float y0 = origin.y + gpu * (bandHeight + rowHeight);
+		drawList->AddText(ImVec2(origin.x, y0), IM_COL32(255, 255, 255, 255), gpu ? "GPU" : "CPU");
+
+		for (const Scope& s : frame)
+		{
+			if (gpu && s.query < 0)
+				continue;
+			const double begin = gpu ? s.gpuBegin : s.cpuBegin;
+			const double end   = gpu ? s.gpuEnd : s.cpuEnd;
+			const ImVec2 p0((float)(origin.x + (begin - t0) * scale), y0 + rowHeight * (s.depth + 1));
+			const ImVec2 p1(std::max((float)(origin.x + (end - t0) * scale), p0.x + 1.0f), p0.y + rowHeight - 1.0f);
+			drawList->AddRectFilled(p0, p1, getScopeColor(s.name));
+			drawList->PushClipRect(p0, p1, true);
+			drawList->AddText(ImVec2(p0.x + 2.0f, p0.y + 2.0f), IM_COL32(0, 0, 0, 255), s.name);
+			drawList->PopClipRect();
+		}
+	}
+
+	ImGui::Dummy(ImVec2(width, 2.0f * (bandHeight + rowHeight)));
+
+	// rolling averages and history, a scope that runs several times per frame is summed
+	if (ImGui::BeginTable("Scopes", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("CPU ms");
+		ImGui::TableSetupColumn("GPU ms");
+		ImGui::TableSetupColumn("History");
+		ImGui::TableHeadersRow();
+
+		std::vector<float> history(mHistory.size());
+
+		for (size_t i = 0; i != frame.size(); i++)
+		{
+			const Scope& scope = frame[i];
+
+			// only the first occurrence of every name gets a row
+			if (std::any_of(frame.begin(), frame.begin() + i, [&scope](const Scope& s) { return !strcmp(s.name, scope.name); }))
+				continue;
+
+			double cpuTotal = 0.0, gpuTotal = 0.0;
+			for (size_t f = 0; f != mHistory.size(); f++)
+			{
+				double cpu = 0.0, gpu = 0.0;
+				for (const Scope& s : mHistory[f])
+				{
+					if (strcmp(s.name, scope.name))
+						continue;
+					cpu += s.cpuEnd - s.cpuBegin;
+					if (s.query >= 0)
+						gpu += s.gpuEnd - s.gpuBegin;
+				}
+				cpuTotal += cpu;
+				gpuTotal += gpu;
+				history[f] = (float)((scope.query >= 0 ? gpu : cpu) * 1e-3);
+			}
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Indent(10.0f * scope.depth + 1.0f);
+			ImGui::TextUnformatted(scope.name);
+			ImGui::Unindent(10.0f * scope.depth + 1.0f);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", cpuTotal * 1e-3 / mHistory.size());
+			ImGui::TableNextColumn();
+			if (scope.query >= 0)
+				ImGui::Text("%.3f", gpuTotal * 1e-3 / mHistory.size());
+			ImGui::TableNextColumn();
+			ImGui::PushID(scope.name);
+			ImGui::PlotLines("##history", history.data(), (int)history.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(150.0f, rowHeight));
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+static void writeJsonString(FILE* f, const char* str)
+{
+	fputc('"', f);
+	for (const char* c = str; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', f);
+		fputc(*c, f);
+	}
+	fputc('"', f);
+}
+
+bool GLProfiler::exportChromeTrace(const char* fileName) const
+{
+	FILE* f = fopen(fileName, "w");
+
+	if (!f)
+	{
+		printf("Cannot write profiler trace '%s'\n", fileName);
+		return false;
+	}
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+
+	for (const auto& frame : mHistory)
+	{
+		for (const Scope& s : frame)
+		{
+			for (int gpu = 0; gpu != 2; gpu++)
+			{
+				if (gpu && s.query < 0)
+					continue;
+				const double begin = gpu ? s.gpuBegin : s.cpuBegin;
+				const double end   = gpu ? s.gpuEnd : s.cpuEnd;
+				fprintf(f, ",\n{\"name\":");
+				writeJsonString(f, s.name);
+				fprintf(f, ",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", gpu, begin, end - begin);
+			}
+		}
+	}
+
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(f);
+
+	return true;
+}
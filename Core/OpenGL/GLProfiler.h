@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Frame profiler with nested CPU and GPU scopes.
+// GPU scopes are measured with GL_TIMESTAMP query counters, since GL_TIME_ELAPSED queries cannot be nested.
+// Queries are recycled in a ring of kFramesInFlight frames and read back when the ring wraps around, by then the GPU
+// has finished the frame and reading the results never stalls. If it has not, the frame is dropped instead.
+// Scope names must be string literals (or otherwise outlive the profiler).
+class GLProfiler
+{
+public:
+	static constexpr uint32_t kFramesInFlight = 3;
+	static constexpr uint32_t kHistorySize    = 128;
+
+	GLProfiler() = default;
+	~GLProfiler();
+	GLProfiler(const GLProfiler&) = delete;
+
+	// opens the "Frame" scope, call at the beginning of the main loop
+	void beginFrame();
+	// closes the "Frame" scope, call before swapping buffers
+	void endFrame();
+
+	void beginScope(const char* name, bool gpu = true);
+	void endScope();
+
+	// ImGui window with a flame graph of the last complete frame and the rolling history of every scope
+	void renderUI();
+
+	// writes the frames of the history as Chrome trace events, see chrome://tracing or https://ui.perfetto.dev
+	bool exportChromeTrace(const char* fileName) const;
+
+private:
+	// times are in microseconds since the first frame, GPU times are moved onto the CPU timeline
+	struct Scope
+	{
+		const char* name;
+		uint32_t    depth;
+		double      cpuBegin = 0.0;
+		double      cpuEnd   = 0.0;
+		double      gpuBegin = 0.0;
+		double      gpuEnd   = 0.0;
+		int32_t     query    = -1; // index of the pair of timestamp queries in the frame, -1 for CPU-only scopes
+	};
+
+	struct Frame
+	{
+		std::vector<Scope>  scopes;
+		std::vector<GLuint> queries;
+		uint32_t            numQueries = 0;
+		double              gpuOffset  = 0.0; // CPU time minus GPU time at the beginning of the frame
+		bool                pending    = false;
+	};
+
+	void   resolveFrame(Frame& frame);
+	double getTime() const;
+
+private:
+	Frame                          mFrames[kFramesInFlight];
+	uint32_t                       mFrameIndex = 0;
+	std::vector<uint32_t>          mStack;
+	std::deque<std::vector<Scope>> mHistory; // complete frames, the newest is at the back
+	uint32_t                       mDroppedFrames = 0;
+	double                         mStartTime     = -1.0;
+	bool                           mPaused        = false;
+};
+
+// measures the enclosing C++ scope
+class GLProfilerScope
+{
+public:
+	GLProfilerScope(GLProfiler& profiler, const char* name, bool gpu = true)
+		: mProfiler(profiler)
+	{
+		mProfiler.beginScope(name, gpu);
+	}
+
+	~GLProfilerScope() { mProfiler.endScope(); }
+
+	GLProfilerScope(const GLProfilerScope&) = delete;
+
+private:
+	GLProfiler& mProfiler;
+};
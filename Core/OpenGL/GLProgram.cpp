@@ -1,8 +1,30 @@
 ﻿#include "GLProgram.h"
 #include "GLShader.h"
+#include "Util/ShaderPreprocessor.h"
+#include "Util/Utils.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstring>
 #include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char*   kProgramCacheFolder = "data/cache/programs";
+static const uint32_t kProgramCacheMagic  = 0x50524F47; // "PROG"
+
+static bool                gBinaryCacheEnabled = true;
+static GLProgramCacheStats gCacheStats;
+
+// live programs and the handles rebuilt for them by the hot reload thread, waiting to be swapped in
+static std::mutex                                gProgramsMutex;
+static std::vector<GLProgram*>                   gPrograms;
+static std::vector<std::pair<GLProgram*, GLuint>> gReloadedPrograms;
 
 static void printProgramInfoLog(GLuint handle)
 {
@@ -16,47 +38,135 @@ static void printProgramInfoLog(GLuint handle)
 	}
 }
 
+// the cache key covers the fully preprocessed sources and the driver, since program binaries are driver-specific
+static uint64_t getProgramCacheKey(std::initializer_list<const GLShader*> shaders)
+{
+	uint64_t hash = hash64(nullptr, 0);
+
+	for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+	{
+		const char* str = (const char*)glGetString(name);
+		if (str)
+			hash = hash64(str, strlen(str), hash);
+	}
+
+	for (const GLShader* s : shaders)
+	{
+		const GLenum type = s->getType();
+		hash              = hash64(&type, sizeof(type), hash);
+		hash              = hash64(s->getSource().data(), s->getSource().size(), hash);
+	}
+
+	return hash;
+}
+
+static std::string getProgramCacheFileName(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return (fs::path(kProgramCacheFolder) / name).string();
+}
+
+// returns true if a valid binary was found and successfully loaded into the program
+static bool loadProgramBinary(GLuint handle, const std::string& fileName)
+{
+	FILE* f = fopen(fileName.c_str(), "rb");
+	if (!f)
+		return false;
+
+	uint32_t header[3] = {0, 0, 0}; // magic, binary format, binary size
+	std::vector<uint8_t> binary;
+
+	const bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == kProgramCacheMagic &&
+	                (binary.resize(header[2]), fread(binary.data(), 1, binary.size(), f) == binary.size());
+	fclose(f);
+
+	if (!ok)
+		return false;
+
+	glProgramBinary(handle, (GLenum)header[1], binary.data(), (GLsizei)binary.size());
+
+	// the driver rejects binaries created by a different driver version
+	GLint status = GL_FALSE;
+	glGetProgramiv(handle, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+static void saveProgramBinary(GLuint handle, const std::string& fileName)
+{
+	GLint length = 0;
+	glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<uint8_t> binary(length);
+	GLenum               format = 0;
+	glGetProgramBinary(handle, length, nullptr, &format, binary.data());
+
+	std::error_code ec;
+	fs::create_directories(kProgramCacheFolder, ec);
+
+	FILE* f = fopen(fileName.c_str(), "wb");
+	if (!f)
+	{
+		printf("Cannot write program binary cache file '%s'\n", fileName.c_str());
+		return;
+	}
+
+	const uint32_t header[3] = {kProgramCacheMagic, (uint32_t)format, (uint32_t)length};
+	fwrite(header, sizeof(header), 1, f);
+	fwrite(binary.data(), 1, binary.size(), f);
+	fclose(f);
+}
+
+static bool isBinaryCacheSupported()
+{
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	return numFormats > 0;
+}
+
 GLProgram::GLProgram(const GLShader& a)
 	: mHandle(glCreateProgram())
 {
-	glAttachShader(mHandle, a.getHandle());
-	glLinkProgram(mHandle);
-	printProgramInfoLog(mHandle);
+	create({&a});
 }
 
 GLProgram::GLProgram(const GLShader& a, const GLShader& b)
 	: mHandle(glCreateProgram())
 {
-	glAttachShader(mHandle, a.getHandle());
-	glAttachShader(mHandle, b.getHandle());
-	glLinkProgram(mHandle);
-	printProgramInfoLog(mHandle);
+	create({&a, &b});
 }
 
 GLProgram::GLProgram(const GLShader& a, const GLShader& b, const GLShader& c)
 	: mHandle(glCreateProgram())
 {
-	glAttachShader(mHandle, a.getHandle());
-	glAttachShader(mHandle, b.getHandle());
-	glAttachShader(mHandle, c.getHandle());
-	glLinkProgram(mHandle);
-	printProgramInfoLog(mHandle);
+	create({&a, &b, &c});
 }
 
 GLProgram::GLProgram(const GLShader& a, const GLShader& b, const GLShader& c, const GLShader& d, const GLShader& e)
 	: mHandle(glCreateProgram())
 {
-	glAttachShader(mHandle, a.getHandle());
-	glAttachShader(mHandle, b.getHandle());
-	glAttachShader(mHandle, c.getHandle());
-	glAttachShader(mHandle, d.getHandle());
-	glAttachShader(mHandle, e.getHandle());
-	glLinkProgram(mHandle);
-	printProgramInfoLog(mHandle);
+	create({&a, &b, &c, &d, &e});
 }
 
 GLProgram::~GLProgram()
 {
+	{
+		std::lock_guard<std::mutex> lock(gProgramsMutex);
+		gPrograms.erase(std::find(gPrograms.begin(), gPrograms.end(), this));
+		for (auto i = gReloadedPrograms.begin(); i != gReloadedPrograms.end();)
+		{
+			if (i->first == this)
+			{
+				glDeleteProgram(i->second);
+				i = gReloadedPrograms.erase(i);
+			}
+			else
+				i++;
+		}
+	}
+
 	glDeleteProgram(mHandle);
 }
 
@@ -64,3 +174,200 @@ void GLProgram::useProgram() const
 {
 	glUseProgram(mHandle);
 }
+
+void GLProgram::setBinaryCacheEnabled(bool enabled)
+{
+	gBinaryCacheEnabled = enabled;
+}
+
+bool GLProgram::isBinaryCacheEnabled()
+{
+	return gBinaryCacheEnabled;
+}
+
+const GLProgramCacheStats& GLProgram::getCacheStats()
+{
+	return gCacheStats;
+}
+
+void GLProgram::create(std::initializer_list<const GLShader*> shaders)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	const bool        useCache = gBinaryCacheEnabled && isBinaryCacheSupported();
+	const uint64_t    key      = useCache ? getProgramCacheKey(shaders) : 0;
+	const std::string fileName = useCache ? getProgramCacheFileName(key) : std::string();
+
+	const bool cacheHit = useCache && loadProgramBinary(mHandle, fileName);
+
+	if (!cacheHit)
+	{
+		// cache miss: compile the shaders (happens in GLShader::getHandle()) and link them
+		for (const GLShader* s : shaders)
+			glAttachShader(mHandle, s->getHandle());
+		if (useCache)
+			glProgramParameteri(mHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(mHandle);
+		printProgramInfoLog(mHandle);
+		for (const GLShader* s : shaders)
+			glDetachShader(mHandle, s->getHandle());
+
+		if (useCache)
+			saveProgramBinary(mHandle, fileName);
+	}
+
+	for (const GLShader* s : shaders)
+		mShaders.push_back({s->getType(), s->isLoadedFromFile() ? s->getFileName() : std::string(), s->getDefines(),
+		                    s->isLoadedFromFile() ? std::string() : s->getSource()});
+
+	{
+		std::lock_guard<std::mutex> lock(gProgramsMutex);
+		gPrograms.push_back(this);
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	cacheHit ? gCacheStats.hits++ : gCacheStats.misses++;
+	gCacheStats.seconds += seconds;
+}
+
+std::vector<std::string> GLProgram::getSourceFiles()
+{
+	std::vector<std::string> files;
+
+	std::lock_guard<std::mutex> lock(gProgramsMutex);
+
+	for (const GLProgram* p : gPrograms)
+		for (const ShaderDesc& s : p->mShaders)
+		{
+			if (s.fileName.empty())
+				continue;
+			addUnique(files, ShaderPreprocessor::normalizePath(s.fileName));
+			for (const auto& dep : ShaderPreprocessor::instance().getDependencies(s.fileName))
+				addUnique(files, dep);
+		}
+
+	return files;
+}
+
+// returns 0 if any of the shaders fails to compile or the program fails to link
+static GLuint buildProgram(const std::vector<std::pair<GLenum, std::string>>& sources, const std::vector<std::string>& fileNames)
+{
+	std::vector<GLuint> shaders;
+	bool                ok = true;
+
+	for (size_t i = 0; i != sources.size() && ok; i++)
+	{
+		const GLuint shader = sources[i].second.empty() ? 0 : GLShader::tryCompile(sources[i].first, sources[i].second, fileNames[i]);
+		ok                  = shader != 0;
+		if (ok)
+			shaders.push_back(shader);
+	}
+
+	GLuint handle = 0;
+
+	if (ok)
+	{
+		handle = glCreateProgram();
+		for (GLuint s : shaders)
+			glAttachShader(handle, s);
+		glLinkProgram(handle);
+
+		GLint status = GL_FALSE;
+		glGetProgramiv(handle, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE)
+		{
+			char    buffer[8192];
+			GLsizei length = 0;
+			glGetProgramInfoLog(handle, sizeof(buffer), &length, buffer);
+			printf("%s\n", buffer);
+			glDeleteProgram(handle);
+			handle = 0;
+		}
+	}
+
+	for (GLuint s : shaders)
+		glDeleteShader(s);
+
+	return handle;
+}
+
+void GLProgram::reloadPrograms(const std::vector<std::string>& changedFiles)
+{
+	// find the affected programs before the include graph of the changed files is dropped
+	std::vector<std::pair<GLProgram*, std::vector<ShaderDesc>>> affected;
+	{
+		std::lock_guard<std::mutex> lock(gProgramsMutex);
+
+		auto isChanged = [&changedFiles](const std::string& file) {
+			return std::find(changedFiles.begin(), changedFiles.end(), file) != changedFiles.end();
+		};
+
+		for (GLProgram* p : gPrograms)
+			for (const ShaderDesc& s : p->mShaders)
+			{
+				if (s.fileName.empty())
+					continue;
+				const auto deps = ShaderPreprocessor::instance().getDependencies(s.fileName);
+				if (isChanged(ShaderPreprocessor::normalizePath(s.fileName)) || std::any_of(deps.begin(), deps.end(), isChanged))
+				{
+					affected.push_back({p, p->mShaders});
+					break;
+				}
+			}
+	}
+
+	for (const auto& f : changedFiles)
+		ShaderPreprocessor::instance().invalidate(f);
+
+	std::vector<std::pair<GLProgram*, GLuint>> reloaded;
+
+	for (const auto& a : affected)
+	{
+		std::vector<std::pair<GLenum, std::string>> sources;
+		std::vector<std::string>                    fileNames;
+		for (const ShaderDesc& s : a.second)
+		{
+			sources.push_back({s.type, s.fileName.empty() ? s.source : ShaderPreprocessor::instance().process(s.fileName.c_str(), nullptr, s.defines)});
+			fileNames.push_back(s.fileName);
+		}
+
+		const GLuint handle = buildProgram(sources, fileNames);
+
+		if (handle)
+			reloaded.push_back({a.first, handle});
+		else
+			printf("Reloading failed, keeping the previous version of the program (File: %s)\n", fileNames.front().c_str());
+	}
+
+	if (reloaded.empty())
+		return;
+
+	// the new programs must be complete before the main context starts using them
+	glFinish();
+
+	std::lock_guard<std::mutex> lock(gProgramsMutex);
+
+	for (const auto& r : reloaded)
+	{
+		// the program may have been destroyed while it was being rebuilt
+		if (std::find(gPrograms.begin(), gPrograms.end(), r.first) != gPrograms.end())
+			gReloadedPrograms.push_back(r);
+		else
+			glDeleteProgram(r.second);
+	}
+}
+
+void GLProgram::applyReloadedPrograms()
+{
+	std::lock_guard<std::mutex> lock(gProgramsMutex);
+
+	for (const auto& r : gReloadedPrograms)
+	{
+		glDeleteProgram(r.first->mHandle);
+		r.first->mHandle = r.second;
+		printf("Reloaded program %u\n", r.second);
+	}
+
+	gReloadedPrograms.clear();
+}
@@ -1,9 +1,21 @@
 ﻿#pragma once
 
 #include <glad/gl.h>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
 
 class GLShader;
 
+// statistics of the on-disk program binary cache, used to report the startup cost of shader programs
+struct GLProgramCacheStats
+{
+	uint32_t hits    = 0;
+	uint32_t misses  = 0;
+	double   seconds = 0.0; // total time spent creating programs
+};
+
 class GLProgram
 {
 public:
@@ -12,10 +24,38 @@ public:
 	GLProgram(const GLShader& a, const GLShader& b, const GLShader& c);
 	GLProgram(const GLShader& a, const GLShader& b, const GLShader& c, const GLShader& d, const GLShader& e);
 	~GLProgram();
+	GLProgram(const GLProgram&) = delete;
 
 	void   useProgram() const;
 	GLuint getHandle() const { return mHandle; }
 
+	// linked programs are stored in data/cache/programs and reused on the next launch
+	// GLApp disables it with --no-program-cache
+	static void                       setBinaryCacheEnabled(bool enabled);
+	static bool                       isBinaryCacheEnabled();
+	static const GLProgramCacheStats& getCacheStats();
+
+	// hot reload, see GLShaderReloader
+	// all shader files and includes used by the live programs
+	static std::vector<std::string> getSourceFiles();
+	// rebuilds the programs affected by the changed files, requires a current GL context sharing objects with the main one
+	static void reloadPrograms(const std::vector<std::string>& changedFiles);
+	// swaps in the reloaded handles, called by the main thread between frames
+	static void applyReloadedPrograms();
+
 private:
-	GLuint mHandle;
-};
\ No newline at end of file
+	void create(std::initializer_list<const GLShader*> shaders);
+
+private:
+	// what is needed to rebuild the program: shaders loaded from files are preprocessed again, others keep their text
+	struct ShaderDesc
+	{
+		GLenum                   type;
+		std::string              fileName;
+		std::vector<std::string> defines;
+		std::string              source;
+	};
+
+	GLuint                  mHandle;
+	std::vector<ShaderDesc> mShaders;
+};
@@ -0,0 +1,372 @@
+#include "GLRenderGraph.h"
+#include "GLFramebuffer.h"
+#include "GLProfiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+// bytes per texel of the formats used for render targets, only used for the statistics
+static uint32_t getFormatSize(GLenum format)
+{
+	switch (format)
+	{
+	case GL_R8:
+		return 1;
+	case GL_R16F:
+	case GL_RG8:
+		return 2;
+	case GL_RGBA8:
+	case GL_R32F:
+	case GL_RG16F:
+	case GL_R11F_G11F_B10F:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+		return 4;
+	case GL_RGBA16F:
+	case GL_RG32F:
+	case GL_DEPTH32F_STENCIL8:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+static uint64_t getTextureSize(const GLRenderGraph::TextureDesc& desc)
+{
+	uint64_t size = 0;
+	for (int level = 0; level != desc.levels; level++)
+		size += (uint64_t)std::max(desc.width >> level, 1) * std::max(desc.height >> level, 1) * getFormatSize(desc.format);
+	return size;
+}
+
+static bool hasStencil(GLenum format)
+{
+	return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+GLRenderGraph::~GLRenderGraph()
+{
+	for (const auto& [key, framebuffer] : mFramebuffers)
+		glDeleteFramebuffers(1, &framebuffer);
+}
+
+void GLRenderGraph::PassBuilder::read(Resource r)
+{
+	mGraph.mPasses[mPass].uses.push_back({r, Access::Read, 0});
+}
+
+void GLRenderGraph::PassBuilder::readImage(Resource r)
+{
+	mGraph.mPasses[mPass].uses.push_back({r, Access::ReadImage, 0});
+}
+
+void GLRenderGraph::PassBuilder::writeImage(Resource r)
+{
+	mGraph.mPasses[mPass].uses.push_back({r, Access::WriteImage, 0});
+}
+
+void GLRenderGraph::PassBuilder::writeColor(Resource r, uint32_t index)
+{
+	mGraph.mPasses[mPass].uses.push_back({r, Access::WriteColor, index});
+}
+
+void GLRenderGraph::PassBuilder::writeDepth(Resource r)
+{
+	mGraph.mPasses[mPass].uses.push_back({r, Access::WriteDepth, 0});
+}
+
+void GLRenderGraph::PassBuilder::writeBackbuffer()
+{
+	mGraph.mPasses[mPass].writesBackbuffer = true;
+}
+
+void GLRenderGraph::PassBuilder::setSideEffect()
+{
+	mGraph.mPasses[mPass].sideEffect = true;
+}
+
+void GLRenderGraph::reset(int backbufferWidth, int backbufferHeight)
+{
+	mPasses.clear();
+	mResources.clear();
+	mBackbufferWidth  = backbufferWidth;
+	mBackbufferHeight = backbufferHeight;
+}
+
+GLRenderGraph::Resource GLRenderGraph::createTexture(const char* name, const TextureDesc& desc)
+{
+	mResources.push_back({.name = name, .desc = desc});
+	return (Resource)mResources.size() - 1;
+}
+
+GLRenderGraph::Resource GLRenderGraph::importTexture(const char* name, GLuint texture, int width, int height)
+{
+	mResources.push_back({.name = name, .desc = {.width = width, .height = height}, .imported = true, .texture = texture});
+	return (Resource)mResources.size() - 1;
+}
+
+void GLRenderGraph::addPass(const char* name, const SetupFunc& setup, const ExecuteFunc& execute)
+{
+	mPasses.push_back({.name = name, .execute = execute});
+	PassBuilder builder(*this, (uint32_t)mPasses.size() - 1);
+	setup(builder);
+}
+
+GLuint GLRenderGraph::getTexture(Resource r) const
+{
+	assert(r < mResources.size());
+	return mResources[r].texture;
+}
+
+void GLRenderGraph::compile()
+{
+	mStats = Stats{.numPasses = (uint32_t)mPasses.size()};
+
+	// culling: walk back from the passes with visible results and keep the passes producing what they read
+	std::vector<bool> needed(mResources.size(), false);
+	for (size_t p = mPasses.size(); p-- > 0;)
+	{
+		Pass& pass = mPasses[p];
+		pass.alive = pass.writesBackbuffer || pass.sideEffect;
+		for (const ResourceUse& u : pass.uses)
+			if (u.access >= Access::WriteImage && (needed[u.resource] || mResources[u.resource].imported))
+				pass.alive = true;
+
+		if (!pass.alive)
+		{
+			mStats.numCulledPasses++;
+			continue;
+		}
+
+		// a read-modify-write keeps the earlier writers too
+		for (const ResourceUse& u : pass.uses)
+			if (u.access <= Access::WriteImage)
+				needed[u.resource] = true;
+	}
+
+	// lifetimes of the transients in the passes that run
+	for (uint32_t p = 0; p != mPasses.size(); p++)
+	{
+		if (!mPasses[p].alive)
+			continue;
+		for (const ResourceUse& u : mPasses[p].uses)
+		{
+			ResourceInfo& r = mResources[u.resource];
+			r.firstPass     = std::min(r.firstPass, p);
+			r.lastPass      = std::max(r.lastPass, p);
+		}
+	}
+
+	// aliasing: transients are placed in order of their first use, a physical texture is reused as soon as the
+	// previous transient placed into it is dead
+	for (PhysicalTexture& t : mTextures)
+		t.used = false;
+
+	std::vector<uint32_t> order(mResources.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return mResources[a].firstPass < mResources[b].firstPass; });
+
+	for (const uint32_t i : order)
+	{
+		ResourceInfo& r = mResources[i];
+		if (r.imported || r.firstPass == ~0u)
+			continue;
+
+		mStats.numTransients++;
+		mStats.transientBytes += getTextureSize(r.desc);
+
+		uint32_t physical = ~0u;
+		for (uint32_t t = 0; t != mTextures.size() && physical == ~0u; t++)
+			if (mTextures[t].desc == r.desc && (!mTextures[t].used || mTextures[t].busyUntil < r.firstPass))
+				physical = t;
+
+		if (physical == ~0u)
+		{
+			PhysicalTexture t = {.desc = r.desc, .texture = std::make_unique<GLTexture>(GL_TEXTURE_2D, r.desc.width, r.desc.height, r.desc.format)};
+			const GLuint    handle = t.texture->getHandle();
+			glTextureParameteri(handle, GL_TEXTURE_MAX_LEVEL, r.desc.levels - 1);
+			glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, r.desc.levels > 1 ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+			glTextureParameteri(handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			mTextures.push_back(std::move(t));
+			physical = (uint32_t)mTextures.size() - 1;
+		}
+
+		PhysicalTexture& t = mTextures[physical];
+		t.used             = true;
+		t.busyUntil        = r.lastPass;
+		r.texture          = t.texture->getHandle();
+	}
+
+	// textures no transient needed this frame are released (the resolution or the set of passes has changed)
+	for (size_t t = mTextures.size(); t-- > 0;)
+	{
+		if (mTextures[t].used)
+			continue;
+		releaseTexture(mTextures[t].texture->getHandle());
+		mTextures.erase(mTextures.begin() + t);
+	}
+
+	mStats.numTextures = (uint32_t)mTextures.size();
+	for (const PhysicalTexture& t : mTextures)
+		mStats.textureBytes += getTextureSize(t.desc);
+}
+
+void GLRenderGraph::releaseTexture(GLuint texture)
+{
+	mPendingBarriers.erase(texture);
+
+	// the names of deleted textures get reused, so framebuffers referencing them have to go
+	for (auto i = mFramebuffers.begin(); i != mFramebuffers.end();)
+	{
+		const bool references = std::any_of(i->first.begin(), i->first.end(), [texture](const auto& a) { return a.second == texture; });
+		if (references)
+		{
+			glDeleteFramebuffers(1, &i->second);
+			i = mFramebuffers.erase(i);
+		}
+		else
+			++i;
+	}
+}
+
+GLuint GLRenderGraph::getFramebuffer(const Pass& pass, int& width, int& height)
+{
+	if (pass.writesBackbuffer)
+	{
+		width  = mBackbufferWidth;
+		height = mBackbufferHeight;
+		return GLFramebuffer::getDefaultHandle();
+	}
+
+	FramebufferKey key;
+	for (const ResourceUse& u : pass.uses)
+	{
+		if (u.access != Access::WriteColor && u.access != Access::WriteDepth)
+			continue;
+
+		const ResourceInfo& r = mResources[u.resource];
+		width                 = r.desc.width;
+		height                = r.desc.height;
+
+		if (u.access == Access::WriteColor)
+			key.push_back({GL_COLOR_ATTACHMENT0 + u.index, r.texture});
+		else
+			key.push_back({hasStencil(r.desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, r.texture});
+	}
+
+	if (key.empty())
+		return 0;
+
+	std::sort(key.begin(), key.end());
+
+	const auto i = mFramebuffers.find(key);
+	if (i != mFramebuffers.end())
+		return i->second;
+
+	GLuint framebuffer = 0;
+	glCreateFramebuffers(1, &framebuffer);
+
+	std::vector<GLenum> drawBuffers;
+	for (const auto& [attachment, texture] : key)
+	{
+		glNamedFramebufferTexture(framebuffer, attachment, texture, 0);
+		if (attachment >= GL_COLOR_ATTACHMENT0 && attachment <= GL_COLOR_ATTACHMENT15)
+			drawBuffers.push_back(attachment);
+	}
+
+	if (drawBuffers.empty())
+		glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+	else
+		glNamedFramebufferDrawBuffers(framebuffer, (GLsizei)drawBuffers.size(), drawBuffers.data());
+
+	const GLenum status = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER);
+	assert(status == GL_FRAMEBUFFER_COMPLETE);
+
+	mFramebuffers[key] = framebuffer;
+	return framebuffer;
+}
+
+void GLRenderGraph::execute(GLProfiler* profiler)
+{
+	compile();
+
+	// nothing is known about the framebuffer bound before the graph runs
+	GLuint boundFramebuffer = ~0u;
+
+	for (const Pass& pass : mPasses)
+	{
+		if (!pass.alive)
+			continue;
+
+		// image stores are not coherent with anything, wait for the ones this pass depends on
+		GLbitfield barriers = 0;
+		for (const ResourceUse& u : pass.uses)
+		{
+			const auto pending = mPendingBarriers.find(getTexture(u.resource));
+			if (pending == mPendingBarriers.end())
+				continue;
+			switch (u.access)
+			{
+			case Access::Read:
+				barriers |= pending->second & GL_TEXTURE_FETCH_BARRIER_BIT;
+				break;
+			case Access::ReadImage:
+			case Access::WriteImage:
+				barriers |= pending->second & GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+				break;
+			case Access::WriteColor:
+			case Access::WriteDepth:
+				barriers |= pending->second & GL_FRAMEBUFFER_BARRIER_BIT;
+				break;
+			}
+		}
+
+		if (barriers)
+		{
+			glMemoryBarrier(barriers);
+			mStats.numBarriers++;
+			for (auto i = mPendingBarriers.begin(); i != mPendingBarriers.end();)
+			{
+				i->second &= ~barriers;
+				i = i->second ? std::next(i) : mPendingBarriers.erase(i);
+			}
+		}
+
+		int          width = 0, height = 0;
+		const GLuint framebuffer = getFramebuffer(pass, width, height);
+		if (width && height)
+		{
+			if (framebuffer != boundFramebuffer)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+				boundFramebuffer = framebuffer;
+				mStats.numFramebufferBinds++;
+			}
+			glViewport(0, 0, width, height);
+		}
+
+		if (profiler)
+			profiler->beginScope(pass.name);
+
+		pass.execute(PassContext(*this, framebuffer));
+
+		if (profiler)
+			profiler->endScope();
+
+		for (const ResourceUse& u : pass.uses)
+			if (u.access == Access::WriteImage)
+				mPendingBarriers[getTexture(u.resource)] = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+	}
+
+	// whatever runs after the graph expects the default framebuffer
+	if (boundFramebuffer != GLFramebuffer::getDefaultHandle())
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, GLFramebuffer::getDefaultHandle());
+		mStats.numFramebufferBinds++;
+	}
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "GLTexture.h"
+
+class GLProfiler;
+
+// A render graph for a frame: passes declare which textures they read and write, the graph runs them in the order
+// they were added and takes care of everything in between.
+// - passes whose results are never read are culled, unless they write to the window or are marked as side effects
+// - transient textures only live from the first to the last pass using them, transient textures with the same
+//   description and non-overlapping lifetimes share a single GL texture. Physical textures are kept across frames
+// - render targets get a framebuffer object each, cached across frames, which is only bound when it changes
+// - glMemoryBarrier() is issued before a pass uses a texture written with image stores, with only the bits it needs
+// The graph is rebuilt every frame: reset(), create or import textures, add passes, execute().
+class GLRenderGraph
+{
+public:
+	using Resource = uint32_t;
+	static constexpr Resource kInvalidResource = ~0u;
+
+	struct TextureDesc
+	{
+		int    width  = 0;
+		int    height = 0;
+		GLenum format = 0;
+		int    levels = 1;
+
+		bool operator==(const TextureDesc&) const = default;
+	};
+
+	class PassBuilder
+	{
+	public:
+		// sampled with texture() or texelFetch()
+		void read(Resource r);
+		// imageLoad()
+		void readImage(Resource r);
+		// imageStore(), the pass binds the image itself
+		void writeImage(Resource r);
+		// render targets, the graph binds the framebuffer and sets the viewport to the size of the attachments
+		void writeColor(Resource r, uint32_t index = 0);
+		void writeDepth(Resource r);
+		// renders to the default framebuffer (see GLFramebuffer::getDefaultHandle())
+		void writeBackbuffer();
+		// the pass is never culled
+		void setSideEffect();
+
+	private:
+		friend class GLRenderGraph;
+		PassBuilder(GLRenderGraph& graph, uint32_t pass) : mGraph(graph), mPass(pass) {}
+
+		GLRenderGraph& mGraph;
+		uint32_t       mPass;
+	};
+
+	class PassContext
+	{
+	public:
+		GLuint getTexture(Resource r) const { return mGraph.getTexture(r); }
+		// the framebuffer the pass renders to, 0 for compute passes
+		GLuint getFramebuffer() const { return mFramebuffer; }
+
+	private:
+		friend class GLRenderGraph;
+		PassContext(const GLRenderGraph& graph, GLuint framebuffer) : mGraph(graph), mFramebuffer(framebuffer) {}
+
+		const GLRenderGraph& mGraph;
+		GLuint               mFramebuffer;
+	};
+
+	using SetupFunc   = std::function<void(PassBuilder&)>;
+	using ExecuteFunc = std::function<void(const PassContext&)>;
+
+	struct Stats
+	{
+		uint32_t numPasses           = 0;
+		uint32_t numCulledPasses     = 0;
+		uint32_t numTransients       = 0;
+		uint32_t numTextures         = 0; // physical textures behind the transients
+		uint64_t transientBytes      = 0; // if every transient had its own texture
+		uint64_t textureBytes        = 0; // actually allocated
+		uint32_t numFramebufferBinds = 0;
+		uint32_t numBarriers         = 0;
+	};
+
+	GLRenderGraph() = default;
+	~GLRenderGraph();
+	GLRenderGraph(const GLRenderGraph&) = delete;
+
+	void reset(int backbufferWidth, int backbufferHeight);
+
+	Resource createTexture(const char* name, const TextureDesc& desc);
+	// a texture owned by someone else, it outlives the frame so passes writing to it are never culled
+	Resource importTexture(const char* name, GLuint texture, int width, int height);
+
+	// pass names must be string literals, they are used as profiler scopes
+	void addPass(const char* name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+	void execute(GLProfiler* profiler = nullptr);
+
+	// valid from execute() until the next reset(), an aliased texture holds what the last pass using it has written
+	GLuint getTexture(Resource r) const;
+
+	const Stats& getStats() const { return mStats; }
+
+private:
+	enum class Access : uint8_t
+	{
+		// reads first, the order is used to tell reads from writes
+		Read,
+		ReadImage,
+		WriteImage,
+		WriteColor,
+		WriteDepth,
+	};
+
+	struct ResourceUse
+	{
+		Resource resource;
+		Access   access;
+		uint32_t index; // color attachment
+	};
+
+	struct Pass
+	{
+		const char*              name;
+		ExecuteFunc              execute;
+		std::vector<ResourceUse> uses;
+		bool                     writesBackbuffer = false;
+		bool                     sideEffect       = false;
+		bool                     alive            = false;
+	};
+
+	struct ResourceInfo
+	{
+		std::string name;
+		TextureDesc desc;
+		bool        imported  = false;
+		GLuint      texture   = 0; // imported, or the physical texture after compile()
+		uint32_t    firstPass = ~0u;
+		uint32_t    lastPass  = 0;
+	};
+
+	struct PhysicalTexture
+	{
+		TextureDesc                desc;
+		std::unique_ptr<GLTexture> texture;
+		uint32_t                   busyUntil = 0; // last pass of the transient using it in this frame
+		bool                       used      = false;
+	};
+
+	using FramebufferKey = std::vector<std::pair<GLenum, GLuint>>; // attachment, texture
+
+	void   compile();
+	GLuint getFramebuffer(const Pass& pass, int& width, int& height);
+	void   releaseTexture(GLuint texture);
+
+private:
+	std::vector<Pass>         mPasses;
+	std::vector<ResourceInfo> mResources;
+
+	// persistent across frames
+	std::vector<PhysicalTexture>     mTextures;
+	std::map<FramebufferKey, GLuint> mFramebuffers;
+	// glMemoryBarrier() bits a texture still needs since its last image store
+	std::map<GLuint, GLbitfield>     mPendingBarriers;
+
+	int   mBackbufferWidth  = 0;
+	int   mBackbufferHeight = 0;
+	Stats mStats;
+};
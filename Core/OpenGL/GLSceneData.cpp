@@ -14,20 +14,29 @@ GLSceneData::GLSceneData(
 	const char* materialFile)
 {
 	// load mesh data
-	mHeader = loadMeshData(meshFile, mMeshData);
+	if (!loadMeshData(meshFile, mMeshData, &mHeader))
+		exit(EXIT_FAILURE);
+	recalculateBoundingBoxes(mMeshData);
 
 	// load scene data
 	loadScene(sceneFile);
 
 	// load material data
 	std::vector<std::string> textureFiles;
-	loadMaterials(materialFile, mMaterials, textureFiles);
+	std::vector<uint32_t>    textureArrays;
+	if (!loadMaterials(materialFile, mMaterials, textureFiles, textureArrays))
+		exit(EXIT_FAILURE);
 
-	for (const auto& f : textureFiles)
+	// every texture array gets a single bindless handle, no matter how many layers it has
+	mAllMaterialTextures.reserve(textureArrays.size());
+	for (size_t i = 0; i + 1 < textureArrays.size(); i++)
 	{
-		mAllMaterialTextures.emplace_back(GL_TEXTURE_2D, f.c_str());
+		const std::vector<std::string> layers(textureFiles.begin() + textureArrays[i], textureFiles.begin() + textureArrays[i + 1]);
+		mAllMaterialTextures.emplace_back(GL_TEXTURE_2D_ARRAY, layers);
 	}
 
+	printf("Loaded %u textures into %u texture arrays\n", (uint32_t)textureFiles.size(), (uint32_t)mAllMaterialTextures.size());
+
 	for (auto& mtl : mMaterials)
 	{
 		mtl.ambientOcclusionMap  = getTextureHandleBindless(mtl.ambientOcclusionMap, mAllMaterialTextures);
@@ -38,28 +47,97 @@ GLSceneData::GLSceneData(
 	}
 }
 
+GLSceneData::GLSceneData(MeshData&& meshData, Scene&& scene, std::vector<MaterialData>&& materials)
+	: mMeshData(std::move(meshData))
+	, mScene(std::move(scene))
+	, mMaterials(std::move(materials))
+{
+	mHeader = {
+		.magicValue = 0x12345678,
+		.meshCount = (uint32_t)mMeshData.meshes.size(),
+		.dataBlockStartOffset = 0,
+		.indexDataSize = (uint32_t)(mMeshData.indexData.size() * sizeof(uint32_t)),
+		.vertexDataSize = (uint32_t)(mMeshData.vertexData.size() * sizeof(float))
+	};
+	if (mMeshData.boundingBoxes.size() != mMeshData.meshes.size())
+		recalculateBoundingBoxes(mMeshData);
+
+	initShapes();
+}
+
 void GLSceneData::loadScene(const char* sceneFile)
 {
-	::loadScene(sceneFile, mScene);
+	if (!::loadScene(sceneFile, mScene))
+		exit(EXIT_FAILURE);
+
+	initShapes();
+}
+
+void GLSceneData::initShapes()
+{
+	// scenes converted before the conversion tool sorted them are still depth-first
+	reorderNodesByLevel(mScene);
 
 	// prepare draw data buffer
-	for (const auto& c : mScene.nodeIDToMeshID)
+	mShapes = getSceneShapes(mScene, mMeshData);
+
+	// shapes grouped by their node, counting sort
+	mNodeShapesStart.assign(mScene.hierarchy.size() + 1, 0);
+	for (const DrawData& d : mShapes)
+		mNodeShapesStart[d.transformIndex + 1]++;
+	for (size_t i = 1; i != mNodeShapesStart.size(); i++)
+		mNodeShapesStart[i] += mNodeShapesStart[i - 1];
+	mNodeShapes.resize(mShapes.size());
+	std::vector<uint32_t> next(mNodeShapesStart.begin(), mNodeShapesStart.end() - 1);
+	for (uint32_t i = 0; i != mShapes.size(); i++)
+		mNodeShapes[next[mShapes[i].transformIndex]++] = i;
+	mShapeMoved.assign(mShapes.size(), false);
+
+	// force recalculation of all global transformations
+	recalculateAllGlobalTransforms(mScene);
+
+	updateShapeBoxes();
+}
+
+void GLSceneData::updateShapeBoxes()
+{
+	mShapeBoxes.resize(mShapes.size());
+
+	for (size_t i = 0; i != mShapes.size(); i++)
+		mShapeBoxes[i] = mMeshData.boundingBoxes[mShapes[i].meshIndex].getTransformed(glm::mat4(mScene.globalTransform[mShapes[i].transformIndex]));
+}
+
+bool GLSceneData::updateTransforms(std::vector<BoundingBox>* dirtyBoxes)
+{
+	mChangedNodes.clear();
+	mMovedShapes.clear();
+
+	recalculateGlobalTransforms(mScene, &mChangedNodes);
+
+	if (mChangedNodes.empty())
+		return false;
+
+	// a node may be in the dirty lists more than once if it was marked along with one of its parents
+	for (const int node : mChangedNodes)
 	{
-		auto material = mScene.nodeIDToMaterialID.find(c.first);
-		if (material != mScene.nodeIDToMaterialID.end())
+		for (uint32_t j = mNodeShapesStart[node]; j != mNodeShapesStart[node + 1]; j++)
 		{
-			mShapes.push_back(DrawData{
-				                  .meshIndex = c.second,
-				                  .materialIndex = material->second,
-				                  .LOD = 0,
-				                  .indexOffset = mMeshData.meshes[c.second].indexOffset,
-				                  .vertexOffset = mMeshData.meshes[c.second].vertexOffset,
-				                  .transformIndex = c.first
-			                  });
+			const uint32_t i = mNodeShapes[j];
+			if (mShapeMoved[i])
+				continue;
+			mShapeMoved[i] = true;
+			mMovedShapes.push_back(i);
+
+			if (dirtyBoxes)
+				dirtyBoxes->push_back(mShapeBoxes[i]);
+			mShapeBoxes[i] = mMeshData.boundingBoxes[mShapes[i].meshIndex].getTransformed(glm::mat4(mScene.globalTransform[node]));
+			if (dirtyBoxes)
+				dirtyBoxes->push_back(mShapeBoxes[i]);
 		}
 	}
 
-	// force recalculation of all global transformations
-	markAsChanged(mScene, 0);
-	recalculateGlobalTransforms(mScene);
+	for (const uint32_t i : mMovedShapes)
+		mShapeMoved[i] = false;
+
+	return true;
 }
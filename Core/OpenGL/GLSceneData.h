@@ -12,6 +12,8 @@ public:
 	GLSceneData(const char* meshFile,
 	            const char* sceneFile,
 	            const char* materialFile);
+	// a scene built in memory, without textures, e.g. by tools
+	GLSceneData(MeshData&& meshData, Scene&& scene, std::vector<MaterialData>&& materials);
 
 	std::vector<GLTexture> mAllMaterialTextures;
 
@@ -21,6 +23,23 @@ public:
 	Scene                     mScene;
 	std::vector<MaterialData> mMaterials;
 	std::vector<DrawData>     mShapes;
+	std::vector<BoundingBox>  mShapeBoxes; // world-space bounds of every shape
+	std::vector<uint32_t>     mMovedShapes; // shapes whose transforms were recalculated by the last updateTransforms()
 
 	void loadScene(const char* sceneFile);
+	void updateShapeBoxes();
+	// recalculates the global transforms of the nodes marked with markAsChanged() and the bounds of their shapes.
+	// Returns true if anything has moved, the old and the new bounds of every moved shape are appended to dirtyBoxes.
+	// The cost depends on the number of changed nodes only, GLMesh::updateMovedShapes() uploads mMovedShapes.
+	bool updateTransforms(std::vector<BoundingBox>* dirtyBoxes = nullptr);
+
+private:
+	// creates the shapes and their bounds once mScene and mMeshData are there
+	void initShapes();
+
+	// the shapes of node i are mNodeShapes[mNodeShapesStart[i]] .. mNodeShapes[mNodeShapesStart[i + 1] - 1]
+	std::vector<uint32_t> mNodeShapesStart;
+	std::vector<uint32_t> mNodeShapes;
+	std::vector<int>      mChangedNodes;
+	std::vector<bool>     mShapeMoved; // false between calls of updateTransforms()
 };
@@ -0,0 +1,115 @@
+#include "GLSceneTransforms.h"
+
+#include <algorithm>
+#include <cstring>
+
+// sceneTransforms.comp, the bindings of the culling buffers of GLMesh are reused
+const static GLuint kBufferIndex_Parents     = 5;
+const static GLuint kBufferIndex_Globals     = 6;
+const static GLuint kBufferIndex_NodeUpdates = 7;
+
+static std::vector<int> getParents(const Scene& scene)
+{
+	std::vector<int> parents(scene.hierarchy.size());
+	for (size_t i = 0; i != scene.hierarchy.size(); i++)
+		parents[i] = scene.hierarchy[i].parent;
+	return parents;
+}
+
+static std::vector<glm::mat3x4> getRows(const Scene& scene)
+{
+	std::vector<glm::mat3x4> rows(scene.globalTransform.size());
+	for (size_t i = 0; i != scene.globalTransform.size(); i++)
+		rows[i] = glm::transpose(scene.globalTransform[i]);
+	return rows;
+}
+
+GLSceneTransforms::GLSceneTransforms(const Scene& scene)
+	: mNumNodes((uint32_t)scene.hierarchy.size())
+	, mBufferParents(sizeof(int) * std::max(mNumNodes, 1u), getParents(scene).data(), 0)
+	, mBufferGlobals(sizeof(glm::mat3x4) * std::max(mNumNodes, 1u), getRows(scene).data(), 0)
+{
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &mAlignment);
+}
+
+void GLSceneTransforms::update(Scene& scene)
+{
+	// the ranges of the levels, children can only be recalculated after their parents
+	GLsizeiptr size = 0;
+	for (int level = 0; level != MAX_NODE_LEVEL; level++)
+	{
+		mLevels[level] = {};
+		const std::vector<int>& nodes = scene.changedAtThisFrame[level];
+		if (nodes.empty())
+			continue;
+		size           = (size + mAlignment - 1) / mAlignment * mAlignment;
+		mLevels[level] = {size, (uint32_t)nodes.size()};
+		size += 16 + nodes.size() * sizeof(NodeUpdate);
+	}
+
+	if (!size)
+		return;
+
+	mUpdates.resize(size);
+	for (int level = 0; level != MAX_NODE_LEVEL; level++)
+	{
+		std::vector<int>& nodes = scene.changedAtThisFrame[level];
+		if (nodes.empty())
+			continue;
+
+		uint8_t* const ptr = mUpdates.data() + mLevels[level].offset;
+		memcpy(ptr, &mLevels[level].count, sizeof(uint32_t));
+
+		NodeUpdate* updates = reinterpret_cast<NodeUpdate*>(ptr + 16);
+		for (const int node : nodes)
+		{
+			const TRS& t = scene.localTransform[node];
+			*updates++   = {
+				.rotation = glm::vec4(t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w),
+				.translation = t.translation,
+				.node = (uint32_t)node,
+				.scale = t.scale,
+				.padding = 0
+			};
+		}
+		nodes.clear();
+	}
+
+	if (size > mUpdatesCapacity)
+	{
+		mUpdatesCapacity = size + size / 2;
+		mBufferUpdates   = std::make_unique<GLBuffer>(mUpdatesCapacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	glNamedBufferSubData(mBufferUpdates->getHandle(), 0, size, mUpdates.data());
+
+	mProgPropagate.useProgram();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Parents, mBufferParents.getHandle());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Globals, mBufferGlobals.getHandle());
+
+	for (int level = 0; level != MAX_NODE_LEVEL; level++)
+	{
+		if (!mLevels[level].count)
+			continue;
+		bindChangedNodes(level);
+		glDispatchCompute((mLevels[level].count + 63) / 64, 1, 1);
+		// the next level reads the transforms of its parents, GLMesh reads all of them
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+}
+
+void GLSceneTransforms::bindChangedNodes(int level) const
+{
+	const LevelRange& range = mLevels[level];
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kBufferIndex_NodeUpdates, mBufferUpdates->getHandle(), range.offset, 16 + range.count * sizeof(NodeUpdate));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Globals, mBufferGlobals.getHandle());
+}
+
+void GLSceneTransforms::getGlobalTransforms(std::vector<glm::mat4x3>& transforms) const
+{
+	std::vector<glm::mat3x4> rows(mNumNodes);
+	glGetNamedBufferSubData(mBufferGlobals.getHandle(), 0, rows.size() * sizeof(glm::mat3x4), rows.data());
+
+	transforms.resize(mNumNodes);
+	for (uint32_t i = 0; i != mNumNodes; i++)
+		transforms[i] = glm::transpose(rows[i]);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "GLBuffer.h"
+#include "GLProgram.h"
+#include "GLShader.h"
+#include "Util/Scene.h"
+
+// Propagates the local transforms of the nodes in the dirty lists of a scene to their global transforms on the GPU,
+// one compute dispatch per level, the GPU version of recalculateGlobalTransforms(). The global transforms stay on the
+// GPU as the 3 rows of the affine matrix of every node; GLMesh::updateModelMatrices(const GLSceneTransforms&) copies
+// them into the model matrices of the shapes without a readback.
+// Scene::globalTransform and the shape bounds of GLSceneData are not updated and update() clears the dirty lists, so the
+// CPU copy goes stale. Code which needs it, e.g. picking or CPU culling, reads the transforms back with
+// getGlobalTransforms(scene.globalTransform) and calls GLSceneData::updateShapeBoxes(), or keeps using
+// GLSceneData::updateTransforms() instead.
+class GLSceneTransforms
+{
+public:
+	// uploads the hierarchy and the current global transforms, the structure of the scene must not change afterwards
+	explicit GLSceneTransforms(const Scene& scene);
+
+	// uploads the local transforms of the changed nodes and recalculates their global transforms, the dirty lists of
+	// the scene are cleared like by recalculateGlobalTransforms()
+	void update(Scene& scene);
+
+	// the nodes recalculated by the last update() on a level, see data/shaders/15LargeScene/sceneTransforms.comp
+	uint32_t getNumChangedNodes(int level) const { return mLevels[level].count; }
+	void     bindChangedNodes(int level) const;
+
+	GLuint getHandle() const { return mBufferGlobals.getHandle(); }
+
+	// reads the global transforms back, waits for the GPU
+	void getGlobalTransforms(std::vector<glm::mat4x3>& transforms) const;
+
+private:
+	// a changed node with its local transform, std430 layout
+	struct NodeUpdate
+	{
+		glm::vec4 rotation; // x, y, z, w
+		glm::vec3 translation;
+		uint32_t  node;
+		glm::vec3 scale;
+		uint32_t  padding;
+	};
+	static_assert(sizeof(NodeUpdate) == 48, "NodeUpdate must match the std430 layout of sceneTransforms.comp");
+
+	// each level is a separately bound range of the update buffer: the number of nodes padded to 16 bytes and the nodes
+	struct LevelRange
+	{
+		GLintptr offset = 0;
+		uint32_t count  = 0;
+	};
+
+	uint32_t mNumNodes;
+	GLint    mAlignment = 0;
+
+	GLBuffer mBufferParents;
+	GLBuffer mBufferGlobals;
+
+	std::unique_ptr<GLBuffer> mBufferUpdates; // grows with the number of changed nodes
+	GLsizeiptr                mUpdatesCapacity = 0;
+	std::vector<uint8_t>      mUpdates;
+	LevelRange                mLevels[MAX_NODE_LEVEL];
+
+	GLShader  mShdPropagate  = GLShader("data/shaders/15LargeScene/sceneTransforms.comp");
+	GLProgram mProgPropagate = GLProgram(mShdPropagate);
+};
@@ -1,4 +1,5 @@
 ﻿#include "GLShader.h"
+#include "Util/ShaderPreprocessor.h"
 #include "Util/Utils.h"
 
 #include <cassert>
@@ -29,16 +30,29 @@ static GLenum GLShaderTypeFromFileName(const char* fileName)
 }
 
 
-GLShader::GLShader(const char* fileName)
-	: GLShader(GLShaderTypeFromFileName(fileName),
-	           readShaderFile(fileName).c_str(), fileName)
+GLShader::GLShader(const char* fileName, const std::vector<std::string>& defines)
+	: mType(GLShaderTypeFromFileName(fileName))
+	, mFileName(fileName)
+	, mDefines(defines)
 {
+	mSource = ShaderPreprocessor::instance().process(fileName, &mSourceFiles, defines);
 }
 
 GLShader::GLShader(GLenum type, const char* text, const char* debugFileName)
 	: mType(type)
-	, mHandle(glCreateShader(type))
+	, mSource(text)
+	, mFileName(debugFileName)
 {
+}
+
+GLuint GLShader::getHandle() const
+{
+	if (mHandle)
+		return mHandle;
+
+	mHandle = glCreateShader(mType);
+
+	const char* text = mSource.c_str();
 	glShaderSource(mHandle, 1, &text, nullptr);
 	glCompileShader(mHandle);
 
@@ -48,13 +62,42 @@ GLShader::GLShader(GLenum type, const char* text, const char* debugFileName)
 
 	if (length)
 	{
-		printf("%s (File: %s)\n", buffer, debugFileName);
+		printf("%s (File: %s)\n", buffer, mFileName.c_str());
+		for (size_t i = 0; i != mSourceFiles.size(); i++)
+			printf("Source string %zu: %s\n", i, mSourceFiles[i].c_str());
 		printShaderSource(text);
 		assert(false);
 	}
+
+	return mHandle;
+}
+
+GLuint GLShader::tryCompile(GLenum type, const std::string& source, const std::string& fileName)
+{
+	const GLuint handle = glCreateShader(type);
+
+	const char* text = source.c_str();
+	glShaderSource(handle, 1, &text, nullptr);
+	glCompileShader(handle);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(handle, GL_COMPILE_STATUS, &status);
+
+	if (status != GL_TRUE)
+	{
+		char    buffer[8192];
+		GLsizei length = 0;
+		glGetShaderInfoLog(handle, sizeof(buffer), &length, buffer);
+		printf("%s (File: %s)\n", buffer, fileName.c_str());
+		glDeleteShader(handle);
+		return 0;
+	}
+
+	return handle;
 }
 
 GLShader::~GLShader()
 {
-	glDeleteShader(mHandle);
+	if (mHandle)
+		glDeleteShader(mHandle);
 }
@@ -1,17 +1,35 @@
 ﻿#pragma once
 
 #include <glad/gl.h>
+#include <string>
+#include <vector>
 
+// a shader keeps its fully preprocessed source and is compiled the first time its handle is requested,
+// so that a program loaded from the binary cache never compiles its shaders
 class GLShader
 {
 public:
-	explicit GLShader(const char* fileName);
+	// defines are inserted after #version, each is either "NAME" or "NAME VALUE"
+	explicit GLShader(const char* fileName, const std::vector<std::string>& defines = {});
 	GLShader(GLenum type, const char* text, const char* debugFileName = "");
 	~GLShader();
-	GLenum getType() const { return mType; }
-	GLuint getHandle() const { return mHandle; }
+	GLShader(const GLShader&) = delete;
+	GLenum                          getType() const { return mType; }
+	GLuint                          getHandle() const;
+	const std::string&              getSource() const { return mSource; }
+	const std::string&              getFileName() const { return mFileName; }
+	const std::vector<std::string>& getDefines() const { return mDefines; }
+	bool                            isLoadedFromFile() const { return !mSourceFiles.empty(); }
+
+	// compiles a shader without asserting on errors, returns 0 and prints the log if compilation fails
+	static GLuint tryCompile(GLenum type, const std::string& source, const std::string& fileName);
 
 private:
-	GLenum mType;
-	GLuint mHandle;
-}; 
\ No newline at end of file
+	GLenum                   mType;
+	mutable GLuint           mHandle = 0;
+	std::string              mSource;
+	std::string              mFileName;
+	std::vector<std::string> mDefines;
+	// files the source was assembled from, indexed by the source string number of its #line directives
+	std::vector<std::string> mSourceFiles;
+};
@@ -0,0 +1,69 @@
+#include "GLShaderReloader.h"
+#include "GLProgram.h"
+#include "Util/FileWatcher.h"
+
+#include <chrono>
+#include <cstdio>
+
+// how often the shader files are checked, also gives editors time to finish writing a file
+static constexpr auto kPollInterval = std::chrono::milliseconds(200);
+
+GLShaderReloader::GLShaderReloader(GLFWwindow* sharedWindow)
+{
+	// windows can only be created on the main thread, the worker only makes the context current
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	mContextWindow = glfwCreateWindow(1, 1, "Shader reloader", nullptr, sharedWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (!mContextWindow)
+	{
+		printf("Cannot create a shared context, shader hot reload is disabled\n");
+		return;
+	}
+
+	mThread = std::thread([this]() { run(); });
+}
+
+GLShaderReloader::~GLShaderReloader()
+{
+	if (mThread.joinable())
+	{
+		mStop = true;
+		mWakeUp.notify_one();
+		mThread.join();
+	}
+
+	if (mContextWindow)
+		glfwDestroyWindow(mContextWindow);
+}
+
+void GLShaderReloader::run()
+{
+	glfwMakeContextCurrent(mContextWindow);
+
+	FileWatcher watcher;
+
+	while (!mStop)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeUp.wait_for(lock, kPollInterval, [this]() { return mStop.load(); });
+		}
+
+		// new programs and includes show up over time, adding a known file is a no-op
+		for (const auto& f : GLProgram::getSourceFiles())
+			watcher.addFile(f);
+
+		const auto changedFiles = watcher.getChangedFiles();
+
+		if (changedFiles.empty())
+			continue;
+
+		for (const auto& f : changedFiles)
+			printf("Shader file changed: %s\n", f.c_str());
+
+		GLProgram::reloadPrograms(changedFiles);
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#define GLFW_INCLUDE_NONE
+#include "GLFW/glfw3.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Watches the shader files (and their includes) of all live GLPrograms and rebuilds the affected programs on a
+// background thread, which owns a hidden window whose context shares objects with the main window.
+// The rebuilt programs are swapped in by GLApp::swapBuffers() so a frame never mixes old and new handles.
+// If a shader fails to compile, the previous program stays in use.
+class GLShaderReloader
+{
+public:
+	explicit GLShaderReloader(GLFWwindow* sharedWindow);
+	~GLShaderReloader();
+	GLShaderReloader(const GLShaderReloader&) = delete;
+
+private:
+	void run();
+
+private:
+	GLFWwindow*             mContextWindow = nullptr;
+	std::thread             mThread;
+	std::mutex              mMutex;
+	std::condition_variable mWakeUp;
+	std::atomic<bool>       mStop = false;
+};
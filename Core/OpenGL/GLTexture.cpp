@@ -9,6 +9,7 @@
 
 #include <stb_image_write.h>
 #include <stb/stb_image.h>
+#include <stb_image_resize.h>
 #include <gli/gli.hpp>
 #include <gli/texture2d.hpp>
 #include <gli/load_ktx.hpp>
@@ -197,6 +198,105 @@ GLTexture::GLTexture(int w, int h, const void* img)
 	glMakeTextureHandleResidentARB(mHandleBindless);
 }
 
+// uploads an RGBA8 image into a layer of an array texture of size w x h, scaled if its size differs
+static void uploadLayer(GLuint texture, int layer, int w, int h, const uint8_t* img, int imgW, int imgH, std::vector<uint8_t>& scratch)
+{
+	if (imgW != w || imgH != h)
+	{
+		scratch.resize(size_t(w) * h * 4);
+		stbir_resize_uint8(img, imgW, imgH, 0, scratch.data(), w, h, 0, STBI_rgb_alpha);
+		img = scratch.data();
+	}
+	glTextureSubImage3D(texture, 0, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, img);
+}
+
+GLTexture::GLTexture(GLenum type, const std::vector<std::string>& layerFileNames)
+	: mType(type)
+{
+	assert(type == GL_TEXTURE_2D_ARRAY);
+	assert(!layerFileNames.empty());
+
+	// all layers are stored in RGBA8, the size of the first layer which loads is the size of the array
+	int w          = 0;
+	int h          = 0;
+	int numMipmaps = 0;
+
+	const int numLayers = (int)layerFileNames.size();
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glCreateTextures(type, 1, &mHandle);
+
+	// every layer is uploaded as soon as it is decoded, the missing ones once the size is known
+	std::vector<int>     missingLayers;
+	std::vector<uint8_t> scratch;
+
+	for (int i = 0; i != numLayers; i++)
+	{
+		int      imgW = 0;
+		int      imgH = 0;
+		uint8_t* img  = stbi_load(layerFileNames[i].c_str(), &imgW, &imgH, nullptr, STBI_rgb_alpha);
+
+		if (!img)
+		{
+			fprintf(stderr, "WARNING: could not load image `%s`, using a fallback.\n", layerFileNames[i].c_str());
+			missingLayers.push_back(i);
+			continue;
+		}
+
+		if (!numMipmaps)
+		{
+			w          = imgW;
+			h          = imgH;
+			numMipmaps = getNumMipMapLevels2D(w, h);
+			glTextureStorage3D(mHandle, numMipmaps, GL_RGBA8, w, h, numLayers);
+		}
+
+		// the converter only packs same-size images together
+		uploadLayer(mHandle, i, w, h, img, imgW, imgH, scratch);
+		stbi_image_free((void*)img);
+	}
+
+	if (!missingLayers.empty())
+	{
+		int      imgW         = 0;
+		int      imgH         = 0;
+		uint8_t* checkerboard = genDefaultCheckerboardImage(&imgW, &imgH);
+		if (!checkerboard)
+		{
+			fprintf(stderr, "FATAL ERROR: out of memory allocating image for fallback texture\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// the checkerboard is RGB, expand it to RGBA
+		std::vector<uint8_t> fallback(size_t(imgW) * imgH * 4, 0xFF);
+		for (int p = 0; p != imgW * imgH; p++)
+			memcpy(&fallback[p * 4], &checkerboard[p * 3], 3);
+		free(checkerboard);
+
+		// none of the layers has loaded
+		if (!numMipmaps)
+		{
+			w          = imgW;
+			h          = imgH;
+			numMipmaps = getNumMipMapLevels2D(w, h);
+			glTextureStorage3D(mHandle, numMipmaps, GL_RGBA8, w, h, numLayers);
+		}
+
+		for (const int i : missingLayers)
+			uploadLayer(mHandle, i, w, h, fallback.data(), imgW, imgH, scratch);
+	}
+
+	glGenerateTextureMipmap(mHandle);
+	glTextureParameteri(mHandle, GL_TEXTURE_MAX_LEVEL, numMipmaps - 1);
+	glTextureParameteri(mHandle, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(mHandle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(mHandle, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(mHandle, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(mHandle, GL_TEXTURE_MAX_ANISOTROPY, 16);
+	mHandleBindless = glGetTextureHandleARB(mHandle);
+	glMakeTextureHandleResidentARB(mHandleBindless);
+}
+
 GLTexture::GLTexture(GLTexture&& other)
 	: mType(other.mType)
 	, mHandle(other.mHandle)
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <string>
+#include <vector>
 
 class GLTexture
 {
@@ -9,6 +11,8 @@ public:
 	GLTexture(GLenum type, const char* fileName, GLenum clamp);
 	GLTexture(GLenum type, int width, int height, GLenum internalFormat);
 	GLTexture(int w, int h, const void* img);
+	// creates a texture array from a list of layer images
+	GLTexture(GLenum type, const std::vector<std::string>& layerFileNames);
 	~GLTexture();
 	GLTexture(const GLTexture&) = delete;
 	GLTexture(GLTexture&&);
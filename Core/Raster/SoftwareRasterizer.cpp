@@ -0,0 +1,384 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include <stb/stb_image_write.h>
+
+#include "Util/ParallelFor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// position, uv and normal
+static constexpr uint32_t kVertexStride = 8;
+
+// the clip-space polygon of a triangle cut by the near plane has at most 4 vertices
+static constexpr int kMaxClippedVertices = 4;
+
+static double getTimeMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// opaque black
+static constexpr uint32_t kClearAlbedo = 0xFF000000;
+
+// there is no blending, every pixel is opaque
+static uint32_t packRGBA8(const GpuVec4& c)
+{
+	const auto toByte = [](float v) { return (uint32_t)(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	return toByte(c.x) | (toByte(c.y) << 8) | (toByte(c.z) << 16) | kClearAlbedo;
+}
+
+// clips a triangle against the near plane z = -w, returns the number of vertices of the polygon left
+static int clipNearPlane(const glm::vec4* in, glm::vec4* out)
+{
+	int n = 0;
+
+	for (int i = 0; i != 3; i++)
+	{
+		const glm::vec4& a  = in[i];
+		const glm::vec4& b  = in[(i + 1) % 3];
+		const float      da = a.z + a.w;
+		const float      db = b.z + b.w;
+
+		if (da >= 0.0f)
+			out[n++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f))
+			out[n++] = a + (b - a) * (da / (da - db));
+	}
+
+	return n;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, uint32_t numThreads)
+	: mWidth(width)
+	, mHeight(height)
+	, mNumThreads(numThreads ? numThreads : getNumWorkerThreads())
+	, mTilesX((width + kTileSize - 1) / kTileSize)
+	, mTilesY((height + kTileSize - 1) / kTileSize)
+	, mPitch(mTilesX * kTileSize)
+	, mTileDepth(mPitch * mTilesY * kTileSize)
+	, mTileAlbedo(mPitch * mTilesY * kTileSize)
+	, mTileShapeIds(mPitch * mTilesY * kTileSize)
+	, mDepth(width * height)
+	, mAlbedo(width * height)
+	, mShapeIds(width * height)
+	, mTriangles(mNumThreads)
+	, mBins(mNumThreads, std::vector<std::vector<uint32_t>>(mTilesX * mTilesY))
+	, mThreadStats(mNumThreads)
+{
+}
+
+void SoftwareRasterizer::render(const MeshData&                  meshData,
+                                const std::vector<DrawData>&     shapes,
+                                const std::vector<glm::mat4x3>&  globalTransforms,
+                                const std::vector<MaterialData>& materials,
+                                const glm::mat4&                 view,
+                                const glm::mat4&                 proj)
+{
+	const double geometryBegin = getTimeMs();
+
+	mStats           = Stats();
+	mStats.numShapes = (uint32_t)shapes.size();
+
+	for (uint32_t t = 0; t != mNumThreads; t++)
+	{
+		mTriangles[t].clear();
+		for (std::vector<uint32_t>& bin : mBins[t])
+			bin.clear();
+		mThreadStats[t] = Stats();
+	}
+
+	const glm::mat4 viewProj = proj * view;
+
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 frustumCorners[8];
+	getFrustumPlanes(viewProj, frustumPlanes);
+	getFrustumCorners(viewProj, frustumCorners);
+
+	// geometry: the split of the shapes between threads decides the order of the triangles in the bins
+	parallelFor((uint32_t)shapes.size(), mNumThreads, [&](uint32_t first, uint32_t last, uint32_t thread)
+	{
+		Stats& stats = mThreadStats[thread];
+
+		for (uint32_t s = first; s != last; s++)
+		{
+			const DrawData&  shape = shapes[s];
+			const glm::mat4  model(globalTransforms[shape.transformIndex]);
+
+			if (materials[shape.materialIndex].flags & sMaterialFlags_AlphaTest)
+			{
+				stats.numSkippedShapes++;
+				continue;
+			}
+
+			// the bounds are only there after recalculateBoundingBoxes()
+			if (!meshData.boundingBoxes.empty() &&
+			    !isBoxInFrustum(frustumPlanes, frustumCorners, meshData.boundingBoxes[shape.meshIndex].getTransformed(model)))
+			{
+				stats.numCulledShapes++;
+				continue;
+			}
+
+			const glm::mat4 mvp        = viewProj * model;
+			const uint32_t  albedo     = packRGBA8(materials[shape.materialIndex].albedoColor);
+			const uint32_t  numIndices = meshData.meshes[shape.meshIndex].getLODIndicesCount(shape.LOD);
+			const uint32_t* indices    = meshData.indexData.data() + shape.indexOffset;
+			const float*    vertices   = meshData.vertexData.data() + shape.vertexOffset * kVertexStride;
+
+			stats.numTriangles += numIndices / 3;
+
+			for (uint32_t i = 0; i + 2 < numIndices; i += 3)
+			{
+				glm::vec4 clip[3];
+				int       numInside = 0;
+				for (int k = 0; k != 3; k++)
+				{
+					const float* v = vertices + indices[i + k] * kVertexStride;
+					clip[k]        = mvp * glm::vec4(v[0], v[1], v[2], 1.0f);
+					numInside += clip[k].z >= -clip[k].w ? 1 : 0;
+				}
+
+				if (numInside == 3)
+				{
+					setupTriangle(clip, albedo, s, thread);
+				}
+				else if (numInside > 0)
+				{
+					glm::vec4 polygon[kMaxClippedVertices];
+					const int n = clipNearPlane(clip, polygon);
+					for (int k = 1; k + 1 < n; k++)
+					{
+						const glm::vec4 fan[3] = {polygon[0], polygon[k], polygon[k + 1]};
+						setupTriangle(fan, albedo, s, thread);
+					}
+				}
+			}
+		}
+	});
+
+	for (const Stats& s : mThreadStats)
+	{
+		mStats.numCulledShapes += s.numCulledShapes;
+		mStats.numSkippedShapes += s.numSkippedShapes;
+		mStats.numTriangles += s.numTriangles;
+		mStats.numSetupTriangles += s.numSetupTriangles;
+		mStats.numBinnedTriangles += s.numBinnedTriangles;
+	}
+
+	const double rasterBegin = getTimeMs();
+	mStats.geometryMs        = rasterBegin - geometryBegin;
+
+	// raster: tiles have very different costs, threads take the next one when they are done
+	parallelForEach((uint32_t)(mTilesX * mTilesY), mNumThreads, [this](uint32_t tile, uint32_t)
+	{
+		rasterizeTile(tile);
+	});
+
+	for (int y = 0; y != mHeight; y++)
+	{
+		std::copy_n(mTileDepth.begin() + y * mPitch, mWidth, mDepth.begin() + y * mWidth);
+		std::copy_n(mTileAlbedo.begin() + y * mPitch, mWidth, mAlbedo.begin() + y * mWidth);
+		std::copy_n(mTileShapeIds.begin() + y * mPitch, mWidth, mShapeIds.begin() + y * mWidth);
+	}
+
+	mStats.rasterMs = getTimeMs() - rasterBegin;
+}
+
+void SoftwareRasterizer::setupTriangle(const glm::vec4* clip, uint32_t albedo, uint32_t shape, uint32_t thread)
+{
+	glm::vec3 p[3];
+	for (int k = 0; k != 3; k++)
+	{
+		const glm::vec3 ndc = glm::vec3(clip[k]) / clip[k].w;
+		p[k]                = glm::vec3((ndc.x * 0.5f + 0.5f) * mWidth, (ndc.y * 0.5f + 0.5f) * mHeight, ndc.z * 0.5f + 0.5f);
+	}
+
+	// both windings are rasterized, the scenes have double-sided materials
+	const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+	if (!(std::abs(area) > 0.0f))
+		return;
+
+	// clamped before the conversion, triangles cut by the near plane can be very large
+	Triangle tri;
+	tri.minX = (int)std::ceil(std::clamp(std::min({p[0].x, p[1].x, p[2].x}) - 0.5f, 0.0f, (float)mWidth));
+	tri.maxX = (int)std::floor(std::clamp(std::max({p[0].x, p[1].x, p[2].x}) - 0.5f, -1.0f, mWidth - 1.0f));
+	tri.minY = (int)std::ceil(std::clamp(std::min({p[0].y, p[1].y, p[2].y}) - 0.5f, 0.0f, (float)mHeight));
+	tri.maxY = (int)std::floor(std::clamp(std::max({p[0].y, p[1].y, p[2].y}) - 0.5f, -1.0f, mHeight - 1.0f));
+
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	// edge i is opposite to vertex i, divided by the area the edge functions are the barycentric coordinates
+	const float invArea = 1.0f / area;
+	for (int i = 0; i != 3; i++)
+	{
+		const glm::vec3& a = p[(i + 1) % 3];
+		const glm::vec3& b = p[(i + 2) % 3];
+		tri.edgeA[i]       = (a.y - b.y) * invArea;
+		tri.edgeB[i]       = (b.x - a.x) * invArea;
+		tri.edgeC[i]       = (a.x * b.y - a.y * b.x) * invArea;
+	}
+
+	// window depth is linear in screen space
+	tri.depthA = tri.edgeA[0] * p[0].z + tri.edgeA[1] * p[1].z + tri.edgeA[2] * p[2].z;
+	tri.depthB = tri.edgeB[0] * p[0].z + tri.edgeB[1] * p[1].z + tri.edgeB[2] * p[2].z;
+	tri.depthC = tri.edgeC[0] * p[0].z + tri.edgeC[1] * p[1].z + tri.edgeC[2] * p[2].z;
+	tri.albedo = albedo;
+	tri.shape  = shape;
+
+	std::vector<Triangle>& triangles = mTriangles[thread];
+	const uint32_t         index     = (uint32_t)triangles.size();
+	triangles.push_back(tri);
+
+	Stats& stats = mThreadStats[thread];
+	stats.numSetupTriangles++;
+
+	for (int ty = tri.minY / kTileSize; ty <= tri.maxY / kTileSize; ty++)
+		for (int tx = tri.minX / kTileSize; tx <= tri.maxX / kTileSize; tx++)
+		{
+			mBins[thread][ty * mTilesX + tx].push_back(index);
+			stats.numBinnedTriangles++;
+		}
+}
+
+void SoftwareRasterizer::rasterizeTile(uint32_t tile)
+{
+	const int tileX0 = (int)(tile % mTilesX) * kTileSize;
+	const int tileY0 = (int)(tile / mTilesX) * kTileSize;
+
+	// clear
+	for (int y = tileY0; y != tileY0 + kTileSize; y++)
+	{
+		std::fill_n(mTileDepth.begin() + y * mPitch + tileX0, kTileSize, 1.0f);
+		std::fill_n(mTileAlbedo.begin() + y * mPitch + tileX0, kTileSize, kClearAlbedo);
+		std::fill_n(mTileShapeIds.begin() + y * mPitch + tileX0, kTileSize, kNoShape);
+	}
+
+	for (uint32_t thread = 0; thread != mNumThreads; thread++)
+	{
+		for (const uint32_t index : mBins[thread][tile])
+		{
+			const Triangle& tri = mTriangles[thread][index];
+
+			// groups of 4 pixels never cross the tile, the pixels outside the triangle fail the edge tests
+			const int x0 = std::max(tri.minX, tileX0) & ~3;
+			const int x1 = std::min(tri.maxX, tileX0 + kTileSize - 1);
+			const int y0 = std::max(tri.minY, tileY0);
+			const int y1 = std::min(tri.maxY, tileY0 + kTileSize - 1);
+
+#ifdef RASTER_SSE2
+			const __m128  laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			const __m128  zero        = _mm_setzero_ps();
+			const __m128  a0          = _mm_set1_ps(tri.edgeA[0]);
+			const __m128  a1          = _mm_set1_ps(tri.edgeA[1]);
+			const __m128  a2          = _mm_set1_ps(tri.edgeA[2]);
+			const __m128  depthA      = _mm_set1_ps(tri.depthA);
+			const __m128i albedo      = _mm_set1_epi32((int)tri.albedo);
+			const __m128i shape       = _mm_set1_epi32((int)tri.shape);
+#endif
+
+			for (int y = y0; y <= y1; y++)
+			{
+				const float py = y + 0.5f;
+				const float r0 = tri.edgeB[0] * py + tri.edgeC[0];
+				const float r1 = tri.edgeB[1] * py + tri.edgeC[1];
+				const float r2 = tri.edgeB[2] * py + tri.edgeC[2];
+				const float rz = tri.depthB * py + tri.depthC;
+
+				float*    depthRow  = mTileDepth.data() + y * mPitch;
+				uint32_t* albedoRow = mTileAlbedo.data() + y * mPitch;
+				uint32_t* shapeRow  = mTileShapeIds.data() + y * mPitch;
+
+				for (int x = x0; x <= x1; x += 4)
+				{
+#ifdef RASTER_SSE2
+					const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+					const __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), _mm_set1_ps(r0));
+					const __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), _mm_set1_ps(r1));
+					const __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), _mm_set1_ps(r2));
+					const __m128 z  = _mm_add_ps(_mm_mul_ps(depthA, px), _mm_set1_ps(rz));
+
+					const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+					const __m128 depth  = _mm_loadu_ps(depthRow + x);
+					const __m128 mask   = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+
+					if (!_mm_movemask_ps(mask))
+						continue;
+
+					const __m128i maski = _mm_castps_si128(mask);
+					__m128i*      a     = (__m128i*)(albedoRow + x);
+					__m128i*      s     = (__m128i*)(shapeRow + x);
+
+					_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, depth)));
+					_mm_storeu_si128(a, _mm_or_si128(_mm_and_si128(maski, albedo), _mm_andnot_si128(maski, _mm_loadu_si128(a))));
+					_mm_storeu_si128(s, _mm_or_si128(_mm_and_si128(maski, shape), _mm_andnot_si128(maski, _mm_loadu_si128(s))));
+#else
+					for (int i = x; i != x + 4; i++)
+					{
+						const float px = i + 0.5f;
+						const float w0 = tri.edgeA[0] * px + r0;
+						const float w1 = tri.edgeA[1] * px + r1;
+						const float w2 = tri.edgeA[2] * px + r2;
+						const float z  = tri.depthA * px + rz;
+						if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z < depthRow[i])
+						{
+							depthRow[i]  = z;
+							albedoRow[i] = tri.albedo;
+							shapeRow[i]  = tri.shape;
+						}
+					}
+#endif
+				}
+			}
+		}
+	}
+}
+
+std::vector<uint32_t> SoftwareRasterizer::getShapeCoverage(uint32_t numShapes) const
+{
+	std::vector<uint32_t> coverage(numShapes, 0);
+
+	for (const uint32_t shape : mShapeIds)
+		if (shape < numShapes)
+			coverage[shape]++;
+
+	return coverage;
+}
+
+static bool writePNG(const char* fileName, int width, int height, int comp, const void* pixels)
+{
+	// bottom-up like OpenGL
+	stbi_flip_vertically_on_write(1);
+	const int ok = stbi_write_png(fileName, width, height, comp, pixels, width * comp);
+	stbi_flip_vertically_on_write(0);
+
+	if (!ok)
+		printf("Cannot write image file '%s'\n", fileName);
+
+	return ok != 0;
+}
+
+bool SoftwareRasterizer::saveAlbedo(const char* fileName) const
+{
+	return writePNG(fileName, mWidth, mHeight, 4, mAlbedo.data());
+}
+
+bool SoftwareRasterizer::saveDepth(const char* fileName, float zNear, float zFar) const
+{
+	std::vector<uint8_t> pixels(mDepth.size());
+
+	for (size_t i = 0; i != mDepth.size(); i++)
+	{
+		const float ndc    = mDepth[i] * 2.0f - 1.0f;
+		const float linear = 2.0f * zNear * zFar / (zFar + zNear - ndc * (zFar - zNear));
+		pixels[i]          = (uint8_t)(std::clamp((linear - zNear) / (zFar - zNear), 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	return writePNG(fileName, mWidth, mHeight, 1, pixels.data());
+}
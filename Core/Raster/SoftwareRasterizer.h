@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Util/Material.h"
+#include "Util/UtilsMath.h"
+#include "Util/VtxData.h"
+
+// A multithreaded tile-based rasterizer for MeshData scenes that runs without a GPU, for image regression tests and
+// for measuring culling on machines without a GL context. It renders depth, the albedo color of the materials (textures
+// are not sampled) and the shape covering every pixel. Alpha-tested shapes are skipped, their coverage would need the
+// albedo maps.
+// A frame runs in two parallel stages:
+// - geometry: shapes are split evenly between threads, which transform, clip against the near plane and set up their
+//   triangles and sort them into per-thread bins of the screen tiles
+// - raster: threads take tiles from a shared queue and rasterize the bins of the tile in thread order, with edge
+//   functions evaluated for 4 pixels at a time (SSE2 where available)
+// Triangles of a tile are drawn in the order of the shapes, so the image does not depend on the number of threads.
+// Buffers are bottom-up like OpenGL, depth is the window depth in [0, 1] with the GL_LESS test.
+class SoftwareRasterizer
+{
+public:
+	static constexpr int      kTileSize = 64;
+	static constexpr uint32_t kNoShape  = ~0u;
+
+	struct Stats
+	{
+		uint32_t numShapes          = 0;
+		uint32_t numCulledShapes    = 0; // outside the frustum
+		uint32_t numSkippedShapes   = 0; // alpha-tested, not drawn
+		uint64_t numTriangles       = 0; // of the shapes inside the frustum
+		uint64_t numSetupTriangles  = 0; // left after clipping, culling degenerate and offscreen triangles
+		uint64_t numBinnedTriangles = 0; // a triangle is counted once per tile it overlaps
+		double   geometryMs         = 0.0;
+		double   rasterMs           = 0.0;
+	};
+
+	// numThreads = 0 uses all hardware threads
+	SoftwareRasterizer(int width, int height, uint32_t numThreads = 0);
+
+	// shapes as in GLSceneData, the vertices of MeshData are interleaved position, uv and normal
+	void render(const MeshData&                  meshData,
+	            const std::vector<DrawData>&     shapes,
+	            const std::vector<glm::mat4x3>&  globalTransforms,
+	            const std::vector<MaterialData>& materials,
+	            const glm::mat4&                 view,
+	            const glm::mat4&                 proj);
+
+	int                          getWidth() const { return mWidth; }
+	int                          getHeight() const { return mHeight; }
+	const std::vector<float>&    getDepth() const { return mDepth; }
+	const std::vector<uint32_t>& getAlbedo() const { return mAlbedo; } // RGBA8
+	const std::vector<uint32_t>& getShapeIds() const { return mShapeIds; }
+	const Stats&                 getStats() const { return mStats; }
+
+	// number of pixels every shape covers in the last frame
+	std::vector<uint32_t> getShapeCoverage(uint32_t numShapes) const;
+
+	// .png files, top-down; depth is linearized between the near and the far plane to be readable
+	bool saveAlbedo(const char* fileName) const;
+	bool saveDepth(const char* fileName, float zNear, float zFar) const;
+
+private:
+	// edge functions and depth are planes in screen space: v = a * x + b * y + c
+	struct Triangle
+	{
+		float    edgeA[3];
+		float    edgeB[3];
+		float    edgeC[3];
+		float    depthA;
+		float    depthB;
+		float    depthC;
+		int      minX, minY, maxX, maxY; // pixels whose centers may be covered
+		uint32_t albedo;
+		uint32_t shape;
+	};
+
+	void setupTriangle(const glm::vec4* clip, uint32_t albedo, uint32_t shape, uint32_t thread);
+	void rasterizeTile(uint32_t tile);
+
+private:
+	int      mWidth;
+	int      mHeight;
+	uint32_t mNumThreads;
+	int      mTilesX;
+	int      mTilesY;
+
+	// the tiles cover the whole frame, rows are padded to full tiles
+	int                   mPitch;
+	std::vector<float>    mTileDepth;
+	std::vector<uint32_t> mTileAlbedo;
+	std::vector<uint32_t> mTileShapeIds;
+
+	std::vector<float>    mDepth;
+	std::vector<uint32_t> mAlbedo;
+	std::vector<uint32_t> mShapeIds;
+
+	// per thread
+	std::vector<std::vector<Triangle>>              mTriangles;
+	std::vector<std::vector<std::vector<uint32_t>>> mBins; // [thread][tile] indices into mTriangles[thread]
+	std::vector<Stats>                              mThreadStats;
+
+	Stats mStats;
+};
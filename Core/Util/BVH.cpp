@@ -0,0 +1,788 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+#include "ParallelFor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// position, uv and normal
+static constexpr uint32_t kVertexStride = 8;
+
+static constexpr uint32_t kNumBins = 16;
+
+// smaller nodes are binned on a single thread
+static constexpr uint32_t kParallelBinningThreshold = 1 << 16;
+
+// deeper nodes become leaves, a split may only peel off a single primitive of widely spread ones
+static constexpr uint32_t kMaxBuildDepth = 64;
+
+// the traversal stacks hold at most one node per level plus the two children of the deepest node
+static constexpr int kMaxTraversalDepth = kMaxBuildDepth + 2;
+
+static BoundingBox getEmptyBox()
+{
+	BoundingBox box;
+	box.min = vec3(FLT_MAX);
+	box.max = vec3(-FLT_MAX);
+	return box;
+}
+
+static void growBox(BoundingBox& box, const BoundingBox& other)
+{
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+
+static float getHalfArea(const BoundingBox& box)
+{
+	const vec3 e = box.max - box.min;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// runs func(first, last, thread) over [0, count), in parallel for large ranges
+template <typename Func>
+static void forRange(uint32_t count, uint32_t numThreads, const Func& func)
+{
+	if (count >= kParallelBinningThreshold && numThreads != 1)
+		parallelFor(count, numThreads, func);
+	else
+		func(0, count, 0);
+}
+
+void buildBVH(const std::vector<BoundingBox>& primBounds, uint32_t maxLeafSize, uint32_t numThreads, std::vector<BVHNode>& nodes, std::vector<uint32_t>& primIndices)
+{
+	const uint32_t numPrims = (uint32_t)primBounds.size();
+
+	nodes.clear();
+	primIndices.resize(numPrims);
+	std::iota(primIndices.begin(), primIndices.end(), 0);
+
+	if (!numPrims)
+		return;
+
+	numThreads = numThreads ? numThreads : getNumWorkerThreads();
+
+	std::vector<vec3> centroids(numPrims);
+	for (uint32_t i = 0; i != numPrims; i++)
+		centroids[i] = primBounds[i].getCenter();
+
+	struct Bin
+	{
+		BoundingBox bounds = getEmptyBox();
+		uint32_t    count  = 0;
+	};
+
+	// per thread: node bounds, centroid bounds and bins of the 3 axes
+	struct ThreadData
+	{
+		BoundingBox bounds;
+		BoundingBox centroidBounds;
+		Bin         bins[3][kNumBins];
+	};
+	std::vector<ThreadData> threadData(numThreads);
+
+	nodes.reserve(2 * numPrims - 1);
+	nodes.push_back({.first = 0, .count = numPrims});
+
+	struct StackEntry
+	{
+		uint32_t node;
+		uint32_t depth;
+	};
+	std::vector<StackEntry> stack = {{0, 0}};
+
+	while (!stack.empty())
+	{
+		const uint32_t nodeIndex = stack.back().node;
+		const uint32_t depth     = stack.back().depth;
+		stack.pop_back();
+
+		const uint32_t first = nodes[nodeIndex].first;
+		const uint32_t count = nodes[nodeIndex].count;
+
+		for (ThreadData& t : threadData)
+		{
+			t.bounds         = getEmptyBox();
+			t.centroidBounds = getEmptyBox();
+		}
+
+		forRange(count, numThreads, [&](uint32_t begin, uint32_t end, uint32_t thread)
+		{
+			ThreadData& t = threadData[thread];
+			for (uint32_t i = first + begin; i != first + end; i++)
+			{
+				const uint32_t p = primIndices[i];
+				growBox(t.bounds, primBounds[p]);
+				growBox(t.centroidBounds, BoundingBox(centroids[p], centroids[p]));
+			}
+		});
+
+		BoundingBox bounds         = getEmptyBox();
+		BoundingBox centroidBounds = getEmptyBox();
+		for (const ThreadData& t : threadData)
+		{
+			growBox(bounds, t.bounds);
+			growBox(centroidBounds, t.centroidBounds);
+		}
+
+		nodes[nodeIndex].boxMin = bounds.min;
+		nodes[nodeIndex].boxMax = bounds.max;
+
+		if (count <= maxLeafSize || depth == kMaxBuildDepth)
+			continue;
+
+		const vec3 extent = centroidBounds.max - centroidBounds.min;
+		const vec3 scale  = vec3(extent.x > 0.0f ? kNumBins / extent.x : 0.0f,
+		                         extent.y > 0.0f ? kNumBins / extent.y : 0.0f,
+		                         extent.z > 0.0f ? kNumBins / extent.z : 0.0f);
+
+		const auto getBin = [&](uint32_t p, int axis)
+		{
+			return std::min((uint32_t)((centroids[p][axis] - centroidBounds.min[axis]) * scale[axis]), kNumBins - 1);
+		};
+
+		for (ThreadData& t : threadData)
+			for (int axis = 0; axis != 3; axis++)
+				std::fill_n(t.bins[axis], kNumBins, Bin());
+
+		forRange(count, numThreads, [&](uint32_t begin, uint32_t end, uint32_t thread)
+		{
+			ThreadData& t = threadData[thread];
+			for (uint32_t i = first + begin; i != first + end; i++)
+			{
+				const uint32_t p = primIndices[i];
+				for (int axis = 0; axis != 3; axis++)
+				{
+					Bin& bin = t.bins[axis][getBin(p, axis)];
+					growBox(bin.bounds, primBounds[p]);
+					bin.count++;
+				}
+			}
+		});
+
+		// the split with the lowest SAH cost, between bins splitBin - 1 and splitBin
+		float bestCost  = FLT_MAX;
+		int   bestAxis  = -1;
+		int   bestSplit = 0;
+
+		for (int axis = 0; axis != 3; axis++)
+		{
+			if (extent[axis] <= 0.0f)
+				continue;
+
+			Bin bins[kNumBins];
+			for (const ThreadData& t : threadData)
+				for (uint32_t b = 0; b != kNumBins; b++)
+				{
+					growBox(bins[b].bounds, t.bins[axis][b].bounds);
+					bins[b].count += t.bins[axis][b].count;
+				}
+
+			float       rightArea[kNumBins];
+			uint32_t    rightCount[kNumBins];
+			BoundingBox right = getEmptyBox();
+			uint32_t    n     = 0;
+			for (uint32_t b = kNumBins - 1; b > 0; b--)
+			{
+				growBox(right, bins[b].bounds);
+				n += bins[b].count;
+				rightArea[b]  = n ? getHalfArea(right) : 0.0f;
+				rightCount[b] = n;
+			}
+
+			BoundingBox left = getEmptyBox();
+			n                = 0;
+			for (uint32_t b = 1; b != kNumBins; b++)
+			{
+				growBox(left, bins[b - 1].bounds);
+				n += bins[b - 1].count;
+				if (!n || !rightCount[b])
+					continue;
+				const float cost = n * getHalfArea(left) + rightCount[b] * rightArea[b];
+				if (cost < bestCost)
+				{
+					bestCost  = cost;
+					bestAxis  = axis;
+					bestSplit = (int)b;
+				}
+			}
+		}
+
+		// all centroids in the same place
+		if (bestAxis < 0)
+			continue;
+
+		const auto     middle    = std::partition(primIndices.begin() + first, primIndices.begin() + first + count,
+		                                          [&](uint32_t p) { return (int)getBin(p, bestAxis) < bestSplit; });
+		const uint32_t leftCount = (uint32_t)(middle - (primIndices.begin() + first));
+
+		const uint32_t children = (uint32_t)nodes.size();
+		nodes.push_back({.first = first, .count = leftCount});
+		nodes.push_back({.first = first + leftCount, .count = count - leftCount});
+		nodes[nodeIndex].first = children;
+		nodes[nodeIndex].count = 0;
+
+		stack.push_back({children + 1, depth + 1});
+		stack.push_back({children, depth + 1});
+	}
+}
+
+// distance to the box along the ray, FLT_MAX if the ray misses it before tMax
+static float intersectBox(const BVHNode& node, const Ray& ray, const vec3& invDirection, float tMax)
+{
+	const vec3 t0 = (node.boxMin - ray.origin) * invDirection;
+	const vec3 t1 = (node.boxMax - ray.origin) * invDirection;
+
+	const float tNear = std::max({std::min(t0.x, t1.x), std::min(t0.y, t1.y), std::min(t0.z, t1.z), 0.0f});
+	const float tFar  = std::min({std::max(t0.x, t1.x), std::max(t0.y, t1.y), std::max(t0.z, t1.z), tMax});
+
+	return tNear <= tFar ? tNear : FLT_MAX;
+}
+
+// front-to-back traversal, leaf(first, count, tMax) intersects the primitives of a leaf, lowers tMax and returns true
+// to stop the traversal
+template <typename LeafFunc>
+static void traverseBVH(const std::vector<BVHNode>& nodes, const Ray& ray, float tMax, const LeafFunc& leaf)
+{
+	const vec3 invDirection = 1.0f / ray.direction;
+
+	if (nodes.empty() || intersectBox(nodes[0], ray, invDirection, tMax) == FLT_MAX)
+		return;
+
+	uint32_t stack[kMaxTraversalDepth];
+	int      stackSize = 0;
+	uint32_t nodeIndex = 0;
+
+	for (;;)
+	{
+		const BVHNode& node = nodes[nodeIndex];
+
+		if (node.isLeaf())
+		{
+			if (leaf(node.first, node.count, tMax))
+				return;
+		}
+		else
+		{
+			uint32_t near     = node.first;
+			uint32_t far      = node.first + 1;
+			float    distNear = intersectBox(nodes[near], ray, invDirection, tMax);
+			float    distFar  = intersectBox(nodes[far], ray, invDirection, tMax);
+			if (distFar < distNear)
+			{
+				std::swap(near, far);
+				std::swap(distNear, distFar);
+			}
+			if (distNear != FLT_MAX)
+			{
+				if (distFar != FLT_MAX)
+				{
+					assert(stackSize < kMaxTraversalDepth);
+					stack[stackSize++] = far;
+				}
+				nodeIndex = near;
+				continue;
+			}
+		}
+
+		// the far child may have been pushed before tMax got lower, it is tested again
+		for (;;)
+		{
+			if (!stackSize)
+				return;
+			nodeIndex = stack[--stackSize];
+			if (intersectBox(nodes[nodeIndex], ray, invDirection, tMax) != FLT_MAX)
+				break;
+		}
+	}
+}
+
+void RayPacket4::setRay(int i, const Ray& ray)
+{
+	originX[i]    = ray.origin.x;
+	originY[i]    = ray.origin.y;
+	originZ[i]    = ray.origin.z;
+	directionX[i] = ray.direction.x;
+	directionY[i] = ray.direction.y;
+	directionZ[i] = ray.direction.z;
+	tMax[i]       = ray.tMax;
+}
+
+static Ray getRay(const RayPacket4& packet, int i)
+{
+	return {
+		.origin = vec3(packet.originX[i], packet.originY[i], packet.originZ[i]),
+		.direction = vec3(packet.directionX[i], packet.directionY[i], packet.directionZ[i]),
+		.tMax = packet.tMax[i]
+	};
+}
+
+MeshBVH::MeshBVH(const MeshData& meshData, uint32_t meshIndex, uint32_t numThreads)
+{
+	const Mesh&     mesh         = meshData.meshes[meshIndex];
+	const uint32_t  numTriangles = mesh.getLODIndicesCount(0) / 3;
+	const uint32_t* indices      = meshData.indexData.data() + mesh.indexOffset;
+	const float*    vertices     = meshData.vertexData.data() + mesh.vertexOffset * kVertexStride;
+
+	const auto getPosition = [&](uint32_t i)
+	{
+		const float* v = vertices + indices[i] * kVertexStride;
+		return vec3(v[0], v[1], v[2]);
+	};
+
+	std::vector<BoundingBox> bounds(numTriangles);
+	for (uint32_t i = 0; i != numTriangles; i++)
+	{
+		const vec3 p[3] = {getPosition(3 * i + 0), getPosition(3 * i + 1), getPosition(3 * i + 2)};
+		bounds[i]       = BoundingBox(p, 3);
+	}
+
+	std::vector<uint32_t> order;
+	buildBVH(bounds, kMaxLeafSize, numThreads, mNodes, order);
+
+	mTriangles.resize(numTriangles);
+	for (uint32_t i = 0; i != numTriangles; i++)
+	{
+		const uint32_t t  = order[i];
+		const vec3     v0 = getPosition(3 * t + 0);
+		mTriangles[i]     = {v0, getPosition(3 * t + 1) - v0, getPosition(3 * t + 2) - v0, t};
+	}
+}
+
+BoundingBox MeshBVH::getBounds() const
+{
+	return mNodes.empty() ? BoundingBox(vec3(0.0f), vec3(0.0f)) : BoundingBox(mNodes[0].boxMin, mNodes[0].boxMax);
+}
+
+// Moller-Trumbore, both sides of the triangle
+static bool intersectTriangle(const Ray& ray, const vec3& v0, const vec3& edge1, const vec3& edge2, float& t, float& u, float& v)
+{
+	const vec3  p   = glm::cross(ray.direction, edge2);
+	const float det = glm::dot(edge1, p);
+	if (std::abs(det) < 1e-12f)
+		return false;
+
+	const float invDet = 1.0f / det;
+	const vec3  s      = ray.origin - v0;
+	u                  = glm::dot(s, p) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	const vec3 q = glm::cross(s, edge1);
+	v            = glm::dot(ray.direction, q) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	t = glm::dot(edge2, q) * invDet;
+	return t > 0.0f;
+}
+
+template <bool AnyHit>
+bool MeshBVH::traverse(const Ray& ray, RayHit& hit) const
+{
+	bool found = false;
+
+	traverseBVH(mNodes, ray, AnyHit ? ray.tMax : std::min(ray.tMax, hit.t), [&](uint32_t first, uint32_t count, float& tMax)
+	{
+		for (uint32_t i = first; i != first + count; i++)
+		{
+			const Triangle& tri = mTriangles[i];
+			float           t, u, v;
+			if (intersectTriangle(ray, tri.v0, tri.edge1, tri.edge2, t, u, v) && t < tMax)
+			{
+				tMax  = t;
+				hit   = {.t = t, .shape = hit.shape, .triangle = tri.index, .u = u, .v = v};
+				found = true;
+				if (AnyHit)
+					return true;
+			}
+		}
+		return false;
+	});
+
+	return found;
+}
+
+bool MeshBVH::intersect(const Ray& ray, RayHit& hit) const
+{
+	return traverse<false>(ray, hit);
+}
+
+bool MeshBVH::isOccluded(const Ray& ray) const
+{
+	RayHit hit;
+	return traverse<true>(ray, hit);
+}
+
+#ifdef BVH_SSE2
+
+struct Vec3x4
+{
+	__m128 x, y, z;
+};
+
+static Vec3x4 sub(const Vec3x4& a, const Vec3x4& b) { return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)}; }
+static Vec3x4 splat(const vec3& v) { return {_mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z)}; }
+
+static __m128 dot(const Vec3x4& a, const Vec3x4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static Vec3x4 cross(const Vec3x4& a, const Vec3x4& b)
+{
+	return {
+		_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+		_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+		_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+	};
+}
+
+static __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static float getHorizontalMin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(v);
+}
+
+struct RayPacketSSE
+{
+	Vec3x4 origin;
+	Vec3x4 direction;
+	Vec3x4 invDirection;
+};
+
+// the rays of the packet which hit the box before their tMax, tNear gets their distances to the box
+static __m128 intersectBox4(const BVHNode& node, const RayPacketSSE& rays, __m128 tMax, __m128& tNear)
+{
+	const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boxMin.x), rays.origin.x), rays.invDirection.x);
+	const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boxMax.x), rays.origin.x), rays.invDirection.x);
+	const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boxMin.y), rays.origin.y), rays.invDirection.y);
+	const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boxMax.y), rays.origin.y), rays.invDirection.y);
+	const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boxMin.z), rays.origin.z), rays.invDirection.z);
+	const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boxMax.z), rays.origin.z), rays.invDirection.z);
+
+	tNear            = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+	const __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), tMax));
+
+	return _mm_cmple_ps(tNear, tFar);
+}
+
+// the packet version of traverseBVH(): a node is visited if any ray of the packet hits it, children are visited in the
+// order of the nearest distance of any ray
+template <typename LeafFunc>
+static void traverseBVH4(const std::vector<BVHNode>& nodes, const RayPacket4& packet, __m128& tMax, const LeafFunc& leaf)
+{
+	if (nodes.empty())
+		return;
+
+	RayPacketSSE rays;
+	rays.origin       = {_mm_loadu_ps(packet.originX), _mm_loadu_ps(packet.originY), _mm_loadu_ps(packet.originZ)};
+	rays.direction    = {_mm_loadu_ps(packet.directionX), _mm_loadu_ps(packet.directionY), _mm_loadu_ps(packet.directionZ)};
+	rays.invDirection = {_mm_div_ps(_mm_set1_ps(1.0f), rays.direction.x), _mm_div_ps(_mm_set1_ps(1.0f), rays.direction.y), _mm_div_ps(_mm_set1_ps(1.0f), rays.direction.z)};
+
+	uint32_t stack[kMaxTraversalDepth];
+	int      stackSize = 0;
+
+	__m128 tNear;
+	if (_mm_movemask_ps(intersectBox4(nodes[0], rays, tMax, tNear)))
+		stack[stackSize++] = 0;
+
+	const auto push = [&](uint32_t nodeIndex)
+	{
+		assert(stackSize < kMaxTraversalDepth);
+		stack[stackSize++] = nodeIndex;
+	};
+
+	while (stackSize)
+	{
+		const BVHNode& node = nodes[stack[--stackSize]];
+
+		if (node.isLeaf())
+		{
+			leaf(node.first, node.count, rays, tMax);
+			continue;
+		}
+
+		__m128       tNearA, tNearB;
+		const __m128 maskA = intersectBox4(nodes[node.first], rays, tMax, tNearA);
+		const __m128 maskB = intersectBox4(nodes[node.first + 1], rays, tMax, tNearB);
+		const bool   hitA  = _mm_movemask_ps(maskA) != 0;
+		const bool   hitB  = _mm_movemask_ps(maskB) != 0;
+
+		const float distA = hitA ? getHorizontalMin(select(maskA, tNearA, _mm_set1_ps(FLT_MAX))) : FLT_MAX;
+		const float distB = hitB ? getHorizontalMin(select(maskB, tNearB, _mm_set1_ps(FLT_MAX))) : FLT_MAX;
+
+		// the nearer child is pushed last to be popped first
+		if (distA <= distB)
+		{
+			if (hitB)
+				push(node.first + 1);
+			if (hitA)
+				push(node.first);
+		}
+		else
+		{
+			if (hitA)
+				push(node.first);
+			if (hitB)
+				push(node.first + 1);
+		}
+	}
+}
+
+uint32_t MeshBVH::intersect(const RayPacket4& packet, RayHit4& hits) const
+{
+	// inactive rays have a negative tMax and never hit anything
+	float tMaxLanes[4];
+	for (int i = 0; i != 4; i++)
+		tMaxLanes[i] = std::min(packet.tMax[i], hits.hits[i].t);
+	__m128 tMax = _mm_loadu_ps(tMaxLanes);
+
+	uint32_t hitMask = 0;
+
+	traverseBVH4(mNodes, packet, tMax, [&](uint32_t first, uint32_t count, const RayPacketSSE& rays, __m128& tMax)
+	{
+		for (uint32_t i = first; i != first + count; i++)
+		{
+			const Triangle& tri   = mTriangles[i];
+			const Vec3x4    edge1 = splat(tri.edge1);
+			const Vec3x4    edge2 = splat(tri.edge2);
+
+			const Vec3x4 p      = cross(rays.direction, edge2);
+			const __m128 det    = dot(edge1, p);
+			const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+			const Vec3x4 s      = sub(rays.origin, splat(tri.v0));
+			const __m128 u      = _mm_mul_ps(dot(s, p), invDet);
+			const Vec3x4 q      = cross(s, edge1);
+			const __m128 v      = _mm_mul_ps(dot(rays.direction, q), invDet);
+			const __m128 t      = _mm_mul_ps(dot(edge2, q), invDet);
+
+			// |det| without the sign bit
+			const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+			__m128       mask   = _mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f));
+			mask                = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, _mm_setzero_ps()), _mm_cmpge_ps(v, _mm_setzero_ps())));
+			mask                = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+			mask                = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, _mm_setzero_ps()), _mm_cmplt_ps(t, tMax)));
+
+			const int laneMask = _mm_movemask_ps(mask);
+			if (!laneMask)
+				continue;
+
+			tMax = select(mask, t, tMax);
+
+			float ts[4], us[4], vs[4];
+			_mm_storeu_ps(ts, t);
+			_mm_storeu_ps(us, u);
+			_mm_storeu_ps(vs, v);
+			for (int lane = 0; lane != 4; lane++)
+				if (laneMask & (1 << lane))
+					hits.hits[lane] = {.t = ts[lane], .shape = hits.hits[lane].shape, .triangle = tri.index, .u = us[lane], .v = vs[lane]};
+			hitMask |= laneMask;
+		}
+	});
+
+	return hitMask;
+}
+
+#else
+
+uint32_t MeshBVH::intersect(const RayPacket4& packet, RayHit4& hits) const
+{
+	uint32_t hitMask = 0;
+
+	for (int i = 0; i != 4; i++)
+		if (packet.tMax[i] >= 0.0f && intersect(getRay(packet, i), hits.hits[i]))
+			hitMask |= 1 << i;
+
+	return hitMask;
+}
+
+#endif // BVH_SSE2
+
+SceneBVH::SceneBVH(const MeshData& meshData, const std::vector<DrawData>& shapes, const std::vector<glm::mat4x3>& globalTransforms, uint32_t numThreads)
+{
+	numThreads = numThreads ? numThreads : getNumWorkerThreads();
+
+	std::vector<uint32_t> usedMeshes;
+	for (const DrawData& shape : shapes)
+		usedMeshes.push_back(shape.meshIndex);
+	std::sort(usedMeshes.begin(), usedMeshes.end());
+	usedMeshes.erase(std::unique(usedMeshes.begin(), usedMeshes.end()), usedMeshes.end());
+
+	// one mesh per thread at a time, meshes are small compared to the scene
+	mMeshes.resize(meshData.meshes.size());
+	parallelForEach((uint32_t)usedMeshes.size(), numThreads, [&](uint32_t i, uint32_t)
+	{
+		mMeshes[usedMeshes[i]] = MeshBVH(meshData, usedMeshes[i], 1);
+	});
+
+	mInstances.resize(shapes.size());
+	for (size_t i = 0; i != shapes.size(); i++)
+		mInstances[i] = {.mesh = shapes[i].meshIndex, .transform = shapes[i].transformIndex};
+
+	updateInstances(globalTransforms);
+
+	std::vector<BoundingBox> bounds(mInstances.size());
+	for (size_t i = 0; i != mInstances.size(); i++)
+		bounds[i] = mInstances[i].bounds;
+
+	buildBVH(bounds, kMaxLeafSize, numThreads, mNodes, mInstanceIndices);
+}
+
+void SceneBVH::updateInstances(const std::vector<glm::mat4x3>& globalTransforms)
+{
+	for (Instance& instance : mInstances)
+	{
+		const glm::mat4  model(globalTransforms[instance.transform]);
+		instance.worldToLocal  = glm::inverse(model);
+		instance.bounds        = mMeshes[instance.mesh].getBounds().getTransformed(model);
+	}
+}
+
+void SceneBVH::refit(const std::vector<glm::mat4x3>& globalTransforms)
+{
+	updateInstances(globalTransforms);
+
+	// children come after their parents
+	for (size_t n = mNodes.size(); n-- > 0;)
+	{
+		BVHNode&    node   = mNodes[n];
+		BoundingBox bounds = getEmptyBox();
+
+		if (node.isLeaf())
+		{
+			for (uint32_t i = node.first; i != node.first + node.count; i++)
+				growBox(bounds, mInstances[mInstanceIndices[i]].bounds);
+		}
+		else
+		{
+			growBox(bounds, BoundingBox(mNodes[node.first].boxMin, mNodes[node.first].boxMax));
+			growBox(bounds, BoundingBox(mNodes[node.first + 1].boxMin, mNodes[node.first + 1].boxMax));
+		}
+
+		node.boxMin = bounds.min;
+		node.boxMax = bounds.max;
+	}
+}
+
+// the ray in the local space of an instance, t is the same in both spaces as the direction is not normalized
+static Ray getLocalRay(const Ray& ray, const glm::mat4& worldToLocal, float tMax)
+{
+	return {
+		.origin = vec3(worldToLocal * vec4(ray.origin, 1.0f)),
+		.direction = vec3(worldToLocal * vec4(ray.direction, 0.0f)),
+		.tMax = tMax
+	};
+}
+
+bool SceneBVH::intersect(const Ray& ray, RayHit& hit) const
+{
+	bool found = false;
+
+	traverseBVH(mNodes, ray, std::min(ray.tMax, hit.t), [&](uint32_t first, uint32_t count, float& tMax)
+	{
+		for (uint32_t i = first; i != first + count; i++)
+		{
+			const uint32_t  shape    = mInstanceIndices[i];
+			const Instance& instance = mInstances[shape];
+			RayHit          localHit;
+			if (mMeshes[instance.mesh].intersect(getLocalRay(ray, instance.worldToLocal, tMax), localHit))
+			{
+				hit       = localHit;
+				hit.shape = shape;
+				tMax      = hit.t;
+				found     = true;
+			}
+		}
+		return false;
+	});
+
+	return found;
+}
+
+bool SceneBVH::isOccluded(const Ray& ray) const
+{
+	bool occluded = false;
+
+	traverseBVH(mNodes, ray, ray.tMax, [&](uint32_t first, uint32_t count, float& tMax)
+	{
+		for (uint32_t i = first; i != first + count && !occluded; i++)
+		{
+			const Instance& instance = mInstances[mInstanceIndices[i]];
+			occluded                 = mMeshes[instance.mesh].isOccluded(getLocalRay(ray, instance.worldToLocal, tMax));
+		}
+		return occluded;
+	});
+
+	return occluded;
+}
+
+uint32_t SceneBVH::intersect(const RayPacket4& packet, RayHit4& hits) const
+{
+	uint32_t hitMask = 0;
+
+#ifdef BVH_SSE2
+	float tMaxLanes[4];
+	for (int i = 0; i != 4; i++)
+		tMaxLanes[i] = std::min(packet.tMax[i], hits.hits[i].t);
+	__m128 tMax = _mm_loadu_ps(tMaxLanes);
+
+	traverseBVH4(mNodes, packet, tMax, [&](uint32_t first, uint32_t count, const RayPacketSSE&, __m128& tMax)
+	{
+		for (uint32_t i = first; i != first + count; i++)
+		{
+			const uint32_t  shape    = mInstanceIndices[i];
+			const Instance& instance = mInstances[shape];
+
+			// all rays of the packet go to the local space of the instance together
+			float      tMaxLanes[4];
+			RayPacket4 local;
+			RayHit4    localHits;
+			_mm_storeu_ps(tMaxLanes, tMax);
+			for (int lane = 0; lane != 4; lane++)
+				local.setRay(lane, getLocalRay(getRay(packet, lane), instance.worldToLocal, tMaxLanes[lane]));
+
+			const uint32_t mask = mMeshes[instance.mesh].intersect(local, localHits);
+			for (int lane = 0; lane != 4; lane++)
+				if (mask & (1 << lane))
+				{
+					hits.hits[lane]       = localHits.hits[lane];
+					hits.hits[lane].shape = shape;
+					tMaxLanes[lane]       = localHits.hits[lane].t;
+				}
+			tMax = _mm_loadu_ps(tMaxLanes);
+			hitMask |= mask;
+		}
+	});
+#else
+	for (int i = 0; i != 4; i++)
+		if (packet.tMax[i] >= 0.0f && intersect(getRay(packet, i), hits.hits[i]))
+			hitMask |= 1 << i;
+#endif
+
+	return hitMask;
+}
+
+Ray SceneBVH::getScreenRay(const glm::vec2& pos, const glm::mat4& view, const glm::mat4& proj)
+{
+	const glm::mat4 invViewProj = glm::inverse(proj * view);
+	const glm::vec2 ndc(pos.x * 2.0f - 1.0f, 1.0f - pos.y * 2.0f);
+
+	const vec4 nearPoint = invViewProj * vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+	const vec4 farPoint  = invViewProj * vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+	const vec3 origin    = vec3(nearPoint) / nearPoint.w;
+
+	return {.origin = origin, .direction = glm::normalize(vec3(farPoint) / farPoint.w - origin)};
+}
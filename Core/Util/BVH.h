@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include "UtilsMath.h"
+#include "VtxData.h"
+
+constexpr uint32_t kInvalidBVHIndex = ~0u;
+
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction; // not necessarily normalized, t is measured in its length
+	float     tMax = FLT_MAX;
+};
+
+struct RayHit
+{
+	float    t        = FLT_MAX;
+	uint32_t shape    = kInvalidBVHIndex; // index into the shapes of SceneBVH, unused by MeshBVH
+	uint32_t triangle = kInvalidBVHIndex; // index of the triangle in LOD 0 of the mesh
+	float    u        = 0.0f;             // barycentric coordinates of the hit on the triangle
+	float    v        = 0.0f;
+
+	bool isHit() const { return triangle != kInvalidBVHIndex; }
+};
+
+// 4 rays traversed together, structure of arrays; inactive rays have a negative tMax
+struct RayPacket4
+{
+	float originX[4], originY[4], originZ[4];
+	float directionX[4], directionY[4], directionZ[4];
+	float tMax[4];
+
+	void setRay(int i, const Ray& ray);
+};
+
+struct RayHit4
+{
+	RayHit hits[4];
+};
+
+// The nodes of a bounding volume hierarchy built with the surface area heuristic over binned centroids. Both children
+// of a node are stored next to each other, after their parent, so refitting is a single reverse sweep over the nodes.
+struct BVHNode
+{
+	glm::vec3 boxMin;
+	uint32_t  first; // first child for inner nodes, first primitive for leaves
+	glm::vec3 boxMax;
+	uint32_t  count; // number of primitives, 0 for inner nodes
+
+	bool isLeaf() const { return count != 0; }
+};
+
+// builds the nodes over the bounds of primitives, primIndices gets the primitives in the order of the leaves.
+// Large nodes are binned in parallel with numThreads threads (0 = all hardware threads). Nodes at a depth of 64 become
+// leaves however many primitives they have, so the traversal stacks have a fixed size.
+void buildBVH(const std::vector<BoundingBox>& primBounds, uint32_t maxLeafSize, uint32_t numThreads, std::vector<BVHNode>& nodes, std::vector<uint32_t>& primIndices);
+
+// Bottom level: the triangles of LOD 0 of a mesh in the local space of the mesh.
+class MeshBVH
+{
+public:
+	static constexpr uint32_t kMaxLeafSize = 4;
+
+	MeshBVH() = default;
+	MeshBVH(const MeshData& meshData, uint32_t meshIndex, uint32_t numThreads = 1);
+
+	// closest hit closer than hit.t
+	bool intersect(const Ray& ray, RayHit& hit) const;
+	// any hit closer than ray.tMax
+	bool isOccluded(const Ray& ray) const;
+	// closest hits of every active ray of the packet, returns a mask of the rays that have hit something
+	uint32_t intersect(const RayPacket4& packet, RayHit4& hits) const;
+
+	BoundingBox getBounds() const;
+	size_t      getNumTriangles() const { return mTriangles.size(); }
+	size_t      getNumNodes() const { return mNodes.size(); }
+
+private:
+	// stored in the order of the leaves, ready for Moller-Trumbore
+	struct Triangle
+	{
+		glm::vec3 v0;
+		glm::vec3 edge1;
+		glm::vec3 edge2;
+		uint32_t  index;
+	};
+
+	template <bool AnyHit>
+	bool traverse(const Ray& ray, RayHit& hit) const;
+
+	std::vector<BVHNode>  mNodes;
+	std::vector<Triangle> mTriangles;
+};
+
+// Top level over the shapes of a scene, every shape is an instance of the MeshBVH of its mesh with its global transform.
+// refit() follows transforms changed by recalculateGlobalTransforms() without rebuilding anything, the tree only
+// degrades when shapes move far from where they were at build time.
+class SceneBVH
+{
+public:
+	static constexpr uint32_t kMaxLeafSize = 1;
+
+	// meshes are built in parallel, numThreads = 0 uses all hardware threads
+	SceneBVH(const MeshData& meshData, const std::vector<DrawData>& shapes, const std::vector<glm::mat4x3>& globalTransforms, uint32_t numThreads = 0);
+
+	void refit(const std::vector<glm::mat4x3>& globalTransforms);
+
+	bool     intersect(const Ray& ray, RayHit& hit) const;
+	bool     isOccluded(const Ray& ray) const;
+	uint32_t intersect(const RayPacket4& packet, RayHit4& hits) const;
+
+	// a ray through a point of the screen in [0, 1]^2, y down as in window coordinates
+	static Ray getScreenRay(const glm::vec2& pos, const glm::mat4& view, const glm::mat4& proj);
+
+	size_t getNumNodes() const { return mNodes.size(); }
+
+private:
+	struct Instance
+	{
+		uint32_t    mesh;
+		uint32_t    transform;
+		glm::mat4   worldToLocal;
+		BoundingBox bounds; // world space
+	};
+
+	void updateInstances(const std::vector<glm::mat4x3>& globalTransforms);
+
+	std::vector<MeshBVH>  mMeshes;
+	std::vector<Instance> mInstances; // one per shape
+	std::vector<BVHNode>  mNodes;
+	std::vector<uint32_t> mInstanceIndices;
+};
@@ -1,5 +1,9 @@
 #include "Camera.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 CameraPositionerFirstPerson::CameraPositionerFirstPerson(const glm::vec3& pos,
                                                          const glm::vec3& target,
                                                          const glm::vec3& up)
@@ -84,6 +88,273 @@ void CameraPositionerFirstPerson::resetMousePosition(const glm::vec2& p)
 	mMousePos = p;
 }
 
+CameraPositionerPath::CameraPositionerPath(const char* fileName)
+{
+	load(fileName);
+}
+
+// binary camera paths: a header followed by 8 floats per keyframe (time, position, orientation as x y z w)
+static constexpr uint32_t kCameraPathMagic   = 0x48544150; // "PATH"
+static constexpr uint32_t kCameraPathVersion = 1;
+
+struct CameraPathHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numKeyframes;
+};
+
+bool CameraPositionerPath::load(const char* fileName)
+{
+	FILE* f = fopen(fileName, "rb");
+
+	if (!f)
+	{
+		printf("Cannot open camera path '%s'\n", fileName);
+		return false;
+	}
+
+	CameraPathHeader header = {};
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != kCameraPathMagic)
+	{
+		fclose(f);
+		return loadText(fileName);
+	}
+
+	if (header.version != kCameraPathVersion)
+	{
+		printf("Camera path '%s' has version %u, expected %u\n", fileName, header.version, kCameraPathVersion);
+		fclose(f);
+		return false;
+	}
+
+	// the count is checked against the file before anything is allocated for it
+	const long dataStart = ftell(f);
+	fseek(f, 0, SEEK_END);
+	const long fileSize = ftell(f);
+	fseek(f, dataStart, SEEK_SET);
+
+	const size_t keyframeSize = sizeof(float) * 8;
+	if (dataStart < 0 || fileSize < dataStart || header.numKeyframes > (size_t)(fileSize - dataStart) / keyframeSize)
+	{
+		printf("Camera path '%s' is truncated: %u keyframes do not fit into %ld bytes\n", fileName, header.numKeyframes, fileSize);
+		fclose(f);
+		return false;
+	}
+
+	std::vector<float> data(size_t(header.numKeyframes) * 8);
+	const size_t       numRead = fread(data.data(), keyframeSize, header.numKeyframes, f);
+	fclose(f);
+
+	if (numRead != header.numKeyframes)
+	{
+		printf("Camera path '%s' is truncated\n", fileName);
+		return false;
+	}
+
+	mKeyframes.clear();
+	for (uint32_t i = 0; i != header.numKeyframes; i++)
+	{
+		const float* k = &data[size_t(i) * 8];
+		addKeyframe(k[0], glm::vec3(k[1], k[2], k[3]), glm::quat(k[7], k[4], k[5], k[6]));
+	}
+
+	setTime(0.0);
+
+	return !mKeyframes.empty();
+}
+
+bool CameraPositionerPath::loadText(const char* fileName)
+{
+	FILE* f = fopen(fileName, "r");
+
+	if (!f)
+	{
+		printf("Cannot open camera path '%s'\n", fileName);
+		return false;
+	}
+
+	mKeyframes.clear();
+
+	char line[256];
+	int  lineNumber = 0;
+	while (fgets(line, sizeof(line), f))
+	{
+		lineNumber++;
+
+		if (char* comment = strchr(line, '#'))
+			*comment = 0;
+
+		float     time;
+		glm::vec3 pos, target;
+		const int n = sscanf(line, "%f %f %f %f %f %f %f", &time, &pos.x, &pos.y, &pos.z, &target.x, &target.y, &target.z);
+		if (n == 7)
+			addKeyframe(time, pos, target);
+		else if (n > 0)
+			printf("%s(%d): expected 'time posX posY posZ targetX targetY targetZ'\n", fileName, lineNumber);
+	}
+
+	fclose(f);
+
+	setTime(0.0);
+
+	return !mKeyframes.empty();
+}
+
+bool CameraPositionerPath::save(const char* fileName) const
+{
+	FILE* f = fopen(fileName, "wb");
+
+	if (!f)
+	{
+		printf("Cannot write camera path '%s'\n", fileName);
+		return false;
+	}
+
+	const CameraPathHeader header = {kCameraPathMagic, kCameraPathVersion, (uint32_t)mKeyframes.size()};
+	fwrite(&header, sizeof(header), 1, f);
+
+	for (const Keyframe& k : mKeyframes)
+	{
+		const float data[8] = {
+			k.time,
+			k.position.x, k.position.y, k.position.z,
+			k.orientation.x, k.orientation.y, k.orientation.z, k.orientation.w
+		};
+		fwrite(data, sizeof(data), 1, f);
+	}
+
+	fclose(f);
+
+	return true;
+}
+
+void CameraPositionerPath::addKeyframe(float time, const glm::vec3& pos, const glm::vec3& target, const glm::vec3& up)
+{
+	addKeyframe(time, pos, glm::quat(glm::lookAt(pos, target, up)));
+}
+
+void CameraPositionerPath::addKeyframe(float time, const glm::vec3& pos, const glm::quat& orientation)
+{
+	const Keyframe key = {.time = time, .position = pos, .orientation = glm::normalize(orientation)};
+
+	const auto it = std::upper_bound(mKeyframes.begin(), mKeyframes.end(), time, [](float t, const Keyframe& k) { return t < k.time; });
+	mKeyframes.insert(it, key);
+
+	setTime(mTime);
+}
+
+void CameraPositionerPath::clear()
+{
+	mKeyframes.clear();
+	mTime = 0.0;
+}
+
+void CameraPositionerPath::update(double deltaSeconds)
+{
+	setTime(mTime + deltaSeconds);
+}
+
+void CameraPositionerPath::setTime(double time)
+{
+	mTime = time;
+
+	if (mKeyframes.empty())
+		return;
+
+	const float t = (float)time;
+
+	// the path holds the first and the last pose outside of its time range
+	const auto next = std::upper_bound(mKeyframes.begin(), mKeyframes.end(), t, [](float t, const Keyframe& k) { return t < k.time; });
+	if (next == mKeyframes.begin() || next == mKeyframes.end())
+	{
+		const Keyframe& k = next == mKeyframes.begin() ? mKeyframes.front() : mKeyframes.back();
+		mPosition         = k.position;
+		mOrientation      = k.orientation;
+		return;
+	}
+
+	const size_t    i1 = next - mKeyframes.begin();
+	const size_t    i0 = i1 - 1;
+	const Keyframe& k0 = mKeyframes[i0];
+	const Keyframe& k1 = mKeyframes[i1];
+
+	// Catmull-Rom tangents for non-uniformly spaced keyframes, the neighbours are clamped at both ends of the path
+	const Keyframe& kPrev = mKeyframes[i0 > 0 ? i0 - 1 : i0];
+	const Keyframe& kNext = mKeyframes[i1 + 1 < mKeyframes.size() ? i1 + 1 : i1];
+	const glm::vec3 m0    = (k1.position - kPrev.position) / (k1.time - kPrev.time);
+	const glm::vec3 m1    = (kNext.position - k0.position) / (kNext.time - k0.time);
+
+	// cubic Hermite basis
+	const float h  = k1.time - k0.time;
+	const float s  = (t - k0.time) / h;
+	const float s2 = s * s;
+	const float s3 = s2 * s;
+
+	mPosition = (2.0f * s3 - 3.0f * s2 + 1.0f) * k0.position + (s3 - 2.0f * s2 + s) * h * m0 +
+	            (-2.0f * s3 + 3.0f * s2) * k1.position + (s3 - s2) * h * m1;
+
+	// glm::slerp() takes the shortest arc
+	mOrientation = glm::slerp(k0.orientation, k1.orientation, s);
+}
+
+glm::mat4 CameraPositionerPath::getViewMatrix() const
+{
+	return glm::mat4_cast(mOrientation) * glm::translate(glm::mat4(1.0f), -mPosition);
+}
+
+glm::vec3 CameraPositionerPath::getPosition() const
+{
+	return mPosition;
+}
+
+CameraPathRecorder::CameraPathRecorder(const CameraPositionerInterface& positioner, float interval)
+	: mPositioner(positioner)
+	, mInterval(interval)
+{
+}
+
+void CameraPathRecorder::start()
+{
+	mPath.clear();
+	mTime         = 0.0;
+	mNextKeyframe = mInterval;
+	mRecording    = true;
+
+	addKeyframe();
+}
+
+void CameraPathRecorder::stop()
+{
+	// the last pose ends the path exactly where the recording stopped
+	if (mRecording && (mPath.getKeyframes().empty() || mPath.getKeyframes().back().time < (float)mTime))
+		addKeyframe();
+
+	mRecording = false;
+}
+
+void CameraPathRecorder::update(double deltaSeconds)
+{
+	if (!mRecording)
+		return;
+
+	mTime += deltaSeconds;
+
+	if (mTime >= mNextKeyframe)
+	{
+		addKeyframe();
+		mNextKeyframe = mTime + mInterval;
+	}
+}
+
+void CameraPathRecorder::addKeyframe()
+{
+	// the rotation part of the view matrix is the orientation of the camera
+	const glm::quat orientation = glm::quat_cast(glm::mat3(mPositioner.getViewMatrix()));
+
+	mPath.addKeyframe((float)mTime, mPositioner.getPosition(), orientation);
+}
+
 Camera::Camera(CameraPositionerInterface& positioner)
 	: mPositioner(positioner)
 {
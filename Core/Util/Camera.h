@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include <vector>
 
 class CameraPositionerInterface
 {
@@ -54,6 +55,81 @@ private:
 	glm::vec3 mUp                = glm::vec3(0.0f, 1.0f, 0.0f);
 };
 
+// Plays back a camera path defined by keyframes: positions follow a Catmull-Rom spline, orientations are slerped.
+// The time only advances through update() or setTime(), so a fixed time step renders the same frames on every run
+// regardless of the frame rate.
+// Paths are either recorded (see CameraPathRecorder) and saved as binary files, or written by hand as text with one
+// keyframe per line: "time posX posY posZ targetX targetY targetZ", '#' starts a comment. load() accepts both.
+class CameraPositionerPath : public CameraPositionerInterface
+{
+public:
+	struct Keyframe
+	{
+		float     time;
+		glm::vec3 position;
+		glm::quat orientation;
+	};
+
+	CameraPositionerPath() = default;
+	explicit CameraPositionerPath(const char* fileName);
+
+	bool load(const char* fileName);
+	bool save(const char* fileName) const;
+
+	void addKeyframe(float time, const glm::vec3& pos, const glm::vec3& target, const glm::vec3& up = glm::vec3(0.0f, 1.0f, 0.0f));
+	void addKeyframe(float time, const glm::vec3& pos, const glm::quat& orientation);
+	void clear();
+
+	const std::vector<Keyframe>& getKeyframes() const { return mKeyframes; }
+
+	void update(double deltaSeconds);
+	void setTime(double time);
+
+	double getTime() const { return mTime; }
+	float  getDuration() const { return mKeyframes.empty() ? 0.0f : mKeyframes.back().time; }
+	bool   isFinished() const { return mTime >= getDuration(); }
+
+	glm::mat4 getViewMatrix() const override;
+	glm::vec3 getPosition() const override;
+
+private:
+	bool loadText(const char* fileName);
+
+private:
+	std::vector<Keyframe> mKeyframes; // sorted by time
+	double                mTime        = 0.0;
+	glm::vec3             mPosition    = glm::vec3(0.0f);
+	glm::quat             mOrientation = glm::quat(glm::vec3(0.f));
+};
+
+// Samples the pose of any positioner at a fixed interval, e.g. while flying through a scene with the mouse, into a path
+// that CameraPositionerPath plays back
+class CameraPathRecorder
+{
+public:
+	explicit CameraPathRecorder(const CameraPositionerInterface& positioner, float interval = 0.1f);
+
+	void start();
+	void stop();
+	bool isRecording() const { return mRecording; }
+
+	// call once per frame
+	void update(double deltaSeconds);
+
+	const CameraPositionerPath& getPath() const { return mPath; }
+
+private:
+	void addKeyframe();
+
+private:
+	const CameraPositionerInterface& mPositioner;
+	CameraPositionerPath             mPath;
+	float                            mInterval;
+	double                           mTime         = 0.0;
+	double                           mNextKeyframe = 0.0;
+	bool                             mRecording    = false;
+};
+
 class Camera
 {
 public:
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// A node -> value component of a scene as (node, value) pairs sorted by node. Scenes add their nodes in increasing
+// order, so adding a component is an append; lookups are binary searches, iterating visits the nodes in order, and the
+// pairs are saved and loaded as one array. The entries are named like std::pair, code written for hash maps keeps working.
+class ComponentMap
+{
+public:
+	struct Entry
+	{
+		uint32_t first;  // node
+		uint32_t second; // value
+	};
+
+	using iterator       = std::vector<Entry>::iterator;
+	using const_iterator = std::vector<Entry>::const_iterator;
+
+	iterator       begin() { return mEntries.begin(); }
+	iterator       end() { return mEntries.end(); }
+	const_iterator begin() const { return mEntries.begin(); }
+	const_iterator end() const { return mEntries.end(); }
+
+	size_t       size() const { return mEntries.size(); }
+	bool         empty() const { return mEntries.empty(); }
+	const Entry* data() const { return mEntries.data(); }
+	void         clear() { mEntries.clear(); }
+	void         reserve(size_t count) { mEntries.reserve(count); }
+
+	iterator find(uint32_t node)
+	{
+		const auto i = lowerBound(node);
+		return (i != mEntries.end() && i->first == node) ? i : mEntries.end();
+	}
+
+	const_iterator find(uint32_t node) const
+	{
+		const auto i = std::lower_bound(mEntries.begin(), mEntries.end(), node, lessNode);
+		return (i != mEntries.end() && i->first == node) ? i : mEntries.end();
+	}
+
+	bool contains(uint32_t node) const { return find(node) != end(); }
+
+	// adds the node with a value of 0 if it has none
+	uint32_t& operator[](uint32_t node)
+	{
+		if (mEntries.empty() || mEntries.back().first < node)
+			return mEntries.emplace_back(Entry{node, 0}).second;
+
+		auto i = lowerBound(node);
+		if (i == mEntries.end() || i->first != node)
+			i = mEntries.insert(i, Entry{node, 0});
+		return i->second;
+	}
+
+	void erase(uint32_t node)
+	{
+		const auto i = find(node);
+		if (i != mEntries.end())
+			mEntries.erase(i);
+	}
+
+	// removes many entries in one pass
+	template <typename Predicate>
+	void eraseIf(const Predicate& predicate) { std::erase_if(mEntries, predicate); }
+
+	// replaces all entries, which have to be sorted by node
+	void assign(const Entry* entries, size_t count) { mEntries.assign(entries, entries + count); }
+
+	// for entries in any order, e.g. from files written before the components were sorted
+	void assignUnsorted(std::vector<Entry>&& entries)
+	{
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.first < b.first; });
+		mEntries = std::move(entries);
+	}
+
+private:
+	static bool lessNode(const Entry& e, uint32_t node) { return e.first < node; }
+
+	iterator lowerBound(uint32_t node) { return std::lower_bound(mEntries.begin(), mEntries.end(), node, lessNode); }
+
+	std::vector<Entry> mEntries;
+};
@@ -0,0 +1,128 @@
+#include "FileWatcher.h"
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher()
+	: mInotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	if (mInotify < 0)
+		printf("Cannot initialize inotify, file changes will not be detected\n");
+}
+
+FileWatcher::~FileWatcher()
+{
+	if (mInotify >= 0)
+		close(mInotify);
+}
+
+void FileWatcher::addFile(const std::string& fileName)
+{
+	const std::string name = ShaderPreprocessor::normalizePath(fileName);
+
+	if (!mFiles.insert(name).second || mInotify < 0)
+		return;
+
+	std::string dir = fs::path(name).parent_path().generic_string();
+	if (dir.empty())
+		dir = ".";
+
+	if (mWatchedDirectories.count(dir))
+		return;
+
+	const int wd = inotify_add_watch(mInotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd < 0)
+	{
+		printf("Cannot watch directory '%s'\n", dir.c_str());
+		return;
+	}
+
+	mDirectories[wd] = dir;
+	mWatchedDirectories.insert(dir);
+}
+
+std::vector<std::string> FileWatcher::getChangedFiles()
+{
+	std::vector<std::string> changed;
+
+	if (mInotify < 0)
+		return changed;
+
+	alignas(inotify_event) char buffer[4096];
+
+	for (;;)
+	{
+		const ssize_t length = read(mInotify, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (ssize_t i = 0; i < length;)
+		{
+			const inotify_event* event = (const inotify_event*)(buffer + i);
+			i += sizeof(inotify_event) + event->len;
+
+			const auto dir = mDirectories.find(event->wd);
+			if (!event->len || dir == mDirectories.end())
+				continue;
+
+			const std::string name = ShaderPreprocessor::normalizePath((fs::path(dir->second) / event->name).generic_string());
+
+			if (mFiles.count(name) && std::find(changed.begin(), changed.end(), name) == changed.end())
+				changed.push_back(name);
+		}
+	}
+
+	return changed;
+}
+
+#else
+
+FileWatcher::FileWatcher()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+void FileWatcher::addFile(const std::string& fileName)
+{
+	const std::string name = ShaderPreprocessor::normalizePath(fileName);
+
+	if (!mFiles.insert(name).second)
+		return;
+
+	std::error_code ec;
+	mTimeStamps[name] = fs::last_write_time(name, ec);
+}
+
+std::vector<std::string> FileWatcher::getChangedFiles()
+{
+	std::vector<std::string> changed;
+
+	for (auto& f : mTimeStamps)
+	{
+		std::error_code ec;
+		const auto      time = fs::last_write_time(f.first, ec);
+		if (!ec && time != f.second)
+		{
+			f.second = time;
+			changed.push_back(f.first);
+		}
+	}
+
+	return changed;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef __linux__
+#include <filesystem>
+#endif
+
+// Reports modifications of a set of files. On Linux the parent directories of the files are watched with inotify,
+// which also catches editors that save by writing a temporary file and renaming it over the original.
+// Elsewhere the modification times are compared on every call.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+
+	void addFile(const std::string& fileName);
+
+	// returns the watched files that changed since the previous call, never blocks
+	std::vector<std::string> getChangedFiles();
+
+private:
+	std::unordered_set<std::string> mFiles;
+#ifdef __linux__
+	int                                  mInotify = -1;
+	std::unordered_map<int, std::string> mDirectories; // watch descriptor -> directory
+	std::unordered_set<std::string>      mWatchedDirectories;
+#else
+	std::unordered_map<std::string, std::filesystem::file_time_type> mTimeStamps;
+#endif
+};
@@ -0,0 +1,279 @@
+#include "LooseOctree.h"
+
+#include <algorithm>
+#include <cmath>
+
+// cells of level 0 are clamped to [-kMaxCell, kMaxCell), items further away are treated as huge
+static constexpr int      kMaxCell = 1 << 20;
+static constexpr int      kKeyBits = 21;
+static constexpr uint64_t kKeyMask = (1ull << kKeyBits) - 1;
+
+static glm::ivec3 getParentCell(const glm::ivec3& cell, uint32_t levels)
+{
+	return glm::ivec3(cell.x >> levels, cell.y >> levels, cell.z >> levels);
+}
+
+static uint64_t getKey(const glm::ivec3& cell)
+{
+	return (uint64_t)(cell.x + kMaxCell) | ((uint64_t)(cell.y + kMaxCell) << kKeyBits) | ((uint64_t)(cell.z + kMaxCell) << (2 * kKeyBits));
+}
+
+static glm::ivec3 getCellFromKey(uint64_t key)
+{
+	return glm::ivec3((int)(key & kKeyMask) - kMaxCell, (int)((key >> kKeyBits) & kKeyMask) - kMaxCell, (int)((key >> (2 * kKeyBits)) & kKeyMask) - kMaxCell);
+}
+
+static bool intersects(const BoundingBox& a, const BoundingBox& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+		a.min.y <= b.max.y && a.max.y >= b.min.y &&
+		a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static bool intersects(const BoundingBox& box, const glm::vec3& center, float radius)
+{
+	const vec3 d = glm::clamp(center, box.min, box.max) - center;
+	return glm::dot(d, d) <= radius * radius;
+}
+
+LooseOctree::LooseOctree(float baseCellSize)
+	: mBaseCellSize(baseCellSize)
+{
+}
+
+glm::ivec3 LooseOctree::getCell(const glm::vec3& p) const
+{
+	const float limit = (float)kMaxCell;
+	return glm::ivec3((int)std::clamp(std::floor(p.x / mBaseCellSize), -limit, limit - 1.0f),
+	                  (int)std::clamp(std::floor(p.y / mBaseCellSize), -limit, limit - 1.0f),
+	                  (int)std::clamp(std::floor(p.z / mBaseCellSize), -limit, limit - 1.0f));
+}
+
+uint32_t LooseOctree::getLevel(const BoundingBox& box) const
+{
+	// the loose bounds of clamped cells would not contain the item
+	const float limit = kMaxCell * mBaseCellSize;
+	const vec3  c     = box.getCenter();
+	if (std::max({std::abs(c.x), std::abs(c.y), std::abs(c.z)}) >= limit)
+		return kNumLevels;
+
+	const vec3  size   = box.max - box.min;
+	const float extent = std::max({size.x, size.y, size.z});
+	if (extent <= mBaseCellSize)
+		return 0;
+
+	return std::min((uint32_t)std::ceil(std::log2(extent / mBaseCellSize)), kNumLevels);
+}
+
+float LooseOctree::getCellSize(uint32_t level) const
+{
+	return std::ldexp(mBaseCellSize, (int)level);
+}
+
+void LooseOctree::update(uint32_t item, const BoundingBox& box)
+{
+	if (item >= mItems.size())
+		mItems.resize(item + 1);
+
+	Item&            it    = mItems[item];
+	const uint32_t   level = getLevel(box);
+	const glm::ivec3 cell  = getCell(box.getCenter());
+
+	if (it.node != kNoNode)
+	{
+		// still in the same cell, the common case
+		if (level == it.level && (level == kNumLevels || getParentCell(cell, level) == getParentCell(it.cell, level)))
+		{
+			it.box  = box;
+			it.cell = cell;
+			return;
+		}
+		removeFromNode(item);
+		mStats.numRelocations++;
+	}
+	else
+	{
+		mStats.numItems++;
+	}
+
+	it.box   = box;
+	it.cell  = cell;
+	it.level = level;
+	add(item);
+}
+
+void LooseOctree::remove(uint32_t item)
+{
+	if (!contains(item))
+		return;
+
+	removeFromNode(item);
+	mStats.numItems--;
+}
+
+void LooseOctree::clear()
+{
+	mItems.clear();
+	mNodes.clear();
+	mFreeNodes.clear();
+	for (auto& nodeMap : mNodeMap)
+		nodeMap.clear();
+	mHugeItems.clear();
+	mStats = {};
+}
+
+void LooseOctree::add(uint32_t item)
+{
+	Item& it = mItems[item];
+
+	if (it.level == kNumLevels)
+	{
+		it.node = kHugeNode;
+		it.slot = (uint32_t)mHugeItems.size();
+		mHugeItems.push_back(item);
+		mStats.numHugeItems++;
+		return;
+	}
+
+	// the item is counted by the nodes of all levels above it, empty nodes are created on the way
+	for (uint32_t level = it.level; level != kNumLevels; level++)
+	{
+		const auto [i, inserted] = mNodeMap[level].try_emplace(getKey(getParentCell(it.cell, level)), 0);
+		if (inserted)
+		{
+			if (mFreeNodes.empty())
+			{
+				i->second = (uint32_t)mNodes.size();
+				mNodes.emplace_back();
+			}
+			else
+			{
+				i->second = mFreeNodes.back();
+				mFreeNodes.pop_back();
+			}
+			mStats.numNodes++;
+		}
+
+		Node& node = mNodes[i->second];
+		node.count++;
+		if (level == it.level)
+		{
+			it.node = i->second;
+			it.slot = (uint32_t)node.items.size();
+			node.items.push_back(item);
+		}
+	}
+}
+
+void LooseOctree::removeFromNode(uint32_t item)
+{
+	Item& it = mItems[item];
+
+	std::vector<uint32_t>& items = it.node == kHugeNode ? mHugeItems : mNodes[it.node].items;
+
+	const uint32_t last = items.back();
+	items[it.slot]      = last;
+	mItems[last].slot   = it.slot;
+	items.pop_back();
+
+	if (it.node == kHugeNode)
+	{
+		mStats.numHugeItems--;
+	}
+	else
+	{
+		// nodes with nothing below them are removed
+		for (uint32_t level = it.level; level != kNumLevels; level++)
+		{
+			const auto i = mNodeMap[level].find(getKey(getParentCell(it.cell, level)));
+			if (--mNodes[i->second].count == 0)
+			{
+				mFreeNodes.push_back(i->second);
+				mNodeMap[level].erase(i);
+				mStats.numNodes--;
+			}
+		}
+	}
+
+	it.node = kNoNode;
+}
+
+template <typename RegionTest, typename ItemTest>
+void LooseOctree::query(const RegionTest& regionTest, const ItemTest& itemTest, std::vector<uint32_t>& items) const
+{
+	for (const uint32_t item : mHugeItems)
+		if (itemTest(mItems[item].box))
+			items.push_back(item);
+
+	for (const auto& [key, node] : mNodeMap[kNumLevels - 1])
+		queryNode(kNumLevels - 1, getCellFromKey(key), node, regionTest, itemTest, items);
+}
+
+template <typename RegionTest, typename ItemTest>
+void LooseOctree::queryNode(uint32_t level, const glm::ivec3& cell, uint32_t nodeIndex, const RegionTest& regionTest, const ItemTest& itemTest, std::vector<uint32_t>& items) const
+{
+	const float cellSize = getCellSize(level);
+	const vec3  cellMin  = vec3((float)cell.x, (float)cell.y, (float)cell.z) * cellSize;
+
+	// everything below the node sticks out by at most half a cell of this level
+	BoundingBox region;
+	region.min = cellMin - vec3(0.5f * cellSize);
+	region.max = cellMin + vec3(1.5f * cellSize);
+	if (!regionTest(region))
+		return;
+
+	const Node& node = mNodes[nodeIndex];
+	for (const uint32_t item : node.items)
+		if (itemTest(mItems[item].box))
+			items.push_back(item);
+
+	if (level == 0 || node.items.size() == node.count)
+		return;
+
+	for (int i = 0; i != 8; i++)
+	{
+		const glm::ivec3 child(cell.x * 2 + (i & 1), cell.y * 2 + ((i >> 1) & 1), cell.z * 2 + (i >> 2));
+		const auto       c = mNodeMap[level - 1].find(getKey(child));
+		if (c != mNodeMap[level - 1].end())
+			queryNode(level - 1, child, c->second, regionTest, itemTest, items);
+	}
+}
+
+void LooseOctree::queryBox(const BoundingBox& box, std::vector<uint32_t>& items) const
+{
+	const auto test = [&box](const BoundingBox& b) { return intersects(box, b); };
+	query(test, test, items);
+}
+
+void LooseOctree::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& items) const
+{
+	const auto test = [&center, radius](const BoundingBox& b) { return intersects(b, center, radius); };
+	query(test, test, items);
+}
+
+void LooseOctree::queryFrustum(const glm::mat4& viewProj, std::vector<uint32_t>& items) const
+{
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 frustumCorners[8];
+	getFrustumPlanes(viewProj, frustumPlanes);
+	getFrustumCorners(viewProj, frustumCorners);
+
+	const auto test = [&](const BoundingBox& b) { return isBoxInFrustum(frustumPlanes, frustumCorners, b); };
+	query(test, test, items);
+}
+
+void addSceneNodes(LooseOctree& octree, const Scene& scene, const MeshData& meshData)
+{
+	for (const auto& [node, mesh] : scene.nodeIDToMeshID)
+		octree.update(node, meshData.boundingBoxes[mesh].getTransformed(glm::mat4(scene.globalTransform[node])));
+}
+
+void updateSceneNodes(LooseOctree& octree, const Scene& scene, const MeshData& meshData, const std::vector<int>& changedNodes)
+{
+	for (const int node : changedNodes)
+	{
+		const auto mesh = scene.nodeIDToMeshID.find(node);
+		if (mesh != scene.nodeIDToMeshID.end())
+			octree.update(node, meshData.boundingBoxes[mesh->second].getTransformed(glm::mat4(scene.globalTransform[node])));
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Scene.h"
+#include "UtilsMath.h"
+#include "VtxData.h"
+
+// A loose octree without a root box: the nodes of every level are the cells of an infinite uniform grid, stored in a
+// hash map per level only while something lives under them. Cells of level 0 are baseCellSize large and double in size
+// with every level, the 8 children of a cell are the cells of the level below inside it.
+// An item lives in the cell containing the center of its box on the smallest level whose cells are at least as large
+// as the box. Cells are loose, their items may stick out by half a cell, so a query descends into a cell if the cell
+// expanded by half its size intersects the query volume.
+// Moving an item only touches the hash maps when it changes its cell, which slowly moving items rarely do.
+class LooseOctree
+{
+public:
+	static constexpr uint32_t kNumLevels = 16;
+
+	struct Stats
+	{
+		uint32_t numItems       = 0;
+		uint32_t numNodes       = 0;
+		uint32_t numHugeItems   = 0; // larger than the cells of the top level, tested by every query
+		uint32_t numRelocations = 0; // items which have changed their cell since the last resetStats()
+	};
+
+	explicit LooseOctree(float baseCellSize = 1.0f);
+
+	// items are small integers, like the indices of scene nodes; update() inserts items which are not in the tree yet
+	void update(uint32_t item, const BoundingBox& box);
+	void remove(uint32_t item);
+	void clear();
+
+	bool               contains(uint32_t item) const { return item < mItems.size() && mItems[item].node != kNoNode; }
+	const BoundingBox& getBox(uint32_t item) const { return mItems[item].box; }
+
+	// append the items whose boxes intersect the volume, in no particular order
+	void queryBox(const BoundingBox& box, std::vector<uint32_t>& items) const;
+	void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& items) const;
+	void queryFrustum(const glm::mat4& viewProj, std::vector<uint32_t>& items) const;
+
+	const Stats& getStats() const { return mStats; }
+	void         resetStats() { mStats.numRelocations = 0; }
+
+private:
+	static constexpr uint32_t kNoNode   = ~0u;
+	static constexpr uint32_t kHugeNode = ~0u - 1;
+
+	struct Item
+	{
+		BoundingBox box;
+		glm::ivec3  cell; // cell of the center on level 0
+		uint32_t    level = 0;
+		uint32_t    node  = kNoNode;
+		uint32_t    slot  = 0; // position in the items of the node
+	};
+
+	struct Node
+	{
+		uint32_t              count = 0; // items in this node and below it
+		std::vector<uint32_t> items;
+	};
+
+	glm::ivec3 getCell(const glm::vec3& p) const;
+	uint32_t   getLevel(const BoundingBox& box) const;
+	float      getCellSize(uint32_t level) const;
+
+	void add(uint32_t item);
+	void removeFromNode(uint32_t item);
+
+	// visits the nodes whose loose bounds pass regionTest(box) and appends their items which pass itemTest(box)
+	template <typename RegionTest, typename ItemTest>
+	void query(const RegionTest& regionTest, const ItemTest& itemTest, std::vector<uint32_t>& items) const;
+	template <typename RegionTest, typename ItemTest>
+	void queryNode(uint32_t level, const glm::ivec3& cell, uint32_t node, const RegionTest& regionTest, const ItemTest& itemTest, std::vector<uint32_t>& items) const;
+
+	float mBaseCellSize;
+
+	std::vector<Item> mItems; // indexed by item
+
+	std::vector<Node>                      mNodes;
+	std::vector<uint32_t>                  mFreeNodes;
+	std::unordered_map<uint64_t, uint32_t> mNodeMap[kNumLevels]; // cell -> node
+	std::vector<uint32_t>                  mHugeItems;
+
+	Stats mStats;
+};
+
+// every node of the scene with a mesh, with the bounds of its mesh transformed by its global transform
+void addSceneNodes(LooseOctree& octree, const Scene& scene, const MeshData& meshData);
+// moves the nodes recalculated by recalculateGlobalTransforms()
+void updateSceneNodes(LooseOctree& octree, const Scene& scene, const MeshData& meshData, const std::vector<int>& changedNodes);
@@ -0,0 +1,46 @@
+#include "Luminance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+float getLuminance(float r, float g, float b)
+{
+	return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+float getLogAverageLuminance(const float* pixels, uint32_t width, uint32_t height, uint32_t numComponents)
+{
+	if (!width || !height)
+		return 0.0f;
+
+	// partial sums per tile first, as the workgroups of the first pass do
+	const uint32_t     tilesX = (width + kLuminanceTileSize - 1) / kLuminanceTileSize;
+	const uint32_t     tilesY = (height + kLuminanceTileSize - 1) / kLuminanceTileSize;
+	std::vector<float> partialSums(tilesX * tilesY, 0.0f);
+
+	for (uint32_t y = 0; y != height; y++)
+	{
+		for (uint32_t x = 0; x != width; x++)
+		{
+			const float*   p = pixels + (y * width + x) * numComponents;
+			const uint32_t t = (y / kLuminanceTileSize) * tilesX + x / kLuminanceTileSize;
+			partialSums[t] += std::log(kLuminanceLogDelta + std::max(getLuminance(p[0], p[1], p[2]), 0.0f));
+		}
+	}
+
+	double sum = 0.0;
+	for (const float s : partialSums)
+		sum += s;
+
+	return (float)std::exp(sum / ((double)width * height));
+}
+
+float adaptLuminance(float adapted, float target, float deltaSeconds, float speedUp, float speedDown)
+{
+	if (adapted < 0.0f)
+		return target;
+
+	const float speed = target > adapted ? speedUp : speedDown;
+	return adapted + (target - adapted) * (1.0f - std::exp(-deltaSeconds * speed));
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// CPU reference of the luminance reduction and eye adaptation of 18HDR (see data/shaders/18HDR/luminance*.comp).
+// It follows the same steps as the compute shaders, so their results can be checked without a GPU.
+
+// pixels of a tile are reduced by one workgroup of the GPU reduction
+constexpr uint32_t kLuminanceTileSize = 32;
+
+// keeps black pixels from sending the logarithm to -infinity
+constexpr float kLuminanceLogDelta = 1e-4f;
+
+// Rec. 709 luminance of a linear RGB color
+float getLuminance(float r, float g, float b);
+
+// log-average luminance exp(mean(log(delta + L))) of an image with numComponents floats per pixel (RGB first)
+float getLogAverageLuminance(const float* pixels, uint32_t width, uint32_t height, uint32_t numComponents);
+
+// moves the adapted luminance towards the luminance of the frame, brightening and darkening at different speeds
+// (in 1/seconds), independently of the frame rate. A negative adapted luminance means no previous frame.
+float adaptLuminance(float adapted, float target, float deltaSeconds, float speedUp, float speedDown);
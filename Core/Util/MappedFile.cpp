@@ -0,0 +1,81 @@
+#include "MappedFile.h"
+
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef MAPPED_FILE_MMAP
+
+MappedFile::MappedFile(const char* fileName)
+{
+	const int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0)
+	{
+		mSize = (size_t)st.st_size;
+		mOpen = true;
+		// mmap() refuses empty files
+		if (mSize > 0)
+		{
+			void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				// the whole file is about to be read, start reading ahead
+				madvise(data, mSize, MADV_WILLNEED);
+				mData   = (const uint8_t*)data;
+				mMapped = true;
+			}
+			else
+			{
+				mOpen = false;
+			}
+		}
+	}
+
+	// the mapping stays valid without the descriptor
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (mMapped)
+		munmap((void*)mData, mSize);
+}
+
+#else
+
+MappedFile::MappedFile(const char* fileName)
+{
+	FILE* f = fopen(fileName, "rb");
+	if (!f)
+		return;
+
+	fseek(f, 0, SEEK_END);
+	const long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if (size >= 0)
+	{
+		mBuffer.resize((size_t)size);
+		mOpen = fread(mBuffer.data(), 1, mBuffer.size(), f) == mBuffer.size();
+		mData = mBuffer.data();
+		mSize = mBuffer.size();
+	}
+
+	fclose(f);
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A read-only view of a whole file. On Linux and other POSIX systems the file is mapped into memory and the pages are
+// only read when they are touched; elsewhere the file is read into a buffer with a single fread().
+class MappedFile
+{
+public:
+	explicit MappedFile(const char* fileName);
+	~MappedFile();
+	MappedFile(const MappedFile&)            = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool           isOpen() const { return mOpen; }
+	const uint8_t* getData() const { return mData; }
+	size_t         getSize() const { return mSize; }
+
+private:
+	const uint8_t*       mData = nullptr;
+	size_t               mSize = 0;
+	bool                 mOpen = false;
+	bool                 mMapped = false;
+	std::vector<uint8_t> mBuffer;
+};
@@ -1,36 +1,159 @@
 #include "Material.h"
 #include "Scene.h"
 
-void saveMaterials(const char*                             fileName,
+#include <algorithm>
+#include <cstdio>
+
+// MaterialData as it was stored before the texture array layers, in files without a header
+struct PACKED_STRUCT MaterialDataV0
+{
+	GpuVec4  emissiveColor;
+	GpuVec4  albedoColor;
+	GpuVec4  roughness;
+	float    transparencyFactor;
+	float    alphaTest;
+	float    metallicFactor;
+	uint32_t flags;
+	uint64_t ambientOcclusionMap;
+	uint64_t emissiveMap;
+	uint64_t albedoMap;
+	uint64_t metallicRoughnessMap;
+	uint64_t normalMap;
+	uint64_t opacityMap;
+};
+
+static_assert(sizeof(MaterialDataV0) == 112, "MaterialDataV0 must match the old material files");
+
+static MaterialData convertMaterial(const MaterialDataV0& m)
+{
+	// every texture was a separate file, which is an array with a single layer
+	MaterialData d;
+	d.emissiveColor        = m.emissiveColor;
+	d.albedoColor          = m.albedoColor;
+	d.roughness            = m.roughness;
+	d.transparencyFactor   = m.transparencyFactor;
+	d.alphaTest            = m.alphaTest;
+	d.metallicFactor       = m.metallicFactor;
+	d.flags                = m.flags | (m.alphaTest > 0.0f ? sMaterialFlags_AlphaTest : 0);
+	d.ambientOcclusionMap  = m.ambientOcclusionMap;
+	d.emissiveMap          = m.emissiveMap;
+	d.albedoMap            = m.albedoMap;
+	d.metallicRoughnessMap = m.metallicRoughnessMap;
+	d.normalMap            = m.normalMap;
+	d.opacityMap           = m.opacityMap;
+	return d;
+}
+
+// counts of corrupt files are not trusted with an allocation
+static bool fitsInFile(FILE* f, uint64_t size)
+{
+	const long pos = ftell(f);
+	fseek(f, 0, SEEK_END);
+	const long end = ftell(f);
+	fseek(f, pos, SEEK_SET);
+	return pos >= 0 && end >= pos && size <= (uint64_t)(end - pos);
+}
+
+static bool readMaterials(FILE* f, std::vector<MaterialData>& materials, std::vector<std::string>& files, std::vector<uint32_t>& textureArrays)
+{
+	uint32_t magic = 0;
+	if (fread(&magic, sizeof(uint32_t), 1, f) != 1)
+		return false;
+
+	if (magic != kMaterialFileMagic)
+	{
+		// the first value of an old file is the number of materials
+		if (!fitsInFile(f, (uint64_t)magic * sizeof(MaterialDataV0)))
+			return false;
+		std::vector<MaterialDataV0> old(magic);
+		if (fread(old.data(), sizeof(MaterialDataV0), old.size(), f) != old.size() || !loadStringList(f, files))
+			return false;
+
+		materials.clear();
+		materials.reserve(old.size());
+		for (const MaterialDataV0& m : old)
+			materials.push_back(convertMaterial(m));
+
+		textureArrays.clear();
+		for (uint32_t i = 0; i <= (uint32_t)files.size(); i++)
+			textureArrays.push_back(i);
+		return true;
+	}
+
+	uint32_t version = 0, sz = 0;
+	if (fread(&version, sizeof(uint32_t), 1, f) != 1 || version < 1 || version > kMaterialFileVersion)
+	{
+		printf("Unsupported material file version %u, expected 1 to %u\n", version, kMaterialFileVersion);
+		return false;
+	}
+
+	if (fread(&sz, sizeof(uint32_t), 1, f) != 1 || !fitsInFile(f, (uint64_t)sz * sizeof(MaterialData)))
+		return false;
+	materials.resize(sz);
+	if (fread(materials.data(), sizeof(MaterialData), materials.size(), f) != materials.size() || !loadStringList(f, files))
+		return false;
+	if (version < 2)
+		for (MaterialData& m : materials)
+			if (m.alphaTest > 0.0f)
+				m.flags |= sMaterialFlags_AlphaTest;
+
+	if (fread(&sz, sizeof(uint32_t), 1, f) != 1 || !fitsInFile(f, (uint64_t)sz * sizeof(uint32_t)))
+		return false;
+	textureArrays.resize(sz);
+	if (fread(textureArrays.data(), sizeof(uint32_t), sz, f) != sz)
+		return false;
+
+	// the layers of every array are a range of the files
+	return !textureArrays.empty() && textureArrays.front() == 0 && textureArrays.back() == files.size() &&
+	       std::is_sorted(textureArrays.begin(), textureArrays.end());
+}
+
+void saveMaterials(const char*                      fileName,
                    const std::vector<MaterialData>& materials,
-                   const std::vector<std::string>&         files)
+                   const std::vector<std::string>&  files,
+                   const std::vector<uint32_t>&     textureArrays)
 {
 	FILE* f = fopen(fileName, "wb");
 	if (!f)
 		return;
 
+	const uint32_t header[] = {kMaterialFileMagic, kMaterialFileVersion};
+	fwrite(header, sizeof(header), 1, f);
+
 	uint32_t sz = (uint32_t)materials.size();
 	fwrite(&sz, 1, sizeof(uint32_t), f);
 	fwrite(materials.data(), sizeof(MaterialData), sz, f);
 	saveStringList(f, files);
+
+	sz = (uint32_t)textureArrays.size();
+	fwrite(&sz, 1, sizeof(uint32_t), f);
+	fwrite(textureArrays.data(), sizeof(uint32_t), sz, f);
 	fclose(f);
 }
 
-void loadMaterials(const char*                       fileName,
+bool loadMaterials(const char*                fileName,
                    std::vector<MaterialData>& materials,
-                   std::vector<std::string>&         files)
+                   std::vector<std::string>&  files,
+                   std::vector<uint32_t>&     textureArrays)
 {
 	FILE* f = fopen(fileName, "rb");
 	if (!f)
 	{
 		printf("Cannot load file %s\nPlease run SceneConverter tool\n", fileName);
-		exit(255);
+		return false;
 	}
 
-	uint32_t sz;
-	fread(&sz, 1, sizeof(uint32_t), f);
-	materials.resize(sz);
-	fread(materials.data(), sizeof(MaterialData), materials.size(), f);
-	loadStringList(f, files);
+	const bool loaded = readMaterials(f, materials, files, textureArrays);
 	fclose(f);
+
+	if (!loaded)
+	{
+		printf("Cannot load file %s: the file is truncated, corrupt or of another version\nPlease run SceneConverter tool\n", fileName);
+		materials.clear();
+		files.clear();
+		textureArrays.clear();
+		return false;
+	}
+
+	return true;
 }
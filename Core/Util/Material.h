@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 #include <vector>
 
@@ -8,6 +10,7 @@ enum MaterialFlags
 	sMaterialFlags_CastShadow = 0x1,
 	sMaterialFlags_ReceiveShadow = 0x2,
 	sMaterialFlags_Transparent = 0x4,
+	sMaterialFlags_AlphaTest = 0x8,
 };
 
 constexpr uint64_t INVALID_TEXTURE = 0xFFFFFFFF;
@@ -31,9 +34,25 @@ struct PACKED_STRUCT MaterialData final
 	uint64_t metallicRoughnessMap = INVALID_TEXTURE;
 	uint64_t normalMap            = INVALID_TEXTURE;
 	uint64_t opacityMap           = INVALID_TEXTURE;
+	// maps are indices of texture arrays, these are the layers inside those arrays
+	uint32_t ambientOcclusionLayer  = 0;
+	uint32_t emissiveLayer          = 0;
+	uint32_t albedoLayer            = 0;
+	uint32_t metallicRoughnessLayer = 0;
+	uint32_t normalLayer            = 0;
+	uint32_t padding[3]             = {0, 0, 0};
 };
 
 static_assert(sizeof(MaterialData) % 16 == 0, "MaterialDescription should be padded to 16 bytes");
 
-void saveMaterials(const char* fileName, const std::vector<MaterialData>& materials, const std::vector<std::string>& files);
-void loadMaterials(const char* fileName, std::vector<MaterialData>& materials, std::vector<std::string>& files);
+// material files start with the magic value and the version, files without them have the layout of MaterialData
+// before the texture array layers were added and are converted when they are loaded;
+// version 1 files predate sMaterialFlags_AlphaTest, the flag is derived from alphaTest for them
+constexpr uint32_t kMaterialFileMagic   = 0x54414D53; // "SMAT"
+constexpr uint32_t kMaterialFileVersion = 2;
+
+// texture files are grouped into texture arrays:
+// the layers of array i are files[textureArrays[i]] ... files[textureArrays[i + 1] - 1]
+void saveMaterials(const char* fileName, const std::vector<MaterialData>& materials, const std::vector<std::string>& files, const std::vector<uint32_t>& textureArrays);
+// false if the file is missing, damaged or of an unknown version, the lists are empty then
+bool loadMaterials(const char* fileName, std::vector<MaterialData>& materials, std::vector<std::string>& files, std::vector<uint32_t>& textureArrays);
@@ -0,0 +1,144 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// position, uv and normal
+static constexpr uint32_t kVertexStride = 8;
+
+static float edgeFunction(const glm::vec3& a, const glm::vec3& b, float px, float py)
+{
+	return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+	: mWidth(width)
+	, mHeight(height)
+	, mDepth(width * height, 1.0f)
+{
+}
+
+void OcclusionBuffer::begin(const glm::mat4& viewProj)
+{
+	mViewProj     = viewProj;
+	mNumTriangles = 0;
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+}
+
+void OcclusionBuffer::rasterizeTriangles(const float* vertices, uint32_t stride, const uint32_t* indices, uint32_t numIndices, const glm::mat4& model)
+{
+	const glm::mat4 mvp = mViewProj * model;
+
+	for (uint32_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		glm::vec3 p[3];
+		bool      clipped = false;
+
+		for (int k = 0; k != 3; k++)
+		{
+			const float*    v    = vertices + indices[i + k] * stride;
+			const glm::vec4 clip = mvp * glm::vec4(v[0], v[1], v[2], 1.0f);
+			if (clip.w <= 0.0f || clip.z < -clip.w)
+			{
+				clipped = true;
+				break;
+			}
+			const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			p[k]                = glm::vec3((ndc.x * 0.5f + 0.5f) * mWidth, (ndc.y * 0.5f + 0.5f) * mHeight, ndc.z * 0.5f + 0.5f);
+		}
+
+		if (clipped)
+			continue;
+
+		// both windings are rasterized, the scene has double-sided materials
+		const float area = edgeFunction(p[0], p[1], p[2].x, p[2].y);
+		if (area == 0.0f)
+			continue;
+
+		// pixels entirely inside the bounds of the triangle
+		const int x0 = std::max((int)std::ceil(std::min({p[0].x, p[1].x, p[2].x})), 0);
+		const int x1 = std::min((int)std::floor(std::max({p[0].x, p[1].x, p[2].x})) - 1, mWidth - 1);
+		const int y0 = std::max((int)std::ceil(std::min({p[0].y, p[1].y, p[2].y})), 0);
+		const int y1 = std::min((int)std::floor(std::max({p[0].y, p[1].y, p[2].y})) - 1, mHeight - 1);
+
+		if (x0 > x1 || y0 > y1)
+			continue;
+
+		mNumTriangles++;
+
+		const float invArea = 1.0f / area;
+
+		// window depth at a pixel corner, false if the corner is outside the triangle
+		auto cornerDepth = [&p, invArea](float px, float py, float& depth) {
+			const float w0 = edgeFunction(p[1], p[2], px, py) * invArea;
+			const float w1 = edgeFunction(p[2], p[0], px, py) * invArea;
+			const float w2 = edgeFunction(p[0], p[1], px, py) * invArea;
+			// window depth is linear in screen space
+			depth = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+			return w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f;
+		};
+
+		// an occluder only fills pixels it covers completely, all four corners inside the (convex) triangle, and with
+		// its farthest depth in the pixel, which is at a corner because the depth is linear; a pixel behind it is
+		// then hidden wherever it is sampled
+		for (int y = y0; y <= y1; y++)
+		{
+			float* row = mDepth.data() + y * mWidth;
+			for (int x = x0; x <= x1; x++)
+			{
+				float d[4];
+				if (!cornerDepth((float)x, (float)y, d[0]) || !cornerDepth(x + 1.0f, (float)y, d[1]) ||
+				    !cornerDepth((float)x, y + 1.0f, d[2]) || !cornerDepth(x + 1.0f, y + 1.0f, d[3]))
+					continue;
+				row[x] = std::min(row[x], std::max({d[0], d[1], d[2], d[3]}));
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::rasterizeShape(const MeshData& meshData, const DrawData& shape, const glm::mat4& model)
+{
+	const Mesh& mesh = meshData.meshes[shape.meshIndex];
+
+	rasterizeTriangles(meshData.vertexData.data() + shape.vertexOffset * kVertexStride,
+	                   kVertexStride,
+	                   meshData.indexData.data() + shape.indexOffset,
+	                   mesh.getLODIndicesCount(shape.LOD),
+	                   model);
+}
+
+bool OcclusionBuffer::isVisible(const BoundingBox& box) const
+{
+	glm::vec3 ndcMin(FLT_MAX);
+	glm::vec3 ndcMax(-FLT_MAX);
+
+	for (int i = 0; i != 8; i++)
+	{
+		const glm::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+		const glm::vec4 clip = mViewProj * glm::vec4(corner, 1.0f);
+		// the box may cover the whole screen
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+			return true;
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		ndcMin              = glm::min(ndcMin, ndc);
+		ndcMax              = glm::max(ndcMax, ndc);
+	}
+
+	if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f)
+		return false;
+
+	// every pixel the box touches, not only the ones whose centers it covers
+	const int x0 = std::max((int)std::floor((ndcMin.x * 0.5f + 0.5f) * mWidth), 0);
+	const int x1 = std::min((int)std::floor((ndcMax.x * 0.5f + 0.5f) * mWidth), mWidth - 1);
+	const int y0 = std::max((int)std::floor((ndcMin.y * 0.5f + 0.5f) * mHeight), 0);
+	const int y1 = std::min((int)std::floor((ndcMax.y * 0.5f + 0.5f) * mHeight), mHeight - 1);
+
+	const float nearestDepth = ndcMin.z * 0.5f + 0.5f;
+
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+			if (nearestDepth <= mDepth[y * mWidth + x])
+				return true;
+
+	return false;
+}
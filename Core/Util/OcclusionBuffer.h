@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "UtilsMath.h"
+#include "VtxData.h"
+
+// A low resolution depth buffer rasterized on the CPU, the fallback and reference of the Hi-Z occlusion culling
+// (see data/shaders/15LargeScene/occlusionCull.comp). It keeps window depths in [0, 1] like the depth buffer, so the
+// results of both can be compared, and it does not need a GL context.
+// Occluders are rasterized first, then boxes are tested against them. Both sides stay conservative: occluder triangles
+// only fill the pixels they cover completely, with their farthest depth there, triangles crossing the near plane are
+// dropped instead of clipped and boxes crossing it are always visible.
+class OcclusionBuffer
+{
+public:
+	static constexpr int kDefaultWidth  = 256;
+	static constexpr int kDefaultHeight = 128;
+
+	explicit OcclusionBuffer(int width = kDefaultWidth, int height = kDefaultHeight);
+
+	// clears to the far plane
+	void begin(const glm::mat4& viewProj);
+
+	// vertices are positions with stride floats between them, the indices are relative to the first vertex
+	void rasterizeTriangles(const float* vertices, uint32_t stride, const uint32_t* indices, uint32_t numIndices, const glm::mat4& model);
+	// a shape of MeshData, with interleaved position, uv and normal as in GLSceneData
+	void rasterizeShape(const MeshData& meshData, const DrawData& shape, const glm::mat4& model);
+
+	// a world-space box is visible if it is inside the frustum and not behind the occluders
+	bool isVisible(const BoundingBox& box) const;
+
+	int                       getWidth() const { return mWidth; }
+	int                       getHeight() const { return mHeight; }
+	const std::vector<float>& getDepth() const { return mDepth; }
+	uint64_t                  getNumRasterizedTriangles() const { return mNumTriangles; }
+
+private:
+	int                mWidth;
+	int                mHeight;
+	glm::mat4          mViewProj = glm::mat4(1.0f);
+	std::vector<float> mDepth;
+	uint64_t           mNumTriangles = 0;
+};
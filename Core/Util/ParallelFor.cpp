@@ -0,0 +1,57 @@
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+uint32_t getNumWorkerThreads()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// runs func(thread) on numThreads threads, including the calling one
+static void runThreads(uint32_t numThreads, const std::function<void(uint32_t thread)>& func)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+
+	for (uint32_t t = 1; t < numThreads; t++)
+		threads.emplace_back(func, t);
+
+	func(0);
+
+	for (std::thread& t : threads)
+		t.join();
+}
+
+void parallelFor(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t first, uint32_t last, uint32_t thread)>& func)
+{
+	if (!count)
+		return;
+
+	numThreads = std::min(numThreads ? numThreads : getNumWorkerThreads(), count);
+
+	runThreads(numThreads, [&](uint32_t thread)
+	{
+		const uint32_t first = (uint32_t)((uint64_t)count * thread / numThreads);
+		const uint32_t last  = (uint32_t)((uint64_t)count * (thread + 1) / numThreads);
+		func(first, last, thread);
+	});
+}
+
+void parallelForEach(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t item, uint32_t thread)>& func)
+{
+	if (!count)
+		return;
+
+	numThreads = std::min(numThreads ? numThreads : getNumWorkerThreads(), count);
+
+	std::atomic<uint32_t> next = 0;
+
+	runThreads(numThreads, [&](uint32_t thread)
+	{
+		for (uint32_t item = next++; item < count; item = next++)
+			func(item, thread);
+	});
+}
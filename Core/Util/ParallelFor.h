@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// number of threads to use when a caller asks for 0, at least 1
+uint32_t getNumWorkerThreads();
+
+// Splits [0, count) into one contiguous range per thread and calls func(first, last, thread) for each on its own thread.
+// The split only depends on count and numThreads, so work that is merged in thread order gives the same result on every
+// run. numThreads = 0 uses getNumWorkerThreads(), the calling thread runs the first range.
+void parallelFor(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t first, uint32_t last, uint32_t thread)>& func);
+
+// Calls func(item, thread) for every item of [0, count), threads pull the next item from a shared counter.
+// For items of uneven cost, such as the tiles of a frame.
+void parallelForEach(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t item, uint32_t thread)>& func);
@@ -1,9 +1,53 @@
 #include "Scene.h"
+#include "MappedFile.h"
+#include "Utils.h"
 
-std::string getNodeName(const Scene& scene, int node)
+#include <cstddef>
+#include <cstring>
+
+std::string_view getNodeName(const Scene& scene, int node)
+{
+	const auto strID = scene.nodeIDToNameID.find(node);
+	return (strID != scene.nodeIDToNameID.end()) ? scene.names[strID->second] : std::string_view("");
+}
+
+SceneNameIndex::SceneNameIndex(const Scene& scene)
+	: mScene(scene)
+	, mNameToNode(scene.names.size(), -1)
+{
+	// the components are sorted by node, the first node with a name is the one found
+	for (const auto& [node, name] : scene.nodeIDToNameID)
+		if (mNameToNode[name] < 0)
+			mNameToNode[name] = (int)node;
+}
+
+int SceneNameIndex::findNode(std::string_view name) const
+{
+	const uint32_t strID = mScene.names.find(name);
+	return strID != StringPool::kInvalidString ? mNameToNode[strID] : -1;
+}
+
+std::vector<DrawData> getSceneShapes(const Scene& scene, const MeshData& meshData)
 {
-	int strID = scene.nodeIDToNameID.contains(node) ? scene.nodeIDToNameID.at(node) : -1;
-	return (strID > -1) ? scene.names[strID] : std::string();
+	std::vector<DrawData> shapes;
+
+	for (const auto& c : scene.nodeIDToMeshID)
+	{
+		auto material = scene.nodeIDToMaterialID.find(c.first);
+		if (material != scene.nodeIDToMaterialID.end())
+		{
+			shapes.push_back(DrawData{
+				                 .meshIndex = c.second,
+				                 .materialIndex = material->second,
+				                 .LOD = 0,
+				                 .indexOffset = meshData.meshes[c.second].indexOffset,
+				                 .vertexOffset = meshData.meshes[c.second].vertexOffset,
+				                 .transformIndex = c.first
+			                 });
+		}
+	}
+
+	return shapes;
 }
 
 int addNode(Scene& scene, int parent, int level)
@@ -12,8 +56,8 @@ int addNode(Scene& scene, int parent, int level)
 	int node = (int)scene.hierarchy.size();
 
 	// new identity transfoms are added to the new node
-	scene.localTransform.push_back(glm::mat4(1.0f));
-	scene.globalTransform.push_back(glm::mat4(1.0f));
+	scene.localTransform.push_back(TRS());
+	scene.globalTransform.push_back(glm::mat4x3(1.0f));
 
 	// the new node only consists of the parent reference
 	scene.hierarchy.push_back({.parent = parent, .lastSibling = -1});
@@ -50,80 +94,284 @@ int addNode(Scene& scene, int parent, int level)
 	return node;
 }
 
-void loadScene(const char* fileName, Scene& scene)
+// the previous format: the node count, full local and global matrices, the hierarchy and unsorted maps
+static bool readArray(FILE* f, void* data, size_t size)
 {
-	FILE* f = fopen(fileName, "rb");
+	return size == 0 || fread(data, 1, size, f) == size;
+}
 
-	if (!f)
-	{
-		printf("Cannot open scene file '%s'. Please run SceneConverterTool  and/or MergeMeshes.", fileName);
-		return;
-	}
+static bool loadMap(FILE* f, ComponentMap& map)
+{
+	uint32_t sz = 0;
+	if (!readArray(f, &sz, sizeof(sz)))
+		return false;
 
-	uint32_t nodeCount = 0;
-	fread(&nodeCount, sizeof(nodeCount), 1, f);
+	std::vector<ComponentMap::Entry> entries(sz / 2);
+	if (!readArray(f, entries.data(), entries.size() * sizeof(ComponentMap::Entry)))
+		return false;
 
+	map.assignUnsorted(std::move(entries));
+	return true;
+}
+
+static bool loadSceneLegacy(FILE* f, uint32_t nodeCount, Scene& scene)
+{
 	scene.hierarchy.resize(nodeCount);
 	scene.globalTransform.resize(nodeCount);
 	scene.localTransform.resize(nodeCount);
-	// TODO: check > -1
-	// TODO: recalculate changedAtThisLevel() - find max depth of a node [or save scene.maxLevel]
-	fread(scene.localTransform.data(), sizeof(glm::mat4), nodeCount, f);
-	fread(scene.globalTransform.data(), sizeof(glm::mat4), nodeCount, f);
-	fread(scene.hierarchy.data(), sizeof(Hierarchy), nodeCount, f);
 
-	// Mesh for node [index to some list of buffers]
-	loadMap(f, scene.nodeIDToMaterialID);
-	loadMap(f, scene.nodeIDToMeshID);
+	std::vector<glm::mat4> matrices(nodeCount);
+	if (!readArray(f, matrices.data(), nodeCount * sizeof(glm::mat4)))
+		return false;
+	for (uint32_t i = 0; i != nodeCount; i++)
+		scene.localTransform[i] = getTRS(matrices[i]);
+	if (!readArray(f, matrices.data(), nodeCount * sizeof(glm::mat4)))
+		return false;
+	for (uint32_t i = 0; i != nodeCount; i++)
+		scene.globalTransform[i] = glm::mat4x3(matrices[i]);
+	if (!readArray(f, scene.hierarchy.data(), nodeCount * sizeof(Hierarchy)))
+		return false;
+
+	if (!loadMap(f, scene.nodeIDToMaterialID) || !loadMap(f, scene.nodeIDToMeshID))
+		return false;
 
-	if (!feof(f))
+	// the names are optional
+	uint32_t sz = 0;
+	if (fread(&sz, 1, sizeof(sz), f) != sizeof(sz))
+		return true;
+	fseek(f, -(long)sizeof(sz), SEEK_CUR);
+
+	std::vector<std::string> names, materialNames;
+	if (!loadMap(f, scene.nodeIDToNameID) || !loadStringList(f, names) || !loadStringList(f, materialNames))
+		return false;
+
+	// node names were stored once per node, the indices of materials have to stay as they are
+	std::vector<uint32_t> nameIDs;
+	for (const std::string& name : names)
+		nameIDs.push_back(scene.names.intern(name));
+	for (auto& [node, name] : scene.nodeIDToNameID)
 	{
-		loadMap(f, scene.nodeIDToNameID);
-		loadStringList(f, scene.names);
-		loadStringList(f, scene.materialNames);
+		if (name >= nameIDs.size())
+			return false;
+		name = nameIDs[name];
 	}
+	for (const std::string& name : materialNames)
+		scene.materialNames.add(name);
+
+	return true;
+}
+
+static bool loadSceneLegacy(const char* fileName, Scene& scene)
+{
+	FILE* f = fopen(fileName, "rb");
+	if (!f)
+		return false;
 
+	uint32_t   nodeCount = 0;
+	const bool ok        = readArray(f, &nodeCount, sizeof(nodeCount)) && loadSceneLegacy(f, nodeCount, scene);
 	fclose(f);
+	return ok;
 }
 
-void saveScene(const char* fileName, const Scene& scene)
+static bool isValidNode(int node, uint32_t nodeCount)
 {
-	FILE* f = fopen(fileName, "wb");
+	return node >= -1 && node < (int)nodeCount;
+}
 
-	// write the count of scene nodes
-	const uint32_t nodeCount = (uint32_t)scene.hierarchy.size();
-	fwrite(&nodeCount, sizeof(nodeCount), 1, f);
+static bool isValidComponentMap(const ComponentMap& map, uint32_t nodeCount, size_t valueCount = ~size_t(0))
+{
+	for (size_t i = 0; i != map.size(); i++)
+	{
+		const ComponentMap::Entry& e = map.data()[i];
+		if (e.first >= nodeCount || e.second >= valueCount || (i > 0 && e.first <= map.data()[i - 1].first))
+			return false;
+	}
+	return true;
+}
 
+// a section of count elements of type T
+template <typename T>
+static const T* getSection(const uint8_t* file, const SceneFileHeader& header, SceneFileSection section, size_t& count)
+{
+	count = header.sections[section].size / sizeof(T);
+	return reinterpret_cast<const T*>(file + header.sections[section].offset);
+}
 
-	fwrite(scene.localTransform.data(), sizeof(glm::mat4), nodeCount, f);
-	fwrite(scene.globalTransform.data(), sizeof(glm::mat4), nodeCount, f);
-	fwrite(scene.hierarchy.data(), sizeof(Hierarchy), nodeCount, f);
+static bool loadStrings(const uint8_t* file, const SceneFileHeader& header, SceneFileSection offsetSection, SceneFileSection charSection, StringPool& strings)
+{
+	size_t          numOffsets = 0;
+	size_t          numChars   = 0;
+	const uint32_t* offsets    = getSection<uint32_t>(file, header, offsetSection, numOffsets);
+	const char*     chars      = getSection<char>(file, header, charSection, numChars);
+	return strings.assignTable(offsets, numOffsets, chars, numChars);
+}
 
-	// Mesh for node [index to some list of buffers]
-	saveMap(f, scene.nodeIDToMaterialID);
-	saveMap(f, scene.nodeIDToMeshID);
+static bool loadSceneSections(const uint8_t* file, size_t fileSize, Scene& scene)
+{
+	SceneFileHeader header;
+	if (fileSize < sizeof(header))
+		return false;
+	memcpy(&header, file, sizeof(header));
 
-	if (!scene.names.empty() && !scene.nodeIDToNameID.empty())
+	if (header.version != kSceneFileVersion || header.sectionCount != SceneFileSection_Count)
 	{
-		saveMap(f, scene.nodeIDToNameID);
-		saveStringList(f, scene.names);
-		saveStringList(f, scene.materialNames);
+		printf("Unsupported scene file version %u\n", header.version);
+		return false;
 	}
-	fclose(f);
+	if (header.headerChecksum != hash64(&header, offsetof(SceneFileHeader, headerChecksum)))
+		return false;
+
+	const uint32_t nodeCount = header.nodeCount;
+
+	const size_t elementSizes[SceneFileSection_Count] = {
+		sizeof(Hierarchy), sizeof(TRS), sizeof(glm::mat4x3),
+		sizeof(ComponentMap::Entry), sizeof(ComponentMap::Entry), sizeof(ComponentMap::Entry),
+		sizeof(uint32_t), sizeof(char), sizeof(uint32_t), sizeof(char)
+	};
+
+	for (uint32_t s = 0; s != SceneFileSection_Count; s++)
+	{
+		const auto& section = header.sections[s];
+		if (section.offset % kSceneFileAlignment != 0 || section.offset > fileSize || section.size > fileSize - section.offset ||
+		    section.size % elementSizes[s] != 0)
+			return false;
+		// checksums are only compared after the sizes, a damaged size must not make us read outside the file
+		if (section.checksum != checksum64(file + section.offset, section.size))
+			return false;
+	}
+
+	for (const SceneFileSection s : {SceneFileSection_Hierarchy, SceneFileSection_LocalTransforms, SceneFileSection_GlobalTransforms})
+		if (header.sections[s].size != nodeCount * elementSizes[s])
+			return false;
+
+	size_t count = 0;
+
+	const Hierarchy* hierarchy = getSection<Hierarchy>(file, header, SceneFileSection_Hierarchy, count);
+	scene.hierarchy.assign(hierarchy, hierarchy + count);
+
+	const TRS* localTransforms = getSection<TRS>(file, header, SceneFileSection_LocalTransforms, count);
+	scene.localTransform.assign(localTransforms, localTransforms + count);
+
+	const glm::mat4x3* globalTransforms = getSection<glm::mat4x3>(file, header, SceneFileSection_GlobalTransforms, count);
+	scene.globalTransform.assign(globalTransforms, globalTransforms + count);
+
+	const ComponentMap::Entry* meshes = getSection<ComponentMap::Entry>(file, header, SceneFileSection_MeshComponents, count);
+	scene.nodeIDToMeshID.assign(meshes, count);
+
+	const ComponentMap::Entry* materials = getSection<ComponentMap::Entry>(file, header, SceneFileSection_MaterialComponents, count);
+	scene.nodeIDToMaterialID.assign(materials, count);
+
+	const ComponentMap::Entry* names = getSection<ComponentMap::Entry>(file, header, SceneFileSection_NameComponents, count);
+	scene.nodeIDToNameID.assign(names, count);
+
+	if (!loadStrings(file, header, SceneFileSection_NameOffsets, SceneFileSection_NameChars, scene.names) ||
+	    !loadStrings(file, header, SceneFileSection_MaterialNameOffsets, SceneFileSection_MaterialNameChars, scene.materialNames))
+		return false;
+
+	// the checksums catch damaged files, these catch files written wrong
+	for (const Hierarchy& h : scene.hierarchy)
+	{
+		if (!isValidNode(h.parent, nodeCount) || !isValidNode(h.firstChild, nodeCount) || !isValidNode(h.nextSibling, nodeCount) ||
+		    !isValidNode(h.lastSibling, nodeCount) || h.level < 0 || h.level >= MAX_NODE_LEVEL)
+			return false;
+	}
+
+	return isValidComponentMap(scene.nodeIDToMeshID, nodeCount) &&
+		isValidComponentMap(scene.nodeIDToMaterialID, nodeCount) &&
+		isValidComponentMap(scene.nodeIDToNameID, nodeCount, scene.names.size());
 }
 
-void saveMap(FILE* f, const std::unordered_map<uint32_t, uint32_t>& map)
+bool loadScene(const char* fileName, Scene& scene)
 {
-	std::vector<uint32_t> ms;
-	ms.reserve(map.size() * 2);
-	for (const auto& m : map)
+	scene = Scene();
+
+	const MappedFile file(fileName);
+
+	if (!file.isOpen())
 	{
-		ms.push_back(m.first);
-		ms.push_back(m.second);
+		printf("Cannot open scene file '%s'. Please run SceneConverterTool  and/or MergeMeshes.\n", fileName);
+		return false;
 	}
-	const uint32_t sz = static_cast<uint32_t>(ms.size());
-	fwrite(&sz, sizeof(sz), 1, f);
-	fwrite(ms.data(), sizeof(int), ms.size(), f);
+
+	uint32_t magicValue = 0;
+	if (file.getSize() >= sizeof(magicValue))
+		memcpy(&magicValue, file.getData(), sizeof(magicValue));
+
+	const bool ok = magicValue == kSceneFileMagic ? loadSceneSections(file.getData(), file.getSize(), scene) : loadSceneLegacy(fileName, scene);
+
+	if (!ok)
+	{
+		printf("Scene file '%s' is damaged or incomplete\n", fileName);
+		scene = Scene();
+	}
+
+	return ok;
+}
+
+bool saveScene(const char* fileName, const Scene& scene)
+{
+	FILE* f = fopen(fileName, "wb");
+	if (!f)
+	{
+		printf("Cannot write scene file '%s'\n", fileName);
+		return false;
+	}
+
+	std::vector<uint32_t> nameOffsets, materialNameOffsets;
+	std::vector<char>     nameChars, materialNameChars;
+	scene.names.getTable(nameOffsets, nameChars);
+	scene.materialNames.getTable(materialNameOffsets, materialNameChars);
+
+	const uint32_t nodeCount = (uint32_t)scene.hierarchy.size();
+
+	const std::pair<const void*, size_t> sections[SceneFileSection_Count] = {
+		{scene.hierarchy.data(), nodeCount * sizeof(Hierarchy)},
+		{scene.localTransform.data(), nodeCount * sizeof(TRS)},
+		{scene.globalTransform.data(), nodeCount * sizeof(glm::mat4x3)},
+		{scene.nodeIDToMeshID.data(), scene.nodeIDToMeshID.size() * sizeof(ComponentMap::Entry)},
+		{scene.nodeIDToMaterialID.data(), scene.nodeIDToMaterialID.size() * sizeof(ComponentMap::Entry)},
+		{scene.nodeIDToNameID.data(), scene.nodeIDToNameID.size() * sizeof(ComponentMap::Entry)},
+		{nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t)},
+		{nameChars.data(), nameChars.size()},
+		{materialNameOffsets.data(), materialNameOffsets.size() * sizeof(uint32_t)},
+		{materialNameChars.data(), materialNameChars.size()}
+	};
+
+	const auto align = [](uint64_t offset) { return (offset + kSceneFileAlignment - 1) & ~uint64_t(kSceneFileAlignment - 1); };
+
+	SceneFileHeader header = {
+		.magicValue = kSceneFileMagic,
+		.version = kSceneFileVersion,
+		.nodeCount = nodeCount,
+		.sectionCount = SceneFileSection_Count
+	};
+
+	uint64_t offset = align(sizeof(header));
+	for (uint32_t s = 0; s != SceneFileSection_Count; s++)
+	{
+		header.sections[s].offset   = offset;
+		header.sections[s].size     = sections[s].second;
+		header.sections[s].checksum = checksum64(sections[s].first, sections[s].second);
+		offset                      = align(offset + sections[s].second);
+	}
+	header.headerChecksum = hash64(&header, offsetof(SceneFileHeader, headerChecksum));
+
+	const uint8_t padding[kSceneFileAlignment] = {};
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (uint32_t s = 0; ok && s != SceneFileSection_Count; s++)
+	{
+		const size_t pad = header.sections[s].offset - (uint64_t)ftell(f);
+		ok               = fwrite(padding, 1, pad, f) == pad && (sections[s].second == 0 || fwrite(sections[s].first, sections[s].second, 1, f) == 1);
+	}
+
+	if (fclose(f) != 0 || !ok)
+	{
+		printf("Cannot write scene file '%s'\n", fileName);
+		return false;
+	}
+
+	return true;
 }
 
 void saveStringList(FILE* f, const std::vector<std::string>& lines)
@@ -138,35 +386,24 @@ void saveStringList(FILE* f, const std::vector<std::string>& lines)
 	}
 }
 
-void loadStringList(FILE* f, std::vector<std::string>& lines)
+bool loadStringList(FILE* f, std::vector<std::string>& lines)
 {
-	{
-		uint32_t sz = 0;
-		fread(&sz, sizeof(uint32_t), 1, f);
-		lines.resize(sz);
-	}
-	std::vector<char> inBytes;
+	uint32_t sz = 0;
+	if (!readArray(f, &sz, sizeof(uint32_t)))
+		return false;
+	lines.resize(sz);
+
+	// the strings are read in place, with their NUL
 	for (auto& s : lines)
 	{
-		uint32_t sz = 0;
-		fread(&sz, sizeof(uint32_t), 1, f);
-		inBytes.resize(sz + 1);
-		fread(inBytes.data(), sz + 1, 1, f);
-		s = std::string(inBytes.data());
+		if (!readArray(f, &sz, sizeof(uint32_t)))
+			return false;
+		s.resize(sz + 1);
+		if (!readArray(f, s.data(), sz + 1))
+			return false;
+		s.pop_back();
 	}
-}
-
-void loadMap(FILE* f, std::unordered_map<uint32_t, uint32_t>& map)
-{
-	std::vector<uint32_t> ms;
-
-	uint32_t sz = 0;
-	fread(&sz, 1, sizeof(sz), f);
-
-	ms.resize(sz);
-	fread(ms.data(), sizeof(int), sz, f);
-	for (size_t i          = 0; i < (sz / 2); i++)
-		map[ms[i * 2 + 0]] = ms[i * 2 + 1];
+	return true;
 }
 
 // mark this node whose transforms have changed in this frame and its children as changed
@@ -184,29 +421,118 @@ void markAsChanged(Scene& scene, int node)
 	}
 }
 
-// CPU version of global transform update []
-// TODO: implement a GPU version using compute shaders 
-void recalculateGlobalTransforms(Scene& scene)
+// CPU version of global transform update [], GLSceneTransforms is the GPU version
+void recalculateGlobalTransforms(Scene& scene, std::vector<int>* changedNodes)
 {
-	// start from the root layer, check if any nodes are changed
-	if (!scene.changedAtThisFrame[0].empty())
+	// start from the root layer, merged scenes have several roots
+	for (const int& r : scene.changedAtThisFrame[0])
 	{
-		// assume we have only one root node
-		int nodeIndex = scene.changedAtThisFrame[0][0];
 		// root node global transforms coincide with their local transforms
-		scene.globalTransform[nodeIndex] = scene.localTransform[nodeIndex];
-		scene.changedAtThisFrame[0].clear();
+		scene.globalTransform[r] = getAffine(scene.localTransform[r]);
 	}
+	if (changedNodes)
+		changedNodes->insert(changedNodes->end(), scene.changedAtThisFrame[0].begin(), scene.changedAtThisFrame[0].end());
+	scene.changedAtThisFrame[0].clear();
 
-	// check all the lower levels
-	for (int i = 1; i < MAX_NODE_LEVEL && (!scene.changedAtThisFrame[i].empty()); i++)
+	// check all the lower levels, a level may be empty if only nodes further down were marked
+	for (int i = 1; i < MAX_NODE_LEVEL; i++)
 	{
 		for (const int& c : scene.changedAtThisFrame[i])
 		{
 			int p = scene.hierarchy[c].parent;
 			// NO RECURSION. MAGIC! 
-			scene.globalTransform[c] = scene.globalTransform[p] * scene.localTransform[c];
+			scene.globalTransform[c] = combineAffine(scene.globalTransform[p], getAffine(scene.localTransform[c]));
 		}
+		if (changedNodes)
+			changedNodes->insert(changedNodes->end(), scene.changedAtThisFrame[i].begin(), scene.changedAtThisFrame[i].end());
 		scene.changedAtThisFrame[i].clear();
 	}
 }
+
+void recalculateAllGlobalTransforms(Scene& scene)
+{
+	for (size_t i = 0; i != scene.hierarchy.size(); i++)
+	{
+		const int p              = scene.hierarchy[i].parent;
+		scene.globalTransform[i] = p > -1 ? combineAffine(scene.globalTransform[p], getAffine(scene.localTransform[i])) : getAffine(scene.localTransform[i]);
+	}
+
+	for (vector<int>& level : scene.changedAtThisFrame)
+		level.clear();
+}
+
+static void remapMap(ComponentMap& map, const std::vector<int>& newIndices)
+{
+	std::vector<ComponentMap::Entry> remapped;
+	remapped.reserve(map.size());
+
+	for (const auto& [node, value] : map)
+		if (newIndices[node] > -1)
+			remapped.push_back({(uint32_t)newIndices[node], value});
+
+	map.assignUnsorted(std::move(remapped));
+}
+
+std::vector<int> reorderNodesByLevel(Scene& scene)
+{
+	const int numNodes = (int)scene.hierarchy.size();
+
+	// the new order is its own queue
+	vector<int> order;
+	order.reserve(numNodes);
+	for (int i = 0; i != numNodes; i++)
+		if (scene.hierarchy[i].parent == -1)
+			order.push_back(i);
+	for (size_t i = 0; i != order.size(); i++)
+		for (int c = scene.hierarchy[order[i]].firstChild; c != -1; c = scene.hierarchy[c].nextSibling)
+			order.push_back(c);
+
+	vector<int> newIndices(numNodes, -1);
+	for (size_t i = 0; i != order.size(); i++)
+		newIndices[order[i]] = (int)i;
+
+	const auto remapNode = [&newIndices](int node) { return node > -1 ? newIndices[node] : -1; };
+
+	vector<Hierarchy>   hierarchy(order.size());
+	vector<TRS>         localTransform(order.size());
+	vector<glm::mat4x3> globalTransform(order.size());
+
+	for (size_t i = 0; i != order.size(); i++)
+	{
+		const Hierarchy& h = scene.hierarchy[order[i]];
+		hierarchy[i]       = {
+			.parent = remapNode(h.parent),
+			.firstChild = remapNode(h.firstChild),
+			.nextSibling = remapNode(h.nextSibling),
+			.lastSibling = remapNode(h.lastSibling),
+			.level = h.level
+		};
+		localTransform[i]  = scene.localTransform[order[i]];
+		globalTransform[i] = scene.globalTransform[order[i]];
+	}
+
+	scene.hierarchy       = std::move(hierarchy);
+	scene.localTransform  = std::move(localTransform);
+	scene.globalTransform = std::move(globalTransform);
+
+	remapMap(scene.nodeIDToMeshID, newIndices);
+	remapMap(scene.nodeIDToMaterialID, newIndices);
+	remapMap(scene.nodeIDToNameID, newIndices);
+
+	for (vector<int>& level : scene.changedAtThisFrame)
+	{
+		vector<int> changed;
+		for (const int node : level)
+			if (newIndices[node] > -1)
+				changed.push_back(newIndices[node]);
+		level = std::move(changed);
+	}
+
+	return newIndices;
+}
+
+void remapTransformIndices(std::vector<DrawData>& shapes, const std::vector<int>& newIndices)
+{
+	for (DrawData& shape : shapes)
+		shape.transformIndex = newIndices[shape.transformIndex];
+}
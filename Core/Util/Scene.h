@@ -2,6 +2,11 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <unordered_map>
+
+#include "ComponentMap.h"
+#include "StringPool.h"
+#include "Transform.h"
+#include "VtxData.h"
 using std::vector;
 using glm::mat4;
 using std::unordered_map;
@@ -27,39 +32,113 @@ struct Hierarchy
 // integer indices in the arrays inside the Scene structure
 struct Scene
 {
-	// the local and global transforms are stored in separate arrays
-	vector<mat4> localTransform;
-	vector<mat4> globalTransform;
+	// the local and global transforms are stored in separate arrays, see Transform.h
+	vector<TRS>         localTransform;
+	vector<glm::mat4x3> globalTransform;
 
 	// list of nodes whose global transform must be recalculated
 	vector<int> changedAtThisFrame[MAX_NODE_LEVEL];
 
 	vector<Hierarchy> hierarchy;
 
-	// hash tables to store node-to-mesh, node-to-material, node-to-name mappings
+	// sorted arrays to store node-to-mesh, node-to-material, node-to-name mappings
 	// absence of such mappings indicates that a node doesn't have such property
 
 	// (Node -> Mesh)
-	unordered_map<uint32_t, uint32_t> nodeIDToMeshID;
+	ComponentMap nodeIDToMeshID;
 	// (Node -> Material)
-	unordered_map<uint32_t, uint32_t> nodeIDToMaterialID;
+	ComponentMap nodeIDToMaterialID;
 	// (Node -> Name)
-	unordered_map<uint32_t, uint32_t> nodeIDToNameID;
+	ComponentMap nodeIDToNameID;
 
-	// collection of debug node names and material names
-	vector<string> names;
-	vector<string> materialNames;
+	// node names are interned, several nodes may share one; material names are in the order of the materials
+	StringPool names;
+	StringPool materialNames;
+};
+
+// Finds nodes by name without allocating: the pool hashes the name to its index, a table maps the index to the first
+// node with that name. Build it again after the scene has changed.
+class SceneNameIndex
+{
+public:
+	explicit SceneNameIndex(const Scene& scene);
+
+	// -1 if no node has that name
+	int findNode(std::string_view name) const;
+
+private:
+	const Scene&     mScene;
+	std::vector<int> mNameToNode;
+};
+
+// A scene file is a SceneFileHeader followed by the sections listed in it, each starting at a multiple of
+// kSceneFileAlignment so that a mapped file can be copied from in place. The hierarchy and the transforms are arrays
+// of Hierarchy, TRS and glm::mat4x3, the components are arrays of ComponentMap::Entry sorted by node, and a list of
+// strings is a table of count + 1 offsets into a blob of characters, each string followed by a NUL.
+constexpr uint32_t kSceneFileMagic     = 0x4E435353; // "SSCN"
+constexpr uint32_t kSceneFileVersion   = 1;
+constexpr uint32_t kSceneFileAlignment = 16;
+
+enum SceneFileSection : uint32_t
+{
+	SceneFileSection_Hierarchy,
+	SceneFileSection_LocalTransforms,
+	SceneFileSection_GlobalTransforms,
+	SceneFileSection_MeshComponents,
+	SceneFileSection_MaterialComponents,
+	SceneFileSection_NameComponents,
+	SceneFileSection_NameOffsets,
+	SceneFileSection_NameChars,
+	SceneFileSection_MaterialNameOffsets,
+	SceneFileSection_MaterialNameChars,
+	SceneFileSection_Count
+};
+
+struct SceneFileHeader
+{
+	uint32_t magicValue;
+	uint32_t version;
+	uint32_t nodeCount;
+	uint32_t sectionCount;
+
+	struct
+	{
+		// from the start of the file, in bytes
+		uint64_t offset;
+		uint64_t size;
+		// checksum64() of the section
+		uint64_t checksum;
+	} sections[SceneFileSection_Count];
+
+	// hash64() of the header up to here
+	uint64_t headerChecksum;
 };
 
 int  addNode(Scene& scene, int parent, int level);
-void loadScene(const char* fileName, Scene& scene);
-void loadStringList(FILE* f, std::vector<std::string>& lines);
-void loadMap(FILE* f, std::unordered_map<uint32_t, uint32_t>& map);
-void saveScene(const char* fileName, const Scene& scene);
-void saveMap(FILE* f, const std::unordered_map<uint32_t, uint32_t>& map);
+// Reads files of the format above, checks their checksums and indices and copies every array with a single copy.
+// Files of the previous format (the node count, then full matrices) are still read. Returns false and leaves the
+// scene empty if the file is missing or damaged.
+bool loadScene(const char* fileName, Scene& scene);
+bool loadStringList(FILE* f, std::vector<std::string>& lines);
+bool saveScene(const char* fileName, const Scene& scene);
 void saveStringList(FILE* f, const std::vector<std::string>& lines);
 
 void markAsChanged(Scene& scene, int node);
-void recalculateGlobalTransforms(Scene& scene);
+// the recalculated nodes are appended to changedNodes, e.g. to move them in a LooseOctree
+void recalculateGlobalTransforms(Scene& scene, std::vector<int>* changedNodes = nullptr);
+// recalculates every global transform in a single sweep over the nodes, parents have to come before their children
+// (true for scenes built with addNode() and after reorderNodesByLevel())
+void recalculateAllGlobalTransforms(Scene& scene);
+
+// Sorts the nodes breadth-first: by level, with the children of a node next to each other and in the order of their
+// parents, so updating a level reads the transforms of its parents and children linearly. Nodes which cannot be reached
+// from a root are dropped. Returns the new index of every old node, -1 for dropped nodes.
+std::vector<int> reorderNodesByLevel(Scene& scene);
+// updates DrawData::transformIndex of shapes created before reorderNodesByLevel()
+void remapTransformIndices(std::vector<DrawData>& shapes, const std::vector<int>& newIndices);
+
+// empty for nodes without a name; the view is NUL-terminated and lives as long as the scene
+std::string_view getNodeName(const Scene& scene, int node);
 
-std::string getNodeName(const Scene& scene, int node);
\ No newline at end of file
+// one shape for every node with a mesh and a material, at LOD 0
+std::vector<DrawData> getSceneShapes(const Scene& scene, const MeshData& meshData);
\ No newline at end of file
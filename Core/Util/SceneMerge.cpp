@@ -0,0 +1,276 @@
+#include "SceneMerge.h"
+
+#include <unordered_map>
+
+// interleaved position, uv and normal, see SceneConversionTool
+const static uint32_t kVertexStride = 8;
+
+void mergeScenes(Scene&                        scene,
+                 const std::vector<Scene*>&    scenes,
+                 const std::vector<glm::mat4>& rootTransforms,
+                 const std::vector<uint32_t>&  meshCounts,
+                 const std::vector<uint32_t>&  materialCounts)
+{
+	uint32_t meshOffset     = 0;
+	uint32_t materialOffset = 0;
+
+	for (size_t s = 0; s != scenes.size(); s++)
+	{
+		const Scene& src        = *scenes[s];
+		const int    nodeOffset = (int)scene.hierarchy.size();
+
+		// names used by several scenes are kept once
+		std::vector<uint32_t> nameIDs;
+		nameIDs.reserve(src.names.size());
+		for (const std::string_view name : src.names)
+			nameIDs.push_back(scene.names.intern(name));
+
+		const auto shift = [nodeOffset](int node) { return node > -1 ? node + nodeOffset : -1; };
+
+		for (size_t i = 0; i != src.hierarchy.size(); i++)
+		{
+			const Hierarchy& h = src.hierarchy[i];
+			scene.hierarchy.push_back({
+				.parent = shift(h.parent),
+				.firstChild = shift(h.firstChild),
+				.nextSibling = shift(h.nextSibling),
+				.lastSibling = shift(h.lastSibling),
+				.level = h.level
+			});
+
+			TRS local = src.localTransform[i];
+			if (h.parent == -1 && s < rootTransforms.size())
+				local = getTRS(rootTransforms[s] * glm::mat4(getAffine(local)));
+			scene.localTransform.push_back(local);
+			scene.globalTransform.push_back(src.globalTransform[i]);
+		}
+
+		for (const auto& [node, mesh] : src.nodeIDToMeshID)
+			scene.nodeIDToMeshID[node + nodeOffset] = mesh + meshOffset;
+		for (const auto& [node, material] : src.nodeIDToMaterialID)
+			scene.nodeIDToMaterialID[node + nodeOffset] = material + materialOffset;
+		for (const auto& [node, name] : src.nodeIDToNameID)
+			scene.nodeIDToNameID[node + nodeOffset] = nameIDs[name];
+
+		for (const std::string_view name : src.materialNames)
+			scene.materialNames.add(name);
+
+		meshOffset += meshCounts[s];
+		materialOffset += materialCounts[s];
+	}
+
+	// the levels of all scenes are interleaved, the roots may have moved
+	reorderNodesByLevel(scene);
+	recalculateAllGlobalTransforms(scene);
+}
+
+void mergeMeshData(MeshData& meshData, const std::vector<MeshData*>& meshDatas)
+{
+	for (const MeshData* m : meshDatas)
+	{
+		const uint32_t indexOffset = (uint32_t)meshData.indexData.size();
+		const uint32_t dataOffset  = (uint32_t)(meshData.vertexData.size() * sizeof(float));
+
+		// indices are relative to the first vertex of their mesh and stay as they are
+		for (Mesh mesh : m->meshes)
+		{
+			mesh.indexOffset += indexOffset;
+			mesh.vertexOffset += dataOffset / mesh.streamElementSize[0];
+			for (uint32_t s = 0; s != mesh.streamCount; s++)
+				mesh.streamOffset[s] += dataOffset;
+			meshData.meshes.push_back(mesh);
+		}
+
+		meshData.indexData.insert(meshData.indexData.end(), m->indexData.begin(), m->indexData.end());
+		meshData.vertexData.insert(meshData.vertexData.end(), m->vertexData.begin(), m->vertexData.end());
+		meshData.boundingBoxes.insert(meshData.boundingBoxes.end(), m->boundingBoxes.begin(), m->boundingBoxes.end());
+	}
+}
+
+void mergeMaterialLists(const std::vector<std::vector<MaterialData>*>& materials,
+                        const std::vector<std::vector<std::string>*>&  files,
+                        const std::vector<std::vector<uint32_t>*>&     textureArrays,
+                        std::vector<MaterialData>&                     allMaterials,
+                        std::vector<std::string>&                      allFiles)
+{
+	std::unordered_map<std::string, uint32_t> fileIndices;
+
+	for (size_t i = 0; i != materials.size(); i++)
+	{
+		const std::vector<std::string>& f      = *files[i];
+		const std::vector<uint32_t>&    arrays = *textureArrays[i];
+
+		const auto toFile = [&](uint64_t map, uint32_t layer) -> uint64_t
+		{
+			if (map == INVALID_TEXTURE)
+				return INVALID_TEXTURE;
+			const auto [it, inserted] = fileIndices.try_emplace(f[arrays[map] + layer], (uint32_t)allFiles.size());
+			if (inserted)
+				allFiles.push_back(it->first);
+			return it->second;
+		};
+
+		// opacity maps have been baked into the albedo maps and are left as they are
+		for (MaterialData m : *materials[i])
+		{
+			m.ambientOcclusionMap    = toFile(m.ambientOcclusionMap, m.ambientOcclusionLayer);
+			m.emissiveMap            = toFile(m.emissiveMap, m.emissiveLayer);
+			m.albedoMap              = toFile(m.albedoMap, m.albedoLayer);
+			m.metallicRoughnessMap   = toFile(m.metallicRoughnessMap, m.metallicRoughnessLayer);
+			m.normalMap              = toFile(m.normalMap, m.normalLayer);
+			m.ambientOcclusionLayer  = 0;
+			m.emissiveLayer          = 0;
+			m.albedoLayer            = 0;
+			m.metallicRoughnessLayer = 0;
+			m.normalLayer            = 0;
+			allMaterials.push_back(m);
+		}
+	}
+}
+
+// removes the meshes without nodes and their indices and vertices
+static void removeUnusedMeshes(Scene& scene, MeshData& meshData)
+{
+	std::vector<int> newMeshIndices(meshData.meshes.size(), -1);
+	for (const auto& [node, mesh] : scene.nodeIDToMeshID)
+		newMeshIndices[mesh] = 0;
+
+	MeshData compact;
+	for (size_t i = 0; i != meshData.meshes.size(); i++)
+	{
+		if (newMeshIndices[i] < 0)
+			continue;
+		newMeshIndices[i] = (int)compact.meshes.size();
+
+		Mesh           mesh   = meshData.meshes[i];
+		const uint32_t stride = mesh.streamElementSize[0] / sizeof(float);
+
+		const auto indices  = meshData.indexData.begin() + mesh.indexOffset;
+		const auto vertices = meshData.vertexData.begin() + mesh.vertexOffset * stride;
+
+		mesh.indexOffset     = (uint32_t)compact.indexData.size();
+		mesh.vertexOffset    = (uint32_t)(compact.vertexData.size() / stride);
+		mesh.streamOffset[0] = mesh.vertexOffset * mesh.streamElementSize[0];
+
+		compact.indexData.insert(compact.indexData.end(), indices, indices + mesh.lodOffset[mesh.lodCount]);
+		compact.vertexData.insert(compact.vertexData.end(), vertices, vertices + mesh.vertexCount * stride);
+		compact.meshes.push_back(mesh);
+		if (i < meshData.boundingBoxes.size())
+			compact.boundingBoxes.push_back(meshData.boundingBoxes[i]);
+	}
+
+	for (auto& [node, mesh] : scene.nodeIDToMeshID)
+		mesh = newMeshIndices[mesh];
+
+	meshData = std::move(compact);
+}
+
+// removes a node without children from the children of its parent, the node is dropped by reorderNodesByLevel()
+static void unlinkNode(Scene& scene, int node)
+{
+	const int parent = scene.hierarchy[node].parent;
+	if (parent < 0)
+		return;
+
+	int& first = scene.hierarchy[parent].firstChild;
+	if (first == node)
+	{
+		first = scene.hierarchy[node].nextSibling;
+	}
+	else
+	{
+		int prev = first;
+		while (scene.hierarchy[prev].nextSibling != node)
+			prev = scene.hierarchy[prev].nextSibling;
+		scene.hierarchy[prev].nextSibling = scene.hierarchy[node].nextSibling;
+	}
+
+	// addNode() finds the last child through the first one
+	if (first != -1)
+	{
+		int last = first;
+		while (scene.hierarchy[last].nextSibling != -1)
+			last = scene.hierarchy[last].nextSibling;
+		scene.hierarchy[first].lastSibling = last;
+	}
+}
+
+uint32_t mergeNodesWithMaterial(Scene& scene, MeshData& meshData, const std::string& materialName)
+{
+	const uint32_t material = scene.materialNames.find(materialName);
+	if (material == StringPool::kInvalidString)
+		return 0;
+
+	std::vector<int> nodes;
+	for (const auto& [node, mesh] : scene.nodeIDToMeshID)
+	{
+		const auto m = scene.nodeIDToMaterialID.find(node);
+		if (m != scene.nodeIDToMaterialID.end() && m->second == material)
+			nodes.push_back((int)node);
+	}
+	if (nodes.empty())
+		return 0;
+
+	std::vector<uint32_t> indices;
+	std::vector<float>    vertices;
+
+	for (const int node : nodes)
+	{
+		const Mesh&     mesh         = meshData.meshes[scene.nodeIDToMeshID[node]];
+		const glm::mat4 model        = glm::mat4(scene.globalTransform[node]);
+		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+		const uint32_t  stride       = mesh.streamElementSize[0] / sizeof(float);
+		const uint32_t  firstVertex  = (uint32_t)(vertices.size() / kVertexStride);
+
+		for (uint32_t v = 0; v != mesh.vertexCount; v++)
+		{
+			const float*    src = &meshData.vertexData[(mesh.vertexOffset + v) * stride];
+			const glm::vec3 p   = glm::vec3(model * glm::vec4(src[0], src[1], src[2], 1.0f));
+			const glm::vec3 n   = glm::normalize(normalMatrix * glm::vec3(src[5], src[6], src[7]));
+			vertices.insert(vertices.end(), {p.x, p.y, p.z, src[3], src[4], n.x, n.y, n.z});
+		}
+
+		for (uint32_t i = 0; i != mesh.getLODIndicesCount(0); i++)
+			indices.push_back(meshData.indexData[mesh.indexOffset + mesh.lodOffset[0] + i] + firstVertex);
+	}
+
+	const Mesh merged = {
+		.lodCount = 1,
+		.streamCount = 1,
+		.indexOffset = (uint32_t)meshData.indexData.size(),
+		.vertexOffset = (uint32_t)(meshData.vertexData.size() / kVertexStride),
+		.vertexCount = (uint32_t)(vertices.size() / kVertexStride),
+		.lodOffset = {0, (uint32_t)indices.size()},
+		.streamOffset = {(uint32_t)(meshData.vertexData.size() * sizeof(float))},
+		.streamElementSize = {kVertexStride * sizeof(float)}
+	};
+
+	meshData.meshes.push_back(merged);
+	meshData.indexData.insert(meshData.indexData.end(), indices.begin(), indices.end());
+	meshData.vertexData.insert(meshData.vertexData.end(), vertices.begin(), vertices.end());
+	if (!meshData.boundingBoxes.empty())
+		recalculateBoundingBoxes(meshData);
+
+	// nodes with children keep them and lose only their mesh
+	std::vector<bool> removed(scene.hierarchy.size(), false);
+	for (const int node : nodes)
+	{
+		removed[node] = true;
+		if (scene.hierarchy[node].firstChild == -1)
+			unlinkNode(scene, node);
+	}
+	const auto isRemoved = [&removed](const ComponentMap::Entry& e) { return (bool)removed[e.first]; };
+	scene.nodeIDToMeshID.eraseIf(isRemoved);
+	scene.nodeIDToMaterialID.eraseIf(isRemoved);
+
+	// the vertices are in world space
+	const int root                 = addNode(scene, -1, 0);
+	scene.nodeIDToMeshID[root]     = (uint32_t)meshData.meshes.size() - 1;
+	scene.nodeIDToMaterialID[root] = material;
+	scene.nodeIDToNameID[root]     = scene.names.intern(materialName);
+
+	removeUnusedMeshes(scene, meshData);
+	reorderNodesByLevel(scene);
+
+	return (uint32_t)nodes.size();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Material.h"
+#include "Scene.h"
+#include "VtxData.h"
+
+// Merging of converted scenes, so that several scenes can be drawn as one. A merged scene has one root for every
+// input scene, the mesh, material and name indices of each input are offset by the counts of the inputs before it.
+
+// appends the nodes of all scenes, the root of scene i is transformed by rootTransforms[i] if there is one.
+// meshCounts and materialCounts are the number of meshes and materials of every scene.
+void mergeScenes(Scene&                        scene,
+                 const std::vector<Scene*>&    scenes,
+                 const std::vector<glm::mat4>& rootTransforms,
+                 const std::vector<uint32_t>&  meshCounts,
+                 const std::vector<uint32_t>&  materialCounts);
+
+// appends the meshes, indices and vertices of all mesh lists, in the order of the scenes passed to mergeScenes()
+void mergeMeshData(MeshData& meshData, const std::vector<MeshData*>& meshDatas);
+
+// appends the materials of all lists. The maps of the input materials are (texture array, layer) pairs, the maps of the
+// merged materials index the merged list of texture files, which has every file once. Every file is a texture array
+// with a single layer, SceneConversionTool packs them again.
+void mergeMaterialLists(const std::vector<std::vector<MaterialData>*>& materials,
+                        const std::vector<std::vector<std::string>*>&  files,
+                        const std::vector<std::vector<uint32_t>*>&     textureArrays,
+                        std::vector<MaterialData>&                     allMaterials,
+                        std::vector<std::string>&                      allFiles);
+
+// replaces the meshes of all nodes with the material materialName by a single mesh in world space, attached to a new
+// root with an identity transform, like the many leaves of a tree. Only LOD 0 of the meshes is kept. Nodes without
+// children are removed with their meshes, meshes no longer used by any node are removed from meshData.
+// Returns the number of merged meshes.
+uint32_t mergeNodesWithMaterial(Scene& scene, MeshData& meshData, const std::string& materialName);
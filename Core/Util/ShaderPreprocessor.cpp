@@ -0,0 +1,281 @@
+#include "ShaderPreprocessor.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+ShaderPreprocessor& ShaderPreprocessor::instance()
+{
+	static ShaderPreprocessor preprocessor;
+	return preprocessor;
+}
+
+std::string ShaderPreprocessor::normalizePath(const std::string& fileName)
+{
+	return std::filesystem::path(fileName).lexically_normal().generic_string();
+}
+
+static std::string getDefinesText(const std::vector<std::string>& defines)
+{
+	std::string text;
+	for (const auto& d : defines)
+		text += "#define " + d + "\n";
+	return text;
+}
+
+static const char* skipSpaces(const char* p, const char* end)
+{
+	while (p != end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+static bool startsWithKeyword(const char*& p, const char* end, const char* keyword)
+{
+	const size_t len = strlen(keyword);
+	if ((size_t)(end - p) < len || strncmp(p, keyword, len))
+		return false;
+	p += len;
+	return true;
+}
+
+const ShaderPreprocessor::SourceFile* ShaderPreprocessor::load(const std::string& fileName)
+{
+	const auto it = mFiles.find(fileName);
+	if (it != mFiles.end())
+		return &it->second;
+
+	FILE* file = fopen(fileName.c_str(), "rb");
+
+	if (!file)
+	{
+		printf("I/O error. Cannot open shader file '%s'\n", fileName.c_str());
+		return nullptr;
+	}
+
+	fseek(file, 0L, SEEK_END);
+	const auto bytesinfile = ftell(file);
+	fseek(file, 0L, SEEK_SET);
+
+	SourceFile src;
+	src.text.resize(bytesinfile);
+	src.text.resize(fread(src.text.data(), 1, bytesinfile, file));
+	fclose(file);
+
+	// parse and eliminate the UTF byte-order marker.
+	// if present, it might not be handled properly by some legacy GLSL compilers
+	static constexpr unsigned char BOM[] = {0xEF, 0xBB, 0xBF};
+
+	if (src.text.size() > 3 && !memcmp(src.text.data(), BOM, 3))
+		src.text.replace(0, 3, 3, ' ');
+
+	// scan the file once and remember where the directives we care about are
+	const char* text = src.text.data();
+	const char* end  = text + src.text.size();
+	uint32_t    line = 1;
+
+	for (const char* lineBegin = text; lineBegin != end; line++)
+	{
+		const char* lineEnd = (const char*)memchr(lineBegin, '\n', end - lineBegin);
+		lineEnd             = lineEnd ? lineEnd + 1 : end;
+
+		const char* p = skipSpaces(lineBegin, lineEnd);
+
+		if (p != lineEnd && *p == '#')
+		{
+			p = skipSpaces(p + 1, lineEnd);
+
+			Directive d;
+			d.begin = lineBegin - text;
+			d.end   = lineEnd - text;
+			d.line  = line;
+
+			if (startsWithKeyword(p, lineEnd, "include"))
+			{
+				p                     = skipSpaces(p, lineEnd);
+				const char  open      = p != lineEnd ? *p : 0;
+				const char  close     = open == '<' ? '>' : '"';
+				const char* nameBegin = p + 1;
+				const char* nameEnd   = (open == '<' || open == '"') ? std::find(nameBegin, lineEnd, close) : lineEnd;
+				if (nameEnd == lineEnd)
+				{
+					printf("Invalid #include directive in %s(%u)\n", fileName.c_str(), line);
+					return nullptr;
+				}
+				d.include = normalizePath(std::string(nameBegin, nameEnd));
+				src.includes.push_back(d.include);
+				src.directives.push_back(d);
+			}
+			else if (startsWithKeyword(p, lineEnd, "pragma") && startsWithKeyword(p = skipSpaces(p, lineEnd), lineEnd, "once"))
+			{
+				src.pragmaOnce = true;
+				src.directives.push_back(d);
+			}
+			else if (startsWithKeyword(p, lineEnd, "version"))
+			{
+				d.isVersion = true;
+				src.directives.push_back(d);
+			}
+		}
+
+		lineBegin = lineEnd;
+	}
+
+	return &mFiles.emplace(fileName, std::move(src)).first->second;
+}
+
+bool ShaderPreprocessor::emit(const std::string& fileName, Context& ctx)
+{
+	const SourceFile* src = load(fileName);
+
+	if (!src)
+		return false;
+
+	// a cycle is an error even through files with #pragma once, which would otherwise just be skipped
+	if (std::find(ctx.stack.begin(), ctx.stack.end(), fileName) != ctx.stack.end())
+	{
+		printf("Circular #include of '%s':", fileName.c_str());
+		for (const auto& f : ctx.stack)
+			printf(" %s ->", f.c_str());
+		printf(" %s\n", fileName.c_str());
+		return false;
+	}
+
+	if (src->pragmaOnce)
+	{
+		if (std::find(ctx.included.begin(), ctx.included.end(), fileName) != ctx.included.end())
+			return true;
+		ctx.included.push_back(fileName);
+	}
+
+	const int index = addUnique(ctx.files, fileName);
+
+	// #line cannot precede #version, so line markers are only emitted after it
+	auto emitLine = [&ctx, index](uint32_t line) {
+		if (!ctx.versionSeen)
+			return;
+		if (!ctx.output.empty() && ctx.output.back() != '\n')
+			ctx.output += '\n';
+		ctx.output += "#line " + std::to_string(line) + " " + std::to_string(index) + "\n";
+	};
+
+	ctx.stack.push_back(fileName);
+
+	emitLine(1);
+
+	size_t pos = 0;
+
+	for (const Directive& d : src->directives)
+	{
+		ctx.output.append(src->text, pos, d.begin - pos);
+		pos = d.end;
+
+		if (d.isVersion)
+		{
+			ctx.output.append(src->text, d.begin, d.end - d.begin);
+			if (ctx.output.back() != '\n')
+				ctx.output += '\n';
+			ctx.output += getDefinesText(*ctx.defines);
+			ctx.versionSeen = true;
+			emitLine(d.line + 1);
+		}
+		else if (!d.include.empty())
+		{
+			if (!emit(d.include, ctx))
+				return false;
+			emitLine(d.line + 1);
+		}
+		else
+		{
+			// #pragma once: keep the line so that the numbering stays intact
+			ctx.output += '\n';
+		}
+	}
+
+	ctx.output.append(src->text, pos, std::string::npos);
+
+	ctx.stack.pop_back();
+
+	return true;
+}
+
+std::string ShaderPreprocessor::process(const char*                     fileName,
+                                        std::vector<std::string>*       sourceFiles,
+                                        const std::vector<std::string>& defines)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Context ctx;
+	ctx.defines = &defines;
+
+	if (!emit(normalizePath(fileName), ctx))
+		return {};
+
+	// without #version the defines simply go first
+	if (!ctx.versionSeen)
+		ctx.output.insert(0, getDefinesText(defines));
+
+	if (sourceFiles)
+		*sourceFiles = std::move(ctx.files);
+
+	return std::move(ctx.output);
+}
+
+void ShaderPreprocessor::collectDependencies(const std::string& fileName, std::vector<std::string>& out)
+{
+	const auto it = mFiles.find(fileName);
+	if (it == mFiles.end())
+		return;
+
+	for (const auto& include : it->second.includes)
+	{
+		if (std::find(out.begin(), out.end(), include) != out.end())
+			continue;
+		out.push_back(include);
+		collectDependencies(include, out);
+	}
+}
+
+std::vector<std::string> ShaderPreprocessor::getDependencies(const std::string& fileName)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	std::vector<std::string> deps;
+	collectDependencies(normalizePath(fileName), deps);
+	return deps;
+}
+
+std::vector<std::string> ShaderPreprocessor::getDependents(const std::string& fileName)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const std::string name = normalizePath(fileName);
+
+	std::vector<std::string> dependents;
+	for (const auto& f : mFiles)
+	{
+		std::vector<std::string> deps;
+		collectDependencies(f.first, deps);
+		if (std::find(deps.begin(), deps.end(), name) != deps.end())
+			dependents.push_back(f.first);
+	}
+
+	std::sort(dependents.begin(), dependents.end());
+	return dependents;
+}
+
+void ShaderPreprocessor::invalidate(const std::string& fileName)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mFiles.erase(normalizePath(fileName));
+}
+
+void ShaderPreprocessor::invalidateAll()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mFiles.clear();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Single-pass GLSL preprocessor that resolves #include <file> and #include "file" directives.
+// Every file is read and scanned once and then kept in memory, so a header shared by many shaders costs nothing
+// after the first load. Files containing #pragma once are included only once per shader. Circular includes are
+// reported as errors. The output contains #line directives so that compiler errors point to the original file and
+// line: the second argument of #line is the index of the file in the table returned by process(), 0 being the
+// shader itself. Defines passed to process() are inserted right after #version. All of the include relations seen so far form a dependency graph that can be queried to find
+// which shaders are affected by a change in a header.
+class ShaderPreprocessor
+{
+public:
+	static ShaderPreprocessor& instance();
+
+	// returns an empty string on error
+	// each define is either "NAME" or "NAME VALUE"
+	std::string process(const char*                     fileName,
+	                    std::vector<std::string>*       sourceFiles = nullptr,
+	                    const std::vector<std::string>& defines     = {});
+
+	// files directly and indirectly included by the given file
+	std::vector<std::string> getDependencies(const std::string& fileName);
+	// files that directly or indirectly include the given file
+	std::vector<std::string> getDependents(const std::string& fileName);
+
+	// drops the cached contents of a file, it will be read again the next time it is included
+	void invalidate(const std::string& fileName);
+	void invalidateAll();
+
+	static std::string normalizePath(const std::string& fileName);
+
+private:
+	struct Directive
+	{
+		size_t      begin = 0; // byte range of the whole line holding the directive
+		size_t      end   = 0;
+		uint32_t    line  = 0; // 1-based line number
+		std::string include;   // empty for #pragma once and #version
+		bool        isVersion = false;
+	};
+
+	struct SourceFile
+	{
+		std::string              text;
+		std::vector<Directive>   directives;
+		std::vector<std::string> includes;
+		bool                     pragmaOnce = false;
+	};
+
+	struct Context
+	{
+		std::string                     output;
+		std::vector<std::string>        files;
+		std::vector<std::string>        stack;
+		std::vector<std::string>        included; // files with #pragma once that were already emitted
+		const std::vector<std::string>* defines     = nullptr;
+		bool                            versionSeen = false;
+	};
+
+	const SourceFile* load(const std::string& fileName);
+	bool              emit(const std::string& fileName, Context& ctx);
+	void              collectDependencies(const std::string& fileName, std::vector<std::string>& out);
+
+private:
+	std::mutex                                  mMutex;
+	std::unordered_map<std::string, SourceFile> mFiles;
+};
@@ -0,0 +1,96 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+
+void getCascadeSplits(float zNear, float zFar, uint32_t numCascades, float lambda, float* splits)
+{
+	for (uint32_t i = 1; i <= numCascades; i++)
+	{
+		const float p        = (float)i / numCascades;
+		const float logSplit = zNear * std::pow(zFar / zNear, p);
+		const float uniSplit = zNear + (zFar - zNear) * p;
+		splits[i - 1]        = glm::mix(uniSplit, logSplit, lambda);
+	}
+}
+
+// the light looks at the origin, only its orientation matters, the projection does the positioning
+static glm::mat4 getLightView(const glm::vec3& lightDir)
+{
+	const glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::lookAt(glm::vec3(0.0f), -lightDir, up);
+}
+
+ShadowCascade fitShadowCascade(const glm::mat4& cameraView, float fovY, float aspect, float splitNear, float splitFar,
+                               const glm::vec3& lightDir, uint32_t shadowMapSize, const BoundingBox& sceneBounds)
+{
+	const glm::mat4 lightView = getLightView(lightDir);
+
+	glm::vec4 corners[8];
+	getFrustumCorners(glm::perspective(fovY, aspect, splitNear, splitFar) * cameraView, corners);
+
+	vec3 sliceMin(std::numeric_limits<float>::max());
+	vec3 sliceMax(std::numeric_limits<float>::lowest());
+	for (const glm::vec4& c : corners)
+	{
+		const vec3 p = vec3(lightView * c);
+		sliceMin     = glm::min(sliceMin, p);
+		sliceMax     = glm::max(sliceMax, p);
+	}
+
+	// snap to whole texels, a texel keeps its world position while the slice translates. One texel is left for the snap,
+	// so the projection is always exactly shadowMapSize texels wide
+	const glm::vec2 texelSize = glm::vec2(sliceMax.x - sliceMin.x, sliceMax.y - sliceMin.y) / (float)(shadowMapSize - 1);
+	const glm::vec2 minXY     = glm::floor(glm::vec2(sliceMin.x, sliceMin.y) / texelSize) * texelSize;
+	const glm::vec2 maxXY     = minXY + texelSize * (float)shadowMapSize;
+
+	// the light looks down -Z, the near plane moves towards the light up to the farthest caster in the scene
+	const float maxZ = std::max(sliceMax.z, sceneBounds.getTransformed(lightView).max.z);
+
+	return ShadowCascade{
+		.view = lightView,
+		.proj = glm::ortho(minXY.x, maxXY.x, minXY.y, maxXY.y, -maxZ, -sliceMin.z),
+		.splitNear = splitNear,
+		.splitFar = splitFar
+	};
+}
+
+ShadowCascade fitStableShadowCascade(const glm::mat4& cameraView, float fovY, float aspect, float splitNear, float splitFar,
+                                     const glm::vec3& lightDir, uint32_t shadowMapSize, const BoundingBox& sceneBounds, float snapFraction)
+{
+	const glm::mat4 lightView = getLightView(lightDir);
+
+	glm::vec4 corners[8];
+	getFrustumCorners(glm::perspective(fovY, aspect, splitNear, splitFar) * cameraView, corners);
+
+	// the sphere around the slice has the same radius however the camera turns
+	vec3 center(0.0f);
+	for (const glm::vec4& c : corners)
+		center += vec3(c) / 8.0f;
+
+	float radius = 0.0f;
+	for (const glm::vec4& c : corners)
+		radius = std::max(radius, glm::length(vec3(c) - center));
+	// round away the float noise of the corners
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	// the projection is the sphere widened by one snap step of k texels, measured in the texels of the widened
+	// projection: N * texel = 2 * (radius + k * texel), so the center moves in whole texels of the shadow map
+	const float numTexels = (float)shadowMapSize;
+	const float numSteps  = glm::clamp(std::round(numTexels * snapFraction), 1.0f, numTexels / 4.0f);
+	const float halfSize  = radius * numTexels / (numTexels - 2.0f * numSteps);
+	const float step      = numSteps * 2.0f * halfSize / numTexels;
+
+	const vec3 lightCenter = vec3(lightView * glm::vec4(center, 1.0f));
+	const float x          = std::floor(lightCenter.x / step) * step;
+	const float y          = std::floor(lightCenter.y / step) * step;
+
+	// the depth range covers the whole scene, so it does not depend on the camera either
+	const BoundingBox sceneLight = sceneBounds.getTransformed(lightView);
+
+	return ShadowCascade{
+		.view = lightView,
+		.proj = glm::ortho(x - halfSize, x + halfSize, y - halfSize, y + halfSize, -sceneLight.max.z, -sceneLight.min.z),
+		.splitNear = splitNear,
+		.splitFar = splitFar
+	};
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "UtilsMath.h"
+
+#include <cstdint>
+
+// cascaded shadow maps for a directional light, one orthographic shadow map per depth slice of the camera frustum
+
+constexpr uint32_t kMaxShadowCascades = 4;
+
+struct ShadowCascade
+{
+	glm::mat4 view;
+	glm::mat4 proj;
+	float     splitNear; // view-space distances covered by the cascade
+	float     splitFar;
+};
+
+// distances at which cascades end, splits[numCascades - 1] == zFar
+// lambda blends between uniform (0) and logarithmic (1) splits, the "practical split scheme" of parallel-split shadow maps
+void getCascadeSplits(float zNear, float zFar, uint32_t numCascades, float lambda, float* splits);
+
+// tight orthographic projection around the slice, snapped to texels; the depth range reaches back to the scene bounds
+// lightDir points towards the light
+ShadowCascade fitShadowCascade(const glm::mat4& cameraView, float fovY, float aspect, float splitNear, float splitFar,
+                               const glm::vec3& lightDir, uint32_t shadowMapSize, const BoundingBox& sceneBounds);
+
+// covers the bounding sphere of the slice and only moves in steps of snapFraction of the map, so static casters can be
+// cached across frames (see 16ShadowMapping)
+ShadowCascade fitStableShadowCascade(const glm::mat4& cameraView, float fovY, float aspect, float splitNear, float splitFar,
+                                     const glm::vec3& lightDir, uint32_t shadowMapSize, const BoundingBox& sceneBounds,
+                                     float snapFraction = 0.125f);
@@ -0,0 +1,164 @@
+#include "StringPool.h"
+#include "Utils.h"
+
+#include <cstring>
+
+StringPool::StringPool(const StringPool& other)
+{
+	*this = other;
+}
+
+StringPool& StringPool::operator=(const StringPool& other)
+{
+	if (this != &other)
+	{
+		// the copy gets its own block, the views of other point into the blocks of other
+		std::vector<uint32_t> offsets;
+		std::vector<char>     chars;
+		other.getTable(offsets, chars);
+		assignTable(offsets.data(), offsets.size(), chars.data(), chars.size());
+	}
+	return *this;
+}
+
+uint32_t StringPool::intern(std::string_view s)
+{
+	const uint32_t index = find(s);
+	return index != kInvalidString ? index : add(s);
+}
+
+uint32_t StringPool::add(std::string_view s)
+{
+	const uint32_t index = (uint32_t)mStrings.size();
+	mStrings.push_back(store(s));
+	addToIndex(index);
+	return index;
+}
+
+uint32_t StringPool::find(std::string_view s) const
+{
+	if (mSlots.empty())
+		return kInvalidString;
+
+	const size_t mask = mSlots.size() - 1;
+	for (size_t slot = hash64(s.data(), s.size()) & mask; mSlots[slot] != 0; slot = (slot + 1) & mask)
+		if (mStrings[mSlots[slot] - 1] == s)
+			return mSlots[slot] - 1;
+
+	return kInvalidString;
+}
+
+void StringPool::clear()
+{
+	mBlocks.clear();
+	mBlockFree = nullptr;
+	mBlockLeft = 0;
+	mStrings.clear();
+	mSlots.clear();
+}
+
+void StringPool::getTable(std::vector<uint32_t>& offsets, std::vector<char>& chars) const
+{
+	size_t numChars = 0;
+	for (const std::string_view s : mStrings)
+		numChars += s.size() + 1;
+
+	offsets.reserve(offsets.size() + mStrings.size() + 1);
+	chars.reserve(chars.size() + numChars);
+
+	offsets.push_back(0);
+	for (const std::string_view s : mStrings)
+	{
+		// the views are followed by their NUL
+		chars.insert(chars.end(), s.data(), s.data() + s.size() + 1);
+		offsets.push_back((uint32_t)chars.size());
+	}
+}
+
+bool StringPool::assignTable(const uint32_t* offsets, size_t numOffsets, const char* chars, size_t numChars)
+{
+	clear();
+
+	if (numOffsets == 0)
+		return numChars == 0;
+	if (offsets[0] != 0 || offsets[numOffsets - 1] != numChars)
+		return false;
+
+	char* block = allocate(numChars);
+	if (numChars > 0)
+		memcpy(block, chars, numChars);
+
+	mStrings.reserve(numOffsets - 1);
+	for (size_t i = 0; i + 1 < numOffsets; i++)
+	{
+		// every string ends with a NUL right before the next one starts
+		if (offsets[i] >= offsets[i + 1] || offsets[i + 1] > numChars || chars[offsets[i + 1] - 1] != 0)
+		{
+			clear();
+			return false;
+		}
+		mStrings.emplace_back(block + offsets[i], offsets[i + 1] - offsets[i] - 1);
+	}
+
+	rebuildIndex(mStrings.size() * 2);
+	return true;
+}
+
+std::string_view StringPool::store(std::string_view s)
+{
+	char* chars = allocate(s.size() + 1);
+	memcpy(chars, s.data(), s.size());
+	chars[s.size()] = 0;
+	return std::string_view(chars, s.size());
+}
+
+char* StringPool::allocate(size_t size)
+{
+	// large strings get a block of their own, the current block stays in use
+	if (size > kBlockSize / 4)
+		return mBlocks.emplace_back(std::make_unique_for_overwrite<char[]>(size)).get();
+
+	if (size > mBlockLeft)
+	{
+		mBlocks.push_back(std::make_unique_for_overwrite<char[]>(kBlockSize));
+		mBlockFree = mBlocks.back().get();
+		mBlockLeft = kBlockSize;
+	}
+
+	char* chars = mBlockFree;
+	mBlockFree += size;
+	mBlockLeft -= size;
+	return chars;
+}
+
+void StringPool::addToIndex(uint32_t index)
+{
+	if ((index + 1) * 2 > mSlots.size())
+	{
+		rebuildIndex(mSlots.size() * 2);
+		return;
+	}
+
+	const std::string_view s    = mStrings[index];
+	const size_t           mask = mSlots.size() - 1;
+
+	size_t slot = hash64(s.data(), s.size()) & mask;
+	for (; mSlots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		// find() returns the first of equal strings
+		if (mStrings[mSlots[slot] - 1] == s)
+			return;
+	}
+	mSlots[slot] = index + 1;
+}
+
+void StringPool::rebuildIndex(size_t numSlots)
+{
+	size_t size = 16;
+	while (size < numSlots || size < mStrings.size() * 2)
+		size *= 2;
+
+	mSlots.assign(size, 0);
+	for (uint32_t i = 0; i != (uint32_t)mStrings.size(); i++)
+		addToIndex(i);
+}
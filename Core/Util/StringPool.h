@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Strings stored once in large blocks and referred to by their index. The views stay valid while the pool lives, also
+// when it grows or is moved, and every string is followed by a NUL so data() can be passed to C functions.
+// An open addressing hash table finds the index of a string without allocating.
+class StringPool
+{
+public:
+	static constexpr uint32_t kInvalidString = ~0u;
+
+	StringPool() = default;
+	StringPool(const StringPool& other);
+	StringPool(StringPool&&) = default;
+	StringPool& operator=(const StringPool& other);
+	StringPool& operator=(StringPool&&) = default;
+
+	// returns the index of the string, adds it if it is not in the pool yet
+	uint32_t intern(std::string_view s);
+	// adds the string even if it is in the pool, for lists whose indices mean something; find() returns the first one
+	uint32_t add(std::string_view s);
+	// kInvalidString if the string is not in the pool
+	uint32_t find(std::string_view s) const;
+
+	std::string_view operator[](uint32_t index) const { return mStrings[index]; }
+
+	size_t size() const { return mStrings.size(); }
+	bool   empty() const { return mStrings.empty(); }
+	void   clear();
+
+	auto begin() const { return mStrings.begin(); }
+	auto end() const { return mStrings.end(); }
+
+	// the strings as a table of size() + 1 offsets into one blob of characters, each string followed by a NUL
+	void getTable(std::vector<uint32_t>& offsets, std::vector<char>& chars) const;
+	// replaces the strings with such a table, copied into a single block; false if the table is malformed
+	bool assignTable(const uint32_t* offsets, size_t numOffsets, const char* chars, size_t numChars);
+
+private:
+	static constexpr size_t kBlockSize = 64 * 1024;
+
+	std::string_view store(std::string_view s);
+	char*            allocate(size_t size);
+	void             addToIndex(uint32_t index);
+	void             rebuildIndex(size_t numSlots);
+
+	std::vector<std::unique_ptr<char[]>> mBlocks;
+	char*                                mBlockFree = nullptr;
+	size_t                               mBlockLeft = 0;
+
+	std::vector<std::string_view> mStrings;
+	// index + 1 of a string in every used slot, at most half of the slots are used
+	std::vector<uint32_t> mSlots;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+// Compact transforms of scene nodes: local transforms are kept as rotation, translation and scale (40 bytes), global
+// transforms as affine matrices without the constant last row (glm::mat4x3, 4 columns of 3 rows, 48 bytes). The GPU
+// gets the rows of the affine matrices, transpose(mat4x3) = mat3x4, which is 48 bytes in std430 as well.
+struct TRS
+{
+	glm::quat rotation    = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 translation = glm::vec3(0.0f);
+	glm::vec3 scale       = glm::vec3(1.0f);
+};
+
+inline glm::mat4x3 getAffine(const TRS& t)
+{
+	const glm::mat3 r = glm::mat3_cast(t.rotation);
+	return glm::mat4x3(r[0] * t.scale.x, r[1] * t.scale.y, r[2] * t.scale.z, t.translation);
+}
+
+// shear is lost, node transforms of converted scenes do not have any
+inline TRS getTRS(const glm::mat4& m)
+{
+	const glm::vec3 axes[3] = {glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2])};
+
+	TRS t;
+	t.translation = glm::vec3(m[3]);
+	t.scale       = glm::vec3(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+
+	// a mirrored basis keeps a negative scale on x, the rotation has to stay a rotation
+	if (glm::determinant(glm::mat3(m)) < 0.0f)
+		t.scale.x = -t.scale.x;
+
+	glm::mat3 r;
+	for (int i = 0; i != 3; i++)
+		r[i] = t.scale[i] != 0.0f ? axes[i] / t.scale[i] : axes[i];
+	t.rotation = glm::normalize(glm::quat_cast(r));
+
+	return t;
+}
+
+// a * b for affine matrices, the implicit last row is (0, 0, 0, 1)
+inline glm::mat4x3 combineAffine(const glm::mat4x3& a, const glm::mat4x3& b)
+{
+	const glm::mat3 r(a);
+	return glm::mat4x3(r * b[0], r * b[1], r * b[2], r * b[3] + a[3]);
+}
@@ -1,4 +1,8 @@
 #include "Utils.h"
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <cstring>
 
 int addUnique(std::vector<std::string>& files, const std::string& file)
 {
@@ -18,53 +22,7 @@ int addUnique(std::vector<std::string>& files, const std::string& file)
 
 std::string readShaderFile(const char* fileName)
 {
-	FILE* file = fopen(fileName, "r");
-
-	if (!file)
-	{
-		printf("I/O error. Cannot open shader file '%s'\n", fileName);
-		return {};
-	}
-
-	fseek(file, 0L, SEEK_END);
-	const auto bytesinfile = ftell(file);
-	fseek(file, 0L, SEEK_SET);
-
-	char*        buffer    = (char*)alloca(bytesinfile + 1);
-	const size_t bytesread = fread(buffer, 1, bytesinfile, file);
-	fclose(file);
-
-	buffer[bytesread] = 0;
-
-	// parse and eliminate the UTF byte-order marker.
-	// if present, it might not be handled properly by some legacy GLSL compilers
-	static constexpr unsigned char BOM[] = {0xEF, 0xBB, 0xBF};
-
-	if (bytesread > 3)
-	{
-		if (!memcmp(buffer, BOM, 3))
-			memset(buffer, ' ', 3);
-	}
-
-	std::string code(buffer);
-
-	// handle #include directives inside the shader source code
-	while (code.find("#include ") != code.npos)
-	{
-		const auto pos = code.find("#include ");
-		const auto p1  = code.find('<', pos);
-		const auto p2  = code.find('>', pos);
-		if (p1 == code.npos || p2 == code.npos || p2 <= p1)
-		{
-			printf("Error while loading shader program: %s\n", code.c_str());
-			return {};
-		}
-		const std::string name    = code.substr(p1 + 1, p2 - p1 - 1);
-		const std::string include = readShaderFile(name.c_str());
-		code.replace(pos, p2 - pos + 1, include.c_str());
-	}
-
-	return code;
+	return ShaderPreprocessor::instance().process(fileName);
 }
 
 void printShaderSource(const char* text)
@@ -96,3 +54,37 @@ int endsWith(const char* s, const char* part)
 {
 	return (strstr(s, part) - s) == (strlen(s) - strlen(part));
 }
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t       hash  = seed;
+	for (size_t i = 0; i != size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+uint64_t checksum64(const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t       lanes[4];
+	for (int l = 0; l != 4; l++)
+		lanes[l] = hash64(&l, sizeof(l));
+
+	size_t i = 0;
+	for (; i + sizeof(lanes) <= size; i += sizeof(lanes))
+	{
+		for (int l = 0; l != 4; l++)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i + l * sizeof(uint64_t), sizeof(word));
+			lanes[l] = (lanes[l] ^ word) * 0x100000001b3ull;
+		}
+	}
+
+	// the lanes and the remaining bytes
+	return hash64(bytes + i, size - i, hash64(lanes, sizeof(lanes), hash64(&size, sizeof(size))));
+}
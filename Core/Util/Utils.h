@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -6,3 +8,8 @@ std::string readShaderFile(const char* fileName);
 void        printShaderSource(const char* text);
 int         endsWith(const char* s, const char* part);
 int         addUnique(std::vector<std::string>& files, const std::string& file);
+
+// 64-bit FNV-1a hash; pass the previous result as seed to hash several blocks
+uint64_t    hash64(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+// checksum of large blocks: four FNV-1a lanes over 8-byte words run in parallel, many times faster than hash64()
+uint64_t    checksum64(const void* data, size_t size);
@@ -2,31 +2,31 @@
 #include <cassert>
 #include "UtilsMath.h"
 
-MeshFileHeader loadMeshData(const char* meshFile, MeshData& out)
+bool loadMeshData(const char* meshFile, MeshData& out, MeshFileHeader* outHeader)
 {
 	MeshFileHeader header;
 
 	FILE* f = fopen(meshFile, "rb");
 
-	assert(f); // Did you forget to run "Ch5_Tool05_MeshConvert"?
-
 	if (!f)
 	{
 		printf("Cannot open %s. Did you forget to run \"Ch5_Tool05_MeshConvert\"?\n", meshFile);
-		exit(EXIT_FAILURE);
+		return false;
 	}
 
-	if (fread(&header, 1, sizeof(header), f) != sizeof(header))
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header) || header.magicValue != 0x12345678)
 	{
-		printf("Unable to read mesh file header\n");
-		exit(EXIT_FAILURE);
+		printf("Unable to read mesh file header of %s\n", meshFile);
+		fclose(f);
+		return false;
 	}
 
 	out.meshes.resize(header.meshCount);
 	if (fread(out.meshes.data(), sizeof(Mesh), header.meshCount, f) != header.meshCount)
 	{
-		printf("Could not read mesh descriptors\n");
-		exit(EXIT_FAILURE);
+		printf("Could not read mesh descriptors of %s\n", meshFile);
+		fclose(f);
+		return false;
 	}
 
 	out.indexData.resize(header.indexDataSize / sizeof(uint32_t));
@@ -35,13 +35,17 @@ MeshFileHeader loadMeshData(const char* meshFile, MeshData& out)
 	if ((fread(out.indexData.data(), 1, header.indexDataSize, f) != header.indexDataSize) ||
 	    (fread(out.vertexData.data(), 1, header.vertexDataSize, f) != header.vertexDataSize))
 	{
-		printf("Unable to read index/vertex data\n");
-		exit(255);
+		printf("Unable to read index/vertex data of %s\n", meshFile);
+		fclose(f);
+		return false;
 	}
 
 	fclose(f);
 
-	return header;
+	if (outHeader)
+		*outHeader = header;
+
+	return true;
 }
 
 void saveMeshesToFile(const char* fileName, const MeshData& m)
@@ -65,25 +69,28 @@ void saveMeshesToFile(const char* fileName, const MeshData& m)
 }
 
 
-// void recalculateBoundingBoxes(MeshData& m)
-// {
-// 	m.boundingBoxes.clear();
-//
-// 	for (const auto& mesh : m.meshes)
-// 	{
-// 		const auto numIndices = mesh.getLODIndicesCount(0);
-//
-// 		glm::vec3 vmin(std::numeric_limits<float>::max());
-// 		glm::vec3 vmax(std::numeric_limits<float>::lowest());
-//
-// 		for (auto i = 0; i != numIndices; i++)
-// 		{
-// 			auto         vtxOffset = m.indexData[mesh.indexOffset + i] + mesh.vertexOffset;
-// 			const float* vf        = &m.vertexData[vtxOffset * MAX_STREAMS];
-// 			vmin                   = glm::min(vmin, vec3(vf[0], vf[1], vf[2]));
-// 			vmax                   = glm::max(vmax, vec3(vf[0], vf[1], vf[2]));
-// 		}
-//
-// 		m.boundingBoxes.emplace_back(vmin, vmax);
-// 	}
-// }
+void recalculateBoundingBoxes(MeshData& m)
+{
+	m.boundingBoxes.clear();
+	m.boundingBoxes.reserve(m.meshes.size());
+
+	for (const auto& mesh : m.meshes)
+	{
+		const uint32_t numIndices = mesh.getLODIndicesCount(0);
+		// vertices are interleaved in the first stream and begin with the position
+		const uint32_t stride = mesh.streamElementSize[0] / sizeof(float);
+
+		glm::vec3 vmin(std::numeric_limits<float>::max());
+		glm::vec3 vmax(std::numeric_limits<float>::lowest());
+
+		for (uint32_t i = 0; i != numIndices; i++)
+		{
+			const uint32_t vtxOffset = m.indexData[mesh.indexOffset + i] + mesh.vertexOffset;
+			const float*   vf        = &m.vertexData[vtxOffset * stride];
+			vmin                     = glm::min(vmin, vec3(vf[0], vf[1], vf[2]));
+			vmax                     = glm::max(vmax, vec3(vf[0], vf[1], vf[2]));
+		}
+
+		m.boundingBoxes.emplace_back(vmin, vmax);
+	}
+}
@@ -101,9 +101,11 @@ struct MeshData
 	// note: you could combine index and vertex data into a single large byte buffer
 	std::vector<uint32_t> indexData;
 	std::vector<float>    vertexData;
-	// std::vector<BoundingBox> boundingBoxes;
+	// local bounds of LOD 0 of every mesh, not stored in mesh files, see recalculateBoundingBoxes()
+	std::vector<BoundingBox> boundingBoxes;
 };
 
-MeshFileHeader loadMeshData(const char* meshFile, MeshData& out);
-void           saveMeshesToFile(const char* fileName, const MeshData& m);
-void           recalculateBoundingBoxes(MeshData& m);
+// false if the file is missing or damaged
+bool loadMeshData(const char* meshFile, MeshData& out, MeshFileHeader* header = nullptr);
+void saveMeshesToFile(const char* fileName, const MeshData& m);
+void recalculateBoundingBoxes(MeshData& m);
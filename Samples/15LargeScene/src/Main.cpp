@@ -1,12 +1,20 @@
 #include <glm/glm.hpp>
+#include <memory>
 
 #include "OpenGL/GLApp.h"
+#include "OpenGL/GLBenchmark.h"
 #include "OpenGL/GLBuffer.h"
+#include "OpenGL/GLFramebuffer.h"
+#include "OpenGL/GLHiZ.h"
+#include "OpenGL/GLMaterialPermutations.h"
 #include "OpenGL/GLMesh.h"
 #include "OpenGL/GLProgram.h"
 #include "OpenGL/GLSceneData.h"
+#include "OpenGL/GLSceneTransforms.h"
 #include "OpenGL/GLShader.h"
+#include "Util/BVH.h"
 #include "Util/Camera.h"
+#include "Util/OcclusionBuffer.h"
 
 using glm::mat4;
 using glm::vec4;
@@ -25,14 +33,120 @@ struct MouseState
 {
 	glm::vec2 pos         = glm::vec2(0.0f);
 	bool      pressedLeft = false;
+	bool      pick        = false;
 }             gMouseState;
 
 CameraPositionerFirstPerson gPositioner(vec3(-10.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
 Camera                      gCamera(gPositioner);
 
-int main()
+// R starts and stops recording the camera, the path can be replayed with --benchmark=data/paths/recorded.campath
+CameraPathRecorder gRecorder(gPositioner);
+
+// specialized shader variants per material permutation, P switches back to the uber-shader for comparison
+bool gUseShaderPermutations = true;
+
+// Z toggles a position-only depth pre-pass of the opaque shapes, the main pass then only shades visible fragments
+bool gDepthPrepass = true;
+
+// O cycles through the occlusion culling modes, both test the shapes against the depth pre-pass
+enum OcclusionCulling
+{
+	OcclusionCulling_None,
+	OcclusionCulling_GPU, // Hi-Z pyramid and a compute shader, the draw counts stay on the GPU
+	OcclusionCulling_CPU, // software-rasterized occlusion buffer, the reference
+	OcclusionCulling_Count,
+};
+
+const char* const kOcclusionCullingNames[] = {"off", "GPU Hi-Z", "CPU occlusion buffer"};
+
+int gOcclusionCulling = OcclusionCulling_GPU;
+
+// shapes smaller than this are not worth rasterizing as occluders on the CPU
+const float kOccluderMinSize = 2.0f;
+
+// the right mouse button picks the node under the cursor, the ray acceleration structures are built on the first pick
+struct PickScene
+{
+	const GLSceneData*        sceneData;
+	std::unique_ptr<SceneBVH> bvh;
+	bool                      moved = false; // nodes have moved since the BVH was built or refitted
+};
+
+// returns the picked node or -1
+int pickNode(PickScene& scene, const Ray& ray)
 {
-	GLApp app;
+	if (!scene.bvh)
+	{
+		const double start = glfwGetTime();
+		scene.bvh          = std::make_unique<SceneBVH>(scene.sceneData->mMeshData, scene.sceneData->mShapes, scene.sceneData->mScene.globalTransform);
+		printf("Built a BVH with %u nodes over %u shapes in %.1f ms\n", (uint32_t)scene.bvh->getNumNodes(), (uint32_t)scene.sceneData->mShapes.size(), (glfwGetTime() - start) * 1000.0);
+	}
+	else if (scene.moved)
+	{
+		scene.bvh->refit(scene.sceneData->mScene.globalTransform);
+	}
+	scene.moved = false;
+
+	RayHit hit;
+	if (!scene.bvh->intersect(ray, hit))
+	{
+		printf("Picked nothing\n");
+		return -1;
+	}
+
+	const GLSceneData& sceneData = *scene.sceneData;
+	const uint32_t     node      = sceneData.mShapes[hit.shape].transformIndex;
+	printf("Picked node %u '%s' at %.2f\n", node, getNodeName(sceneData.mScene, node).data(), hit.t);
+	return (int)node;
+}
+
+// M makes the picked node bob up and down, its shapes are uploaded by GLMesh::updateMovedShapes() every frame
+bool gAnimatePickedNode = false;
+
+// G propagates the transforms of the changed nodes on the GPU instead, see GLSceneTransforms. The CPU copy of the
+// transforms and the shape bounds goes stale, it is read back when picking, CPU occlusion culling or G need it
+bool gTransformsOnGPU = false;
+
+struct AnimatedNode
+{
+	int   node = -1;
+	TRS   rest; // the local transform the animation starts from
+	float time = 0.0f;
+};
+
+// puts the previous node back where it was, the new one starts from where it is
+void selectAnimatedNode(Scene& scene, AnimatedNode& animated, int node)
+{
+	if (animated.node == node)
+		return;
+
+	if (animated.node >= 0)
+	{
+		scene.localTransform[animated.node] = animated.rest;
+		markAsChanged(scene, animated.node);
+	}
+
+	animated.node = node;
+	animated.time = 0.0f;
+	if (node >= 0)
+		animated.rest = scene.localTransform[node];
+}
+
+void animateNode(Scene& scene, AnimatedNode& animated, float deltaSeconds)
+{
+	if (animated.node < 0)
+		return;
+
+	animated.time += deltaSeconds;
+
+	TRS& t        = scene.localTransform[animated.node];
+	t.translation = animated.rest.translation + vec3(0.0f, 0.5f * (1.0f - cosf(2.0f * animated.time)), 0.0f);
+	markAsChanged(scene, animated.node);
+}
+
+int main(int argc, char** argv)
+{
+	GLApp app(argc, argv);
 
 	GLShader  shdGridVertex("data/shaders/11DebugGrid/grid.vert");
 	GLShader  shdGridFragment("data/shaders/11DebugGrid/grid.frag");
@@ -50,82 +164,225 @@ int main()
 	GLShader  shaderFragment("data/shaders/15LargeScene/largeScene.frag");
 	GLProgram program(shaderVertex, shaderFragment);
 
-	GLSceneData sceneData1("data/meshes/bistro_exterior.meshes", "data/meshes/bistro_exterior.scene", "data/meshes/bistro_exterior.materials");
-	GLSceneData sceneData2("data/meshes/bistro_interior.meshes", "data/meshes/bistro_interior.scene", "data/meshes/bistro_interior.materials");
+	GLMaterialPermutations permutations("data/shaders/15LargeScene/largeScene.vert", "data/shaders/15LargeScene/largeScene.frag");
 
-	GLMesh mesh1(sceneData1);
-	GLMesh mesh2(sceneData2);
+	GLShader  shdDepthPrepassVertex("data/shaders/15LargeScene/depthPrepass.vert");
+	GLShader  shdDepthPrepassFragment("data/shaders/15LargeScene/depthPrepass.frag");
+	GLProgram progDepthPrepass(shdDepthPrepassVertex, shdDepthPrepassFragment);
 
-	// set a callback for key events
-	glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
-	{
-		const bool pressed = action != GLFW_RELEASE;
-		if (key == GLFW_KEY_ESCAPE && pressed)
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
-		if (key == GLFW_KEY_W)
-			gPositioner.mMovement.forward = pressed;
-		if (key == GLFW_KEY_S)
-			gPositioner.mMovement.backward = pressed;
-		if (key == GLFW_KEY_A)
-			gPositioner.mMovement.left = pressed;
-		if (key == GLFW_KEY_D)
-			gPositioner.mMovement.right = pressed;
-		if (key == GLFW_KEY_1)
-			gPositioner.mMovement.up = pressed;
-		if (key == GLFW_KEY_2)
-			gPositioner.mMovement.down = pressed;
-		if (mods & GLFW_MOD_SHIFT)
-			gPositioner.mMovement.fastSpeed = pressed;
-		if (key == GLFW_KEY_SPACE)
-			gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
-	});
-
-	glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
-	{
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-		gMouseState.pos.x = static_cast<float>(x / width);
-		gMouseState.pos.y = static_cast<float>(y / height);
-	});
+	// the exterior and the interior merged by SceneConversionTool, drawn with one multi-draw
+	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
+
+	GLMesh mesh(sceneData);
 
-	glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+	// there is no window to receive input from in headless mode
+	if (!app.isHeadless())
 	{
-		if (button == GLFW_MOUSE_BUTTON_LEFT)
-			gMouseState.pressedLeft = action == GLFW_PRESS;
-	});
+		// set a callback for key events
+		glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			const bool pressed = action != GLFW_RELEASE;
+			if (key == GLFW_KEY_ESCAPE && pressed)
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			if (key == GLFW_KEY_W)
+				gPositioner.mMovement.forward = pressed;
+			if (key == GLFW_KEY_S)
+				gPositioner.mMovement.backward = pressed;
+			if (key == GLFW_KEY_A)
+				gPositioner.mMovement.left = pressed;
+			if (key == GLFW_KEY_D)
+				gPositioner.mMovement.right = pressed;
+			if (key == GLFW_KEY_1)
+				gPositioner.mMovement.up = pressed;
+			if (key == GLFW_KEY_2)
+				gPositioner.mMovement.down = pressed;
+			if (mods & GLFW_MOD_SHIFT)
+				gPositioner.mMovement.fastSpeed = pressed;
+			if (key == GLFW_KEY_SPACE)
+				gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
+			if (key == GLFW_KEY_R && action == GLFW_PRESS)
+			{
+				if (!gRecorder.isRecording())
+				{
+					gRecorder.start();
+					printf("Recording the camera path...\n");
+				}
+				else
+				{
+					gRecorder.stop();
+					if (gRecorder.getPath().save("data/paths/recorded.campath"))
+						printf("Saved %u keyframes to data/paths/recorded.campath\n", (uint32_t)gRecorder.getPath().getKeyframes().size());
+				}
+			}
+			if (key == GLFW_KEY_P && action == GLFW_PRESS)
+				gUseShaderPermutations = !gUseShaderPermutations;
+			if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+			{
+				gDepthPrepass = !gDepthPrepass;
+				printf("Depth pre-pass %s\n", gDepthPrepass ? "on" : "off");
+			}
+			if (key == GLFW_KEY_O && action == GLFW_PRESS)
+			{
+				gOcclusionCulling = (gOcclusionCulling + 1) % OcclusionCulling_Count;
+				printf("Occlusion culling: %s\n", kOcclusionCullingNames[gOcclusionCulling]);
+			}
+			if (key == GLFW_KEY_M && action == GLFW_PRESS)
+				gAnimatePickedNode = !gAnimatePickedNode;
+			if (key == GLFW_KEY_G && action == GLFW_PRESS)
+			{
+				gTransformsOnGPU = !gTransformsOnGPU;
+				printf("Transforms on the %s\n", gTransformsOnGPU ? "GPU" : "CPU");
+			}
+		});
+
+		glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			gMouseState.pos.x = static_cast<float>(x / width);
+			gMouseState.pos.y = static_cast<float>(y / height);
+		});
+
+		glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+		{
+			if (button == GLFW_MOUSE_BUTTON_LEFT)
+				gMouseState.pressedLeft = action == GLFW_PRESS;
+			if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+				gMouseState.pick = true;
+		});
+	}
 
 	gPositioner.mMaxSpeed = 1.0f;
 
-	while (!glfwWindowShouldClose(app.getWindow()))
+	// the scene is rendered offscreen, the Hi-Z pyramid is built from its depth buffer
+	int width, height;
+	app.getFramebufferSize(width, height);
+	GLFramebuffer framebuffer(width, height, GL_RGBA8, GL_DEPTH_COMPONENT24);
+
+	GLHiZ           hiZ;
+	OcclusionBuffer occlusionBuffer;
+
+	PickScene    pickScene = {&sceneData};
+	AnimatedNode animatedNode;
+
+	std::unique_ptr<GLSceneTransforms> gpuTransforms;
+
+	// --benchmark replaces the mouse-driven camera with a camera path
+	GLBenchmark* benchmark = app.getBenchmark();
+	const Camera camera    = benchmark ? Camera(benchmark->getPositioner()) : gCamera;
+
+	while (!app.shouldClose())
 	{
 		gPositioner.update(app.getDeltaSeconds(), gMouseState.pos, gMouseState.pressedLeft);
+		gRecorder.update(app.getDeltaSeconds());
 
-		int width, height;
-		glfwGetFramebufferSize(app.getWindow(), &width, &height);
+		app.getFramebufferSize(width, height);
 		const float ratio = width / (float)height;
 
-		glViewport(0, 0, width, height);
+		framebuffer.bind();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		const mat4 p    = glm::perspective(45.0f, ratio, 0.1f, 1000.0f);
-		const mat4 view = gCamera.getViewMatrix();
+		const mat4 view = camera.getViewMatrix();
+
+		// created from the current global transforms whenever G switches them on
+		if (gTransformsOnGPU && !gpuTransforms)
+			gpuTransforms = std::make_unique<GLSceneTransforms>(sceneData.mScene);
+
+		if (gpuTransforms && (!gTransformsOnGPU || gMouseState.pick || gOcclusionCulling == OcclusionCulling_CPU))
+		{
+			// waits for the GPU, the model matrices on the GPU are already up to date
+			gpuTransforms->getGlobalTransforms(sceneData.mScene.globalTransform);
+			sceneData.updateShapeBoxes();
+			pickScene.moved = true;
+			if (!gTransformsOnGPU)
+				gpuTransforms.reset();
+		}
+
+		if (gMouseState.pick)
+		{
+			const int node = pickNode(pickScene, SceneBVH::getScreenRay(gMouseState.pos, view, p));
+			gMouseState.pick = false;
+			if (node >= 0)
+				selectAnimatedNode(sceneData.mScene, animatedNode, node);
+		}
+
+		if (gAnimatePickedNode)
+			animateNode(sceneData.mScene, animatedNode, app.getDeltaSeconds());
+
+		if (gpuTransforms)
+		{
+			// nothing is uploaded but the local transforms of the changed nodes
+			gpuTransforms->update(sceneData.mScene);
+			mesh.updateModelMatrices(*gpuTransforms);
+		}
+		// only the shapes of the changed nodes are uploaded
+		else if (sceneData.updateTransforms())
+		{
+			mesh.updateMovedShapes(sceneData);
+			pickScene.moved = true;
+		}
 
 		const PerFrameData perFrameData = {
 			.view = view,
 			.proj = p,
-			.cameraPos = glm::vec4(gCamera.getPosition(), 1.0f)
+			.cameraPos = glm::vec4(camera.getPosition(), 1.0f)
 		};
 		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
 
 		glDisable(GL_BLEND);
-		program.useProgram();
-		mesh1.draw(sceneData1);
-		mesh2.draw(sceneData2);
+
+		// occlusion culling needs the depth of the occluders
+		const bool depthPrepass = gDepthPrepass || gOcclusionCulling == OcclusionCulling_GPU;
+		if (depthPrepass)
+		{
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			progDepthPrepass.useProgram();
+			mesh.drawDepth();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			// opaque fragments of the main pass land exactly on the depth of the pre-pass
+			glDepthFunc(GL_LEQUAL);
+		}
+
+		uint32_t numCulled = 0;
+		if (gOcclusionCulling == OcclusionCulling_GPU)
+		{
+			hiZ.build(framebuffer.getTextureDepth().getHandle(), framebuffer.getWidth(), framebuffer.getHeight());
+			mesh.cullOcclusion(hiZ);
+		}
+		else if (gOcclusionCulling == OcclusionCulling_CPU)
+		{
+			occlusionBuffer.begin(p * view);
+			mesh.rasterizeOccluders(sceneData, occlusionBuffer, kOccluderMinSize);
+			numCulled += mesh.cullOcclusion(sceneData, occlusionBuffer);
+		}
+
+		if (gOcclusionCulling != OcclusionCulling_None)
+		{
+			mesh.drawVisible(permutations);
+		}
+		else if (gUseShaderPermutations)
+		{
+			mesh.draw(sceneData, permutations);
+		}
+		else
+		{
+			program.useProgram();
+			mesh.draw(sceneData);
+		}
+		// the GPU culls without reading back how many shapes it has culled
+		if (benchmark)
+			benchmark->addDrawStats(mesh.getNumDrawCommands() - numCulled, mesh.getNumTriangles(), numCulled);
+
+		glDepthFunc(GL_LESS);
 
 		glEnable(GL_BLEND);
 		progGrid.useProgram();
 		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);
 
+		framebuffer.unbind();
+		glBlitNamedFramebuffer(framebuffer.getHandle(), GLFramebuffer::getDefaultHandle(), 0, 0, framebuffer.getWidth(), framebuffer.getHeight(), 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
 		app.swapBuffers();
 	}
 
@@ -1,16 +1,20 @@
 #include <glm/glm.hpp>
+#include <limits>
 
 #include "OpenGL/GLApp.h"
+#include "OpenGL/GLBenchmark.h"
 #include "OpenGL/GLBuffer.h"
 #include "OpenGL/GLCanvas.h"
 #include "OpenGL/GLFramebuffer.h"
 #include "OpenGL/GLImGui.h"
 #include "OpenGL/GLMesh.h"
 #include "OpenGL/GLMeshPVP.h"
+#include "OpenGL/GLProfiler.h"
 #include "OpenGL/GLProgram.h"
 #include "OpenGL/GLSceneData.h"
 #include "OpenGL/GLShader.h"
 #include "Util/Camera.h"
+#include "Util/ShadowCascades.h"
 
 using glm::mat4;
 using glm::vec4;
@@ -20,28 +24,35 @@ const GLuint kBufferIndex_PerFrameUniforms = 0;
 // kBufferIndex_Vertices is set to 0 in GLMeshPVP.cpp
 const GLuint kBufferIndex_ModelMatrices = 1;
 
+// size of every cascade, the shadow map is an atlas of 2x2 cascades
 const int SHADOW_MAP_SIZE = 1024;
 
-float gLightAngle      = 60.0f; // FOV of the light 
-float gLightInnerAngle = 10.0f;
-float gLightNear       = 1.0f;
-float gLightFar        = 20.0f;
-float gLightDist       = 12.0f;
+// direction of the sun (degrees)
+float gLightElevation = 50.0f;
+float gLightAzimuth   = 30.0f;
 
-// the rotation angles around the local X and Y axis
-float gLightXAngle = -1.0f;
-float gLightYAngle = -2.0f;
+// cascades split the camera frustum up to gShadowDistance, gCascadeLambda blends uniform and logarithmic splits
+int   gNumCascades    = 4;
+float gCascadeLambda  = 0.75f;
+float gShadowDistance = 100.0f;
+bool  gShowCascades   = false;
+
+// static casters are rendered into a separate atlas which is reused until a cascade moves or a caster inside it changes
+bool gCacheShadows = true;
 
 bool gRotateModel = true;
 
+// offset of a static caster of the Bistro, moving it invalidates the cached cascades around it
+vec3 gCasterOffset = vec3(0.0f);
+
 struct PerFrameData
 {
 	mat4 view;
 	mat4 proj;
-	mat4 lightViewProj; // assume we have a single light
+	mat4 lightViewProj[kMaxShadowCascades];
+	vec4 cascadeSplits; // view-space distances at which the cascades end
 	vec4 cameraPos;
-	vec4 lightAngles; // stores cosines of the light's inner and outer angles: cos(inner), cos(outer)
-	vec4 lightPos;
+	vec4 lightDir; // points towards the sun
 };
 
 struct MouseState
@@ -50,47 +61,81 @@ struct MouseState
 	bool      pressedLeft = false;
 }             gMouseState;
 
-CameraPositionerFirstPerson gPositioner(vec3(0.0f, 6.0f, 11.0f), vec3(0.0f, 4.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+CameraPositionerFirstPerson gPositioner(vec3(-10.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
 Camera                      gCamera(gPositioner);
 
-int main()
+// the node of the shadow-casting shape closest to pos, the root is never returned as it moves everything
+int findCasterNode(const GLSceneData& sceneData, const vec3& pos)
 {
-	GLApp app;
+	int   node     = -1;
+	float minDist2 = std::numeric_limits<float>::max();
+	for (size_t i = 0; i != sceneData.mShapes.size(); i++)
+	{
+		const DrawData& shape = sceneData.mShapes[i];
+		if (shape.transformIndex == 0 || !(sceneData.mMaterials[shape.materialIndex].flags & sMaterialFlags_CastShadow))
+			continue;
+
+		const vec3  d     = sceneData.mShapeBoxes[i].getCenter() - pos;
+		const float dist2 = glm::dot(d, d);
+		if (dist2 < minDist2)
+		{
+			minDist2 = dist2;
+			node     = (int)shape.transformIndex;
+		}
+	}
+	return node;
+}
 
-	// shader program that renders the grid
-	GLShader  shdGridVertex("data/shaders/11DebugGrid/grid.vert");
-	GLShader  shdGridFragment("data/shaders/11DebugGrid/grid.frag");
-	GLProgram progGrid(shdGridVertex, shdGridFragment);
+int main(int argc, char** argv)
+{
+	GLApp app(argc, argv);
 
-	// shader program that renders the scene
+	// shader program that renders the model
 	GLShader  shdModelVert("data/shaders/16ShadowMapping/scene.vert");
 	GLShader  shdModelFrag("data/shaders/16ShadowMapping/scene.frag");
 	GLProgram progModel(shdModelVert, shdModelFrag);
 
-	// shader program that renders the shadow
+	// shader program that renders the Bistro
+	GLShader  shdBistroVert("data/shaders/16ShadowMapping/bistro.vert");
+	GLShader  shdBistroFrag("data/shaders/16ShadowMapping/bistro.frag");
+	GLProgram progBistro(shdBistroVert, shdBistroFrag);
+
+	// shader programs that render the shadow casters of the model and of the Bistro
 	GLShader  shdShadowVert("data/shaders/16ShadowMapping/shadow.vert");
+	GLShader  shdShadowSceneVert("data/shaders/16ShadowMapping/shadowScene.vert");
 	GLShader  shdShadowFrag("data/shaders/16ShadowMapping/shadow.frag");
 	GLProgram progShadowMap(shdShadowVert, shdShadowFrag);
+	GLProgram progShadowMapScene(shdShadowSceneVert, shdShadowFrag);
+
+	// the static Bistro exterior
+	GLSceneData sceneData("data/meshes/bistro_exterior.meshes", "data/meshes/bistro_exterior.scene", "data/meshes/bistro_exterior.materials");
+	GLMesh      mesh(sceneData);
+
+	const BoundingBox sceneBounds = combineBoxes(sceneData.mShapeBoxes);
 
-	// create meshes in the scene
-	GLMeshPVP jet("data/rubber_duck/scene.gltf");
-	//? note we have two base color textures, does it mean that we have two meshes in this model? 
-	GLTexture texAlbedoJet(GL_TEXTURE_2D, "data/rubber_duck/textures/Duck_baseColor.png");
+	// a rotating model
+	GLMeshPVP model("data/rubber_duck/scene.gltf");
+	GLTexture texAlbedoModel(GL_TEXTURE_2D, "data/rubber_duck/textures/Duck_baseColor.png");
 
-	const std::vector<uint32_t>   indices  = {0, 1, 2, 2, 3, 0};
-	const std::vector<VertexData> vertices = {
-		{vec3(-2, -2, 0), vec3(0, 0, 1), vec2(0, 0)},
-		{vec3(-2, +2, 0), vec3(0, 0, 1), vec2(0, 1)},
-		{vec3(+2, +2, 0), vec3(0, 0, 1), vec2(1, 1)},
-		{vec3(+2, -2, 0), vec3(0, 0, 1), vec2(1, 0)},
-	};
-	GLMeshPVP plane(indices, vertices.data(), uint32_t(sizeof(VertexData) * vertices.size()));
-	GLTexture texAlbedoPlane(GL_TEXTURE_2D, "data/ch2_sample3_STB.jpg");
+	// create shadow map atlas (technically you won't need a color buffer, but we provide one for visualization purposes)
+	GLFramebuffer shadowMap(2 * SHADOW_MAP_SIZE, 2 * SHADOW_MAP_SIZE, GL_RGBA8, GL_DEPTH_COMPONENT24);
+	// static casters only, copied into the shadow map every frame before the dynamic casters are drawn on top
+	GLFramebuffer staticShadowMap(2 * SHADOW_MAP_SIZE, 2 * SHADOW_MAP_SIZE, GL_RGBA8, GL_DEPTH_COMPONENT24);
 
-	const std::vector<GLMeshPVP*> meshesToDraw = {&jet, &plane};
+	// the light transformation every cascade of the static atlas was rendered with
+	struct CachedCascade
+	{
+		mat4 viewProj = mat4(0.0f);
+		bool valid    = false;
+	} cachedCascades[kMaxShadowCascades];
+
+	// bounds of the static shapes which have moved this frame, before and after the move
+	std::vector<BoundingBox> dirtyBoxes;
 
-	// create shadow map (technically you won't need a color buffer, but we provide one for visualization purposes)
-	GLFramebuffer shadowMap(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, GL_RGBA8, GL_DEPTH_COMPONENT24);
+	// the caster moved by the UI and its translation before it was moved
+	const int  casterNode        = findCasterNode(sceneData, gPositioner.getPosition());
+	const vec3 casterTranslation = casterNode >= 0 ? sceneData.mScene.localTransform[casterNode].translation : vec3(0.0f);
+	vec3       casterOffset      = vec3(0.0f);
 
 	// create canvas and imgui renderer
 	GLImGui  rendererUI;
@@ -109,61 +154,73 @@ int main()
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// set a callback for key events
-	glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
-	{
-		const bool pressed = action != GLFW_RELEASE;
-		if (key == GLFW_KEY_ESCAPE && pressed)
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
-		if (key == GLFW_KEY_W)
-			gPositioner.mMovement.forward = pressed;
-		if (key == GLFW_KEY_S)
-			gPositioner.mMovement.backward = pressed;
-		if (key == GLFW_KEY_A)
-			gPositioner.mMovement.left = pressed;
-		if (key == GLFW_KEY_D)
-			gPositioner.mMovement.right = pressed;
-		if (key == GLFW_KEY_1)
-			gPositioner.mMovement.up = pressed;
-		if (key == GLFW_KEY_2)
-			gPositioner.mMovement.down = pressed;
-		if (mods & GLFW_MOD_SHIFT)
-			gPositioner.mMovement.fastSpeed = pressed;
-		else
-			gPositioner.mMovement.fastSpeed = false;
-		if (key == GLFW_KEY_SPACE)
-			gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
-	});
-
-	glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
-	{
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-		gMouseState.pos.x       = static_cast<float>(x / width);
-		gMouseState.pos.y       = static_cast<float>(y / height);
-		ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
-	});
-
-	glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+	// there is no window to receive input from in headless mode
+	if (!app.isHeadless())
 	{
-		auto&     io      = ImGui::GetIO();
-		const int idx     = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
-		io.MouseDown[idx] = action == GLFW_PRESS;
-
-		if (!io.WantCaptureMouse)
-			if (button == GLFW_MOUSE_BUTTON_LEFT)
-				gMouseState.pressedLeft = action == GLFW_PRESS;
-	});
+		// set a callback for key events
+		glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			const bool pressed = action != GLFW_RELEASE;
+			if (key == GLFW_KEY_ESCAPE && pressed)
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			if (key == GLFW_KEY_W)
+				gPositioner.mMovement.forward = pressed;
+			if (key == GLFW_KEY_S)
+				gPositioner.mMovement.backward = pressed;
+			if (key == GLFW_KEY_A)
+				gPositioner.mMovement.left = pressed;
+			if (key == GLFW_KEY_D)
+				gPositioner.mMovement.right = pressed;
+			if (key == GLFW_KEY_1)
+				gPositioner.mMovement.up = pressed;
+			if (key == GLFW_KEY_2)
+				gPositioner.mMovement.down = pressed;
+			if (mods & GLFW_MOD_SHIFT)
+				gPositioner.mMovement.fastSpeed = pressed;
+			else
+				gPositioner.mMovement.fastSpeed = false;
+			if (key == GLFW_KEY_SPACE)
+				gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
+		});
+
+		glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			gMouseState.pos.x       = static_cast<float>(x / width);
+			gMouseState.pos.y       = static_cast<float>(y / height);
+			ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
+		});
+
+		glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+		{
+			auto&     io      = ImGui::GetIO();
+			const int idx     = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
+			io.MouseDown[idx] = action == GLFW_PRESS;
+
+			if (!io.WantCaptureMouse)
+				if (button == GLFW_MOUSE_BUTTON_LEFT)
+					gMouseState.pressedLeft = action == GLFW_PRESS;
+		});
+	}
 
 	gPositioner.mMaxSpeed = 5.0f;
 	float angle           = 0.0f;
 
-	while (!glfwWindowShouldClose(app.getWindow()))
+	GLProfiler profiler;
+
+	// --benchmark replaces the mouse-driven camera with a camera path
+	GLBenchmark* benchmark = app.getBenchmark();
+	const Camera camera    = benchmark ? Camera(benchmark->getPositioner()) : gCamera;
+
+	while (!app.shouldClose())
 	{
+		profiler.beginFrame();
+
 		gPositioner.update(app.getDeltaSeconds(), gMouseState.pos, gMouseState.pressedLeft);
 
 		int width, height;
-		glfwGetFramebufferSize(app.getWindow(), &width, &height);
+		app.getFramebufferSize(width, height);
 		const float ratio = width / (float)height;
 
 		if (gRotateModel)
@@ -171,100 +228,233 @@ int main()
 			angle += app.getDeltaSeconds();
 		}
 
-		// Render shadow map
+		// the model is the only dynamic object
+		const mat4 scale = glm::scale(mat4(1.0f), vec3(3.0f));
+		const mat4 rot   = rotate(mat4(1.0f), glm::radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+		const mat4 pos   = translate(mat4(1.0f), vec3(0.0f, 0.0f, +1.0f));
+		const mat4 m     = rotate(scale * rot * pos, angle, vec3(0.0f, 0.0f, 1.0f));
+		glNamedBufferSubData(modelMatrices.getHandle(), 0, sizeof(mat4), value_ptr(m));
+
+		const float elevation = glm::radians(gLightElevation);
+		const float azimuth   = glm::radians(gLightAzimuth);
+		const vec3  lightDir  = vec3(cosf(elevation) * cosf(azimuth), sinf(elevation), cosf(elevation) * sinf(azimuth));
+
+		if (casterNode >= 0 && casterOffset != gCasterOffset)
+		{
+			casterOffset                                            = gCasterOffset;
+			sceneData.mScene.localTransform[casterNode].translation = casterTranslation + casterOffset;
+			markAsChanged(sceneData.mScene, casterNode);
+		}
+
+		// nodes moved with markAsChanged() invalidate the cascades they were and are in
+		dirtyBoxes.clear();
+		if (sceneData.updateTransforms(&dirtyBoxes))
+			mesh.updateMovedShapes(sceneData);
+
+		// fit the cascades around slices of the camera frustum
+		const float zNear = 0.5f;
+		const float zFar  = 5000.0f;
+		const float fovY  = glm::radians(45.0f);
+		const mat4  view  = camera.getViewMatrix();
+
+		float splits[kMaxShadowCascades];
+		getCascadeSplits(zNear, std::min(gShadowDistance, zFar), gNumCascades, gCascadeLambda, splits);
+
+		// cached cascades have to stay put while the camera turns, tight ones are sharper but change every frame
+		ShadowCascade cascades[kMaxShadowCascades];
+		for (int i = 0; i != gNumCascades; i++)
+			cascades[i] = gCacheShadows
+				              ? fitStableShadowCascade(view, fovY, ratio, i ? splits[i - 1] : zNear, splits[i], lightDir, SHADOW_MAP_SIZE, sceneBounds)
+				              : fitShadowCascade(view, fovY, ratio, i ? splits[i - 1] : zNear, splits[i], lightDir, SHADOW_MAP_SIZE, sceneBounds);
+
+		// Render shadow maps
 		glEnable(GL_DEPTH_TEST);
 		glDisable(GL_BLEND);
 
-		// Calculate light parameters (which we can control via IMGUI)
-		const mat4 rotY      = rotate(mat4(1.f), gLightYAngle, vec3(0, 1, 0));
-		const mat4 rotX      = rotate(rotY, gLightXAngle, vec3(1, 0, 0));
-		const vec4 lightPos  = rotX * vec4(0, 0, gLightDist, 1.0f);
-		const mat4 lightProj = glm::perspective(glm::radians(gLightAngle), 1.0f, gLightNear, gLightFar);
-		const mat4 lightView = lookAt(vec3(lightPos), vec3(0), vec3(0, 1, 0));
+		static const char* const kCascadeNames[kMaxShadowCascades] = {"Cascade 0", "Cascade 1", "Cascade 2", "Cascade 3"};
+
+		int numStaticCascadesRendered = 0;
 
 		{
-			const PerFrameData perFrameData = {
-				// notice that some fields are uninitialized b/c we won't use them in the shadow pass
-				.view = lightView,
-				.proj = lightProj,
-				.cameraPos = vec4(gCamera.getPosition(), 1.0f)
-			};
-			glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
+			GLProfilerScope scope(profiler, "Shadow map");
+
+			// bring the static casters up to date
+			if (gCacheShadows)
+			{
+				GLProfilerScope staticScope(profiler, "Static casters");
+
+				staticShadowMap.bind();
+				glEnable(GL_SCISSOR_TEST);
+				for (int i = 0; i != gNumCascades; i++)
+				{
+					CachedCascade& cached   = cachedCascades[i];
+					const mat4     viewProj = cascades[i].proj * cascades[i].view;
+
+					// a cascade is only redrawn if the sun or the cascade has moved, or if a caster inside it has
+					bool valid = cached.valid && cached.viewProj == viewProj;
+					if (valid && !dirtyBoxes.empty())
+					{
+						glm::vec4 frustumPlanes[6];
+						glm::vec4 frustumCorners[8];
+						getFrustumPlanes(viewProj, frustumPlanes);
+						getFrustumCorners(viewProj, frustumCorners);
+						for (const BoundingBox& box : dirtyBoxes)
+							valid = valid && !isBoxInFrustum(frustumPlanes, frustumCorners, box);
+					}
+
+					if (valid)
+						continue;
+
+					GLProfilerScope cascadeScope(profiler, kCascadeNames[i]);
+
+					// the clears only touch the quadrant of the cascade
+					glViewport((i & 1) * SHADOW_MAP_SIZE, (i >> 1) * SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+					glScissor((i & 1) * SHADOW_MAP_SIZE, (i >> 1) * SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+					glClearNamedFramebufferfv(staticShadowMap.getHandle(), GL_COLOR, 0, value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+					glClearNamedFramebufferfi(staticShadowMap.getHandle(), GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+					const PerFrameData perFrameData = {.view = cascades[i].view, .proj = cascades[i].proj};
+					glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
+
+					progShadowMapScene.useProgram();
+					const uint32_t numCulled = mesh.drawCulled(sceneData, viewProj, sMaterialFlags_CastShadow);
+
+					if (benchmark)
+						benchmark->addDrawStats(mesh.getNumDrawCommands() - numCulled, 0, numCulled);
+
+					cached.viewProj = viewProj;
+					cached.valid    = true;
+					numStaticCascadesRendered++;
+				}
+				glDisable(GL_SCISSOR_TEST);
+				staticShadowMap.unbind();
+
+				// the static casters replace the clear of the shadow map
+				glBlitNamedFramebuffer(staticShadowMap.getHandle(), shadowMap.getHandle(),
+				                       0, 0, 2 * SHADOW_MAP_SIZE, 2 * SHADOW_MAP_SIZE,
+				                       0, 0, 2 * SHADOW_MAP_SIZE, 2 * SHADOW_MAP_SIZE,
+				                       GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			}
+			else
+			{
+				for (CachedCascade& cached : cachedCascades)
+					cached.valid = false;
+
+				// before rendering, clear the color and depth buffers of the shadow-map frame buffer
+				glClearNamedFramebufferfv(shadowMap.getHandle(), GL_COLOR, 0, value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+				glClearNamedFramebufferfi(shadowMap.getHandle(), GL_DEPTH_STENCIL, 0, 1.0f, 0);
+			}
+
 			shadowMap.bind();
-			// before rendering, clear the color and depth buffers of the shadow-map frame buffer
-			glClearNamedFramebufferfv(shadowMap.getHandle(), GL_COLOR, 0, value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-			glClearNamedFramebufferfi(shadowMap.getHandle(), GL_DEPTH_STENCIL, 0, 1.0f, 0);
-			progShadowMap.useProgram();
-			for (const auto& m : meshesToDraw)
-				m->drawElements();
+
+			for (int i = 0; i != gNumCascades; i++)
+			{
+				GLProfilerScope cascadeScope(profiler, kCascadeNames[i]);
+
+				// notice that some fields are uninitialized b/c we won't use them in the shadow pass
+				const PerFrameData perFrameData = {.view = cascades[i].view, .proj = cascades[i].proj};
+				glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
+				glViewport((i & 1) * SHADOW_MAP_SIZE, (i >> 1) * SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+
+				// only the casters inside the cascade are drawn
+				if (!gCacheShadows)
+				{
+					progShadowMapScene.useProgram();
+					const uint32_t numCulled = mesh.drawCulled(sceneData, cascades[i].proj * cascades[i].view, sMaterialFlags_CastShadow);
+
+					if (benchmark)
+						benchmark->addDrawStats(mesh.getNumDrawCommands() - numCulled, 0, numCulled);
+				}
+
+				// dynamic casters go on top of the static ones every frame
+				progShadowMap.useProgram();
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, modelMatrices.getHandle());
+				model.drawElements();
+
+				if (benchmark)
+					benchmark->addDrawStats(1, model.mNumIndices / 3);
+			}
 			shadowMap.unbind();
 		}
 
 		// Render scene
+		profiler.beginScope("Scene");
 		glViewport(0, 0, width, height); // restore OpenGL viewport
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		const mat4         proj         = glm::perspective(45.0f, ratio, 0.5f, 5000.0f);
-		const mat4         view         = gCamera.getViewMatrix();
-		const PerFrameData perFrameData = {
+		const mat4   proj         = glm::perspective(fovY, ratio, zNear, zFar);
+		PerFrameData perFrameData = {
 			.view = view,
 			.proj = proj,
-			.lightViewProj = lightProj * lightView,
-			.cameraPos = vec4(gCamera.getPosition(), 1.0f),
-			.lightAngles = vec4(cosf(glm::radians(0.5f * gLightAngle)),
-			                    cosf(glm::radians(0.5f * (gLightAngle - gLightInnerAngle))),
-			                    1.0f,
-			                    1.0f),
-			.lightPos = lightPos
+			.cameraPos = vec4(camera.getPosition(), 1.0f),
+			.lightDir = vec4(lightDir, 0.0f)
 		};
+		for (int i = 0; i != kMaxShadowCascades; i++)
+		{
+			// unused cascades repeat the last one, so the shader never selects them
+			const ShadowCascade& c        = cascades[std::min(i, gNumCascades - 1)];
+			perFrameData.lightViewProj[i] = c.proj * c.view;
+			perFrameData.cascadeSplits[i] = c.splitFar;
+		}
 		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
 
-		// Position the mesh+plane to where we want
-		const mat4 scale = glm::scale(mat4(1.0f), vec3(3.0f));
-		const mat4 rot   = rotate(mat4(1.0f), glm::radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
-		const mat4 pos   = translate(mat4(1.0f), vec3(0.0f, 0.0f, +1.0f));
-		const mat4 m     = rotate(scale * rot * pos, angle, vec3(0.0f, 0.0f, 1.0f));
-		glNamedBufferSubData(modelMatrices.getHandle(), 0, sizeof(mat4), value_ptr(m));
-
-		const GLuint textures[] = {texAlbedoJet.getHandle(), texAlbedoPlane.getHandle()};
 		glBindTextureUnit(1, shadowMap.getTextureDepth().getHandle()); // shadow map always at location = 1
+
+		progBistro.useProgram();
+		mesh.draw(sceneData);
+
 		progModel.useProgram();
-		for (size_t i = 0; i != meshesToDraw.size(); i++)
-		{
-			glBindTextureUnit(0, textures[i]); // different meshes have different albedo textures (at location = 0)
-			meshesToDraw[i]->drawElements();
-		}
+		glBindTextureUnit(0, texAlbedoModel.getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, modelMatrices.getHandle());
+		model.drawElements();
 
-		glEnable(GL_BLEND);
-		progGrid.useProgram();
-		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);
+		if (benchmark)
+			benchmark->addDrawStats(mesh.getNumDrawCommands() + 1, mesh.getNumTriangles() + model.mNumIndices / 3);
 
-		// render a debug light frustum
-		renderCameraFrustumGL(canvas, lightView, lightProj, vec4(0.0f, 1.0f, 0.0f, 1.0f));
-		canvas.flush();
+		profiler.endScope();
+
+		// render debug cascade frusta
+		if (gShowCascades)
+		{
+			const vec4 colors[kMaxShadowCascades] = {vec4(1, 0, 0, 1), vec4(0, 1, 0, 1), vec4(0, 0, 1, 1), vec4(1, 1, 0, 1)};
+			for (int i = 0; i != gNumCascades; i++)
+				renderCameraFrustumGL(canvas, cascades[i].view, cascades[i].proj, colors[i]);
+			canvas.flush();
+		}
 
 		// render IMGUI
+		profiler.beginScope("ImGui");
 		ImGuiIO& io    = ImGui::GetIO();
 		io.DisplaySize = ImVec2((float)width, (float)height);
 		ImGui::NewFrame();
 
 		ImGui::Begin("Control", nullptr);
 		ImGui::Checkbox("Rotate model", &gRotateModel);
-		ImGui::Text("Light parameters", nullptr);
-		ImGui::SliderFloat("Proj::Light angle", &gLightAngle, 15.0f, 170.0f);
-		ImGui::SliderFloat("Proj::Light inner angle", &gLightInnerAngle, 1.0f, 15.0f);
-		ImGui::SliderFloat("Proj::Near", &gLightNear, 0.1f, 5.0f);
-		ImGui::SliderFloat("Proj::Far", &gLightFar, 0.1f, 100.0f);
-		ImGui::SliderFloat("Pos::Dist", &gLightDist, 0.5f, 100.0f);
-		ImGui::SliderFloat("Pos::AngleX", &gLightXAngle, -3.15f, +3.15f);
-		ImGui::SliderFloat("Pos::AngleY", &gLightYAngle, -3.15f, +3.15f);
+		ImGui::Text("Sun", nullptr);
+		ImGui::SliderFloat("Elevation", &gLightElevation, 5.0f, 90.0f);
+		ImGui::SliderFloat("Azimuth", &gLightAzimuth, -180.0f, 180.0f);
+		ImGui::Text("Cascades", nullptr);
+		ImGui::SliderInt("Count", &gNumCascades, 3, kMaxShadowCascades);
+		ImGui::SliderFloat("Split lambda", &gCascadeLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Shadow distance", &gShadowDistance, 10.0f, 500.0f);
+		ImGui::Checkbox("Show cascades", &gShowCascades);
+		ImGui::Checkbox("Cache static casters", &gCacheShadows);
+		ImGui::Text("Static cascades rendered: %d", numStaticCascadesRendered);
+		if (casterNode >= 0)
+		{
+			ImGui::DragFloat3("Move caster", value_ptr(gCasterOffset), 0.05f);
+			ImGui::Text("Dirty boxes: %d", (int)dirtyBoxes.size());
+		}
 		ImGui::End();
 
 		imguiTextureWindowGL("Color", shadowMap.getTextureColor().getHandle());
 		imguiTextureWindowGL("Depth", shadowMap.getTextureDepth().getHandle());
+		profiler.renderUI();
 
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
+		profiler.endScope();
 
+		profiler.endFrame();
 		app.swapBuffers();
 	}
 
@@ -1,13 +1,19 @@
 #include <glm/glm.hpp>
 
+#include <algorithm>
+
 #include "OpenGL/GLApp.h"
+#include "OpenGL/GLBenchmark.h"
 #include "OpenGL/GLBuffer.h"
 #include "OpenGL/GLCanvas.h"
 #include "OpenGL/GLFramebuffer.h"
 #include "OpenGL/GLImGui.h"
+#include "OpenGL/GLMaterialPermutations.h"
 #include "OpenGL/GLMesh.h"
 #include "OpenGL/GLMeshPVP.h"
+#include "OpenGL/GLProfiler.h"
 #include "OpenGL/GLProgram.h"
+#include "OpenGL/GLRenderGraph.h"
 #include "OpenGL/GLSceneData.h"
 #include "OpenGL/GLShader.h"
 #include "Util/Camera.h"
@@ -37,6 +43,10 @@ struct SSAOParams
 	float radius    = 0.2f;
 	float attScale  = 1.0f;
 	float distScale = 0.5f;
+	// filled in every frame, level of the depth pyramid the SSAO is computed from
+	float depthLod = 0.0f;
+	// relative depth difference beyond which the blur and the upsampling do not mix occlusion
+	float depthThreshold = 0.1f;
 }         gSSAOParams;
 
 // we reuse a single uniform buffer for both per-frame data and SSAO parameters,
@@ -52,22 +62,30 @@ struct MouseState
 CameraPositionerFirstPerson gPositioner(vec3(-10.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
 Camera                      gCamera(gPositioner);
 
+// R starts and stops recording the camera, the path can be replayed with --benchmark=data/paths/recorded.campath
+CameraPathRecorder gRecorder(gPositioner);
+
 bool gEnableSSAO = true;
 bool gEnableBlur = true;
 
-int main()
+// SSAO is computed at 1/2^gSSAOResolution of the framebuffer resolution: full, half or quarter. At reduced resolution
+// it reads a min/max depth pyramid, is blurred without crossing depth discontinuities and upsampled guided by depth
+int gSSAOResolution = 1;
+
+int main(int argc, char** argv)
 {
-	GLApp app;
+	GLApp app(argc, argv);
+	app.enableShaderHotReload();
+
+	const double startupTime = app.getTime();
 
 	// shader program that renders the grid
 	GLShader  shdGridVertex("data/shaders/11DebugGrid/grid.vert");
 	GLShader  shdGridFragment("data/shaders/11DebugGrid/grid.frag");
 	GLProgram progGrid(shdGridVertex, shdGridFragment);
 
-	// shader program that renders the scene
-	GLShader  shaderVertex("data/shaders/15LargeScene/largeScene.vert");
-	GLShader  shaderFragment("data/shaders/15LargeScene/largeScene.frag");
-	GLProgram program(shaderVertex, shaderFragment);
+	// shader programs that render the scene, specialized for each material permutation
+	GLMaterialPermutations permutations("data/shaders/15LargeScene/largeScene.vert", "data/shaders/15LargeScene/largeScene.frag");
 
 	// full screen vertex shader will be shared with multiple shader programs
 	GLShader shdFullScreenQuadVert("data/shaders/fullScreenQuadOpt.vert");
@@ -84,6 +102,28 @@ int main()
 	GLShader  shdBlurYFrag("data/shaders/17SSAO/BlurY.frag");
 	GLProgram progBlurY(shdFullScreenQuadVert, shdBlurYFrag);
 
+	// reduced resolution pipeline
+	GLShader  shdDepthMinMaxFirstComp("data/shaders/17SSAO/depthMinMax.comp", {"FROM_DEPTH_BUFFER"});
+	GLProgram progDepthMinMaxFirst(shdDepthMinMaxFirstComp);
+
+	GLShader  shdDepthMinMaxComp("data/shaders/17SSAO/depthMinMax.comp");
+	GLProgram progDepthMinMax(shdDepthMinMaxComp);
+
+	GLShader  shdSSAOLowResFrag("data/shaders/17SSAO/SSAO.frag", {"LINEAR_DEPTH"});
+	GLProgram progSSAOLowRes(shdFullScreenQuadVert, shdSSAOLowResFrag);
+
+	GLShader  shdCombineUpsampleSSAOFrag("data/shaders/17SSAO/SSAO_combine.frag", {"UPSAMPLE"});
+	GLProgram progCombineUpsampleSSAO(shdFullScreenQuadVert, shdCombineUpsampleSSAOFrag);
+
+	GLShader  shdBlurBilateralXFrag("data/shaders/17SSAO/BlurBilateralX.frag");
+	GLProgram progBlurBilateralX(shdFullScreenQuadVert, shdBlurBilateralXFrag);
+
+	GLShader  shdBlurBilateralYFrag("data/shaders/17SSAO/BlurBilateralY.frag");
+	GLProgram progBlurBilateralY(shdFullScreenQuadVert, shdBlurBilateralYFrag);
+
+	GLShader  shdCopyFrag("data/shaders/17SSAO/copy.frag");
+	GLProgram progCopy(shdFullScreenQuadVert, shdCopyFrag);
+
 	const GLsizeiptr perFrameDataBufferSize = sizeof(PerFrameData);
 	GLBuffer         perFrameDataBuffer(perFrameDataBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
 	glBindBufferRange(GL_UNIFORM_BUFFER, kBufferIndex_PerFrameUniforms, perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize);
@@ -94,146 +134,272 @@ int main()
 
 	GLTexture rotationPattern(GL_TEXTURE_2D, "data/rot_texture.bmp");
 
-	GLSceneData sceneData1("data/meshes/bistro_exterior.meshes", "data/meshes/bistro_exterior.scene", "data/meshes/bistro_exterior.materials");
-	GLSceneData sceneData2("data/meshes/bistro_interior.meshes", "data/meshes/bistro_interior.scene", "data/meshes/bistro_interior.materials");
+	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
 
-	GLMesh mesh1(sceneData1);
-	GLMesh mesh2(sceneData2);
+	GLMesh mesh(sceneData);
 
-	// set a callback for key events
-	glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
+	// there is no window to receive input from in headless mode
+	if (!app.isHeadless())
 	{
-		const bool pressed = action != GLFW_RELEASE;
-		if (key == GLFW_KEY_ESCAPE && pressed)
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
-		if (key == GLFW_KEY_W)
-			gPositioner.mMovement.forward = pressed;
-		if (key == GLFW_KEY_S)
-			gPositioner.mMovement.backward = pressed;
-		if (key == GLFW_KEY_A)
-			gPositioner.mMovement.left = pressed;
-		if (key == GLFW_KEY_D)
-			gPositioner.mMovement.right = pressed;
-		if (key == GLFW_KEY_1)
-			gPositioner.mMovement.up = pressed;
-		if (key == GLFW_KEY_2)
-			gPositioner.mMovement.down = pressed;
-		if (mods & GLFW_MOD_SHIFT)
-			gPositioner.mMovement.fastSpeed = pressed;
-		else
-			gPositioner.mMovement.fastSpeed = false;
-		if (key == GLFW_KEY_SPACE)
-			gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
-	});
-
-	glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
-	{
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-		gMouseState.pos.x       = static_cast<float>(x / width);
-		gMouseState.pos.y       = static_cast<float>(y / height);
-		ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
-	});
+		// set a callback for key events
+		glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			const bool pressed = action != GLFW_RELEASE;
+			if (key == GLFW_KEY_ESCAPE && pressed)
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			if (key == GLFW_KEY_W)
+				gPositioner.mMovement.forward = pressed;
+			if (key == GLFW_KEY_S)
+				gPositioner.mMovement.backward = pressed;
+			if (key == GLFW_KEY_A)
+				gPositioner.mMovement.left = pressed;
+			if (key == GLFW_KEY_D)
+				gPositioner.mMovement.right = pressed;
+			if (key == GLFW_KEY_1)
+				gPositioner.mMovement.up = pressed;
+			if (key == GLFW_KEY_2)
+				gPositioner.mMovement.down = pressed;
+			if (mods & GLFW_MOD_SHIFT)
+				gPositioner.mMovement.fastSpeed = pressed;
+			else
+				gPositioner.mMovement.fastSpeed = false;
+			if (key == GLFW_KEY_SPACE)
+				gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
+			if (key == GLFW_KEY_R && action == GLFW_PRESS)
+			{
+				if (!gRecorder.isRecording())
+				{
+					gRecorder.start();
+					printf("Recording the camera path...\n");
+				}
+				else
+				{
+					gRecorder.stop();
+					if (gRecorder.getPath().save("data/paths/recorded.campath"))
+						printf("Saved %u keyframes to data/paths/recorded.campath\n", (uint32_t)gRecorder.getPath().getKeyframes().size());
+				}
+			}
+		});
+
+		glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			gMouseState.pos.x       = static_cast<float>(x / width);
+			gMouseState.pos.y       = static_cast<float>(y / height);
+			ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
+		});
+
+		glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+		{
+			auto&     io      = ImGui::GetIO();
+			const int idx     = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
+			io.MouseDown[idx] = action == GLFW_PRESS;
+
+			if (!io.WantCaptureMouse)
+				if (button == GLFW_MOUSE_BUTTON_LEFT)
+					gMouseState.pressedLeft = action == GLFW_PRESS;
+		});
+	}
 
-	glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
-	{
-		auto&     io      = ImGui::GetIO();
-		const int idx     = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
-		io.MouseDown[idx] = action == GLFW_PRESS;
+	gPositioner.mMaxSpeed = 1.0f;
 
-		if (!io.WantCaptureMouse)
-			if (button == GLFW_MOUSE_BUTTON_LEFT)
-				gMouseState.pressedLeft = action == GLFW_PRESS;
-	});
+	// all render targets are transient textures of the render graph, rebuilt every frame
+	GLRenderGraph graph;
 
-	gPositioner.mMaxSpeed = 1.0f;
+	GLImGui rendererUI;
 
-	// offscreen render targets
-	int width, height;
-	glfwGetFramebufferSize(app.getWindow(), &width, &height);
-	GLFramebuffer framebuffer(width, height, GL_RGBA8, GL_DEPTH_COMPONENT24); // our scene will be rendered to this frame buffer
+	GLProfiler profiler;
 
-	// ssao and blur frame buffers will be used in a ping-pong fashion to do a multipass gaussian blur
-	GLFramebuffer ssao(1024, 1024, GL_RGBA8, 0); // SSAO effect goes into a 1024x1024 buffer and no depth buffer
-	GLFramebuffer blur(1024, 1024, GL_RGBA8, 0); // blur is the same as SSAO effects
+	const GLProgramCacheStats& cacheStats = GLProgram::getCacheStats();
+	printf("Startup took %.2f s (program cache %s: %u hits, %u misses, %.2f s creating programs)\n",
+	       app.getTime() - startupTime, GLProgram::isBinaryCacheEnabled() ? "on" : "off", cacheStats.hits, cacheStats.misses, cacheStats.seconds);
 
-	GLImGui rendererUI;
+	// --benchmark replaces the mouse-driven camera with a camera path
+	GLBenchmark* benchmark = app.getBenchmark();
+	const Camera camera    = benchmark ? Camera(benchmark->getPositioner()) : gCamera;
 
-	while (!glfwWindowShouldClose(app.getWindow()))
+	while (!app.shouldClose())
 	{
+		profiler.beginFrame();
+
 		gPositioner.update(app.getDeltaSeconds(), gMouseState.pos, gMouseState.pressedLeft);
+		gRecorder.update(app.getDeltaSeconds());
 
 		int width, height;
-		glfwGetFramebufferSize(app.getWindow(), &width, &height);
+		app.getFramebufferSize(width, height);
 		const float ratio = width / (float)height;
 
-		// clear the frame buffer 
-		glClearNamedFramebufferfv(framebuffer.getHandle(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-		glClearNamedFramebufferfi(framebuffer.getHandle(), GL_DEPTH_STENCIL, 0, 1.0f, 0);
-
 		// update view and projection matrix
 		const mat4         p            = glm::perspective(45.0f, ratio, gSSAOParams.zNear, gSSAOParams.zFar);
-		const mat4         view         = gCamera.getViewMatrix();
-		const PerFrameData perFrameData = {.view = view, .proj = p, .cameraPos = glm::vec4(gCamera.getPosition(), 1.0f)};
-		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
+		const mat4         view         = camera.getViewMatrix();
+		const PerFrameData perFrameData = {.view = view, .proj = p, .cameraPos = glm::vec4(camera.getPosition(), 1.0f)};
+
+		// SSAO is computed at the resolution of a level of the linear depth pyramid: level 0 is half and level 1 is
+		// quarter resolution, every texel holds the min and max depth of its footprint
+		const bool lowRes             = gSSAOResolution > 0;
+		const int  depthPyramidWidth  = (width + 1) / 2;
+		const int  depthPyramidHeight = (height + 1) / 2;
+		const int  ssaoWidth          = lowRes ? std::max(depthPyramidWidth >> (gSSAOResolution - 1), 1) : width;
+		const int  ssaoHeight         = lowRes ? std::max(depthPyramidHeight >> (gSSAOResolution - 1), 1) : height;
+		gSSAOParams.depthLod          = lowRes ? (float)(gSSAOResolution - 1) : 0.0f;
+
+		graph.reset(width, height);
+
+		using Resource                = GLRenderGraph::Resource;
+		const Resource sceneColor     = graph.createTexture("Scene color", {.width = width, .height = height, .format = GL_RGBA8});
+		const Resource sceneDepth     = graph.createTexture("Scene depth", {.width = width, .height = height, .format = GL_DEPTH_COMPONENT24});
+		const Resource depthPyramid   = graph.createTexture("Depth pyramid", {.width = depthPyramidWidth, .height = depthPyramidHeight, .format = GL_RG32F, .levels = 2});
+		// the raw and the blurred SSAO do not live at the same time and share a texture, as the ping-pong buffers did
+		const Resource ssaoRaw        = graph.createTexture("SSAO", {.width = ssaoWidth, .height = ssaoHeight, .format = GL_RGBA8});
+		const Resource ssaoBlurX      = graph.createTexture("SSAO blur X", {.width = ssaoWidth, .height = ssaoHeight, .format = GL_RGBA8});
+		const Resource ssaoBlurred    = graph.createTexture("SSAO blurred", {.width = ssaoWidth, .height = ssaoHeight, .format = GL_RGBA8});
+		const Resource ssao           = gEnableBlur ? ssaoBlurred : ssaoRaw;
 
 		// 1. Render scene
-		glDisable(GL_BLEND);
-		glEnable(GL_DEPTH_TEST);
-		framebuffer.bind();
-		// 1.1 Bistro
-		program.useProgram();
-		mesh1.draw(sceneData1);
-		mesh2.draw(sceneData2);
-		// 1.2 Grid
-		glEnable(GL_BLEND);
-		progGrid.useProgram();
-		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);
-		framebuffer.unbind();
-		glDisable(GL_DEPTH_TEST);
-
-		// 2. Calculate SSAO
-		glClearNamedFramebufferfv(ssao.getHandle(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, sizeof(gSSAOParams), &gSSAOParams);
-		ssao.bind();
-		progSSAO.useProgram();
-		glBindTextureUnit(0, framebuffer.getTextureDepth().getHandle()); // pass the depth texture of the main framebuffer into the SSAO shader (location = 0)
-		glBindTextureUnit(1, rotationPattern.getHandle());               // pass a special 2D texture with the rotation pattern into the SSAO shader (location = 1)
-		glDrawArrays(GL_TRIANGLES, 0, 3);                                //!? Note: for optimized full screen, count == 3
-		ssao.unbind();
-
-		// 2.1 Blur SSAO
-		if (gEnableBlur)
+		graph.addPass("Scene", [&](GLRenderGraph::PassBuilder& b)
 		{
-			// Blur X
-			blur.bind();
-			progBlurX.useProgram();
-			glBindTextureUnit(0, ssao.getTextureColor().getHandle());
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-			blur.unbind();
-			// Blur Y
-			ssao.bind();
-			progBlurY.useProgram();
-			glBindTextureUnit(0, blur.getTextureColor().getHandle());
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-			ssao.unbind();
+			b.writeColor(sceneColor);
+			b.writeDepth(sceneDepth);
+		}, [&](const GLRenderGraph::PassContext& ctx)
+		{
+			glClearNamedFramebufferfv(ctx.getFramebuffer(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+			glClearNamedFramebufferfi(ctx.getFramebuffer(), GL_DEPTH_STENCIL, 0, 1.0f, 0);
+			glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
+			glDisable(GL_BLEND);
+			glEnable(GL_DEPTH_TEST);
+			// 1.1 Bistro
+			mesh.draw(sceneData, permutations);
+			if (benchmark)
+				benchmark->addDrawStats(mesh.getNumDrawCommands(), mesh.getNumTriangles());
+			// 1.2 Grid
+			glEnable(GL_BLEND);
+			progGrid.useProgram();
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);
+			glDisable(GL_DEPTH_TEST);
+			// the passes after the scene share the buffer for the SSAO parameters
+			glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, sizeof(gSSAOParams), &gSSAOParams);
+		});
+
+		// 2. Build the depth pyramid down to the SSAO resolution
+		if (lowRes)
+		{
+			graph.addPass("Depth pyramid", [&](GLRenderGraph::PassBuilder& b)
+			{
+				b.read(sceneDepth);
+				b.writeImage(depthPyramid);
+			}, [&](const GLRenderGraph::PassContext& ctx)
+			{
+				const GLuint pyramid = ctx.getTexture(depthPyramid);
+				glTextureParameteri(pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+				glTextureParameteri(pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+				progDepthMinMaxFirst.useProgram();
+				glBindTextureUnit(0, ctx.getTexture(sceneDepth));
+				glBindImageTexture(0, pyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+				glDispatchCompute((depthPyramidWidth + 7) / 8, (depthPyramidHeight + 7) / 8, 1);
+
+				if (gSSAOResolution > 1)
+				{
+					// the graph only sees the pass, the levels inside it are synchronized here
+					glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+					progDepthMinMax.useProgram();
+					glBindTextureUnit(0, pyramid);
+					glBindImageTexture(0, pyramid, 1, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+					glDispatchCompute((depthPyramidWidth / 2 + 7) / 8, (depthPyramidHeight / 2 + 7) / 8, 1);
+				}
+			});
 		}
 
-		// 3. Combine SSAO and the rendered scene
-		glViewport(0, 0, width, height);
-		if (gEnableSSAO)
+		// 3. Calculate SSAO
+		graph.addPass("SSAO", [&](GLRenderGraph::PassBuilder& b)
 		{
-			progCombineSSAO.useProgram();
-			glBindTextureUnit(0, framebuffer.getTextureColor().getHandle());
-			glBindTextureUnit(1, ssao.getTextureColor().getHandle());
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-		}
-		else
+			b.read(lowRes ? depthPyramid : sceneDepth);
+			b.writeColor(ssaoRaw);
+		}, [&](const GLRenderGraph::PassContext& ctx)
 		{
-			// if SSAO is disabled, copy offscreen framebuffer right into the app's main window
-			glBlitNamedFramebuffer(framebuffer.getHandle(), 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glClearNamedFramebufferfv(ctx.getFramebuffer(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+			// the pyramid replaces the depth buffer at reduced resolution
+			(lowRes ? progSSAOLowRes : progSSAO).useProgram();
+			glBindTextureUnit(0, ctx.getTexture(lowRes ? depthPyramid : sceneDepth));
+			glBindTextureUnit(1, rotationPattern.getHandle()); // pass a special 2D texture with the rotation pattern into the SSAO shader (location = 1)
+			glDrawArrays(GL_TRIANGLES, 0, 3);                  //!? Note: for optimized full screen, count == 3
+		});
+
+		// 3.1 Blur SSAO
+		if (gEnableBlur)
+		{
+			graph.addPass("Blur X", [&](GLRenderGraph::PassBuilder& b)
+			{
+				b.read(ssaoRaw);
+				if (lowRes)
+					b.read(depthPyramid);
+				b.writeColor(ssaoBlurX);
+			}, [&](const GLRenderGraph::PassContext& ctx)
+			{
+				(lowRes ? progBlurBilateralX : progBlurX).useProgram();
+				glBindTextureUnit(0, ctx.getTexture(ssaoRaw));
+				if (lowRes)
+					glBindTextureUnit(1, ctx.getTexture(depthPyramid)); // only used by the bilateral blur
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			});
+
+			graph.addPass("Blur Y", [&](GLRenderGraph::PassBuilder& b)
+			{
+				b.read(ssaoBlurX);
+				if (lowRes)
+					b.read(depthPyramid);
+				b.writeColor(ssaoBlurred);
+			}, [&](const GLRenderGraph::PassContext& ctx)
+			{
+				(lowRes ? progBlurBilateralY : progBlurY).useProgram();
+				glBindTextureUnit(0, ctx.getTexture(ssaoBlurX));
+				if (lowRes)
+					glBindTextureUnit(1, ctx.getTexture(depthPyramid));
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			});
 		}
 
+		// 4. Combine SSAO and the rendered scene
+		// if SSAO is disabled, nothing reads it and the graph culls all SSAO passes
+		graph.addPass("Combine", [&](GLRenderGraph::PassBuilder& b)
+		{
+			b.read(sceneColor);
+			if (gEnableSSAO)
+			{
+				b.read(ssao);
+				if (lowRes)
+				{
+					b.read(sceneDepth);
+					b.read(depthPyramid);
+				}
+			}
+			b.writeBackbuffer();
+		}, [&](const GLRenderGraph::PassContext& ctx)
+		{
+			glBindTextureUnit(0, ctx.getTexture(sceneColor));
+			if (!gEnableSSAO)
+			{
+				progCopy.useProgram();
+			}
+			else if (lowRes)
+			{
+				progCombineUpsampleSSAO.useProgram();
+				glBindTextureUnit(1, ctx.getTexture(ssao));
+				glBindTextureUnit(2, ctx.getTexture(sceneDepth));
+				glBindTextureUnit(3, ctx.getTexture(depthPyramid));
+			}
+			else
+			{
+				progCombineSSAO.useProgram();
+				glBindTextureUnit(1, ctx.getTexture(ssao));
+			}
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		});
+
+		graph.execute(&profiler);
+
+		profiler.beginScope("ImGui");
 		ImGuiIO& io    = ImGui::GetIO();
 		io.DisplaySize = ImVec2((float)width, (float)height);
 		ImGui::NewFrame();
@@ -243,6 +409,8 @@ int main()
 		ImGui::BeginDisabled(!gEnableSSAO);
 		ImGui::GetStyle().DisabledAlpha = 0.2f;
 		ImGui::Checkbox("Enable blur", &gEnableBlur);
+		ImGui::Combo("SSAO resolution", &gSSAOResolution, "Full\0Half\0Quarter\0");
+		ImGui::SliderFloat("Depth threshold", &gSSAOParams.depthThreshold, 0.01f, 0.5f);
 		ImGui::SliderFloat("SSAO scale", &gSSAOParams.scale, 0.0f, 2.0f);
 		ImGui::SliderFloat("SSAO bias", &gSSAOParams.bias, 0.0f, 0.3f);
 		ImGui::EndDisabled();
@@ -252,15 +420,27 @@ int main()
 		ImGui::SliderFloat("SSAO radius", &gSSAOParams.radius, 0.05f, 0.5f);
 		ImGui::SliderFloat("SSAO attenuation scale", &gSSAOParams.attScale, 0.5f, 1.5f);
 		ImGui::SliderFloat("SSAO distance scale", &gSSAOParams.distScale, 0.0f, 1.0f);
+
+		ImGui::Separator();
+
+		const GLRenderGraph::Stats& graphStats = graph.getStats();
+		ImGui::Text("Render graph: %u passes, %u culled", graphStats.numPasses, graphStats.numCulledPasses);
+		ImGui::Text("%u transient textures in %u textures, %.1f MB instead of %.1f MB",
+		            graphStats.numTransients, graphStats.numTextures, graphStats.textureBytes / (1024.0 * 1024.0), graphStats.transientBytes / (1024.0 * 1024.0));
+		ImGui::Text("%u framebuffer binds, %u barriers", graphStats.numFramebufferBinds, graphStats.numBarriers);
 		ImGui::End();
 
-		imguiTextureWindowGL("Color", framebuffer.getTextureColor().getHandle());
-		imguiTextureWindowGL("Depth", framebuffer.getTextureDepth().getHandle());
-		imguiTextureWindowGL("SSAO", ssao.getTextureColor().getHandle());
+		imguiTextureWindowGL("Color", graph.getTexture(sceneColor));
+		imguiTextureWindowGL("Depth", graph.getTexture(sceneDepth));
+		if (gEnableSSAO)
+			imguiTextureWindowGL("SSAO", graph.getTexture(ssao));
+		profiler.renderUI();
 
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
+		profiler.endScope();
 
+		profiler.endFrame();
 		app.swapBuffers();
 	}
 
@@ -1,5 +1,10 @@
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
 #include "OpenGL/GLApp.h"
 #include "OpenGL/GLBuffer.h"
 #include "OpenGL/GLCanvas.h"
@@ -7,10 +12,12 @@
 #include "OpenGL/GLImGui.h"
 #include "OpenGL/GLMesh.h"
 #include "OpenGL/GLMeshPVP.h"
+#include "OpenGL/GLProfiler.h"
 #include "OpenGL/GLProgram.h"
 #include "OpenGL/GLSceneData.h"
 #include "OpenGL/GLShader.h"
 #include "Util/Camera.h"
+#include "Util/Luminance.h"
 
 using glm::mat4;
 using glm::vec4;
@@ -18,6 +25,11 @@ using glm::vec3;
 
 const GLuint kBufferIndex_PerFrameUniforms = 0;
 const GLuint kBufferIndex_ModelMatrices = 1;
+// kBufferIndex_Materials is set to 2 in GLMesh.cpp
+const GLuint kBufferIndex_Luminance = 3;
+
+// levels of the bloom mip chain, the first one is half the framebuffer resolution
+const int kBloomLevels = 6;
 
 struct PerFrameData
 {
@@ -30,7 +42,13 @@ struct HDRParams
 {
 	float exposure      = 0.9f;
 	float maxWhite      = 1.17f;
-	float bloomStrength = 1.1f;
+	float bloomStrength = 0.05f;
+	float bloomThreshold = 1.0f;
+	// eye adaptation, the eye adapts to bright light faster than to darkness
+	float adaptationSpeedUp   = 3.0f;
+	float adaptationSpeedDown = 1.0f;
+	// filled in every frame
+	float deltaSeconds = 0.0f;
 }         gHDRParams;
 
 
@@ -49,14 +67,75 @@ Camera                      gCamera(gPositioner);
 
 bool gEnableHDR = true;
 
-int main()
+static std::vector<float> getInitialLuminance(uint32_t numTiles)
+{
+	// the adapted and the current luminance, followed by the partial sums of every tile
+	std::vector<float> luminance(2 + numTiles, 0.0f);
+	luminance[0] = -1.0f; // nothing to adapt from yet
+	return luminance;
+}
+
+// offscreen render targets, they follow the size of the framebuffer and are recreated when it changes
+struct HDRTargets
+{
+	HDRTargets(int width, int height)
+		: framebuffer(width, height, GL_RGBA16F, GL_DEPTH_COMPONENT24)
+		, numLuminanceTilesX((width + kLuminanceTileSize - 1) / kLuminanceTileSize)
+		, numLuminanceTilesY((height + kLuminanceTileSize - 1) / kLuminanceTileSize)
+		, luminanceBuffer((2 + numLuminanceTilesX * numLuminanceTilesY) * sizeof(float),
+		                  getInitialLuminance(numLuminanceTilesX * numLuminanceTilesY).data(), GL_DYNAMIC_STORAGE_BIT)
+		, bloomWidth(std::max(width / 2, 1))
+		, bloomHeight(std::max(height / 2, 1))
+		, bloomLevels(std::min(kBloomLevels, (int)std::log2(std::max(bloomWidth, bloomHeight)) + 1))
+		, bloom(GL_TEXTURE_2D, bloomWidth, bloomHeight, GL_RGBA16F)
+	{
+		// every level is read through its own texture view while the next one is written as an image
+		glTextureParameteri(bloom.getHandle(), GL_TEXTURE_MAX_LEVEL, bloomLevels - 1);
+		glGenTextures(bloomLevels, bloomViews);
+		for (int i = 0; i != bloomLevels; i++)
+		{
+			glTextureView(bloomViews[i], GL_TEXTURE_2D, bloom.getHandle(), GL_RGBA16F, i, 1, 0, 1);
+			glTextureParameteri(bloomViews[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(bloomViews[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(bloomViews[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(bloomViews[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+	}
+
+	~HDRTargets()
+	{
+		glDeleteTextures(bloomLevels, bloomViews);
+	}
+
+	HDRTargets(const HDRTargets&) = delete;
+
+	void getBloomLevelSize(int level, int& w, int& h) const
+	{
+		w = std::max(bloomWidth >> level, 1);
+		h = std::max(bloomHeight >> level, 1);
+	}
+
+	GLFramebuffer framebuffer;
+
+	// log-average luminance
+	uint32_t numLuminanceTilesX;
+	uint32_t numLuminanceTilesY;
+	GLBuffer luminanceBuffer;
+
+	// bloom mip chain
+	int       bloomWidth;
+	int       bloomHeight;
+	int       bloomLevels;
+	GLTexture bloom;
+	GLuint    bloomViews[kBloomLevels];
+};
+
+int main(int argc, char** argv)
 {
-	GLApp app;
+	GLApp app(argc, argv);
+	app.enableShaderHotReload();
 
-	// shader program that renders the grid
-	GLShader  shdGridVertex("data/shaders/11DebugGrid/grid.vert");
-	GLShader  shdGridFragment("data/shaders/11DebugGrid/grid.frag");
-	GLProgram progGrid(shdGridVertex, shdGridFragment);
+	const double startupTime = app.getTime();
 
 	// shader program that renders the scene with IBL
 	GLShader  shaderVertex("data/shaders/18HDR/scene_IBL.vert");
@@ -69,17 +148,21 @@ int main()
 	GLShader  shdCombineHDR("data/shaders/18HDR/HDR.frag");
 	GLProgram progCombineHDR(shdFullScreenQuadVert, shdCombineHDR);
 
-	GLShader  shdToLuminance("data/shaders/18HDR/ToLuminance.frag");
-	GLProgram progToLuminance(shdFullScreenQuadVert, shdToLuminance);
+	// post-processing runs on compute shaders
+	GLShader  shdLuminanceReduce("data/shaders/18HDR/luminanceReduce.comp");
+	GLProgram progLuminanceReduce(shdLuminanceReduce);
+
+	GLShader  shdLuminanceAdapt("data/shaders/18HDR/luminanceAdapt.comp");
+	GLProgram progLuminanceAdapt(shdLuminanceAdapt);
 
-	GLShader  shdBrightPass("data/shaders/18HDR/BrightPass.frag");
-	GLProgram progBrightPass(shdFullScreenQuadVert, shdBrightPass);
+	GLShader  shdBloomDownsampleFirst("data/shaders/18HDR/bloomDownsample.comp", {"FIRST_PASS"});
+	GLProgram progBloomDownsampleFirst(shdBloomDownsampleFirst);
 
-	GLShader  shdBlurXFrag("data/shaders/16SSAO/BlurX.frag");
-	GLProgram progBlurX(shdFullScreenQuadVert, shdBlurXFrag);
+	GLShader  shdBloomDownsample("data/shaders/18HDR/bloomDownsample.comp");
+	GLProgram progBloomDownsample(shdBloomDownsample);
 
-	GLShader  shdBlurYFrag("data/shaders/16SSAO/BlurY.frag");
-	GLProgram progBlurY(shdFullScreenQuadVert, shdBlurYFrag);
+	GLShader  shdBloomUpsample("data/shaders/18HDR/bloomUpsample.comp");
+	GLProgram progBloomUpsample(shdBloomUpsample);
 
 	const GLsizeiptr perFrameDataBufferSize = sizeof(PerFrameData);
 	GLBuffer         perFrameDataBuffer(perFrameDataBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
@@ -89,84 +172,74 @@ int main()
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_DEPTH_TEST);
 
-	GLTexture rotationPattern(GL_TEXTURE_2D, "data/rot_texture.bmp");
-
-	GLSceneData sceneData1("data/meshes/bistro_exterior.meshes", "data/meshes/bistro_exterior.scene", "data/meshes/bistro_exterior.materials");
-	GLSceneData sceneData2("data/meshes/bistro_interior.meshes", "data/meshes/bistro_interior.scene", "data/meshes/bistro_interior.materials");
-
-	GLMesh mesh1(sceneData1);
-	GLMesh mesh2(sceneData2);
+	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
 
-	// set a callback for key events
-	glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
-	{
-		const bool pressed = action != GLFW_RELEASE;
-		if (key == GLFW_KEY_ESCAPE && pressed)
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
-		if (key == GLFW_KEY_W)
-			gPositioner.mMovement.forward = pressed;
-		if (key == GLFW_KEY_S)
-			gPositioner.mMovement.backward = pressed;
-		if (key == GLFW_KEY_A)
-			gPositioner.mMovement.left = pressed;
-		if (key == GLFW_KEY_D)
-			gPositioner.mMovement.right = pressed;
-		if (key == GLFW_KEY_1)
-			gPositioner.mMovement.up = pressed;
-		if (key == GLFW_KEY_2)
-			gPositioner.mMovement.down = pressed;
-		if (mods & GLFW_MOD_SHIFT)
-			gPositioner.mMovement.fastSpeed = pressed;
-		else
-			gPositioner.mMovement.fastSpeed = false;
-		if (key == GLFW_KEY_SPACE)
-			gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
-	});
-
-	glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
-	{
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-		gMouseState.pos.x       = static_cast<float>(x / width);
-		gMouseState.pos.y       = static_cast<float>(y / height);
-		ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
-	});
+	GLMesh mesh(sceneData);
 
-	glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+	// there is no window to receive input from in headless mode
+	if (!app.isHeadless())
 	{
-		auto&     io      = ImGui::GetIO();
-		const int idx     = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
-		io.MouseDown[idx] = action == GLFW_PRESS;
-
-		if (!io.WantCaptureMouse)
-			if (button == GLFW_MOUSE_BUTTON_LEFT)
-				gMouseState.pressedLeft = action == GLFW_PRESS;
-	});
+		// set a callback for key events
+		glfwSetKeyCallback(app.getWindow(), [](GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			const bool pressed = action != GLFW_RELEASE;
+			if (key == GLFW_KEY_ESCAPE && pressed)
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			if (key == GLFW_KEY_W)
+				gPositioner.mMovement.forward = pressed;
+			if (key == GLFW_KEY_S)
+				gPositioner.mMovement.backward = pressed;
+			if (key == GLFW_KEY_A)
+				gPositioner.mMovement.left = pressed;
+			if (key == GLFW_KEY_D)
+				gPositioner.mMovement.right = pressed;
+			if (key == GLFW_KEY_1)
+				gPositioner.mMovement.up = pressed;
+			if (key == GLFW_KEY_2)
+				gPositioner.mMovement.down = pressed;
+			if (mods & GLFW_MOD_SHIFT)
+				gPositioner.mMovement.fastSpeed = pressed;
+			else
+				gPositioner.mMovement.fastSpeed = false;
+			if (key == GLFW_KEY_SPACE)
+				gPositioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
+		});
+
+		glfwSetCursorPosCallback(app.getWindow(), [](auto* window, double x, double y)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			gMouseState.pos.x       = static_cast<float>(x / width);
+			gMouseState.pos.y       = static_cast<float>(y / height);
+			ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
+		});
+
+		glfwSetMouseButtonCallback(app.getWindow(), [](auto* window, int button, int action, int mods)
+		{
+			auto&     io      = ImGui::GetIO();
+			const int idx     = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
+			io.MouseDown[idx] = action == GLFW_PRESS;
+
+			if (!io.WantCaptureMouse)
+				if (button == GLFW_MOUSE_BUTTON_LEFT)
+					gMouseState.pressedLeft = action == GLFW_PRESS;
+		});
+	}
 
 	gPositioner.mMaxSpeed = 1.0f;
 
 	// offscreen render targets
 	int width, height;
-	glfwGetFramebufferSize(app.getWindow(), &width, &height);
-	GLFramebuffer framebuffer(width, height, GL_RGBA16F, GL_DEPTH_COMPONENT24);
-	GLFramebuffer luminance(64, 64, GL_R16F, 0);
-	GLFramebuffer brightPass(256, 256, GL_RGBA16F, 0);
-	GLFramebuffer bloom1(256, 256, GL_RGBA16F, 0);
-	GLFramebuffer bloom2(256, 256, GL_RGBA16F, 0);
-	// create a texture view into the last mip-level (1x1 pixel) of our luminance framebuffer
-	GLuint luminance1x1;
-	glGenTextures(1, &luminance1x1);
-	glTextureView(luminance1x1, GL_TEXTURE_2D, luminance.getTextureColor().getHandle(), GL_R16F, 6, 1, 0, 1);
-	const GLint Mask[] = {GL_RED, GL_RED, GL_RED, GL_RED};
-	glTextureParameteriv(luminance1x1, GL_TEXTURE_SWIZZLE_RGBA, Mask);
+	app.getFramebufferSize(width, height);
+	auto targets = std::make_unique<HDRTargets>(width, height);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Luminance, targets->luminanceBuffer.getHandle());
 
 	// cube map
-	// https://hdrihaven.com/hdri/?h=immenstadter_horn
-	GLTexture envMap(GL_TEXTURE_CUBE_MAP, "data/immenstadter_horn_2k.hdr");
-	GLTexture envMapIrradiance(GL_TEXTURE_CUBE_MAP, "data/immenstadter_horn_2k_irradiance.hdr");
-	GLShader  shdCubeVertex("data/shaders/chapter08/GL03_cube.vert");
-	GLShader  shdCubeFragment("data/shaders/chapter08/GL03_cube.frag");
-	GLProgram progCube(shdCubeVertex, shdCubeFragment);
+	GLTexture envMap(GL_TEXTURE_CUBE_MAP, "data/piazza_bologni_1k.hdr");
+	GLTexture envMapIrradiance(GL_TEXTURE_CUBE_MAP, "data/piazza_bologni_1k_irradiance.hdr"); // precomputed
+	GLShader  shdSkyVertex("data/shaders/18HDR/sky.vert");
+	GLShader  shdSkyFragment("data/shaders/18HDR/sky.frag");
+	GLProgram progSky(shdSkyVertex, shdSkyFragment);
 	GLuint    dummyVAO;
 	glCreateVertexArrays(1, &dummyVAO);
 	const GLuint pbrTextures[] = {envMap.getHandle(), envMapIrradiance.getHandle()};
@@ -174,18 +247,157 @@ int main()
 
 	GLImGui rendererUI;
 
-	while (!glfwWindowShouldClose(app.getWindow()))
+	GLProfiler profiler;
+
+	const GLProgramCacheStats& cacheStats = GLProgram::getCacheStats();
+	printf("Startup took %.2f s (program cache %s: %u hits, %u misses, %.2f s creating programs)\n",
+	       app.getTime() - startupTime, GLProgram::isBinaryCacheEnabled() ? "on" : "off", cacheStats.hits, cacheStats.misses, cacheStats.seconds);
+
+	while (!app.shouldClose())
 	{
+		profiler.beginFrame();
+
 		gPositioner.update(app.getDeltaSeconds(), gMouseState.pos, gMouseState.pressedLeft);
 
 		int width, height;
-		glfwGetFramebufferSize(app.getWindow(), &width, &height);
+		app.getFramebufferSize(width, height);
 		const float ratio = width / (float)height;
 
-		//
-
+		// a minimized window has no size, the old targets are kept until it comes back
+		if ((width != targets->framebuffer.getWidth() || height != targets->framebuffer.getHeight()) && width > 0 && height > 0)
+		{
+			auto resized = std::make_unique<HDRTargets>(width, height);
+			// the eye stays adapted
+			glCopyNamedBufferSubData(targets->luminanceBuffer.getHandle(), resized->luminanceBuffer.getHandle(), 0, 0, sizeof(float));
+			targets = std::move(resized);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Luminance, targets->luminanceBuffer.getHandle());
+		}
+
+		GLFramebuffer& framebuffer = targets->framebuffer;
+
+		// 1. Render the scene in HDR
+		profiler.beginScope("Scene");
+		const mat4         proj         = glm::perspective(45.0f, ratio, 0.1f, 1000.0f);
+		const mat4         view         = gCamera.getViewMatrix();
+		const PerFrameData perFrameData = {.view = view, .proj = proj, .cameraPos = glm::vec4(gCamera.getPosition(), 1.0f)};
+		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, perFrameDataBufferSize, &perFrameData);
+
+		glClearNamedFramebufferfv(framebuffer.getHandle(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+		glClearNamedFramebufferfi(framebuffer.getHandle(), GL_DEPTH_STENCIL, 0, 1.0f, 0);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+		framebuffer.bind();
+		program.useProgram();
+		mesh.draw(sceneData);
+		// the sky fills what is left at the far plane
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+		progSky.useProgram();
+		glBindVertexArray(dummyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		framebuffer.unbind();
+		glDisable(GL_DEPTH_TEST);
+		profiler.endScope();
+
+		gHDRParams.deltaSeconds = app.getDeltaSeconds();
+		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, sizeof(gHDRParams), &gHDRParams);
+
+		// 2. Log-average luminance and eye adaptation
+		{
+			GLProfilerScope scope(profiler, "Luminance");
+			glBindTextureUnit(0, framebuffer.getTextureColor().getHandle());
+			progLuminanceReduce.useProgram();
+			glDispatchCompute(targets->numLuminanceTilesX, targets->numLuminanceTilesY, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			progLuminanceAdapt.useProgram();
+			glDispatchCompute(1, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+
+		// 3. Bloom: downsample the bright pixels level by level, then upsample and accumulate back to the first level
+		{
+			GLProfilerScope scope(profiler, "Bloom");
+			int w, h;
+			for (int i = 0; i != targets->bloomLevels; i++)
+			{
+				(i ? progBloomDownsample : progBloomDownsampleFirst).useProgram();
+				glBindTextureUnit(0, i ? targets->bloomViews[i - 1] : framebuffer.getTextureColor().getHandle());
+				glBindImageTexture(0, targets->bloom.getHandle(), i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+				targets->getBloomLevelSize(i, w, h);
+				glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+				glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			}
+			progBloomUpsample.useProgram();
+			for (int i = targets->bloomLevels - 2; i >= 0; i--)
+			{
+				glBindTextureUnit(0, targets->bloomViews[i + 1]);
+				glBindImageTexture(0, targets->bloom.getHandle(), i, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+				targets->getBloomLevelSize(i, w, h);
+				glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+				glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			}
+		}
+
+		// 4. Tone mapping
+		profiler.beginScope("Tone mapping");
+		glViewport(0, 0, width, height);
+		if (gEnableHDR)
+		{
+			progCombineHDR.useProgram();
+			glBindTextureUnit(0, framebuffer.getTextureColor().getHandle());
+			glBindTextureUnit(2, targets->bloomViews[0]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		else
+		{
+			// without tone mapping, everything brighter than 1 is clipped
+			glBlitNamedFramebuffer(framebuffer.getHandle(), GLFramebuffer::getDefaultHandle(), 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+		profiler.endScope();
+
+		profiler.beginScope("ImGui");
+		ImGuiIO& io    = ImGui::GetIO();
+		io.DisplaySize = ImVec2((float)width, (float)height);
+		ImGui::NewFrame();
+
+		ImGui::Begin("Control", nullptr);
+		ImGui::Checkbox("Enable HDR", &gEnableHDR);
+		ImGui::BeginDisabled(!gEnableHDR);
+		ImGui::GetStyle().DisabledAlpha = 0.2f;
+		ImGui::SliderFloat("Exposure", &gHDRParams.exposure, 0.1f, 2.0f);
+		ImGui::SliderFloat("Max white", &gHDRParams.maxWhite, 0.5f, 2.0f);
+		ImGui::SliderFloat("Bloom strength", &gHDRParams.bloomStrength, 0.0f, 0.5f);
+		ImGui::SliderFloat("Bloom threshold", &gHDRParams.bloomThreshold, 0.0f, 4.0f);
+		ImGui::SliderFloat("Adaptation speed up", &gHDRParams.adaptationSpeedUp, 0.1f, 10.0f);
+		ImGui::SliderFloat("Adaptation speed down", &gHDRParams.adaptationSpeedDown, 0.1f, 10.0f);
+		ImGui::EndDisabled();
+		// compares the GPU reduction of the last frame with the CPU reference, it stalls until the GPU is done
+		if (ImGui::Button("Check luminance on the CPU"))
+		{
+			std::vector<float> pixels(framebuffer.getWidth() * framebuffer.getHeight() * 4);
+			glGetTextureImage(framebuffer.getTextureColor().getHandle(), 0, GL_RGBA, GL_FLOAT, (GLsizei)(pixels.size() * sizeof(float)), pixels.data());
+			float gpuLuminance[2];
+			glGetNamedBufferSubData(targets->luminanceBuffer.getHandle(), 0, sizeof(gpuLuminance), gpuLuminance);
+			const float cpuLuminance = getLogAverageLuminance(pixels.data(), framebuffer.getWidth(), framebuffer.getHeight(), 4);
+			printf("Log-average luminance: GPU %f, CPU %f, relative error %g\n",
+			       gpuLuminance[1], cpuLuminance, std::abs(gpuLuminance[1] - cpuLuminance) / std::max(cpuLuminance, 1e-6f));
+		}
+		ImGui::End();
+
+		imguiTextureWindowGL("Color", framebuffer.getTextureColor().getHandle());
+		imguiTextureWindowGL("Bloom", targets->bloomViews[0]);
+		profiler.renderUI();
+		ImGui::Render();
+		rendererUI.render(width, height, ImGui::GetDrawData());
+		profiler.endScope();
+
+		profiler.endFrame();
 		app.swapBuffers();
 	}
 
+	glDeleteVertexArrays(1, &dummyVAO);
+
 	return 0;
 }
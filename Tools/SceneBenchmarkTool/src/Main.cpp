@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "argh.h"
+
+#include "Util/LooseOctree.h"
+#include "Util/Scene.h"
+#include "Util/UtilsMath.h"
+#include "Util/VtxData.h"
+
+using glm::mat4;
+using glm::vec3;
+
+// leaves are grouped under nodes which move them together, like props on vehicles, groups have a level of sub-groups
+const uint32_t kSubGroupsPerGroup = 8;
+const uint32_t kLeavesPerSubGroup = 8;
+const uint32_t kLeavesPerGroup    = kSubGroupsPerGroup * kLeavesPerSubGroup;
+
+// one leaf in kBuildingRate gets a large mesh, so the octree is filled on several levels
+const uint32_t kBuildingRate = 1000;
+
+const float kFrameTime = 1.0f / 60.0f;
+
+static double getTimeMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// L1 data cache and last level cache misses of the calling thread, read through perf events where the kernel allows it
+class CacheMissCounter
+{
+public:
+	CacheMissCounter()
+	{
+#ifdef __linux__
+		mL1Misses  = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+		mLLCMisses = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+	}
+
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if (mL1Misses >= 0)
+			close(mL1Misses);
+		if (mLLCMisses >= 0)
+			close(mLLCMisses);
+#endif
+	}
+
+	bool isAvailable() const { return mL1Misses >= 0 || mLLCMisses >= 0; }
+
+	void start()
+	{
+#ifdef __linux__
+		for (const int fd : {mL1Misses, mLLCMisses})
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+	}
+
+	// misses since start(), 0 for counters which are unavailable
+	void stop(uint64_t& l1Misses, uint64_t& llcMisses)
+	{
+		l1Misses  = read(mL1Misses);
+		llcMisses = read(mLLCMisses);
+	}
+
+private:
+#ifdef __linux__
+	static int open(uint32_t type, uint64_t config)
+	{
+		perf_event_attr attr = {};
+		attr.type            = type;
+		attr.size            = sizeof(attr);
+		attr.config          = config;
+		attr.disabled        = 1;
+		attr.exclude_kernel  = 1;
+		attr.exclude_hv      = 1;
+		return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+#endif
+
+	static uint64_t read(int fd)
+	{
+		uint64_t count = 0;
+#ifdef __linux__
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (::read(fd, &count, sizeof(count)) != sizeof(count))
+				count = 0;
+		}
+#endif
+		return count;
+	}
+
+	int mL1Misses  = -1;
+	int mLLCMisses = -1;
+};
+
+// a synthetic scene: a root, groups spread over the world and leaves with meshes around every group. Nodes are added
+// depth-first, like the SceneConversionTool used to save them.
+static void createScene(Scene& scene, MeshData& meshData, uint32_t numNodes, float worldSize)
+{
+	meshData.boundingBoxes = {
+		BoundingBox(vec3(-0.5f), vec3(0.5f)),
+		BoundingBox(vec3(-10.0f, 0.0f, -10.0f), vec3(10.0f, 20.0f, 10.0f))
+	};
+
+	const int root = addNode(scene, -1, 0);
+
+	const uint32_t numGroups = std::max(numNodes / kLeavesPerGroup, 1u);
+	for (uint32_t g = 0; g != numGroups; g++)
+	{
+		const int group                         = addNode(scene, root, 1);
+		scene.localTransform[group].translation = randomVec(vec3(-0.5f * worldSize, 0.0f, -0.5f * worldSize), vec3(0.5f * worldSize, 50.0f, 0.5f * worldSize));
+
+		for (uint32_t j = 0; j != kSubGroupsPerGroup; j++)
+		{
+			const int subGroup                         = addNode(scene, group, 2);
+			scene.localTransform[subGroup].translation = randomVec(vec3(-6.0f), vec3(6.0f));
+
+			for (uint32_t i = 0; i != kLeavesPerSubGroup; i++)
+			{
+				const int leaf                         = addNode(scene, subGroup, 3);
+				scene.localTransform[leaf].translation = randomVec(vec3(-2.0f), vec3(2.0f));
+				scene.localTransform[leaf].scale       = vec3(randomFloat(0.25f, 2.0f));
+				scene.nodeIDToMeshID[leaf]             = (leaf % kBuildingRate) ? 0 : 1;
+			}
+		}
+	}
+
+	markAsChanged(scene, root);
+	recalculateGlobalTransforms(scene);
+}
+
+// full-scene transform updates, the fastest of several runs and the cache misses of that run
+static void benchmarkFullUpdate(const char* name, Scene& scene, bool singleSweep, uint32_t numRuns, CacheMissCounter& counter)
+{
+	double   minMs     = 1e30;
+	uint64_t l1Misses  = 0;
+	uint64_t llcMisses = 0;
+
+	for (uint32_t run = 0; run != numRuns; run++)
+	{
+		if (!singleSweep)
+			markAsChanged(scene, 0);
+
+		counter.start();
+		const double start = getTimeMs();
+		if (singleSweep)
+			recalculateAllGlobalTransforms(scene);
+		else
+			recalculateGlobalTransforms(scene);
+		const double ms = getTimeMs() - start;
+
+		uint64_t l1, llc;
+		counter.stop(l1, llc);
+		if (ms < minMs)
+		{
+			minMs     = ms;
+			l1Misses  = l1;
+			llcMisses = llc;
+		}
+	}
+
+	printf("%-36s %8.3f ms", name, minMs);
+	if (counter.isAvailable())
+		printf(", L1D misses %10llu (%.2f per node), LLC misses %10llu (%.2f per node)",
+		       (unsigned long long)l1Misses, (double)l1Misses / scene.hierarchy.size(), (unsigned long long)llcMisses, (double)llcMisses / scene.hierarchy.size());
+	printf("\n");
+}
+
+struct QueryTimes
+{
+	double   octreeMs   = 0.0;
+	double   linearMs   = 0.0;
+	uint64_t numResults = 0;
+	uint32_t numErrors  = 0; // queries where the octree and the linear scan disagree
+};
+
+static void printQueryTimes(const char* name, const QueryTimes& t, uint32_t numQueries)
+{
+	printf("%-8s octree %9.3f us, linear %9.3f us, speed-up %6.1fx, %8.1f results per query, %u errors\n",
+	       name, 1000.0 * t.octreeMs / numQueries, 1000.0 * t.linearMs / numQueries, t.linearMs / std::max(t.octreeMs, 1e-9),
+	       (double)t.numResults / numQueries, t.numErrors);
+}
+
+// runs the same query with the octree and with a linear scan over all nodes and compares the results
+template <typename Query, typename Test>
+static void runQuery(const LooseOctree& octree, const std::vector<uint32_t>& nodes, const Query& query, const Test& test, QueryTimes& times)
+{
+	std::vector<uint32_t> found, expected;
+
+	double start = getTimeMs();
+	query(found);
+	times.octreeMs += getTimeMs() - start;
+
+	start = getTimeMs();
+	for (const uint32_t node : nodes)
+		if (test(octree.getBox(node)))
+			expected.push_back(node);
+	times.linearMs += getTimeMs() - start;
+
+	times.numResults += found.size();
+
+	std::sort(found.begin(), found.end());
+	if (found != expected)
+		times.numErrors++;
+}
+
+int main(int argc, char** argv)
+{
+	argh::parser cmdl(argc, argv);
+
+	std::string scenePrefix;
+	uint32_t    numNodes = 0, numFrames = 0, numQueries = 0, numUpdateRuns = 0, seed = 0;
+	float       movingFraction = 0.0f, cellSize = 0.0f, worldSize = 0.0f;
+
+	cmdl("--scene", "") >> scenePrefix;
+	cmdl("--nodes", 1000000) >> numNodes;
+	cmdl("--moving", 0.1f) >> movingFraction;
+	cmdl("--frames", 60) >> numFrames;
+	cmdl("--queries", 1000) >> numQueries;
+	cmdl("--update-runs", 10) >> numUpdateRuns;
+	cmdl("--cell-size", 1.0f) >> cellSize;
+	cmdl("--world", 4000.0f) >> worldSize;
+	cmdl("--seed", 1) >> seed;
+
+	srand(seed);
+
+	Scene    scene;
+	MeshData meshData;
+
+	double start = getTimeMs();
+	if (scenePrefix.empty())
+	{
+		createScene(scene, meshData, numNodes, worldSize);
+	}
+	else
+	{
+		if (!loadMeshData((scenePrefix + ".meshes").c_str(), meshData))
+			return EXIT_FAILURE;
+		recalculateBoundingBoxes(meshData);
+		if (!loadScene((scenePrefix + ".scene").c_str(), scene))
+			return EXIT_FAILURE;
+		// merged scenes have several roots
+		recalculateAllGlobalTransforms(scene);
+	}
+	printf("Created %u nodes (%u with meshes) in %.1f ms\n", (uint32_t)scene.hierarchy.size(), (uint32_t)scene.nodeIDToMeshID.size(), getTimeMs() - start);
+
+	// the order of the scene as it was created or loaded against the breadth-first order
+	CacheMissCounter counter;
+	if (!counter.isAvailable())
+		printf("Cache miss counters are unavailable (see /proc/sys/kernel/perf_event_paranoid), only times are reported\n");
+
+	benchmarkFullUpdate("Changed lists, original order", scene, false, numUpdateRuns, counter);
+	benchmarkFullUpdate("Single sweep, original order", scene, true, numUpdateRuns, counter);
+
+	start = getTimeMs();
+	reorderNodesByLevel(scene);
+	printf("Reordered the nodes by level in %.1f ms\n", getTimeMs() - start);
+
+	benchmarkFullUpdate("Changed lists, level order", scene, false, numUpdateRuns, counter);
+	benchmarkFullUpdate("Single sweep, level order", scene, true, numUpdateRuns, counter);
+
+	LooseOctree octree(cellSize);
+
+	start = getTimeMs();
+	addSceneNodes(octree, scene, meshData);
+	printf("Built the octree in %.1f ms: %u nodes, %u items too large for it\n", getTimeMs() - start, octree.getStats().numNodes, octree.getStats().numHugeItems);
+
+	// moving groups drive in straight lines, every group moves its leaves with it
+	std::vector<int>  movingGroups;
+	std::vector<vec3> velocities;
+	for (int node = 0; node != (int)scene.hierarchy.size(); node++)
+		if (scene.hierarchy[node].level == 1 && random01() < movingFraction)
+		{
+			movingGroups.push_back(node);
+			velocities.push_back(randomVec(vec3(-10.0f, 0.0f, -10.0f), vec3(10.0f, 0.0f, 10.0f)));
+		}
+
+	double           transformMs = 0.0, updateMs = 0.0;
+	uint64_t         numChanged  = 0;
+	std::vector<int> changedNodes;
+
+	octree.resetStats();
+	for (uint32_t frame = 0; frame != numFrames; frame++)
+	{
+		changedNodes.clear();
+
+		start = getTimeMs();
+		for (size_t i = 0; i != movingGroups.size(); i++)
+		{
+			scene.localTransform[movingGroups[i]].translation += velocities[i] * kFrameTime;
+			markAsChanged(scene, movingGroups[i]);
+		}
+		recalculateGlobalTransforms(scene, &changedNodes);
+		const double updateStart = getTimeMs();
+		transformMs += updateStart - start;
+
+		updateSceneNodes(octree, scene, meshData, changedNodes);
+		updateMs += getTimeMs() - updateStart;
+		numChanged += changedNodes.size();
+	}
+
+	if (numFrames)
+		printf("Updates: %.1f changed nodes per frame, transforms %.3f ms, octree %.3f ms (%.1f ns per node), %.2f%% of the updates relocated\n",
+		       (double)numChanged / numFrames, transformMs / numFrames, updateMs / numFrames, 1e6 * updateMs / std::max(numChanged, (uint64_t)1),
+		       100.0 * octree.getStats().numRelocations / std::max(numChanged, (uint64_t)1));
+
+	// the linear scan visits the same boxes as the octree
+	std::vector<uint32_t> meshNodes;
+	for (const auto& [node, mesh] : scene.nodeIDToMeshID)
+		meshNodes.push_back(node);
+	std::sort(meshNodes.begin(), meshNodes.end());
+
+	const vec3 worldMin(-0.5f * worldSize, 0.0f, -0.5f * worldSize);
+	const vec3 worldMax(0.5f * worldSize, 50.0f, 0.5f * worldSize);
+
+	QueryTimes frustumTimes, sphereTimes, boxTimes;
+
+	for (uint32_t i = 0; i != numQueries; i++)
+	{
+		// a camera with a shorter far plane than the samples, a whole world in view is not a spatial query
+		const vec3 eye      = randomVec(worldMin, worldMax);
+		const vec3 target   = eye + randomVec(vec3(-1.0f, -0.2f, -1.0f), vec3(1.0f, 0.2f, 1.0f));
+		const mat4 viewProj = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 200.0f) * glm::lookAt(eye, target, vec3(0.0f, 1.0f, 0.0f));
+
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 frustumCorners[8];
+		getFrustumPlanes(viewProj, frustumPlanes);
+		getFrustumCorners(viewProj, frustumCorners);
+
+		runQuery(octree, meshNodes,
+		         [&](std::vector<uint32_t>& items) { octree.queryFrustum(viewProj, items); },
+		         [&](const BoundingBox& b) { return isBoxInFrustum(frustumPlanes, frustumCorners, b); },
+		         frustumTimes);
+
+		const vec3  center = randomVec(worldMin, worldMax);
+		const float radius = randomFloat(10.0f, 50.0f);
+		runQuery(octree, meshNodes,
+		         [&](std::vector<uint32_t>& items) { octree.querySphere(center, radius, items); },
+		         [&](const BoundingBox& b)
+		         {
+			         const vec3 d = glm::clamp(center, b.min, b.max) - center;
+			         return glm::dot(d, d) <= radius * radius;
+		         },
+		         sphereTimes);
+
+		const BoundingBox box(center, center + randomVec(vec3(20.0f), vec3(100.0f)));
+		runQuery(octree, meshNodes,
+		         [&](std::vector<uint32_t>& items) { octree.queryBox(box, items); },
+		         [&](const BoundingBox& b)
+		         {
+			         return box.min.x <= b.max.x && box.max.x >= b.min.x && box.min.y <= b.max.y && box.max.y >= b.min.y && box.min.z <= b.max.z && box.max.z >= b.min.z;
+		         },
+		         boxTimes);
+	}
+
+	if (numQueries)
+	{
+		printQueryTimes("Frustum", frustumTimes, numQueries);
+		printQueryTimes("Sphere", sphereTimes, numQueries);
+		printQueryTimes("Box", boxTimes, numQueries);
+	}
+
+	const bool failed = frustumTimes.numErrors || sphereTimes.numErrors || boxTimes.numErrors;
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -20,6 +20,7 @@
 
 #include "Util/Material.h"
 #include "Util/Scene.h"
+#include "Util/SceneMerge.h"
 #include "Util/Utils.h"
 #include "Util/VtxData.h"
 
@@ -34,6 +35,7 @@ struct SceneConfig
 	float       scale;
 	bool        calculateLODs;
 	bool        mergeInstances;
+	bool        packTextures;
 };
 
 MeshData       gMeshData;
@@ -77,7 +79,8 @@ std::vector<SceneConfig> readConfigFile(const char* cfgFileName)
 			                        .outputMaterials = document[i]["output_materials"].GetString(),
 			                        .scale = (float)document[i]["scale"].GetDouble(),
 			                        .calculateLODs = document[i]["calculate_LODs"].GetBool(),
-			                        .mergeInstances = document[i]["merge_instances"].GetBool()
+			                        .mergeInstances = document[i]["merge_instances"].GetBool(),
+			                        .packTextures = document[i].HasMember("pack_textures") && document[i]["pack_textures"].GetBool()
 		                        });
 	}
 
@@ -100,11 +103,7 @@ void traverse(const aiScene* sourceScene,
 		makePrefix(atLevel);
 		printf("Node[%d].name = %s\n", newNodeID, node->mName.C_Str());
 
-		uint32_t nameID = (uint32_t)scene.names.size();
-
-		scene.names.push_back(std::string(node->mName.C_Str()));
-
-		scene.nodeIDToNameID[newNodeID] = nameID;
+		scene.nodeIDToNameID[newNodeID] = scene.names.intern(node->mName.C_Str());
 	}
 
 	// for each mesh attached in this node, create a sub-node for it
@@ -112,11 +111,10 @@ void traverse(const aiScene* sourceScene,
 	{
 		int newSubNodeID = addNode(scene, newNodeID, atLevel + 1);;
 
-		uint32_t nameID = (uint32_t)scene.names.size();
+		char name[sizeof(node->mName.data) + 32];
+		snprintf(name, sizeof(name), "%s_Mesh_%u", node->mName.C_Str(), (uint32_t)i);
 
-		scene.names.push_back(std::string(node->mName.C_Str()) + "_Mesh_" + std::to_string(i));
-
-		scene.nodeIDToNameID[newSubNodeID] = nameID;
+		scene.nodeIDToNameID[newSubNodeID] = scene.names.intern(name);
 
 		int meshID = (int)node->mMeshes[i];
 
@@ -134,16 +132,16 @@ void traverse(const aiScene* sourceScene,
 		       sourceScene->mMeshes[meshID]->mMaterialIndex);
 
 		// subnodes are only use to attach meshes, so set the local/global transform to identity
-		scene.globalTransform[newSubNodeID] = glm::mat4(1.0f);
-		scene.localTransform[newSubNodeID]  = glm::mat4(1.0f);
+		scene.globalTransform[newSubNodeID] = glm::mat4x3(1.0f);
+		scene.localTransform[newSubNodeID]  = TRS();
 	}
 
 	// global trans. is set to identity at the beginning of node conversion
 	// it will be recalculated at the first frame or if the node is marked as changed. 
-	scene.globalTransform[newNodeID] = glm::mat4(1.0f);
+	scene.globalTransform[newNodeID] = glm::mat4x3(1.0f);
 
 	// local trans. is fetched from aiNode
-	scene.localTransform[newNodeID] = toMat4(node->mTransformation);
+	scene.localTransform[newNodeID] = getTRS(toMat4(node->mTransformation));
 
 	if (node->mParent != nullptr)
 	{
@@ -347,6 +345,9 @@ MaterialData convertAIMaterialToMaterialData(const aiMaterial*         M,
 		D.roughness      = GpuVec4(0.1f, 0.1f, 0.0f, 0.0f);
 	}
 
+	if (D.alphaTest > 0.0f)
+		D.flags |= sMaterialFlags_AlphaTest;
+
 	return D;
 }
 
@@ -523,6 +524,100 @@ void convertAndDownscaleAllTextures(const std::vector<MaterialData>& materials,
 	std::transform(std::execution::par, std::begin(files), std::end(files), std::begin(files), converter);
 }
 
+// group the converted textures into texture arrays and rewrite the material maps as (array, layer) pairs
+// materials: a list of material data whose maps index the files list
+// files: the converted texture files, reordered so that the layers of each array are contiguous
+// textureArrays: output, the layers of array i are files[textureArrays[i]] ... files[textureArrays[i + 1] - 1]
+// pack: if false, every texture becomes an array with a single layer
+void packTexturesIntoArrays(std::vector<MaterialData>& materials,
+                            std::vector<std::string>&  files,
+                            std::vector<uint32_t>&     textureArrays,
+                            bool                       pack)
+{
+	// keep the arrays reasonably small, so that a single array does not need a huge allocation
+	const uint32_t maxLayersPerArray = 256;
+
+	textureArrays.clear();
+
+	if (!pack)
+	{
+		for (uint32_t i = 0; i <= (uint32_t)files.size(); i++)
+			textureArrays.push_back(i);
+		return;
+	}
+
+	// all converted textures are RGBA, so textures of the same size can share an array
+	struct ArrayInfo
+	{
+		int                   width;
+		int                   height;
+		std::vector<uint32_t> layers; // indices into the original files list
+	};
+
+	std::vector<ArrayInfo> arrays;
+
+	for (uint32_t i = 0; i != (uint32_t)files.size(); i++)
+	{
+		int w = 0, h = 0, comp = 0;
+		if (!stbi_info(files[i].c_str(), &w, &h, &comp))
+			printf("Unable to read the size of [%s] texture\n", files[i].c_str());
+
+		auto it = std::find_if(arrays.begin(),
+		                       arrays.end(),
+		                       [w, h, maxLayersPerArray](const ArrayInfo& a)
+		                       {
+			                       return a.width == w && a.height == h && a.layers.size() < maxLayersPerArray;
+		                       });
+
+		if (it == arrays.end())
+			it = arrays.insert(arrays.end(), ArrayInfo{.width = w, .height = h});
+
+		it->layers.push_back(i);
+	}
+
+	// old file index -> (array, layer)
+	std::vector<uint32_t>    fileToArray(files.size());
+	std::vector<uint32_t>    fileToLayer(files.size());
+	std::vector<std::string> packedFiles;
+	packedFiles.reserve(files.size());
+
+	for (uint32_t a = 0; a != (uint32_t)arrays.size(); a++)
+	{
+		textureArrays.push_back((uint32_t)packedFiles.size());
+		for (uint32_t l = 0; l != (uint32_t)arrays[a].layers.size(); l++)
+		{
+			const uint32_t f = arrays[a].layers[l];
+			fileToArray[f]   = a;
+			fileToLayer[f]   = l;
+			packedFiles.push_back(files[f]);
+		}
+		printf("Texture array %u: %u layers of %dx%d\n", a, (uint32_t)arrays[a].layers.size(), arrays[a].width, arrays[a].height);
+	}
+	textureArrays.push_back((uint32_t)packedFiles.size());
+
+	// MaterialData is packed, so the layer has to be computed before the map index is overwritten
+	auto toLayer = [&](uint64_t map) { return map == INVALID_TEXTURE ? 0u : fileToLayer[map]; };
+	auto toArray = [&](uint64_t map) { return map == INVALID_TEXTURE ? map : (uint64_t)fileToArray[map]; };
+
+	// opacity maps index a separate list and have already been baked into the albedo maps
+	for (auto& m : materials)
+	{
+		m.ambientOcclusionLayer  = toLayer(m.ambientOcclusionMap);
+		m.ambientOcclusionMap    = toArray(m.ambientOcclusionMap);
+		m.emissiveLayer          = toLayer(m.emissiveMap);
+		m.emissiveMap            = toArray(m.emissiveMap);
+		m.albedoLayer            = toLayer(m.albedoMap);
+		m.albedoMap              = toArray(m.albedoMap);
+		m.metallicRoughnessLayer = toLayer(m.metallicRoughnessMap);
+		m.metallicRoughnessMap   = toArray(m.metallicRoughnessMap);
+		m.normalLayer            = toLayer(m.normalMap);
+		m.normalMap              = toArray(m.normalMap);
+	}
+
+	printf("Packed %u textures into %u texture arrays\n", (uint32_t)files.size(), (uint32_t)arrays.size());
+
+	files = std::move(packedFiles);
+}
 
 void makePrefix(int atLevel)
 {
@@ -818,7 +913,7 @@ void processScene(const SceneConfig& cfg)
 
 	// Material conversion
 	std::vector<MaterialData> materials;
-	std::vector<std::string>& materialNames = ourScene.materialNames;
+	StringPool& materialNames = ourScene.materialNames;
 
 	std::vector<std::string> files;
 	std::vector<std::string> opacityMaps;
@@ -828,7 +923,7 @@ void processScene(const SceneConfig& cfg)
 		aiMaterial* mm = scene->mMaterials[m];
 
 		printf("Material [%s] %u\n", mm->GetName().C_Str(), m);
-		materialNames.push_back(std::string(mm->GetName().C_Str()));
+		materialNames.add(mm->GetName().C_Str());
 
 		MaterialData D = convertAIMaterialToMaterialData(mm, files, opacityMaps);
 		materials.push_back(D);
@@ -838,66 +933,83 @@ void processScene(const SceneConfig& cfg)
 	// Texture processing, rescaling and packing
 	convertAndDownscaleAllTextures(materials, basePath, files, opacityMaps);
 
-	saveMaterials(cfg.outputMaterials.c_str(), materials, files);
+	std::vector<uint32_t> textureArrays;
+	packTexturesIntoArrays(materials, files, textureArrays, cfg.packTextures);
+
+	saveMaterials(cfg.outputMaterials.c_str(), materials, files, textureArrays);
 
 	// Scene hierarchy conversion
 	traverse(scene, ourScene, scene->mRootNode, -1, 0);
 
+	// traverse() adds the nodes depth-first, transform updates sweep the scene level by level
+	reorderNodesByLevel(ourScene);
+
 	saveScene(cfg.outputScene.c_str(), ourScene);
 }
 
 /** Chapter9: Merge meshes (interior/exterior) */
-// void mergeBistro()
-// {
-// 	Scene scene1, scene2;
-// 	std::vector<Scene*> scenes = { &scene1, &scene2 };
-//
-// 	MeshData m1, m2;
-// 	MeshFileHeader header1 = loadMeshData("data/meshes/test.meshes", m1);
-// 	MeshFileHeader header2 = loadMeshData("data/meshes/test2.meshes", m2);
-//
-// 	std::vector<uint32_t> meshCounts = { header1.meshCount, header2.meshCount };
-//
-// 	loadScene("data/meshes/test.scene", scene1);
-// 	loadScene("data/meshes/test2.scene", scene2);
-//
-// 	Scene scene;
-// 	mergeScenes(scene, scenes, {}, meshCounts);
-//
-// 	MeshData meshData;
-// 	std::vector<MeshData*> meshDatas = { &m1, &m2 };
-//
-// 	MeshFileHeader header = mergeMeshData(meshData, meshDatas);
-//
-// 	// now the material lists:
-// 	std::vector<MaterialDescription> materials1, materials2;
-// 	std::vector<std::string> textureFiles1, textureFiles2;
-// 	loadMaterials("data/meshes/test.materials", materials1, textureFiles1);
-// 	loadMaterials("data/meshes/test2.materials", materials2, textureFiles2);
-//
-// 	std::vector<MaterialDescription> allMaterials;
-// 	std::vector<std::string> allTextures;
-//
-// 	mergeMaterialLists(
-// 		{ &materials1, &materials2 },
-// 		{ &textureFiles1, &textureFiles2 },
-// 		allMaterials, allTextures);
-//
-// 	saveMaterials("data/meshes/bistro_all.materials", allMaterials, allTextures);
-//
-// 	printf("[Unmerged] scene items: %d\n", (int)scene.hierarchy_.size());
-// 	mergeScene(scene, meshData, "Foliage_Linde_Tree_Large_Orange_Leaves");
-// 	printf("[Merged orange leaves] scene items: %d\n", (int)scene.hierarchy_.size());
-// 	mergeScene(scene, meshData, "Foliage_Linde_Tree_Large_Green_Leaves");
-// 	printf("[Merged green leaves]  scene items: %d\n", (int)scene.hierarchy_.size());
-// 	mergeScene(scene, meshData, "Foliage_Linde_Tree_Large_Trunk");
-// 	printf("[Merged trunk]  scene items: %d\n", (int)scene.hierarchy_.size());
-//
-// 	recalculateBoundingBoxes(meshData);
-//
-// 	saveMeshData("data/meshes/bistro_all.meshes", meshData);
-// 	saveScene("data/meshes/bistro_all.scene", scene);
-// }
+// merges the converted exterior and interior of the Bistro into a single scene which is drawn with one multi-draw, the
+// many small meshes of the trees are merged into one mesh per material
+void mergeBistro()
+{
+	const char* const prefixes[] = {"data/meshes/bistro_exterior", "data/meshes/bistro_interior"};
+
+	for (const char* prefix : prefixes)
+	{
+		if (!fs::exists(std::string(prefix) + ".meshes"))
+		{
+			printf("Skipping the merged Bistro, '%s' has not been converted\n", prefix);
+			return;
+		}
+	}
+
+	Scene                     scenes[2];
+	MeshData                  meshDatas[2];
+	std::vector<MaterialData> materials[2];
+	std::vector<std::string>  textureFiles[2];
+	std::vector<uint32_t>     textureArrays[2];
+	std::vector<uint32_t>     meshCounts;
+	std::vector<uint32_t>     materialCounts;
+
+	for (int i = 0; i != 2; i++)
+	{
+		const std::string prefix = prefixes[i];
+		if (!loadMeshData((prefix + ".meshes").c_str(), meshDatas[i]))
+			return;
+		meshCounts.push_back((uint32_t)meshDatas[i].meshes.size());
+		if (!loadScene((prefix + ".scene").c_str(), scenes[i]))
+			return;
+		if (!loadMaterials((prefix + ".materials").c_str(), materials[i], textureFiles[i], textureArrays[i]))
+			return;
+		materialCounts.push_back((uint32_t)materials[i].size());
+	}
+
+	Scene scene;
+	mergeScenes(scene, {&scenes[0], &scenes[1]}, {}, meshCounts, materialCounts);
+
+	MeshData meshData;
+	mergeMeshData(meshData, {&meshDatas[0], &meshDatas[1]});
+
+	// both parts share many textures, the merged list has every file once and is packed again
+	std::vector<MaterialData> allMaterials;
+	std::vector<std::string>  allFiles;
+	std::vector<uint32_t>     allTextureArrays;
+	mergeMaterialLists({&materials[0], &materials[1]}, {&textureFiles[0], &textureFiles[1]}, {&textureArrays[0], &textureArrays[1]}, allMaterials, allFiles);
+	packTexturesIntoArrays(allMaterials, allFiles, allTextureArrays, true);
+
+	saveMaterials("data/meshes/bistro_all.materials", allMaterials, allFiles, allTextureArrays);
+
+	printf("[Unmerged] scene items: %d\n", (int)scene.hierarchy.size());
+	mergeNodesWithMaterial(scene, meshData, "Foliage_Linde_Tree_Large_Orange_Leaves");
+	printf("[Merged orange leaves] scene items: %d\n", (int)scene.hierarchy.size());
+	mergeNodesWithMaterial(scene, meshData, "Foliage_Linde_Tree_Large_Green_Leaves");
+	printf("[Merged green leaves]  scene items: %d\n", (int)scene.hierarchy.size());
+	mergeNodesWithMaterial(scene, meshData, "Foliage_Linde_Tree_Large_Trunk");
+	printf("[Merged trunk]  scene items: %d\n", (int)scene.hierarchy.size());
+
+	saveMeshesToFile("data/meshes/bistro_all.meshes", meshData);
+	saveScene("data/meshes/bistro_all.scene", scene);
+}
 
 int main()
 {
@@ -911,7 +1023,7 @@ int main()
 	}
 
 	// Final step: optimize bistro scene
-	// mergeBistro();
+	mergeBistro();
 
 	return 0;
 }
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "argh.h"
+
+#include "OpenGL/GLApp.h"
+#include "OpenGL/GLMesh.h"
+#include "OpenGL/GLSceneData.h"
+#include "OpenGL/GLSceneTransforms.h"
+#include "Util/Scene.h"
+#include "Util/UtilsMath.h"
+
+using glm::vec3;
+
+static double getTimeMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static TRS getRandomTRS()
+{
+	TRS t;
+	t.rotation    = glm::angleAxis(randomFloat(0.0f, 2.0f * glm::pi<float>()), glm::normalize(randomVec(vec3(-1.0f), vec3(1.0f)) + vec3(0.0f, 1e-3f, 0.0f)));
+	t.translation = randomVec(vec3(-10.0f), vec3(10.0f));
+	t.scale       = randomVec(vec3(0.8f), vec3(1.25f));
+	// mirrored nodes
+	if (rand() % 16 == 0)
+		t.scale.x = -t.scale.x;
+	return t;
+}
+
+// a single triangle with interleaved position, uv and normal, the shapes only need a mesh to get model matrices
+static MeshData createTriangleMesh()
+{
+	MeshData m;
+
+	Mesh mesh;
+	mesh.lodCount             = 1;
+	mesh.streamCount          = 1;
+	mesh.vertexCount          = 3;
+	mesh.lodOffset[1]         = 3;
+	mesh.streamElementSize[0] = 8 * sizeof(float);
+	m.meshes.push_back(mesh);
+
+	m.indexData  = {0, 1, 2};
+	m.vertexData = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f
+	};
+	return m;
+}
+
+// a random hierarchy with a single root: half of the nodes continue a chain from the previous node, so that all levels
+// are used, the others get a random parent. A fraction of the nodes gets the triangle mesh.
+static void createScene(Scene& scene, uint32_t numNodes, float shapeFraction)
+{
+	addNode(scene, -1, 0);
+
+	for (uint32_t i = 1; i < numNodes; i++)
+	{
+		int parent = rand() % 2 ? (int)i - 1 : rand() % (int)i;
+		while (scene.hierarchy[parent].level == MAX_NODE_LEVEL - 1)
+			parent = scene.hierarchy[parent].parent;
+
+		const int node             = addNode(scene, parent, scene.hierarchy[parent].level + 1);
+		scene.localTransform[node] = getRandomTRS();
+	}
+
+	// the order the scenes are loaded in
+	reorderNodesByLevel(scene);
+	recalculateAllGlobalTransforms(scene);
+
+	// the nodes are final now, the components are added in increasing order
+	for (uint32_t node = 0; node != numNodes; node++)
+	{
+		if (randomFloat(0.0f, 1.0f) < shapeFraction)
+		{
+			scene.nodeIDToMeshID[node]     = 0;
+			scene.nodeIDToMaterialID[node] = 0;
+		}
+	}
+}
+
+// the largest difference of the elements, relative to the larger of both elements but at least 1
+static float getMaxDifference(const std::vector<glm::mat4x3>& a, const std::vector<glm::mat4x3>& b)
+{
+	float maxDiff = 0.0f;
+	for (size_t i = 0; i != a.size(); i++)
+		for (int c = 0; c != 4; c++)
+			for (int r = 0; r != 3; r++)
+			{
+				const float x = a[i][c][r];
+				const float y = b[i][c][r];
+				maxDiff       = std::max(maxDiff, std::abs(x - y) / std::max({1.0f, std::abs(x), std::abs(y)}));
+			}
+	return maxDiff;
+}
+
+int main(int argc, char** argv)
+{
+	argh::parser cmdl(argc, argv);
+
+	uint32_t numNodes = 0, numHierarchies = 0, numFrames = 0, seed = 0;
+	float    changedFraction = 0.0f, shapeFraction = 0.0f, tolerance = 0.0f;
+
+	cmdl("--nodes", 100000) >> numNodes;
+	cmdl("--hierarchies", 8) >> numHierarchies;
+	cmdl("--frames", 16) >> numFrames;
+	cmdl("--changed", 0.01f) >> changedFraction;
+	cmdl("--shapes", 0.25f) >> shapeFraction;
+	cmdl("--tolerance", 1e-4f) >> tolerance;
+	cmdl("--seed", 1) >> seed;
+
+	numNodes = std::max(numNodes, 1u);
+
+	// GLApp only needs to know that there is no window, its own options would clash with the ones of the tool
+	char  headless[] = "--headless";
+	char* appArgs[]  = {argv[0], headless};
+	GLApp app(2, appArgs);
+
+	srand(seed);
+
+	float  maxDiff = 0.0f;
+	double cpuMs   = 0.0;
+	double gpuMs   = 0.0;
+
+	float  maxModelDiff = 0.0f;
+	size_t numShapes    = 0;
+
+	std::vector<glm::mat4x3> gpuTransforms;
+	std::vector<glm::mat4x3> gpuModels;
+	std::vector<glm::mat4x3> cpuModels;
+
+	for (uint32_t h = 0; h != numHierarchies; h++)
+	{
+		Scene newScene;
+		createScene(newScene, numNodes, shapeFraction);
+
+		GLSceneData sceneData(createTriangleMesh(), std::move(newScene), {MaterialData()});
+		Scene&      scene = sceneData.mScene;
+		numShapes += sceneData.mShapes.size();
+
+		GLSceneTransforms transforms(scene);
+		GLMesh            mesh(sceneData);
+
+		for (uint32_t f = 0; f != numFrames; f++)
+		{
+			const uint32_t numChanged = std::max((uint32_t)(changedFraction * numNodes), 1u);
+			for (uint32_t i = 0; i != numChanged; i++)
+			{
+				const int node             = rand() % (int)numNodes;
+				scene.localTransform[node] = getRandomTRS();
+				markAsChanged(scene, node);
+			}
+
+			// both versions get the same dirty lists, the CPU version clears them
+			std::vector<int> changedAtThisFrame[MAX_NODE_LEVEL];
+			std::copy(std::begin(scene.changedAtThisFrame), std::end(scene.changedAtThisFrame), std::begin(changedAtThisFrame));
+
+			double start = getTimeMs();
+			recalculateGlobalTransforms(scene);
+			cpuMs += getTimeMs() - start;
+
+			std::copy(std::begin(changedAtThisFrame), std::end(changedAtThisFrame), std::begin(scene.changedAtThisFrame));
+
+			glFinish();
+			start = getTimeMs();
+			transforms.update(scene);
+			mesh.updateModelMatrices(transforms);
+			glFinish();
+			gpuMs += getTimeMs() - start;
+
+			transforms.getGlobalTransforms(gpuTransforms);
+			maxDiff = std::max(maxDiff, getMaxDifference(scene.globalTransform, gpuTransforms));
+
+			// the model matrices of the shapes have to be the global transforms of their nodes
+			mesh.getModelMatrices(gpuModels);
+			cpuModels.resize(sceneData.mShapes.size());
+			for (size_t s = 0; s != sceneData.mShapes.size(); s++)
+				cpuModels[s] = scene.globalTransform[sceneData.mShapes[s].transformIndex];
+			maxModelDiff = std::max(maxModelDiff, getMaxDifference(cpuModels, gpuModels));
+		}
+	}
+
+	const uint32_t numUpdates = numHierarchies * numFrames;
+
+	printf("%u hierarchies of %u nodes and %zu shapes, %u updates\n", numHierarchies, numNodes, numShapes, numUpdates);
+	if (numUpdates)
+		printf("CPU: %.3f ms per update, GPU: %.3f ms per update\n", cpuMs / numUpdates, gpuMs / numUpdates);
+	printf("Largest difference: %g of the global transforms, %g of the model matrices (tolerance %g)\n", maxDiff, maxModelDiff, tolerance);
+
+	const bool failed = maxDiff > tolerance || maxModelDiff > tolerance;
+	if (failed)
+		printf("FAILED\n");
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "argh.h"
+
+#include "Raster/SoftwareRasterizer.h"
+#include "Util/Camera.h"
+#include "Util/Material.h"
+#include "Util/OcclusionBuffer.h"
+#include "Util/Scene.h"
+#include "Util/VtxData.h"
+
+using glm::mat4;
+using glm::vec3;
+
+// the projection of the large scene samples
+const float kFov   = 45.0f;
+const float kZNear = 0.1f;
+const float kZFar  = 1000.0f;
+
+// the same occluders as 15LargeScene
+const float kOccluderMinSize = 2.0f;
+
+int main(int argc, char** argv)
+{
+	argh::parser cmdl(argc, argv);
+
+	std::string scenePrefix, pathFileName, outputFileName, depthOutputFileName;
+	int         width = 0, height = 0;
+	uint32_t    numThreads = 0, numFrames = 0;
+	double      time       = 0.0;
+
+	cmdl("--scene", "data/meshes/bistro_exterior") >> scenePrefix;
+	cmdl("--width", 1280) >> width;
+	cmdl("--height", 720) >> height;
+	cmdl("--threads", 0) >> numThreads;
+	cmdl("--frames", 1) >> numFrames;
+	cmdl("--path", "") >> pathFileName;
+	cmdl("--time", 0.0) >> time;
+	cmdl("--output", "raster.png") >> outputFileName;
+	cmdl("--depth-output", "") >> depthOutputFileName;
+
+	MeshData meshData;
+	if (!loadMeshData((scenePrefix + ".meshes").c_str(), meshData))
+		return EXIT_FAILURE;
+	recalculateBoundingBoxes(meshData);
+
+	Scene scene;
+	if (!loadScene((scenePrefix + ".scene").c_str(), scene))
+		return EXIT_FAILURE;
+	// merged scenes have several roots
+	recalculateAllGlobalTransforms(scene);
+
+	std::vector<MaterialData> materials;
+	std::vector<std::string>  textureFiles;
+	std::vector<uint32_t>     textureArrays;
+	if (!loadMaterials((scenePrefix + ".materials").c_str(), materials, textureFiles, textureArrays))
+		return EXIT_FAILURE;
+
+	const std::vector<DrawData> shapes = getSceneShapes(scene, meshData);
+
+	// the start position of the samples unless a camera path is given
+	CameraPositionerFirstPerson positionerStart(vec3(-10.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+	CameraPositionerPath        positionerPath;
+	if (!pathFileName.empty())
+	{
+		if (!positionerPath.load(pathFileName.c_str()))
+		{
+			printf("Camera path '%s' is empty\n", pathFileName.c_str());
+			return EXIT_FAILURE;
+		}
+		positionerPath.setTime(time);
+	}
+
+	const mat4 view = pathFileName.empty() ? positionerStart.getViewMatrix() : positionerPath.getViewMatrix();
+	const mat4 proj = glm::perspective(kFov, width / (float)height, kZNear, kZFar);
+
+	SoftwareRasterizer rasterizer(width, height, numThreads);
+
+	double minMs = 1e30, sumMs = 0.0;
+	for (uint32_t i = 0; i < std::max(numFrames, 1u); i++)
+	{
+		rasterizer.render(meshData, shapes, scene.globalTransform, materials, view, proj);
+		const double ms = rasterizer.getStats().geometryMs + rasterizer.getStats().rasterMs;
+		minMs           = std::min(minMs, ms);
+		sumMs += ms;
+	}
+
+	const SoftwareRasterizer::Stats& stats = rasterizer.getStats();
+	printf("Rendered %dx%d: %u shapes (%u outside the frustum, %u alpha-tested skipped), %llu triangles, %llu set up, %llu binned\n",
+	       width, height, stats.numShapes, stats.numCulledShapes, stats.numSkippedShapes, (unsigned long long)stats.numTriangles,
+	       (unsigned long long)stats.numSetupTriangles, (unsigned long long)stats.numBinnedTriangles);
+	printf("Frame time: min %.2f ms, average %.2f ms over %u frames (last frame: geometry %.2f ms, raster %.2f ms)\n",
+	       minMs, sumMs / std::max(numFrames, 1u), std::max(numFrames, 1u), stats.geometryMs, stats.rasterMs);
+
+	// culling effectiveness against the shapes which actually cover pixels
+	OcclusionBuffer occlusionBuffer;
+	occlusionBuffer.begin(proj * view);
+	for (const DrawData& shape : shapes)
+	{
+		const mat4        model(scene.globalTransform[shape.transformIndex]);
+		const BoundingBox box   = meshData.boundingBoxes[shape.meshIndex].getTransformed(model);
+		const vec3        size  = box.max - box.min;
+		if ((materials[shape.materialIndex].flags & sMaterialFlags_AlphaTest) || std::max({size.x, size.y, size.z}) < kOccluderMinSize)
+			continue;
+		occlusionBuffer.rasterizeShape(meshData, shape, model);
+	}
+
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 frustumCorners[8];
+	getFrustumPlanes(proj * view, frustumPlanes);
+	getFrustumCorners(proj * view, frustumCorners);
+
+	const std::vector<uint32_t> coverage = rasterizer.getShapeCoverage((uint32_t)shapes.size());
+
+	uint32_t numVisible = 0, numInFrustum = 0, numKept = 0, numErrors = 0;
+	for (size_t i = 0; i != shapes.size(); i++)
+	{
+		const BoundingBox box       = meshData.boundingBoxes[shapes[i].meshIndex].getTransformed(mat4(scene.globalTransform[shapes[i].transformIndex]));
+		const bool        inFrustum = isBoxInFrustum(frustumPlanes, frustumCorners, box);
+		const bool        kept      = inFrustum && occlusionBuffer.isVisible(box);
+		numVisible += coverage[i] ? 1 : 0;
+		numInFrustum += inFrustum ? 1 : 0;
+		numKept += kept ? 1 : 0;
+		numErrors += coverage[i] && !kept ? 1 : 0;
+	}
+
+	printf("Culling: %u shapes cover pixels, %u inside the frustum, %u kept by the occlusion buffer (%llu occluder triangles), %u visible shapes culled\n",
+	       numVisible, numInFrustum, numKept, (unsigned long long)occlusionBuffer.getNumRasterizedTriangles(), numErrors);
+
+	if (!outputFileName.empty() && !rasterizer.saveAlbedo(outputFileName.c_str()))
+		return EXIT_FAILURE;
+	if (!depthOutputFileName.empty() && !rasterizer.saveDepth(depthOutputFileName.c_str(), kZNear, kZFar))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+#version 460 core
+
+// only writes depth
+
+void main()
+{
+}
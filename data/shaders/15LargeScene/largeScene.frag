@@ -5,6 +5,17 @@
 
 #include <data/shaders/15LargeScene/material.glsl>
 
+// GLMaterialPermutations compiles variants with MATERIAL_PERMUTATION defined and only the features of their materials.
+// Without it, this is an uber-shader that enables every feature and checks the material at runtime.
+#ifdef MATERIAL_PERMUTATION
+	#define MATERIAL_RUNTIME_CHECK(condition) true
+#else
+	#define MATERIAL_HAS_ALBEDO_MAP
+	#define MATERIAL_HAS_NORMAL_MAP
+	#define MATERIAL_ALPHA_TEST
+	#define MATERIAL_RUNTIME_CHECK(condition) (condition)
+#endif
+
 layout(std140, binding = 0) uniform PerFrameData
 {
 	mat4 view;
@@ -45,28 +56,35 @@ void main()
 	 // uint64_t values can be converted to any sampler or image type using constructors: sampler2DArray(some_uint64)
 	 // Thus, I delete the code to convert it to uvec2 
 
+	// all material textures are packed into texture arrays, so every map comes with a layer index
+
 	// fetch albedo
-	if (mtl.albedoMap > 0)
+#ifdef MATERIAL_HAS_ALBEDO_MAP
+	if (MATERIAL_RUNTIME_CHECK(mtl.albedoMap > 0))
 	{
-		// albedo = texture( sampler2D(unpackUint2x32(mtl.albedoMap)), v_tc); 
-		albedo = texture( sampler2D(mtl.albedoMap), v_tc); 
+		albedo = texture( sampler2DArray(mtl.albedoMap), vec3(v_tc, mtl.albedoLayer) ); 
 	}
-		
-	if (mtl.normalMap > 0)
+#endif
+
+#ifdef MATERIAL_HAS_NORMAL_MAP
+	if (MATERIAL_RUNTIME_CHECK(mtl.normalMap > 0))
 	{
-		// normalSample = texture( sampler2D(unpackUint2x32(mtl.normalMap)), v_tc).xyz;
-		normalSample = texture( sampler2D(mtl.normalMap), v_tc).xyz;
+		normalSample = texture( sampler2DArray(mtl.normalMap), vec3(v_tc, mtl.normalLayer) ).xyz;
 	}
-		
+#endif
 
+#ifdef MATERIAL_ALPHA_TEST
 	runAlphaTest(albedo.a, mtl.alphaTest);
+#endif
 
 	// world-space normal
 	vec3 n = normalize(v_worldNormal);
 
 	// normal mapping: skip missing normal maps
+#ifdef MATERIAL_HAS_NORMAL_MAP
 	if (length(normalSample) > 0.5)
 		n = perturbNormal(n, normalize(cameraPos.xyz - v_worldPos.xyz), normalSample, v_tc);
+#endif
 
 	vec3 lightDir = normalize(vec3(-1.0, 1.0, 0.1));
 
@@ -11,10 +11,7 @@ layout(std140, binding = 0) uniform PerFrameData
 	vec4 cameraPos;
 };
 
-layout(std430, binding = 1) restrict readonly buffer Matrices
-{
-	mat4 in_Model[];
-};
+#include <data/shaders/15LargeScene/modelMatrices.glsl>
 
 layout (location=0) in vec3 in_Vertex;
 layout (location=1) in vec2 in_TexCoord;
@@ -25,15 +22,17 @@ layout (location=1) out vec3 v_worldNormal;
 layout (location=2) out vec3 v_worldPos;
 layout (location=3) out flat uint matIdx;
 
+// the depth pre-pass computes the same position
+invariant gl_Position;
+
 void main()
 {
-	mat4 model = in_Model[gl_InstanceID];
-	mat4 MVP = proj * view * model;
+	mat3x4 model = in_Model[gl_BaseInstance];
 
-	gl_Position = MVP * vec4(in_Vertex, 1.0);
+	gl_Position = proj * view * vec4(transformPosition(model, in_Vertex), 1.0);
 
 	v_worldPos = (view * vec4(in_Vertex, 1.0)).xyz;
-	v_worldNormal = transpose(inverse(mat3(model))) * in_Normal;
+	v_worldNormal = transformNormal(model, in_Normal);
 	v_tc = in_TexCoord;
-	matIdx = gl_BaseInstance; // DrawElementsIndirectCommand::baseInstance
+	matIdx = in_CommandMaterials[gl_BaseInstance];
 }
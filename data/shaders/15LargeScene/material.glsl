@@ -17,4 +17,12 @@ struct MaterialData
 	uint64_t metallicRoughnessMap;
 	uint64_t normalMap;
 	uint64_t opacityMap;
+
+	// layers inside the texture arrays referenced by the maps
+	uint ambientOcclusionLayer;
+	uint emissiveLayer;
+	uint albedoLayer;
+	uint metallicRoughnessLayer;
+	uint normalLayer;
+	uint padding[3];
 };
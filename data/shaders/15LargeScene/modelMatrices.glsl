@@ -0,0 +1,30 @@
+// model matrices of GLMesh: the 3 rows of the affine matrix of every draw command, 48 bytes each, indexed with
+// gl_BaseInstance (gl_InstanceID is always 0, every command draws a single instance)
+layout(std430, binding = 1) restrict readonly buffer Matrices
+{
+	mat3x4 in_Model[];
+};
+
+// the material of every draw command of GLMesh, DrawElementsIndirectCommand::baseInstance is the index of the command
+layout(std430, binding = 0) restrict readonly buffer CommandMaterials
+{
+	uint in_CommandMaterials[];
+};
+
+vec3 transformPosition(mat3x4 model, vec3 pos)
+{
+	return vec4(pos, 1.0) * model;
+}
+
+// the cofactor matrix of the upper 3x3 is its transposed inverse scaled by the determinant, the sign of the
+// determinant keeps mirrored shapes facing out and the length goes away when the normal is normalized
+vec3 transformNormal(mat3x4 model, vec3 n)
+{
+	vec3 r0 = model[0].xyz;
+	vec3 r1 = model[1].xyz;
+	vec3 r2 = model[2].xyz;
+
+	mat3 cofactor = mat3(cross(r1, r2), cross(r2, r0), cross(r0, r1));
+
+	return (n * cofactor) * sign(dot(r0, cross(r1, r2)));
+}
@@ -0,0 +1,18 @@
+// the changed nodes of a level and the global transforms of GLSceneTransforms, the global transforms are the 3 rows of
+// the affine matrix of every node like the model matrices of GLMesh
+
+// GLSceneTransforms::NodeUpdate
+struct NodeUpdate
+{
+	vec4 rotation;
+	vec3 translation;
+	uint node;
+	vec3 scale;
+	uint padding;
+};
+
+layout(std430, binding = 7) restrict readonly buffer NodeUpdates
+{
+	uint       in_NumUpdates;
+	NodeUpdate in_Updates[];
+};
@@ -0,0 +1,40 @@
+#version 460 core
+
+#extension GL_ARB_bindless_texture : require
+#extension GL_ARB_gpu_shader_int64 : enable
+
+#include <data/shaders/15LargeScene/material.glsl>
+#include <data/shaders/16ShadowMapping/shadowCascades.glsl>
+
+layout(std430, binding = 2) restrict readonly buffer Materials
+{
+	MaterialData in_Materials[];
+};
+
+layout (location=0) in vec2 v_tc;
+layout (location=1) in vec3 v_worldNormal;
+layout (location=2) in vec3 v_worldPos;
+layout (location=3) in flat uint matIdx;
+
+layout (location=0) out vec4 out_FragColor;
+
+#include <data/shaders/15LargeScene/alphaTest.glsl>
+
+void main()
+{
+	MaterialData mtl = in_Materials[matIdx];
+
+	vec4 albedo = mtl.albedoColor;
+
+	if (mtl.albedoMap > 0)
+		albedo = texture( sampler2DArray(mtl.albedoMap), vec3(v_tc, mtl.albedoLayer) );
+
+	runAlphaTest(albedo.a, mtl.alphaTest);
+
+	float NdotL = max( dot( normalize(v_worldNormal), lightDir.xyz ), 0.0 );
+
+	// 2 == sMaterialFlags_ReceiveShadow
+	float shadow = (mtl.flags & 2) != 0 ? shadowFactor(v_worldPos) : 1.0;
+
+	out_FragColor = vec4( albedo.rgb * mix(0.3, 1.0, NdotL * shadow), 1.0 );
+};
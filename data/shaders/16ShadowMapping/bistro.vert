@@ -0,0 +1,27 @@
+#version 460 core
+
+#include <data/shaders/16ShadowMapping/shadowCascades.glsl>
+
+#include <data/shaders/15LargeScene/modelMatrices.glsl>
+
+layout (location=0) in vec3 in_Vertex;
+layout (location=1) in vec2 in_TexCoord;
+layout (location=2) in vec3 in_Normal;
+
+layout (location=0) out vec2 v_tc;
+layout (location=1) out vec3 v_worldNormal;
+layout (location=2) out vec3 v_worldPos;
+layout (location=3) out flat uint matIdx;
+
+void main()
+{
+	mat3x4 model = in_Model[gl_BaseInstance];
+	vec4 worldPos = vec4(transformPosition(model, in_Vertex), 1.0);
+
+	gl_Position = proj * view * worldPos;
+
+	v_worldPos = worldPos.xyz;
+	v_worldNormal = transformNormal(model, in_Normal);
+	v_tc = in_TexCoord;
+	matIdx = in_CommandMaterials[gl_BaseInstance];
+}
@@ -0,0 +1,55 @@
+// Per-frame data and cascaded shadow lookups shared by the scene shaders, must match PerFrameData in Main.cpp
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	mat4 light[4];      // view-projection matrix of every cascade
+	vec4 cascadeSplits; // view-space distances at which the cascades end
+	vec4 cameraPos;
+	vec4 lightDir;      // points towards the sun
+};
+
+// the cascades are the quadrants of a single shadow map atlas
+layout (binding = 1) uniform sampler2D textureShadow;
+
+vec2 getCascadeOffset(int cascade)
+{
+	return 0.5 * vec2(cascade & 1, cascade >> 1);
+}
+
+// kernelSize: kernelSize x kernelSize averaging square (odd number), the taps stay inside the quadrant of the cascade
+float PCF(int kernelSize, int cascade, vec2 shadowCoord, float depth)
+{
+	float size = 1.0 / float( textureSize(textureShadow, 0 ).x );
+	vec2 minUV = getCascadeOffset(cascade) + size;
+	vec2 maxUV = getCascadeOffset(cascade) + 0.5 - size;
+	float shadow = 0.0;
+	int range = kernelSize / 2;
+	for ( int v=-range; v<=range; v++ ) for ( int u=-range; u<=range; u++ )
+		shadow += (depth >= texture( textureShadow, clamp(shadowCoord + size * vec2(u, v), minUV, maxUV) ).r) ? 1.0 : 0.0;
+	return shadow / (kernelSize * kernelSize);
+}
+
+float shadowFactor(vec3 worldPos)
+{
+	float depth = -(view * vec4(worldPos, 1.0)).z;
+
+	int cascade = 0;
+	while (cascade < 3 && depth > cascadeSplits[cascade])
+		cascade++;
+
+	if (depth > cascadeSplits[cascade])
+		return 1.0;
+
+	// OpenGL's Z is in -1..1, the shadow map in 0..1
+	vec4 shadowCoord = light[cascade] * vec4(worldPos, 1.0);
+	vec3 coord = shadowCoord.xyz / shadowCoord.w * 0.5 + 0.5;
+
+	if (coord.z > 1.0)
+		return 1.0;
+
+	float depthBias = -0.001;
+	float shadowSample = PCF( 3, cascade, getCascadeOffset(cascade) + 0.5 * coord.xy, coord.z + depthBias );
+	return mix(1.0, 0.3, shadowSample);
+}
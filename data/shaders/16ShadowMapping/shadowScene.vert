@@ -0,0 +1,16 @@
+#version 460 core
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+};
+
+#include <data/shaders/15LargeScene/modelMatrices.glsl>
+
+layout (location=0) in vec3 in_Vertex;
+
+void main()
+{
+	gl_Position = proj * view * vec4(transformPosition(in_Model[gl_BaseInstance], in_Vertex), 1.0);
+}
@@ -0,0 +1,9 @@
+// a fullscreen depth-aware gaussian blur
+#version 460 core
+
+#include <data/shaders/17SSAO/bilateralBlur.glsl>
+
+void main()
+{
+	outColor = blurBilateral(vec2(1.0, 0.0));
+}
@@ -6,6 +6,9 @@ layout(location = 0) in vec2 uv;
 
 layout(location = 0) out vec4 outColor;
 
+#include <data/shaders/17SSAO/SSAOParams.glsl>
+
+// the depth buffer, or the min/max depth pyramid at reduced resolution (LINEAR_DEPTH)
 layout(binding = 0) uniform sampler2D texDepth;
 layout(binding = 1) uniform sampler2D texRotation;
 
@@ -21,32 +24,30 @@ const vec3 offsets[8] = vec3[8]
 	vec3( 0.5,  0.5,  0.5)
 );
 
-layout(std140, binding = 0) uniform SSAOParams
+// eye space depth
+float getDepth(vec2 uv)
 {
-	float scale;
-	float bias;
-	float zNear;
-	float zFar;
-	float radius;
-	float attScale;
-	float distScale;
-};
+#ifdef LINEAR_DEPTH
+	// the closest depth of the footprint, thin foreground objects do not vanish at low resolution
+	return -textureLod(texDepth, uv, depthLod).x;
+#else
+	return linearizeDepth(texture(texDepth, uv).x);
+#endif
+}
 
 void main()
 {
 	float size = 1.0 / float(textureSize(texDepth, 0 ).x);
     
 	// convert depth value to eye space
-	float Z     = (zFar*zNear) / (texture(texDepth, uv).x * (zFar-zNear) - zFar);
+	float Z     = getDepth(uv);
 	float att   = 0.0;
 	vec3  plane = texture(texRotation, uv * size / 4.0).xyz - vec3(1.0);
   
 	for ( int i = 0; i < 8; i++ )
 	{
 		vec3  rSample = reflect( offsets[i], plane );
-		float zSample = texture( texDepth, uv + radius*rSample.xy / Z ).x;
-
-		zSample = (zFar*zNear) / (zSample * (zFar-zNear) - zFar);
+		float zSample = getDepth( uv + radius*rSample.xy / Z );
         
 		float dist = max(zSample - Z, 0.0) / distScale;
 		float occl = 15.0 * max( dist * (2.0 - dist), 0.0 );
@@ -0,0 +1,26 @@
+// SSAO parameters, shares the uniform buffer with the per-frame data (see SSAOParams in 17SSAO)
+
+layout(std140, binding = 0) uniform SSAOParams
+{
+	float scale;
+	float bias;
+	float zNear;
+	float zFar;
+	float radius;
+	float attScale;
+	float distScale;
+	float depthLod;       // level of the depth pyramid matching the SSAO resolution
+	float depthThreshold; // relative depth difference at which the blur and the upsampling stop
+};
+
+// converts a depth buffer value to a (negative) eye space depth
+float linearizeDepth(float d)
+{
+	return (zFar*zNear) / (d * (zFar-zNear) - zFar);
+}
+
+// weight of a sample at depth z when filtering a pixel at depth zCenter, both linear
+float depthWeight(float z, float zCenter)
+{
+	return max(0.0, 1.0 - abs(z - zCenter) / (depthThreshold * zCenter));
+}
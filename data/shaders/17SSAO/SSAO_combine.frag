@@ -6,19 +6,51 @@ layout(location = 0) in vec2 uv;
 
 layout(location = 0) out vec4 outColor;
 
+#include <data/shaders/17SSAO/SSAOParams.glsl>
+
 layout(binding = 0) uniform sampler2D texScene;
 layout(binding = 1) uniform sampler2D texSSAO;
 
-layout(std140, binding = 0) uniform SSAOParams
+#ifdef UPSAMPLE
+layout(binding = 2) uniform sampler2D texDepth;         // full resolution depth buffer
+layout(binding = 3) uniform sampler2D texDepthLowRes;   // min/max depth pyramid
+
+// joint bilateral upsampling: the 4 low resolution texels around the pixel are weighted bilinearly and by how close
+// their depth is to the depth of the pixel, so that occlusion does not bleed over the edges of objects
+float upsampleSSAO()
 {
-	float scale;
-	float bias;
-};
+	vec2 size = vec2(textureSize(texSSAO, 0));
+	vec2 st   = uv * size - 0.5;
+	vec2 f    = fract(st);
+	vec2 base = (floor(st) + 0.5) / size;
+
+	float z = -linearizeDepth(texture(texDepth, uv).x);
+
+	vec4 bilinear = vec4((1.0-f.x)*(1.0-f.y), f.x*(1.0-f.y), (1.0-f.x)*f.y, f.x*f.y);
+
+	float ao     = 0.0;
+	float weight = 0.0;
+
+	for (int i = 0; i != 4; i++)
+	{
+		vec2  coord = base + vec2(i & 1, i >> 1) / size;
+		float w     = bilinear[i] * (depthWeight(textureLod(texDepthLowRes, coord, depthLod).x, z) + 1e-3);
+		ao     += textureLod(texSSAO, coord, 0).r * w;
+		weight += w;
+	}
+
+	return ao / weight;
+}
+#endif
 
 void main()
 {
 	vec4 color = texture(texScene, uv);
+#ifdef UPSAMPLE
+	float ssao = clamp( upsampleSSAO() + bias, 0.0, 1.0 );
+#else
 	float ssao = clamp( texture(texSSAO,  uv).r + bias, 0.0, 1.0 );
+#endif
 
 	outColor = vec4(
 		mix(color, color * ssao, scale).rgb,
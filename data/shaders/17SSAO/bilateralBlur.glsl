@@ -0,0 +1,40 @@
+// a separable gaussian blur which does not mix occlusion across depth discontinuities
+
+#include <data/shaders/17SSAO/SSAOParams.glsl>
+
+layout(location = 0) in  vec2 uv;
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D texSSAO;
+layout(binding = 1) uniform sampler2D texDepth; // min/max depth pyramid
+
+// a narrower kernel than BlurX/BlurY, every texel covers several pixels of the screen
+const vec2 gaussFilter[7] = vec2[](
+	vec2(-3.0,  1.0/64.0),
+	vec2(-2.0,  6.0/64.0),
+	vec2(-1.0, 15.0/64.0),
+	vec2( 0.0, 20.0/64.0),
+	vec2( 1.0, 15.0/64.0),
+	vec2( 2.0,  6.0/64.0),
+	vec2( 3.0,  1.0/64.0)
+);
+
+vec4 blurBilateral(vec2 direction)
+{
+	vec2  texelSize = direction / vec2(textureSize(texSSAO, 0));
+	float zCenter   = textureLod(texDepth, uv, depthLod).x;
+
+	float ao     = 0.0;
+	float weight = 0.0;
+
+	for (int i = 0; i < 7; i++)
+	{
+		vec2  coord = uv + gaussFilter[i].x * texelSize;
+		float w     = gaussFilter[i].y * depthWeight(textureLod(texDepth, coord, depthLod).x, zCenter);
+		ao     += textureLod(texSSAO, coord, 0).r * w;
+		weight += w;
+	}
+
+	// the center sample always has a non-zero weight
+	return vec4(vec3(ao / weight), 1.0);
+}
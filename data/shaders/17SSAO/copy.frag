@@ -1,3 +1,5 @@
+// copies the rendered scene when SSAO is disabled
+
 #version 460 core
 
 layout(location = 0) in vec2 uv;
@@ -8,9 +10,5 @@ layout(binding = 0) uniform sampler2D texScene;
 
 void main()
 {
-	vec4 color = texture(texScene, uv);
-
-	float luminance = dot(color, vec4(0.3, 0.6, 0.1, 0.0));
-
-	outColor = vec4(vec3(luminance), 1.0);
+	outColor = vec4(texture(texScene, uv).rgb, 1.0);
 }
@@ -0,0 +1,12 @@
+// HDR parameters, shares the uniform buffer with the per-frame data (see HDRParams in 18HDR)
+
+layout(std140, binding = 0) uniform HDRParams
+{
+	float exposure;
+	float maxWhite;
+	float bloomStrength;
+	float bloomThreshold;
+	float adaptationSpeedUp;   // 1/seconds
+	float adaptationSpeedDown; // 1/seconds
+	float deltaSeconds;
+};
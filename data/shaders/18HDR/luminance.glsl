@@ -0,0 +1,21 @@
+// log-average luminance of the frame, computed by luminanceReduce.comp and luminanceAdapt.comp
+// the CPU reference is in Core/Util/Luminance.cpp
+
+// pixels of a tile are reduced by one workgroup, every invocation reads 2x2 pixels
+const uint kLuminanceTileSize = 32;
+
+// keeps black pixels from sending the logarithm to -infinity
+const float kLuminanceLogDelta = 1e-4;
+
+layout(std430, binding = 3) buffer Luminance
+{
+	float adaptedLuminance; // negative until the first frame has been adapted to
+	float averageLuminance; // of the last frame
+	float partialSums[];    // sum of log(delta + L) of every tile
+};
+
+// Rec. 709
+float getLuminance(vec3 color)
+{
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
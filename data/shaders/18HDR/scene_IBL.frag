@@ -4,7 +4,7 @@
 #extension GL_ARB_bindless_texture : require
 #extension GL_ARB_gpu_shader_int64 : enable
 
-#include <data/shaders/chapter07/MaterialData.h>
+#include <data/shaders/15LargeScene/material.glsl>
 
 layout(std140, binding = 0) uniform PerFrameData
 {
@@ -27,25 +27,25 @@ layout (location=0) out vec4 out_FragColor;
 
 layout (binding = 5) uniform samplerCube texEnvMap;
 layout (binding = 6) uniform samplerCube texEnvMapIrradiance;
-layout (binding = 7) uniform sampler2D   texBRDF_LUT; // not used, but required to include PBR.sp
+layout (binding = 7) uniform sampler2D   texBRDF_LUT; // not used, but required to include PBR.glsl
 
-#include <data/shaders/chapter07/AlphaTest.h>
-#include <data/shaders/chapter06/PBR.sp>
+#include <data/shaders/15LargeScene/alphaTest.glsl>
+#include <data/shaders/15LargeScene/PBR.glsl>
 
 void main()
 {
 	MaterialData mtl = in_Materials[matIdx];
 
-	vec4 albedo = mtl.albedoColor_;
+	vec4 albedo = mtl.albedoColor;
 	vec3 normalSample = vec3(0.0, 0.0, 0.0);
 
 	// fetch albedo
-	if (mtl.albedoMap_ > 0)
-		albedo = texture( sampler2D(unpackUint2x32(mtl.albedoMap_)), v_tc);
-	if (mtl.normalMap_ > 0)
-		normalSample = texture( sampler2D(unpackUint2x32(mtl.normalMap_)), v_tc).xyz;
+	if (mtl.albedoMap > 0)
+		albedo = texture( sampler2DArray(mtl.albedoMap), vec3(v_tc, mtl.albedoLayer) );
+	if (mtl.normalMap > 0)
+		normalSample = texture( sampler2DArray(mtl.normalMap), vec3(v_tc, mtl.normalLayer) ).xyz;
 
-	runAlphaTest(albedo.a, mtl.alphaTest_);
+	runAlphaTest(albedo.a, mtl.alphaTest);
 
 	// world-space normal
 	vec3 n = normalize(v_worldNormal);
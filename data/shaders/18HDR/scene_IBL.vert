@@ -1,10 +1,6 @@
 ﻿//
 #version 460 core
 
-#extension GL_ARB_gpu_shader_int64 : enable
-
-#include <data/shaders/chapter07/MaterialData.h>
-
 layout(std140, binding = 0) uniform PerFrameData
 {
 	mat4 view;
@@ -12,10 +8,7 @@ layout(std140, binding = 0) uniform PerFrameData
 	vec4 cameraPos;
 };
 
-layout(std430, binding = 1) restrict readonly buffer Matrices
-{
-	mat4 in_Model[];
-};
+#include <data/shaders/15LargeScene/modelMatrices.glsl>
 
 layout (location=0) in vec3 in_Vertex;
 layout (location=1) in vec2 in_TexCoord;
@@ -28,13 +21,13 @@ layout (location=3) out flat uint matIdx;
 
 void main()
 {
-	mat4 model = in_Model[gl_InstanceID];
-	mat4 MVP = proj * view * model;
+	mat3x4 model = in_Model[gl_BaseInstance];
+	vec4 worldPos = vec4(transformPosition(model, in_Vertex), 1.0);
 
-	gl_Position = MVP * vec4(in_Vertex, 1.0);
+	gl_Position = proj * view * worldPos;
 
-	v_worldPos = (view * vec4(in_Vertex, 1.0)).xyz;
-	v_worldNormal = transpose(inverse(mat3(model))) * in_Normal;
+	v_worldPos = worldPos.xyz;
+	v_worldNormal = transformNormal(model, in_Normal);
 	v_tc = in_TexCoord;
-	matIdx = gl_BaseInstance;
+	matIdx = in_CommandMaterials[gl_BaseInstance];
 }
@@ -0,0 +1,12 @@
+#version 460 core
+
+layout (location=0) in vec3 dir;
+
+layout (location=0) out vec4 out_FragColor;
+
+layout (binding = 5) uniform samplerCube texEnvMap;
+
+void main()
+{
+	out_FragColor = vec4(texture(texEnvMap, dir).rgb, 1.0);
+};
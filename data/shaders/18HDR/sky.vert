@@ -0,0 +1,24 @@
+#version 460 core
+
+// the environment behind the scene: a fullscreen triangle on the far plane, looking up the cube map along the view rays
+// this must be used with glDrawArrays(GL_TRIANGLES, 0, 3) and glDepthFunc(GL_LEQUAL)
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	vec4 cameraPos;
+};
+
+layout (location=0) out vec3 dir;
+
+void main()
+{
+	vec2 pos = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+
+	gl_Position = vec4(pos, 1.0, 1.0);
+
+	// view ray in view space, rotated to world space
+	vec4 ray = inverse(proj) * vec4(pos, 1.0, 1.0);
+	dir = transpose(mat3(view)) * (ray.xyz / ray.w);
+}